@@ -1,26 +1,69 @@
+#include "app.hpp"
+#include "bindless_table.hpp"
 #include "debug_utils.hpp"
+#include "deletion_queue.hpp"
+#include "descriptor_allocator.hpp"
+#include "device_memory_allocator.hpp"
+#include "file_watcher.hpp"
+#include "frame_sync.hpp"
+#include "frustum_culling.hpp"
+#include "gpu_culling.hpp"
+#include "hash.hpp"
+#include "job_system.hpp"
+#include "mesh_loader.hpp"
+#include "mesh_optimizer.hpp"
+#include "parallel_command_recorder.hpp"
+#include "pipeline_cache.hpp"
+#include "pipeline_variants.hpp"
+#include "profiler.hpp"
+#include "render_graph.hpp"
+#include "shader_compiler.hpp"
+#include "staging_uploader.hpp"
+#include "texture_streamer.hpp"
+#include "transform_system.hpp"
+#include "uniform_ring_buffer.hpp"
+#include "vertex_formats.hpp"
+#include "vertex_layout.hpp"
 
 // shaders
 #include <cstdint> // have to include this here to pass 'uint32_t' to shaders
 #include "shader_bin/triangle_vert.hpp"
 #include "shader_bin/fill_triangle_frag.hpp"
 #include "shader_bin/sp_triangle_vert.hpp"
+#include "shader_bin/instanced_quad_vert.hpp"
+#include "shader_bin/bindless_triangle_vert.hpp"
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <glm/mat4x4.hpp>
 
+#include <charconv>
 #include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <future>
 #include <vector>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <unordered_set>
 #include <algorithm>
 #include <array>
+#include <numeric>
+#include <string>
+
+// Both come from CMakeLists.txt, hot reload compiles the sources in the tree with the compiler the build used
+#ifndef SHADER_SOURCE_DIR
+#define SHADER_SOURCE_DIR "shaders"
+#endif
+#ifndef GLSLANG_VALIDATOR_PATH
+#define GLSLANG_VALIDATOR_PATH "glslangValidator"
+#endif
 
 namespace
 {
@@ -30,7 +73,25 @@ namespace
     constexpr bool ENABLE_VALIDATION_LAYERS = true;
 #endif
 
-    constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+    // Upper bound of --frames-in-flight, each slot owns its own command buffer, sync objects and buffer partitions
+    constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+    // Per-frame partition of the uniform ring buffer, enough for thousands of per-draw UniformBufferObjects
+    constexpr VkDeviceSize UNIFORM_RING_FRAME_CAPACITY = 4 * 1024 * 1024;
+
+    // Below this many draws recording inline on the main thread beats fanning out to secondary command buffers
+    constexpr uint32_t PARALLEL_RECORDING_MIN_DRAWS = 512;
+    constexpr uint32_t MIN_DRAWS_PER_SECONDARY = 128;
+
+    // Instances covered by one indirect command. Smaller batches don't cost the GPU anything and leave room for
+    // culling them individually later on.
+    constexpr uint32_t INSTANCES_PER_INDIRECT_COMMAND = 1024;
+
+    // Staging memory shared by all uploads, recycled as upload batches complete
+    constexpr VkDeviceSize STAGING_RING_CAPACITY = 16 * 1024 * 1024;
+
+    // Texel bytes the texture streamer may copy per frame, a few milliseconds of transfer at worst on slow hardware
+    constexpr VkDeviceSize TEXTURE_UPLOAD_FRAME_BUDGET = 8 * 1024 * 1024;
 
     const std::vector<const char*> VALIDATION_LAYERS = {
         "VK_LAYER_LUNARG_standard_validation"
@@ -40,6 +101,12 @@ namespace
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
 
+    // Offscreen mode has nothing to present, so it doesn't need any device extension at all
+    const std::vector<const char*> HEADLESS_DEVICE_EXTENSIONS = {};
+
+    // Number of frames rendered in headless mode when --frames isn't given
+    constexpr uint32_t DEFAULT_HEADLESS_FRAME_COUNT = 1000;
+
     enum class ERRORS : uint32_t
     {
         // ReSharper disable once CppEnumeratorNeverUsed
@@ -55,6 +122,7 @@ namespace
         FAILED_TO_CREATE_GRAPHICS_PIPELINE,
         FAILED_TO_CREATE_FRAMEBUFFERS,
         FAILED_TO_CREATE_COMMAND_POOL,
+        FAILED_TO_CREATE_THREAD_COMMAND_POOLS,
         FAILED_TO_ALLOCATE_COMMAND_BUFFERS,
         FAILED_TO_BEGIN_RECORDING_COMMAND_BUFFER,
         FAILED_TO_END_RECORDING_COMMAND_BUFFER,
@@ -65,6 +133,22 @@ namespace
         FAILED_TO_FIND_SUITABLE_MEMORY_TYPE,
         FAILED_TO_ALLOCATE_VERTEX_BUFFER_MEMORY,
         FAILED_TO_CREATE_BUFFER,
+        FAILED_TO_CREATE_PIPELINE_CACHE,
+        FAILED_TO_CREATE_UNIFORM_RING_BUFFER,
+        FAILED_TO_CREATE_STAGING_UPLOADER,
+        FAILED_TO_UPLOAD_BUFFER,
+        UNIFORM_RING_BUFFER_OVERFLOW,
+        FAILED_TO_CREATE_DESCRIPTOR_POOL,
+        FAILED_TO_ALLOCATE_DESCRIPTOR_SETS,
+        FAILED_TO_CREATE_OFFSCREEN_IMAGE,
+        FAILED_TO_ALLOCATE_OFFSCREEN_IMAGE_MEMORY,
+        INVALID_COMMAND_LINE,
+        FAILED_TO_LOAD_MESH,
+        FAILED_TO_CREATE_PROFILER,
+        FAILED_TO_CREATE_GPU_CULLING,
+        FAILED_TO_CREATE_BINDLESS_TABLE,
+        FAILED_TO_CREATE_TEXTURE_STREAMER,
+        FAILED_TO_CREATE_RENDER_GRAPH,
         // ReSharper disable once CppEnumeratorNeverUsed
         END,
         FAILED_TO_CREATE_DESCRIPTOR_SET_LAYOUR,
@@ -74,16 +158,79 @@ namespace
         exit(static_cast<uint32_t>(error));
     }
 
-    std::vector<const char*> get_required_extensions() {
-        uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    void print_usage(const char* executable) {
+        std::cerr << "usage: " << executable << " [--headless] [--frames N] [--width W] [--height H]"
+            " [--frames-in-flight 1-4] [--present-mode auto|fifo|fifo-relaxed|mailbox|immediate] [--low-latency] [--fence-sync]"
+            " [--pipeline-cache PATH | --no-pipeline-cache] [--trace PATH]"
+            " [--hot-reload-shaders [--shader-dir DIR] [--shader-cache DIR | --no-shader-cache]]"
+            " [--quads N] [--quad-vertices N] [--draws N] [--uniform-updates N]"
+            " [--draw-mode per-object|instanced|indirect] [--mesh PATH.obj|gltf|glb|vmesh [--optimize-mesh]]"
+            " [--packed-vertices] [--cpu-culling] [--gpu-culling] [--material-variants N] [--bindless]"
+            " [--texture PATH.png|ktx2]...\n";
+    }
+
+    // The whole of value as a decimal uint32_t, anything else is a malformed command line
+    uint32_t parse_number(const char* executable, const char* value) {
+        uint32_t number = 0;
+        const char* end = value + strlen(value);
+        const auto result = std::from_chars(value, end, number);
+        if (result.ec != std::errc() || result.ptr != end) {
+            print_usage(executable);
+            quit_application(ERRORS::INVALID_COMMAND_LINE);
+        }
+        return number;
+    }
+
+    uint32_t parse_count(const char* executable, const char* value) {
+        const uint32_t count = parse_number(executable, value);
+        if (count == 0) {
+            print_usage(executable);
+            quit_application(ERRORS::INVALID_COMMAND_LINE);
+        }
+        return count;
+    }
+
+    const char* vk_present_mode_name(VkPresentModeKHR mode) {
+        switch (mode) {
+            case VK_PRESENT_MODE_IMMEDIATE_KHR: return present_mode_name(PresentMode::IMMEDIATE);
+            case VK_PRESENT_MODE_MAILBOX_KHR: return present_mode_name(PresentMode::MAILBOX);
+            case VK_PRESENT_MODE_FIFO_KHR: return present_mode_name(PresentMode::FIFO);
+            case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return present_mode_name(PresentMode::FIFO_RELAXED);
+            default: return "other";
+        }
+    }
+
+    double milliseconds(std::chrono::high_resolution_clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    double average(const std::vector<double>& values) {
+        return values.empty() ? 0.0 : std::accumulate(values.begin(), values.end(), 0.0) / double(values.size());
+    }
+
+    std::vector<const char*> get_required_extensions(bool headless) {
+        std::vector<const char*> extensions;
+        if (!headless) {
+            uint32_t glfwExtensionCount = 0;
+            const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
         if (ENABLE_VALIDATION_LAYERS) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
         }
         return extensions;
     }
 
+    bool has_instance_extension(const char* name) {
+        uint32_t extension_count = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, nullptr);
+        std::vector<VkExtensionProperties> extensions(extension_count);
+        vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, extensions.data());
+
+        return std::any_of(extensions.begin(), extensions.end(),
+            [name](const VkExtensionProperties& extension) { return strcmp(extension.extensionName, name) == 0; });
+    }
+
     VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* create_info,
                                           const VkAllocationCallbacks* allocator,
                                           VkDebugUtilsMessengerEXT* callback) {
@@ -110,67 +257,206 @@ namespace
         glm::mat4 proj;
     };
 
-    struct Vertex
+    // bindless_triangle.vert's push constants
+    struct DrawIndices
     {
-        glm::vec2 position;
-        glm::vec3 color;
-
-        static VkVertexInputBindingDescription get_binding_description() {
-            VkVertexInputBindingDescription binding_description = {};
-
-            binding_description.binding = 0;
-            binding_description.stride = sizeof(Vertex);
-            binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-            return binding_description;
-        }
-
-        static std::array<VkVertexInputAttributeDescription, 2> get_attribute_descriptions() {
-            std::array<VkVertexInputAttributeDescription, 2> attribute_descriptions = {};
+        uint32_t uniform_buffer;
+        // In vec4s from the start of the buffer
+        uint32_t uniform_offset;
+    };
 
-            attribute_descriptions[0].binding = 0;
-            attribute_descriptions[0].location = 0;
-            attribute_descriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-            attribute_descriptions[0].offset = offsetof(Vertex, position);
+    // Per-instance vertex stream of the instanced and indirect draw modes
+    struct InstanceData
+    {
+        glm::mat4 model;
+        glm::vec4 color;
+    };
+}
 
-            attribute_descriptions[1].binding = 0;
-            attribute_descriptions[1].location = 1;
-            attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-            attribute_descriptions[1].offset = offsetof(Vertex, color);
+// The model matrix takes locations 2 to 5, one per column
+template <> struct VertexLayout<InstanceData>
+{
+    static constexpr std::array<VertexAttribute, 2> attributes = {{
+        VERTEX_ATTRIBUTE(InstanceData, model, 2),
+        VERTEX_ATTRIBUTE(InstanceData, color, 6),
+    }};
+};
 
-            return attribute_descriptions;
-        }
+namespace
+{
+    struct SyntheticMesh
+    {
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> indices;
     };
 
-    const std::vector<Vertex> vertices = {
-        {{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
-        {{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
-        {{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
-        {{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}},
-    };
+    // Lays quad_count quads out on a square grid covering the tutorial's unit quad. Each quad is tessellated into a
+    // k x k vertex grid, k = round(sqrt(quad_vertices)) but at least 2, and gets the tutorial's corner colors
+    // interpolated across it. One quad with 4 vertices is exactly the original red/green/blue/white quad.
+    SyntheticMesh build_synthetic_mesh(uint32_t quad_count, uint32_t quad_vertices) {
+        const auto k = std::max(2u, uint32_t(std::lround(std::sqrt(double(quad_vertices)))));
+        const auto columns = uint32_t(std::ceil(std::sqrt(double(quad_count))));
+        const float cell = 1.f / float(columns);
+        // Leave a gap between quads so they stay distinguishable
+        const float quad_size = quad_count == 1 ? 1.f : cell * 0.9f;
+        const glm::vec3 corner_colors[4] = {{1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}, {0.f, 0.f, 1.f}, {1.f, 1.f, 1.f}};
+
+        SyntheticMesh mesh;
+        mesh.vertices.reserve(size_t(quad_count) * k * k);
+        mesh.indices.reserve(size_t(quad_count) * (k - 1) * (k - 1) * 6);
+        for (uint32_t quad = 0; quad < quad_count; quad++) {
+            const glm::vec2 origin(-0.5f + float(quad % columns) * cell, -0.5f + float(quad / columns) * cell);
+            const auto base = uint32_t(mesh.vertices.size());
+            for (uint32_t y = 0; y < k; y++) {
+                for (uint32_t x = 0; x < k; x++) {
+                    const float u = float(x) / float(k - 1);
+                    const float v = float(y) / float(k - 1);
+                    const glm::vec3 color = glm::mix(glm::mix(corner_colors[0], corner_colors[1], u),
+                                                     glm::mix(corner_colors[3], corner_colors[2], u), v);
+                    mesh.vertices.push_back({glm::vec3(origin + glm::vec2(u, v) * quad_size, 0.f), color});
+                }
+            }
+            for (uint32_t y = 0; y + 1 < k; y++) {
+                for (uint32_t x = 0; x + 1 < k; x++) {
+                    const uint32_t i00 = base + y * k + x;
+                    const uint32_t i10 = i00 + 1;
+                    const uint32_t i01 = i00 + k;
+                    const uint32_t i11 = i01 + 1;
+                    mesh.indices.insert(mesh.indices.end(), {i00, i10, i11, i11, i01, i00});
+                }
+            }
+        }
+        return mesh;
+    }
+}
 
-    const std::vector<uint16_t> indices = {
-        0,1,2,2,3,0
-    };
+ApplicationOptions parse_options(int argc, char** argv) {
+    ApplicationOptions options;
+    for (int i = 1; i < argc; i++) {
+        const std::string argument = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (argument == "--headless") {
+            options.headless = true;
+        } else if (argument == "--frames" && has_value) {
+            options.frame_count = parse_number(argv[0], argv[++i]);
+        } else if (argument == "--width" && has_value) {
+            options.width = parse_number(argv[0], argv[++i]);
+        } else if (argument == "--height" && has_value) {
+            options.height = parse_number(argv[0], argv[++i]);
+        } else if (argument == "--frames-in-flight" && has_value) {
+            options.frames_in_flight = parse_count(argv[0], argv[++i]);
+            if (options.frames_in_flight > MAX_FRAMES_IN_FLIGHT) {
+                print_usage(argv[0]);
+                quit_application(ERRORS::INVALID_COMMAND_LINE);
+            }
+        } else if (argument == "--present-mode" && has_value) {
+            const std::string mode = argv[++i];
+            bool known = false;
+            for (const auto candidate : {PresentMode::AUTO, PresentMode::FIFO, PresentMode::FIFO_RELAXED, PresentMode::MAILBOX,
+                                         PresentMode::IMMEDIATE}) {
+                if (mode == present_mode_name(candidate)) {
+                    options.present_mode = candidate;
+                    known = true;
+                }
+            }
+            if (!known) {
+                print_usage(argv[0]);
+                quit_application(ERRORS::INVALID_COMMAND_LINE);
+            }
+        } else if (argument == "--low-latency") {
+            options.low_latency = true;
+        } else if (argument == "--fence-sync") {
+            options.timeline_semaphores = false;
+        } else if (argument == "--pipeline-cache" && has_value) {
+            options.pipeline_cache_path = argv[++i];
+        } else if (argument == "--no-pipeline-cache") {
+            options.pipeline_cache_path.clear();
+        } else if (argument == "--hot-reload-shaders") {
+            options.shader_hot_reload = true;
+        } else if (argument == "--shader-dir" && has_value) {
+            options.shader_directory = argv[++i];
+        } else if (argument == "--shader-cache" && has_value) {
+            options.shader_cache_path = argv[++i];
+        } else if (argument == "--no-shader-cache") {
+            options.shader_cache_path.clear();
+        } else if (argument == "--trace" && has_value) {
+            options.trace_path = argv[++i];
+        } else if (argument == "--quads" && has_value) {
+            options.quad_count = parse_count(argv[0], argv[++i]);
+        } else if (argument == "--quad-vertices" && has_value) {
+            options.quad_vertices = parse_count(argv[0], argv[++i]);
+        } else if (argument == "--draws" && has_value) {
+            options.draw_count = parse_count(argv[0], argv[++i]);
+        } else if (argument == "--uniform-updates" && has_value) {
+            options.uniform_updates = parse_count(argv[0], argv[++i]);
+        } else if (argument == "--mesh" && has_value) {
+            options.mesh_path = argv[++i];
+        } else if (argument == "--optimize-mesh") {
+            options.optimize_mesh = true;
+        } else if (argument == "--packed-vertices") {
+            options.packed_vertices = true;
+        } else if (argument == "--cpu-culling") {
+            options.cpu_culling = true;
+        } else if (argument == "--gpu-culling") {
+            options.gpu_culling = true;
+        } else if (argument == "--bindless") {
+            options.bindless = true;
+        } else if (argument == "--texture" && has_value) {
+            options.texture_paths.emplace_back(argv[++i]);
+        } else if (argument == "--material-variants" && has_value) {
+            options.material_variants = parse_count(argv[0], argv[++i]);
+        } else if (argument == "--draw-mode" && has_value) {
+            const std::string mode = argv[++i];
+            if (mode == draw_mode_name(DrawMode::PER_OBJECT)) {
+                options.draw_mode = DrawMode::PER_OBJECT;
+            } else if (mode == draw_mode_name(DrawMode::INSTANCED)) {
+                options.draw_mode = DrawMode::INSTANCED;
+            } else if (mode == draw_mode_name(DrawMode::INDIRECT)) {
+                options.draw_mode = DrawMode::INDIRECT;
+            } else {
+                print_usage(argv[0]);
+                quit_application(ERRORS::INVALID_COMMAND_LINE);
+            }
+        } else {
+            print_usage(argv[0]);
+            quit_application(ERRORS::INVALID_COMMAND_LINE);
+        }
+    }
+    if (options.headless && options.frame_count == 0) {
+        options.frame_count = DEFAULT_HEADLESS_FRAME_COUNT;
+    }
+    return options;
 }
 
 class HelloTriangleApplication
 {
 public:
+    explicit HelloTriangleApplication(const ApplicationOptions& options) : options_(options), frames_in_flight_(options.frames_in_flight) {}
 
     void run() {
-        init_window();
-        if (!init_vulkan()) return;
+        const auto start_time = std::chrono::high_resolution_clock::now();
+        if (!options_.headless) init_window();
+        // Whatever was created stays alive until the process exits, cleanup() expects a complete setup
+        if (!init_vulkan()) {
+            std::cerr << "Failed to initialize Vulkan\n";
+            return;
+        }
+        report_.startup_seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+        std::cout << "Startup took " << report_.startup_seconds * 1000.0 << " ms\n";
+
         main_loop();
         cleanup();
+        report_.completed = true;
     }
 
+    const RunReport& report() const { return report_; }
+
 private:
     void init_window() {
         glfwInit();
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
         
-        window_ = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+        window_ = glfwCreateWindow(int(options_.width), int(options_.height), "Vulkan", nullptr, nullptr);
         glfwSetWindowUserPointer(window_, this);
         glfwSetFramebufferSizeCallback(window_, [](GLFWwindow* window, int width, int height) {
             const auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
@@ -213,13 +499,23 @@ private:
         application_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         application_info.pEngineName = "No Engine";
         application_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        application_info.apiVersion = VK_API_VERSION_1_0;
+        // 1.2 for timeline semaphores when the loader knows it. A 1.0 loader rejects anything above 1.0, and has no
+        // vkEnumerateInstanceVersion to ask.
+        uint32_t loader_version = VK_API_VERSION_1_0;
+        const auto enumerate_instance_version = PFN_vkEnumerateInstanceVersion(vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+        if (enumerate_instance_version != nullptr) enumerate_instance_version(&loader_version);
+        api_version_ = options_.timeline_semaphores && loader_version >= VK_API_VERSION_1_2 ? VK_API_VERSION_1_2 : VK_API_VERSION_1_0;
+        application_info.apiVersion = api_version_;
 
         VkInstanceCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
         create_info.pApplicationInfo = &application_info;
 
-        auto instance_extensions = get_required_extensions();
+        auto instance_extensions = get_required_extensions(options_.headless);
+        // Bindless needs it to ask the device about descriptor indexing
+        physical_device_properties2_ = options_.bindless &&
+            has_instance_extension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        if (physical_device_properties2_) instance_extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 
         create_info.enabledExtensionCount = uint32_t(instance_extensions.size());
         create_info.ppEnabledExtensionNames = instance_extensions.data();
@@ -266,6 +562,10 @@ private:
         return true;
     }
 
+    const std::vector<const char*>& required_device_extensions() const {
+        return options_.headless ? HEADLESS_DEVICE_EXTENSIONS : DEVICE_EXTENSIONS;
+    }
+
     bool check_device_extension_support(const VkPhysicalDevice& device) const {
         uint32_t extension_count = 0;
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
@@ -273,7 +573,8 @@ private:
         std::vector<VkExtensionProperties> available_extensions(extension_count);
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, available_extensions.data());
 
-        std::unordered_set<std::string> required_extensions(begin(DEVICE_EXTENSIONS), end(DEVICE_EXTENSIONS));
+        const auto& device_extensions = required_device_extensions();
+        std::unordered_set<std::string> required_extensions(begin(device_extensions), end(device_extensions));
 
         for(const auto& extension : available_extensions) {
             required_extensions.erase(extension.extensionName);
@@ -282,24 +583,44 @@ private:
         return required_extensions.empty();
     }
 
-    bool is_device_suitable(const VkPhysicalDevice& device) {
-        VkPhysicalDeviceProperties properties;
-        vkGetPhysicalDeviceProperties(device, &properties);
+    bool has_device_extension(const VkPhysicalDevice& device, const char* name) const {
+        uint32_t extension_count = 0;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+
+        std::vector<VkExtensionProperties> available_extensions(extension_count);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, available_extensions.data());
 
-        VkPhysicalDeviceFeatures features;
-        vkGetPhysicalDeviceFeatures(device, &features);
+        return std::any_of(available_extensions.begin(), available_extensions.end(),
+            [name](const VkExtensionProperties& extension) { return strcmp(extension.extensionName, name) == 0; });
+    }
 
+    bool is_device_suitable(const VkPhysicalDevice& device) {
         auto indices = find_queue_families(device);
 
         const auto device_extension_supported = check_device_extension_support(device);
-        bool swap_chain_is_adequate = false;
-        if(device_extension_supported) {
+        // Nothing gets presented in headless mode, so there is no swap chain to be adequate
+        bool swap_chain_is_adequate = options_.headless;
+        if(device_extension_supported && !options_.headless) {
             const auto swap_chain_support = query_swap_chain_support(device);
             swap_chain_is_adequate = !swap_chain_support.formats.empty() && !swap_chain_support.presentModes.empty();
         }
 
-        return VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU == properties.deviceType &&
-            features.geometryShader && indices.is_complete() && device_extension_supported && swap_chain_is_adequate;
+        // Any device type is fine (integrated GPUs and software ICDs like lavapipe included), the pipeline doesn't
+        // use geometry shaders. pick_physical_device() prefers faster device types when there is a choice.
+        return indices.is_complete() && device_extension_supported && swap_chain_is_adequate;
+    }
+
+    static int rate_device_type(const VkPhysicalDevice& device) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+
+        switch (properties.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 4;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 3;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 2;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: return 1;
+        default: return 0;
+        }
     }
 
     VkSurfaceFormatKHR choose_surface_format(const std::vector<VkSurfaceFormatKHR>& available_formats) {
@@ -316,13 +637,28 @@ private:
         return available_formats.at(0);
     }
 
-    VkPresentModeKHR choose_present_mode(const std::vector<VkPresentModeKHR> available_present_modes) {
-        auto best_mode = VK_PRESENT_MODE_FIFO_KHR;
-		for (const auto& present_mode : available_present_modes) {
-			if (present_mode == VK_PRESENT_MODE_MAILBOX_KHR) return present_mode;
-			if (present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR) best_mode = present_mode;
-		}
-        return best_mode;
+    VkPresentModeKHR choose_present_mode(const std::vector<VkPresentModeKHR> available_present_modes) const {
+        const auto available = [&](VkPresentModeKHR mode) {
+            return std::find(available_present_modes.begin(), available_present_modes.end(), mode) != available_present_modes.end();
+        };
+        switch (options_.present_mode) {
+            case PresentMode::AUTO:
+                if (available(VK_PRESENT_MODE_MAILBOX_KHR)) return VK_PRESENT_MODE_MAILBOX_KHR;
+                if (available(VK_PRESENT_MODE_IMMEDIATE_KHR)) return VK_PRESENT_MODE_IMMEDIATE_KHR;
+                break;
+            case PresentMode::FIFO_RELAXED:
+                if (available(VK_PRESENT_MODE_FIFO_RELAXED_KHR)) return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+                break;
+            case PresentMode::MAILBOX:
+                if (available(VK_PRESENT_MODE_MAILBOX_KHR)) return VK_PRESENT_MODE_MAILBOX_KHR;
+                break;
+            case PresentMode::IMMEDIATE:
+                if (available(VK_PRESENT_MODE_IMMEDIATE_KHR)) return VK_PRESENT_MODE_IMMEDIATE_KHR;
+                break;
+            case PresentMode::FIFO:
+                break;
+        }
+        return VK_PRESENT_MODE_FIFO_KHR;
     }
 
     VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities) const {
@@ -345,7 +681,9 @@ private:
         const VkSurfaceFormatKHR format_khr = choose_surface_format(swap_chain_support_details.formats);
         const VkPresentModeKHR present_mode_khr = choose_present_mode(swap_chain_support_details.presentModes);
         const VkExtent2D extent_2d = choose_swap_extent(swap_chain_support_details.capabilities);
-        uint32_t image_count = swap_chain_support_details.capabilities.minImageCount + 1;
+        // One spare image keeps acquire from waiting on the presentation engine, low latency gives it up so fewer
+        // frames can queue up in front of the display
+        uint32_t image_count = swap_chain_support_details.capabilities.minImageCount + (options_.low_latency ? 0 : 1);
         if(swap_chain_support_details.capabilities.maxImageCount > 0 && image_count > swap_chain_support_details.capabilities.maxImageCount) {
             image_count = swap_chain_support_details.capabilities.maxImageCount;
         }
@@ -371,16 +709,27 @@ private:
         create_info_khr.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         create_info_khr.presentMode = present_mode_khr;
         create_info_khr.clipped = VK_TRUE;
-        // Example of using oldSwapchain - if current swap chain becomes invalid or unoptimized, e.g. resize of main window,
-        // you'll need to create new swap chain and pass old one to oldSwapchain
-        create_info_khr.oldSwapchain = nullptr;
-        
-        if(vkCreateSwapchainKHR(device_, &create_info_khr, nullptr, &swapchain_) == VK_SUCCESS) {
+        // If current swap chain becomes invalid or unoptimized, e.g. resize of main window, the new one is created with the
+        // old one in oldSwapchain. That lets the presentation engine hand resources over instead of starting from scratch.
+        create_info_khr.oldSwapchain = swapchain_;
+
+        VkSwapchainKHR new_swapchain;
+        if(vkCreateSwapchainKHR(device_, &create_info_khr, nullptr, &new_swapchain) == VK_SUCCESS) {
+            // Frames already submitted may still present from the retired swap chain
+            if(swapchain_ != VK_NULL_HANDLE) {
+                retire([device = device_, old_swapchain = swapchain_] { vkDestroySwapchainKHR(device, old_swapchain, nullptr); });
+            }
+            swapchain_ = new_swapchain;
+
             vkGetSwapchainImagesKHR(device_, swapchain_, &image_count, nullptr);
             swap_chain_images_.resize(image_count);
             vkGetSwapchainImagesKHR(device_, swapchain_, &image_count, swap_chain_images_.data());
             format_ = format_khr.format;
             swap_chain_extent_ = extent_2d;
+            if (present_mode_name_ != vk_present_mode_name(present_mode_khr)) {
+                present_mode_name_ = vk_present_mode_name(present_mode_khr);
+                std::cout << "Present mode: " << present_mode_name_ << ", " << image_count << " swap chain images\n";
+            }
             return true;
         }
 
@@ -388,6 +737,57 @@ private:
         return false;
     }
 
+    // Headless replacement for the swap chain: a few color images the render pass draws into. They're filled in
+    // swap_chain_images_ so that image views, framebuffers and command buffers don't have to know the difference.
+    bool create_offscreen_images() {
+        const uint32_t image_count = frames_in_flight_;
+        format_ = VK_FORMAT_B8G8R8A8_UNORM;
+        swap_chain_extent_ = {options_.width, options_.height};
+        swap_chain_images_.resize(image_count);
+        offscreen_allocations_.resize(image_count);
+
+        for (uint32_t i = 0; i < image_count; i++) {
+            VkImageCreateInfo image_create_info = {};
+            image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            image_create_info.imageType = VK_IMAGE_TYPE_2D;
+            image_create_info.format = format_;
+            image_create_info.extent = {swap_chain_extent_.width, swap_chain_extent_.height, 1};
+            image_create_info.mipLevels = 1;
+            image_create_info.arrayLayers = 1;
+            image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+            image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            // TRANSFER_SRC so the result can be read back, e.g. to compare against a reference image
+            image_create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            const VkResult result = allocator_.create_image(image_create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                swap_chain_images_[i], offscreen_allocations_[i]);
+            if(result == VK_ERROR_FEATURE_NOT_PRESENT) {
+                quit_application(ERRORS::FAILED_TO_FIND_SUITABLE_MEMORY_TYPE);
+                return false;
+            }
+            if(result != VK_SUCCESS) {
+                quit_application(swap_chain_images_[i] == VK_NULL_HANDLE ? ERRORS::FAILED_TO_CREATE_OFFSCREEN_IMAGE : ERRORS::FAILED_TO_ALLOCATE_OFFSCREEN_IMAGE_MEMORY);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool create_render_targets() {
+        return options_.headless ? create_offscreen_images() : create_swap_chain();
+    }
+
+    // Queues destruction of an object that frames submitted so far may still be using
+    void retire(std::function<void()> deleter) {
+        deletion_queue_.push(submitted_frames_, std::move(deleter));
+    }
+
+    // Incremental resize: no vkDeviceWaitIdle, and only what depends on the swap chain images is rebuilt. The pipeline
+    // uses dynamic viewport/scissor, so it survives resizes. The frame graph hands out its cached render pass unless
+    // the surface format changed, only then does the pipeline have to follow. Retired objects are destroyed once
+    // their frames have completed.
     bool recreate_swap_chain() {
         int width = 0;
         int height = 0;
@@ -395,18 +795,30 @@ private:
             glfwGetFramebufferSize(window_, &width, &height);
             glfwWaitEvents();
         }
-        vkDeviceWaitIdle(device_);
 
-        cleanup_swap_chain();
+        retire([device = device_, image_views = swap_chain_image_views_] {
+            for (auto image_view : image_views) vkDestroyImageView(device, image_view, nullptr);
+        });
 
-        return
-            create_swap_chain() &&
-            create_image_views() &&
-            create_render_pass() &&
-            create_graphics_pipeline() &&
-            create_framebuffers() &&
-            create_uniform_buffers() &&
-            create_command_buffers();
+        const VkRenderPass old_render_pass = render_pass_;
+        if(!create_swap_chain() || !create_image_views() || !build_frame_graph()) return false;
+
+        if(render_pass_ != old_render_pass) {
+            wait_for_shader_reload();
+            pipeline_variants_.wait_idle();
+            // The old render pass stays cached in the frame graph until it's destroyed
+            retire([device = device_, pipeline = pipeline_, pipeline_layout = pipeline_layout_] {
+                vkDestroyPipeline(device, pipeline, nullptr);
+                vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+            });
+            if(!create_graphics_pipeline()) return false;
+        }
+
+        // The image count may have changed, and the old swap chain's presents may still be waiting on theirs
+        retire([device = device_, semaphores = render_finished_semaphores_] {
+            for (auto semaphore : semaphores) vkDestroySemaphore(device, semaphore, nullptr);
+        });
+        return create_render_finished_semaphores();
     }
 
     bool pick_physical_device() {
@@ -418,15 +830,24 @@ private:
         std::vector<VkPhysicalDevice> physicalDevices(device_count);
         vkEnumeratePhysicalDevices(instance_, &device_count, physicalDevices.data());
 
+        int best_rating = -1;
         for (const auto& device : physicalDevices) {
-            // TODO: check for multiple GPU's and select appropriate one (page 64)
-            if (is_device_suitable(device)) {
+            if (!is_device_suitable(device)) continue;
+
+            const int rating = rate_device_type(device);
+            if (rating > best_rating) {
+                best_rating = rating;
                 physical_device_ = device;
-                return true;
             }
         }
 
-        return false;
+        if (physical_device_ == nullptr) return false;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device_, &properties);
+        std::cout << "Using device: " << properties.deviceName << "\n";
+        report_.device_name = properties.deviceName;
+        return true;
     }
 
     bool create_logical_device() {
@@ -434,24 +855,68 @@ private:
 
         // [AP] NB: I'm drifting from tutorial on purpose as I'm using the same queue from graphics and presentation and
         // I don't need to create multiple queues
+        constexpr float queue_priority = 1.0f;
+        std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
+
         VkDeviceQueueCreateInfo queue_create_info = {};
         queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queue_create_info.queueFamilyIndex = indices.graphics_and_present_family;
         queue_create_info.queueCount = 1;
-
-        constexpr float queue_priority = 1.0f;
         queue_create_info.pQueuePriorities = &queue_priority;
+        queue_create_infos.push_back(queue_create_info);
+
+        // Uploads get a queue of their own when the device has a transfer-only (DMA) family
+        if (indices.has_dedicated_transfer()) {
+            queue_create_info.queueFamilyIndex = indices.transfer_family;
+            queue_create_infos.push_back(queue_create_info);
+        }
 
+        // Both only matter for DrawMode::INDIRECT, which falls back to one command per call / one command in total
+        VkPhysicalDeviceFeatures supported_features;
+        vkGetPhysicalDeviceFeatures(physical_device_, &supported_features);
         VkPhysicalDeviceFeatures device_features = {};
+        device_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+        device_features.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
+        multi_draw_indirect_ = supported_features.multiDrawIndirect == VK_TRUE;
+        draw_indirect_first_instance_ = supported_features.drawIndirectFirstInstance == VK_TRUE;
 
         VkDeviceCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-        create_info.pQueueCreateInfos = &queue_create_info;
-        create_info.queueCreateInfoCount = 1;
+        create_info.pQueueCreateInfos = queue_create_infos.data();
+        create_info.queueCreateInfoCount = uint32_t(queue_create_infos.size());
         create_info.pEnabledFeatures = &device_features;
 
-        create_info.enabledExtensionCount = static_cast<uint32_t>(DEVICE_EXTENSIONS.size());
-        create_info.ppEnabledExtensionNames = DEVICE_EXTENSIONS.data();
+        // Decided here already, the frame graph built before create_gpu_culling() needs to know
+        gpu_culling_active_ = options_.gpu_culling && options_.draw_mode == DrawMode::INDIRECT;
+        // Optional, GPU culling falls back to a single indirect draw without it
+        std::vector<const char*> device_extensions = required_device_extensions();
+        draw_indirect_count_supported_ = gpu_culling_active_ &&
+            has_device_extension(physical_device_, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        if (draw_indirect_count_supported_) device_extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        // Optional as well, per-object draws bind a descriptor set per draw without it
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing_features = BindlessTable::required_features();
+        bindless_active_ = options_.bindless && check_bindless_support();
+        if (bindless_active_) BindlessTable::enable_core_features(device_features);
+        if (bindless_active_) {
+            device_extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+            device_extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+            create_info.pNext = &descriptor_indexing_features;
+        }
+        // Optional as well, frames are tracked with a fence per frame slot without them
+        VkPhysicalDeviceTimelineSemaphoreFeatures timeline_features = {};
+        VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2_features = {};
+        frame_sync_mode_ = choose_frame_sync_mode(timeline_features, synchronization2_features);
+        if (frame_sync_mode_ != FrameSync::Mode::FENCES) {
+            timeline_features.pNext = const_cast<void*>(create_info.pNext);
+            create_info.pNext = &timeline_features;
+        }
+        if (frame_sync_mode_ == FrameSync::Mode::TIMELINE_SYNCHRONIZATION2) {
+            device_extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+            synchronization2_features.pNext = const_cast<void*>(create_info.pNext);
+            create_info.pNext = &synchronization2_features;
+        }
+        create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
+        create_info.ppEnabledExtensionNames = device_extensions.data();
 
         if constexpr  (ENABLE_VALIDATION_LAYERS) {
             create_info.enabledLayerCount = static_cast<uint32_t>(VALIDATION_LAYERS.size());
@@ -464,6 +929,9 @@ private:
             // The parameters are the logical device, queue family, queue index and a pointer to the variable to store the queue handle in.
             // Because we’re only creating a single queue from this family, we’ll simply use index 0.
             vkGetDeviceQueue(device_, indices.graphics_and_present_family, 0, &graphics_queue_);
+            vkGetDeviceQueue(device_, indices.transfer_family, 0, &transfer_queue_);
+            queue_families_ = indices;
+            std::cout << "Uploading on " << (indices.has_dedicated_transfer() ? "a dedicated transfer" : "the graphics") << " queue\n";
             return true;
         };
 
@@ -471,7 +939,99 @@ private:
         return false;
     }
 
+    // VK_EXT_descriptor_indexing with every feature BindlessTable needs, fills in bindless_limits_. Vulkan 1.2 drivers
+    // keep advertising the extension, so the instance can stay on 1.0.
+    bool check_bindless_support() {
+        if (options_.draw_mode != DrawMode::PER_OBJECT) {
+            std::cout << "Bindless descriptors only apply to per-object draws\n";
+            return false;
+        }
+        if (!physical_device_properties2_ ||
+            !has_device_extension(physical_device_, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) ||
+            !has_device_extension(physical_device_, VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+            std::cout << "No descriptor indexing, binding a descriptor set per draw\n";
+            return false;
+        }
+        const auto get_features2 = PFN_vkGetPhysicalDeviceFeatures2KHR(vkGetInstanceProcAddr(instance_, "vkGetPhysicalDeviceFeatures2KHR"));
+        const auto get_properties2 = PFN_vkGetPhysicalDeviceProperties2KHR(vkGetInstanceProcAddr(instance_, "vkGetPhysicalDeviceProperties2KHR"));
+        if (get_features2 == nullptr || get_properties2 == nullptr) return false;
+
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported_features = {};
+        supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2KHR features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features.pNext = &supported_features;
+        get_features2(physical_device_, &features);
+
+        bindless_limits_ = {};
+        bindless_limits_.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2KHR properties = {};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+        properties.pNext = &bindless_limits_;
+        get_properties2(physical_device_, &properties);
+        bindless_limits_.pNext = nullptr;
+
+        // The vertex shader addresses uniform blocks in vec4s
+        const bool blocks_addressable = properties.properties.limits.minUniformBufferOffsetAlignment % 16 == 0;
+        if (!BindlessTable::has_required_features(supported_features) || !blocks_addressable) {
+            std::cout << "Descriptor indexing without update-after-bind arrays, binding a descriptor set per draw\n";
+            return false;
+        }
+        if (!BindlessTable::has_core_features(features.features)) {
+            std::cout << "No dynamic indexing into descriptor arrays, binding a descriptor set per draw\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Timeline semaphores need Vulkan 1.2 from both the instance and the device, synchronization2 its KHR extension on
+    // top. Fills in the feature structs create_logical_device() enables.
+    FrameSync::Mode choose_frame_sync_mode(VkPhysicalDeviceTimelineSemaphoreFeatures& timeline_features,
+                                           VkPhysicalDeviceSynchronization2FeaturesKHR& synchronization2_features) {
+        if (!options_.timeline_semaphores) return FrameSync::Mode::FENCES;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device_, &properties);
+        const auto get_features2 = PFN_vkGetPhysicalDeviceFeatures2(vkGetInstanceProcAddr(instance_, "vkGetPhysicalDeviceFeatures2"));
+        if (api_version_ < VK_API_VERSION_1_2 || properties.apiVersion < VK_API_VERSION_1_2 || get_features2 == nullptr) {
+            std::cout << "No Vulkan 1.2, tracking frames with fences\n";
+            return FrameSync::Mode::FENCES;
+        }
+
+        const bool has_synchronization2 = has_device_extension(physical_device_, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+        timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        synchronization2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+        timeline_features.pNext = has_synchronization2 ? &synchronization2_features : nullptr;
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &timeline_features;
+        get_features2(physical_device_, &features);
+        timeline_features.pNext = nullptr;
+
+        if (timeline_features.timelineSemaphore != VK_TRUE) {
+            std::cout << "No timeline semaphores, tracking frames with fences\n";
+            return FrameSync::Mode::FENCES;
+        }
+        if (!has_synchronization2 || synchronization2_features.synchronization2 != VK_TRUE) return FrameSync::Mode::TIMELINE;
+        return FrameSync::Mode::TIMELINE_SYNCHRONIZATION2;
+    }
+
+    bool create_allocator() {
+        allocator_.init(physical_device_, device_);
+        return true;
+    }
+
+    bool create_pipeline_cache() {
+        if(!pipeline_cache_.init(physical_device_, device_, options_.pipeline_cache_path)) {
+            quit_application(ERRORS::FAILED_TO_CREATE_PIPELINE_CACHE);
+            return false;
+        }
+        return true;
+    }
+
     bool create_surface() {
+        if(options_.headless) return true;
+
         if(glfwCreateWindowSurface(instance_, window_, nullptr, &surface_) == VK_SUCCESS) {
             return true;
         }
@@ -508,22 +1068,180 @@ private:
         return true;
     }
 
-    VkShaderModule create_shader_module(const uint32_t * shader_code, uint32_t code_size) const {
+    // Null on failure, also called from the hot reload job
+    VkShaderModule create_shader_module(const uint32_t * shader_code, size_t code_size) const {
         VkShaderModuleCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
         create_info.codeSize = code_size;
         create_info.pCode = shader_code;
-        VkShaderModule shader_module;
+        VkShaderModule shader_module = VK_NULL_HANDLE;
         if(vkCreateShaderModule(device_, &create_info, nullptr, &shader_module) != VK_SUCCESS)
         {
-            quit_application(ERRORS::FAILED_TO_CREATE_SHADER_MODULE);
+            return VK_NULL_HANDLE;
         }
         return shader_module;
     }
 
+    std::string shader_source_path(const char* name) const {
+        return (options_.shader_directory.empty() ? std::string(SHADER_SOURCE_DIR) : options_.shader_directory) + "/" + name;
+    }
+
+    const char* vertex_shader_name() const {
+        if (options_.draw_mode != DrawMode::PER_OBJECT) return "instanced_quad.vert";
+        return bindless_active_ ? "bindless_triangle.vert" : "sp_triangle.vert";
+    }
+
+    // SPIR-V of the graphics pipeline's stages from their sources, straight from the shader cache when they're unchanged
+    bool compile_graphics_shaders(std::vector<uint32_t>& vertex_code, std::vector<uint32_t>& fragment_code, std::string& error) {
+        return shader_compiler_.compile(shader_source_path(vertex_shader_name()), {}, vertex_code, error) &&
+            shader_compiler_.compile(shader_source_path("fill_triangle.frag"), {}, fragment_code, error);
+    }
+
+    bool create_shader_compiler() {
+        if (!options_.shader_hot_reload) return true;
+        shader_compiler_.init(GLSLANG_VALIDATOR_PATH, options_.shader_cache_path);
+        shader_watcher_.watch(shader_source_path(vertex_shader_name()));
+        shader_watcher_.watch(shader_source_path("fill_triangle.frag"));
+        return true;
+    }
+
+    bool create_pipeline_variants() {
+        pipeline_variants_.init(device_, job_system_);
+        if (options_.material_variants > 1 && options_.draw_mode != DrawMode::PER_OBJECT) {
+            std::cout << "Material variants only apply to per-object draws\n";
+        } else if (options_.material_variants > 1) {
+            variant_pipelines_.resize(std::min(options_.material_variants, MATERIAL_VARIANT_COUNT));
+        }
+        return true;
+    }
+
     bool create_graphics_pipeline() {
-        auto vertex_module = create_shader_module(triangle_vert, sizeof(triangle_vert));
-        auto frag_module = create_shader_module(fill_triangle_frag, sizeof(fill_triangle_frag));
+        // With hot reload the sources are compiled (or their cached SPIR-V loaded) right away, so the pipeline matches
+        // the files on disk from the first frame on. The built-in SPIR-V is the fallback.
+        std::vector<uint32_t> vertex_code, fragment_code;
+        bool from_source = false;
+        if (options_.shader_hot_reload) {
+            std::string error;
+            from_source = compile_graphics_shaders(vertex_code, fragment_code, error);
+            if (from_source) {
+                std::cout << "Shaders: " << shader_compiler_.cache_hits() << " cache hits, "
+                    << shader_compiler_.compilations() << " compiled\n";
+            } else {
+                std::cerr << error << "\nUsing the built-in shaders\n";
+            }
+        }
+
+        if (!from_source) {
+            if (options_.draw_mode != DrawMode::PER_OBJECT) {
+                vertex_code.assign(std::begin(instanced_quad_vert), std::end(instanced_quad_vert));
+            } else if (bindless_active_) {
+                vertex_code.assign(std::begin(bindless_triangle_vert), std::end(bindless_triangle_vert));
+            } else {
+                vertex_code.assign(std::begin(sp_triangle_vert), std::end(sp_triangle_vert));
+            }
+            fragment_code.assign(std::begin(fill_triangle_frag), std::end(fill_triangle_frag));
+        }
+        auto vertex_module = create_shader_module(vertex_code.data(), vertex_code.size() * sizeof(uint32_t));
+        auto frag_module = create_shader_module(fragment_code.data(), fragment_code.size() * sizeof(uint32_t));
+        if (vertex_module == VK_NULL_HANDLE || frag_module == VK_NULL_HANDLE) {
+            quit_application(ERRORS::FAILED_TO_CREATE_SHADER_MODULE);
+            return false;
+        }
+
+        // Bindless draws have the table as their only set and push the indices of what they read
+        const VkDescriptorSetLayout set_layout = bindless_active_ ? bindless_table_.layout() : descriptor_set_layout_;
+        const VkPushConstantRange draw_indices_range = {VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawIndices)};
+
+        VkPipelineLayoutCreateInfo layout_create_info = {};
+        layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layout_create_info.setLayoutCount = 1;
+        layout_create_info.pSetLayouts = &set_layout;
+        layout_create_info.pushConstantRangeCount = bindless_active_ ? 1 : 0;
+        layout_create_info.pPushConstantRanges = bindless_active_ ? &draw_indices_range : nullptr;
+
+        if(vkCreatePipelineLayout(device_, &layout_create_info, nullptr, &pipeline_layout_) != VK_SUCCESS) {
+            quit_application(ERRORS::FAILED_TO_CREATE_PIPELINE_LAYOUT);
+            return false;
+        }
+
+        const auto creation_start = std::chrono::high_resolution_clock::now();
+        const VkResult result = build_graphics_pipeline(vertex_module, frag_module, render_pass_, pipeline_layout_, pipeline_);
+        vkDestroyShaderModule(device_, vertex_module, nullptr);
+        vkDestroyShaderModule(device_, frag_module, nullptr);
+        if(result != VK_SUCCESS) {
+            quit_application(ERRORS::FAILED_TO_CREATE_GRAPHICS_PIPELINE);
+            return false;
+        }
+
+        // Only the startup creation tells warm from cold, after that the in-memory cache is always warm
+        if (!pipeline_creation_reported_) {
+            const auto milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - creation_start).count();
+            std::cout << "Graphics pipeline created in " << milliseconds << " ms ("
+                << (pipeline_cache_.is_warm() ? "warm" : "cold") << " pipeline cache)\n";
+            pipeline_creation_reported_ = true;
+        }
+
+        reset_pipeline_variants(std::move(vertex_code), std::move(fragment_code));
+        return true;
+    }
+
+    // The material variants are pipeline_ with other fragment specialization constants. They get the shaders and the
+    // objects pipeline_ was built against, and are keyed by everything build_graphics_pipeline() depends on.
+    void reset_pipeline_variants(std::vector<uint32_t> vertex_code, std::vector<uint32_t> fragment_code) {
+        if (variant_pipelines_.empty()) return;
+
+        struct VariantState
+        {
+            std::vector<uint32_t> vertex_code;
+            std::vector<uint32_t> fragment_code;
+            VkRenderPass render_pass;
+            VkPipelineLayout pipeline_layout;
+        };
+        const auto state = std::make_shared<const VariantState>(
+            VariantState{std::move(vertex_code), std::move(fragment_code), render_pass_, pipeline_layout_});
+
+        const uint32_t vertex_input[] = {uint32_t(options_.draw_mode), options_.packed_vertices ? 1u : 0u};
+        uint64_t state_hash = fnv1a(state->vertex_code.data(), state->vertex_code.size() * sizeof(uint32_t));
+        state_hash = fnv1a(state->fragment_code.data(), state->fragment_code.size() * sizeof(uint32_t), state_hash);
+        state_hash = fnv1a(&state->render_pass, sizeof(VkRenderPass), state_hash);
+        state_hash = fnv1a(&state->pipeline_layout, sizeof(VkPipelineLayout), state_hash);
+        state_hash = fnv1a(vertex_input, sizeof(vertex_input), state_hash);
+
+        pipeline_variants_.reset(state_hash, [this, state](const VkSpecializationInfo& specialization) {
+            const VkShaderModule vertex_module = create_shader_module(state->vertex_code.data(), state->vertex_code.size() * sizeof(uint32_t));
+            const VkShaderModule frag_module = create_shader_module(state->fragment_code.data(), state->fragment_code.size() * sizeof(uint32_t));
+            VkPipeline pipeline = VK_NULL_HANDLE;
+            if (vertex_module != VK_NULL_HANDLE && frag_module != VK_NULL_HANDLE &&
+                build_graphics_pipeline(vertex_module, frag_module, state->render_pass, state->pipeline_layout, pipeline, &specialization) != VK_SUCCESS) {
+                pipeline = VK_NULL_HANDLE;
+            }
+            vkDestroyShaderModule(device_, vertex_module, nullptr);
+            vkDestroyShaderModule(device_, frag_module, nullptr);
+            return pipeline;
+        }, pipeline_, [this](VkPipeline pipeline) {
+            retire([device = device_, pipeline] { vkDestroyPipeline(device, pipeline, nullptr); });
+        });
+    }
+
+    // Per-object draws only. Objects get variants in contiguous ranges, so draws in object order switch pipelines at
+    // most material_variants - 1 times.
+    uint32_t object_material(uint32_t object) const {
+        return uint32_t(uint64_t(object) * variant_pipelines_.size() / options_.draw_count);
+    }
+
+    // This frame's pipeline of every material, the variants still being built use pipeline_
+    void resolve_variant_pipelines() {
+        for (uint32_t material = 0; material < variant_pipelines_.size(); material++) {
+            variant_pipelines_[material] = pipeline_variants_.get(material_variant(material));
+        }
+    }
+
+    // Everything but the shaders and the objects it's built against is fixed, so this only reads options_ and the
+    // pipeline cache and can run on a worker while the render loop goes on
+    VkResult build_graphics_pipeline(VkShaderModule vertex_module, VkShaderModule frag_module, VkRenderPass render_pass,
+                                     VkPipelineLayout pipeline_layout, VkPipeline& pipeline,
+                                     const VkSpecializationInfo* frag_specialization = nullptr) const {
+        const bool instanced = options_.draw_mode != DrawMode::PER_OBJECT;
 
         VkPipelineShaderStageCreateInfo vertex_stage_create_info = {};
         vertex_stage_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -538,44 +1256,46 @@ private:
         frag_stage_create_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         frag_stage_create_info.module = frag_module;
         frag_stage_create_info.pName = "main";
-        //  pSpecializationInfo is used to pass constants to shaders
-        // vertex_stage_create_info.pSpecializationInfo = nullptr;
+        // The material variant's feature toggles, null for the default material
+        frag_stage_create_info.pSpecializationInfo = frag_specialization;
         
         VkPipelineShaderStageCreateInfo shader_stages[] = {vertex_stage_create_info, frag_stage_create_info};
 
-        auto binding_description = Vertex::get_binding_description();
-        auto attribute_description = Vertex::get_attribute_descriptions();        
+        // Binding 0 is per vertex, binding 1 per instance and only used by the instanced shader
+        const VkVertexInputBindingDescription binding_descriptions[] = {
+            options_.packed_vertices ? vertex_binding_description<PackedVertex>(0) : vertex_binding_description<MeshVertex>(0),
+            vertex_binding_description<InstanceData>(1, VK_VERTEX_INPUT_RATE_INSTANCE)
+        };
+        std::vector<VkVertexInputAttributeDescription> attribute_descriptions;
+        if (options_.packed_vertices) {
+            for (const auto& attribute : vertex_attribute_descriptions<PackedVertex>(0)) attribute_descriptions.push_back(attribute);
+        } else {
+            for (const auto& attribute : vertex_attribute_descriptions<MeshVertex>(0)) attribute_descriptions.push_back(attribute);
+        }
+        if (instanced) {
+            for (const auto& attribute : vertex_attribute_descriptions<InstanceData>(1)) attribute_descriptions.push_back(attribute);
+        }
 
         VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info = {};
         vertex_input_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertex_input_state_create_info.vertexBindingDescriptionCount = 1;
-        vertex_input_state_create_info.pVertexBindingDescriptions = &binding_description;
-        vertex_input_state_create_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_description.size());
-        vertex_input_state_create_info.pVertexAttributeDescriptions = attribute_description.data();
+        vertex_input_state_create_info.vertexBindingDescriptionCount = instanced ? 2 : 1;
+        vertex_input_state_create_info.pVertexBindingDescriptions = binding_descriptions;
+        vertex_input_state_create_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
+        vertex_input_state_create_info.pVertexAttributeDescriptions = attribute_descriptions.data();
 
         VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info = {};
         input_assembly_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
         input_assembly_state_create_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         input_assembly_state_create_info.primitiveRestartEnable = VK_FALSE;
 
-        VkViewport viewport = {};
-        viewport.x = 0.f;
-        viewport.y = 0.f;
-        viewport.width = static_cast<float>(swap_chain_extent_.width);
-        viewport.height = static_cast<float>(swap_chain_extent_.height);
-        viewport.minDepth = 0.f;
-        viewport.maxDepth = 1.f;
-
-        VkRect2D scissor = {};
-        scissor.offset = {0, 0};
-        scissor.extent = swap_chain_extent_;
-
+        // Viewport and scissor are dynamic state (see below), so the pipeline doesn't depend on the swap chain extent and
+        // doesn't have to be rebuilt on resize. The counts still have to be given, the pointers are ignored.
         VkPipelineViewportStateCreateInfo viewport_state_create_info = {};
         viewport_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         viewport_state_create_info.viewportCount = 1;
-        viewport_state_create_info.pViewports = &viewport;
+        viewport_state_create_info.pViewports = nullptr;
         viewport_state_create_info.scissorCount = 1;
-        viewport_state_create_info.pScissors = &scissor;
+        viewport_state_create_info.pScissors = nullptr;
 
         VkPipelineRasterizationStateCreateInfo rasterization_state_create_info = {};
         rasterization_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -584,7 +1304,8 @@ private:
         rasterization_state_create_info.polygonMode = VK_POLYGON_MODE_FILL;
         rasterization_state_create_info.lineWidth = 1.f;
         rasterization_state_create_info.cullMode = VK_CULL_MODE_BACK_BIT;
-        rasterization_state_create_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
+        // The projection matrix flips Y, which turns the clockwise quad into a counter-clockwise one
+        rasterization_state_create_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
         
         rasterization_state_create_info.depthBiasEnable = VK_FALSE; // Optional
         rasterization_state_create_info.depthBiasConstantFactor = 0.f; // Optional
@@ -625,26 +1346,14 @@ private:
 
         VkDynamicState dynamic_states[] = {
             VK_DYNAMIC_STATE_VIEWPORT,
-            VK_DYNAMIC_STATE_LINE_WIDTH
+            VK_DYNAMIC_STATE_SCISSOR
         };
 
         VkPipelineDynamicStateCreateInfo dynamic_state_create_info = {};
         dynamic_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        dynamic_state_create_info.dynamicStateCount = 0;
+        dynamic_state_create_info.dynamicStateCount = static_cast<uint32_t>(std::size(dynamic_states));
         dynamic_state_create_info.pDynamicStates = dynamic_states;
 
-        VkPipelineLayoutCreateInfo layout_create_info = {};
-        layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        layout_create_info.setLayoutCount = 0; // Optional
-        layout_create_info.pSetLayouts = nullptr; // Optional
-        layout_create_info.pushConstantRangeCount = 0; // Optional
-        layout_create_info.pPushConstantRanges = nullptr; // Optional
-
-        if(vkCreatePipelineLayout(device_, &layout_create_info, nullptr, &pipeline_layout_) != VK_SUCCESS) {
-            quit_application(ERRORS::FAILED_TO_CREATE_PIPELINE_LAYOUT);
-            return false;
-        }
-
         VkGraphicsPipelineCreateInfo graphics_pipeline_create_info = {};
         graphics_pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
         graphics_pipeline_create_info.stageCount = 2;
@@ -656,94 +1365,125 @@ private:
         graphics_pipeline_create_info.pMultisampleState = &multisample_state_create_info;
         graphics_pipeline_create_info.pDepthStencilState = nullptr; // Optional
         graphics_pipeline_create_info.pColorBlendState = &color_blend_state_create_info;
-        graphics_pipeline_create_info.pDynamicState = nullptr; // Optional
+        graphics_pipeline_create_info.pDynamicState = &dynamic_state_create_info;
 
-        graphics_pipeline_create_info.layout = pipeline_layout_;
-        graphics_pipeline_create_info.renderPass = render_pass_;
+        graphics_pipeline_create_info.layout = pipeline_layout;
+        graphics_pipeline_create_info.renderPass = render_pass;
         graphics_pipeline_create_info.subpass = 0;
 
         graphics_pipeline_create_info.basePipelineHandle = nullptr; // Optional
         graphics_pipeline_create_info.basePipelineIndex = -1; // Optional
 
-        if(vkCreateGraphicsPipelines(device_, nullptr, 1, &graphics_pipeline_create_info, nullptr, &pipeline_) != VK_SUCCESS) {
-            quit_application(ERRORS::FAILED_TO_CREATE_GRAPHICS_PIPELINE);
-            return false;
+        return vkCreateGraphicsPipelines(device_, pipeline_cache_.handle(), 1, &graphics_pipeline_create_info, nullptr, &pipeline);
+    }
+
+    // Hot reload: a changed shader source starts a rebuild on a worker and the render loop keeps going with the
+    // current pipeline. Once the new one is ready it's swapped in here, between frames, and the old one retired.
+    // A shader that fails to compile leaves the current pipeline in place.
+    void update_shader_reload() {
+        if (!options_.shader_hot_reload) return;
+
+        if (shader_reload_.valid()) {
+            if (shader_reload_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return;
+            ShaderReload reload = shader_reload_.get();
+            if (reload.pipeline == VK_NULL_HANDLE) {
+                std::cerr << reload.error << "\nKeeping the current shaders\n";
+            } else if (reload.render_pass != render_pass_ || reload.pipeline_layout != pipeline_layout_) {
+                // The surface format changed meanwhile, and the pipeline rebuilt for it already used the new sources
+                vkDestroyPipeline(device_, reload.pipeline, nullptr);
+            } else {
+                retire([device = device_, pipeline = pipeline_] { vkDestroyPipeline(device, pipeline, nullptr); });
+                pipeline_ = reload.pipeline;
+                reset_pipeline_variants(std::move(reload.vertex_code), std::move(reload.fragment_code));
+                std::cout << "Shaders reloaded\n";
+            }
         }
 
-        vkDestroyShaderModule(device_, vertex_module, nullptr);
-        vkDestroyShaderModule(device_, frag_module, nullptr);
+        // Changes made during a rebuild show up in the next poll after it
+        if (shader_watcher_.poll().empty()) return;
+
+        auto promise = std::make_shared<std::promise<ShaderReload>>();
+        shader_reload_ = promise->get_future();
+        job_system_.submit([this, promise, render_pass = render_pass_, pipeline_layout = pipeline_layout_](uint32_t) {
+            ShaderReload reload;
+            reload.render_pass = render_pass;
+            reload.pipeline_layout = pipeline_layout;
+            if (compile_graphics_shaders(reload.vertex_code, reload.fragment_code, reload.error)) {
+                const VkShaderModule vertex_module = create_shader_module(reload.vertex_code.data(), reload.vertex_code.size() * sizeof(uint32_t));
+                const VkShaderModule frag_module = create_shader_module(reload.fragment_code.data(), reload.fragment_code.size() * sizeof(uint32_t));
+                if (vertex_module == VK_NULL_HANDLE || frag_module == VK_NULL_HANDLE ||
+                    build_graphics_pipeline(vertex_module, frag_module, render_pass, pipeline_layout, reload.pipeline) != VK_SUCCESS) {
+                    reload.pipeline = VK_NULL_HANDLE;
+                    reload.error = "Failed to create the reloaded graphics pipeline";
+                }
+                vkDestroyShaderModule(device_, vertex_module, nullptr);
+                vkDestroyShaderModule(device_, frag_module, nullptr);
+            }
+            promise->set_value(std::move(reload));
+        });
+    }
 
-        return true;
+    // Lets a rebuild in flight finish, before the objects it is built against go away
+    void wait_for_shader_reload() const {
+        if (shader_reload_.valid()) shader_reload_.wait();
     }
 
-    bool create_render_pass() {
-        VkAttachmentDescription attachment_description = {};
-        attachment_description.format = format_;
-        attachment_description.samples = VK_SAMPLE_COUNT_1_BIT;
-        attachment_description.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        attachment_description.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-        attachment_description.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        attachment_description.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-        VkAttachmentReference attachment_reference = {};
-        attachment_reference.attachment = 0;
-        attachment_reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-        VkSubpassDescription subpass_description = {};
-        subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        subpass_description.colorAttachmentCount = 1;
-        subpass_description.pColorAttachments = &attachment_reference;
-        // The index of the attachment in this array is directly referenced from the fragment
-        // shader with the layout(location = 0)out vec4 outColor directive!
-        
-        VkSubpassDependency subpass_dependency = {};
-        subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        subpass_dependency.dstSubpass = 0;
-        subpass_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        subpass_dependency.srcAccessMask = 0;
-        subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-        
-        
-        VkRenderPassCreateInfo render_pass_create_info = {};
-        render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        render_pass_create_info.attachmentCount = 1;
-        render_pass_create_info.pAttachments = &attachment_description;
-        render_pass_create_info.subpassCount = 1;
-        render_pass_create_info.pSubpasses = &subpass_description;
-        render_pass_create_info.dependencyCount = 1;
-        render_pass_create_info.pDependencies = &subpass_dependency;
-
-        if(vkCreateRenderPass(device_, &render_pass_create_info, nullptr, &render_pass_) != VK_SUCCESS) {
-            quit_application(ERRORS::FAILED_TO_CREATE_RENDER_PASS);
-            return false;
+    bool create_frame_graph() {
+        frame_graph_.init(device_, allocator_);
+        return build_frame_graph();
+    }
+
+    // The frame as render graph passes: streamed texture uploads, the GPU culling dispatch and the main pass drawing
+    // into the swap chain image. The graph derives the barriers in between and the main pass's render pass, which
+    // stays the same cached object across rebuilds as long as the format does.
+    bool build_frame_graph() {
+        frame_graph_.reset([this](std::function<void()> deleter) { retire(std::move(deleter)); });
+
+        // Offscreen images are never presented, leave them ready to be copied out instead
+        const ResourceAccess backbuffer_access = options_.headless ? ResourceAccess::TRANSFER_READ : ResourceAccess::PRESENT;
+        backbuffer_ = frame_graph_.import_image("backbuffer", format_, swap_chain_extent_, backbuffer_access, backbuffer_access);
+
+        if (!options_.texture_paths.empty()) {
+            // The streamer orders its own copies and transitions, the graph only has to run it first
+            const RenderGraph::PassId upload_pass = frame_graph_.add_pass("texture_upload", PassKind::TRANSFER,
+                [this](VkCommandBuffer command_buffer, const RenderGraph::PassContext&) { record_texture_uploads(command_buffer); });
+            frame_graph_.keep(upload_pass);
         }
 
-        return true;
-    }
+        RenderGraph::ResourceId culled_draws = 0;
+        if (gpu_culling_active_) {
+            // The frame slot's commands and instances, the slot's previous frame is done with them before recording.
+            // visible_count() reads the counter on the host.
+            culled_draws = frame_graph_.import_buffer("culled_draws", ResourceAccess::NONE, ResourceAccess::HOST_READ);
+            const RenderGraph::PassId cull_pass = frame_graph_.add_pass("cull", PassKind::COMPUTE,
+                [this](VkCommandBuffer command_buffer, const RenderGraph::PassContext&) {
+                    if (!gpu_culling_.record_cull(command_buffer, frame_descriptor_allocators_[current_frame], uint32_t(current_frame),
+                            options_.draw_count, index_count_, extract_frustum_planes(view_projection_), object_bounds_min_,
+                            object_bounds_max_)) {
+                        std::cerr << "No descriptor set for the culling pass\n";
+                        quit_application(ERRORS::FAILED_TO_ALLOCATE_DESCRIPTOR_SETS);
+                    }
+                });
+            frame_graph_.use(cull_pass, culled_draws, ResourceAccess::STORAGE_WRITE);
+        }
 
-    bool create_framebuffers() {
-        swap_chain_framebuffers_.resize(swap_chain_image_views_.size());
-        for (int i = 0; i <  swap_chain_image_views_.size(); i++){
-            VkImageView attachments[] = {swap_chain_image_views_[i]};
-            VkFramebufferCreateInfo framebuffer_create_info = {};
-            framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            // Specify which render pass this framebuffer needs to be compatible with
-            // Compatible = uses same number and type of attachments
-            framebuffer_create_info.renderPass = render_pass_;
-            // attachmentCount & pAttachments specify same objects that should be bound to respective attachment descriptions
-            // in the render pass pAttachment array
-            framebuffer_create_info.attachmentCount = 1;
-            framebuffer_create_info.pAttachments = attachments;
-            framebuffer_create_info.width = swap_chain_extent_.width;
-            framebuffer_create_info.height = swap_chain_extent_.height;
-            framebuffer_create_info.layers = 1;
-
-            if(vkCreateFramebuffer(device_, &framebuffer_create_info, nullptr, &swap_chain_framebuffers_[i]) != VK_SUCCESS) {
-                quit_application(ERRORS::FAILED_TO_CREATE_FRAMEBUFFERS);
-                return false;
-            }
+        main_pass_ = frame_graph_.add_pass("render_pass", PassKind::GRAPHICS,
+            [this](VkCommandBuffer command_buffer, const RenderGraph::PassContext& context) { record_main_pass(command_buffer, context); });
+        // Black with 100% opacity
+        const VkClearColorValue clear_color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+        frame_graph_.color_attachment(main_pass_, backbuffer_, &clear_color);
+        if (gpu_culling_active_) {
+            frame_graph_.use(main_pass_, culled_draws, ResourceAccess::INDIRECT_READ);
+            frame_graph_.use(main_pass_, culled_draws, ResourceAccess::VERTEX_READ);
         }
+
+        std::string error;
+        if (!frame_graph_.compile(error)) {
+            std::cerr << error << "\n";
+            quit_application(ERRORS::FAILED_TO_CREATE_RENDER_GRAPH);
+            return false;
+        }
+        render_pass_ = frame_graph_.render_pass(main_pass_);
         return true;
     }
 
@@ -753,7 +1493,8 @@ private:
         VkCommandPoolCreateInfo command_pool_create_info = {};
         command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         command_pool_create_info.queueFamilyIndex = indices.graphics_and_present_family;
-        command_pool_create_info.flags = 0; // Optional
+        // Command buffers are re-recorded every frame, so they have to be individually resettable
+        command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
         if(vkCreateCommandPool(device_, &command_pool_create_info, nullptr, &command_pool_)) {
             quit_application(ERRORS::FAILED_TO_CREATE_COMMAND_POOL);
@@ -763,8 +1504,33 @@ private:
         return true;
     }
 
+    // A command pool per worker thread and frame slot, for the secondary buffers draws are recorded into
+    bool create_thread_command_pools() {
+        if(!command_recorder_.init(device_, uint32_t(queue_families_.graphics_and_present_family), frames_in_flight_, job_system_.thread_count())) {
+            quit_application(ERRORS::FAILED_TO_CREATE_THREAD_COMMAND_POOLS);
+            return false;
+        }
+        return true;
+    }
+
+    bool create_profiler() {
+        uint32_t queue_family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device_, &queue_family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device_, &queue_family_count, queue_families.data());
+
+        const uint32_t timestamp_valid_bits = queue_families[queue_families_.graphics_and_present_family].timestampValidBits;
+        if(!profiler_.init(physical_device_, device_, timestamp_valid_bits, frames_in_flight_, !options_.trace_path.empty())) {
+            quit_application(ERRORS::FAILED_TO_CREATE_PROFILER);
+            return false;
+        }
+        return true;
+    }
+
+    // One command buffer per frame in flight. They are recorded in draw_frame(), once the frame knows which image it
+    // renders to and where its uniform data ended up in the ring buffer.
     bool create_command_buffers() {
-        command_buffers_.resize(swap_chain_framebuffers_.size());
+        command_buffers_.resize(frames_in_flight_);
 
         VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
         command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -780,74 +1546,224 @@ private:
             return false;
         }
 
-        for (int i = 0; i < command_buffers_.size(); i++) {
+        return true;
+    }
+
+    // Pipeline, dynamic state and geometry shared by every draw mode
+    void bind_draw_state(VkCommandBuffer command_buffer) {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_);
+
+        VkViewport viewport = {};
+        viewport.x = 0.f;
+        viewport.y = 0.f;
+        viewport.width = static_cast<float>(swap_chain_extent_.width);
+        viewport.height = static_cast<float>(swap_chain_extent_.height);
+        viewport.minDepth = 0.f;
+        viewport.maxDepth = 1.f;
+        vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+        VkRect2D scissor = {};
+        scissor.offset = {0, 0};
+        scissor.extent = swap_chain_extent_;
+        vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+        VkBuffer vertex_buffers[] = {vertex_buffer_};
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(command_buffer, 0, 1, vertex_buffers, offsets);
+
+        vkCmdBindIndexBuffer(command_buffer, index_buffer_, 0, index_type_);
+    }
+
+    // Binds everything the draws need and issues entries [first_draw, end_draw) of this frame's draw list. Shared by the
+    // inline path and the secondary command buffers, which don't inherit any state from the primary one.
+    void record_draws(VkCommandBuffer command_buffer, uint32_t first_draw, uint32_t end_draw) {
+        bind_draw_state(command_buffer);
+        VkPipeline bound_pipeline = pipeline_;
+
+        // Same descriptor set for every draw, only the dynamic offset into the ring buffer changes. Bindless draws bind
+        // the table once and push the offset instead. Draws cycle through the frame's uniform updates when there are
+        // fewer updates than draws.
+        if (bindless_active_) bindless_table_.bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_);
+        for (uint32_t i = first_draw; i < end_draw; i++) {
+            const uint32_t draw = draw_list_[i];
+            if (!variant_pipelines_.empty()) {
+                const VkPipeline pipeline = variant_pipelines_[object_material(draw)];
+                if (pipeline != bound_pipeline) {
+                    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                    bound_pipeline = pipeline;
+                }
+            }
+            const uint32_t uniform_offset = draw_uniform_offsets_[draw % draw_uniform_offsets_.size()];
+            if (bindless_active_) {
+                const DrawIndices indices = {uniform_buffer_index_, uniform_offset / 16};
+                vkCmdPushConstants(command_buffer, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(indices), &indices);
+            } else {
+                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &descriptor_set_, 1, &uniform_offset);
+            }
+            vkCmdDrawIndexed(command_buffer, index_count_, 1, 0, 0, 0);
+        }
+    }
+
+    // All objects in one instanced draw, or a handful of indirect ones, or whatever the GPU culling pass kept. Transforms
+    // come from this frame's slice of the instance buffer, the uniform block only contributes view and projection.
+    void record_instanced_draws(VkCommandBuffer command_buffer) {
+        bind_draw_state(command_buffer);
+
+        const uint32_t uniform_offset = draw_uniform_offsets_[0];
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &descriptor_set_, 1, &uniform_offset);
+
+        if (gpu_culling_active_) {
+            gpu_culling_.record_draw(command_buffer, uint32_t(current_frame), 1);
+            return;
+        }
+
+        const VkDeviceSize instance_offset = VkDeviceSize(current_frame) * instance_frame_stride_;
+        vkCmdBindVertexBuffers(command_buffer, 1, 1, &instance_buffer_, &instance_offset);
+
+        if (options_.draw_mode == DrawMode::INSTANCED) {
+            vkCmdDrawIndexed(command_buffer, index_count_, instance_count_, 0, 0, 0);
+            return;
+        }
+
+        const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        if (multi_draw_indirect_) {
+            vkCmdDrawIndexedIndirect(command_buffer, indirect_buffer_, 0, indirect_command_count_, stride);
+            return;
+        }
+        // Without multiDrawIndirect drawCount has to be 0 or 1
+        for (uint32_t command = 0; command < indirect_command_count_; command++) {
+            vkCmdDrawIndexedIndirect(command_buffer, indirect_buffer_, VkDeviceSize(command) * stride, 1, stride);
+        }
+    }
+
+    uint32_t draw_calls_per_frame() const {
+        switch (options_.draw_mode) {
+            case DrawMode::PER_OBJECT: return options_.draw_count;
+            case DrawMode::INSTANCED: return 1;
+            case DrawMode::INDIRECT: return multi_draw_indirect_ || gpu_culling_active_ ? 1 : indirect_command_count_;
+        }
+        return 0;
+    }
+
+    // Splits the draw list into slices, records each slice into a secondary command buffer on the job system (every
+    // thread allocates from its own per-frame command pool) and executes them in draw list order
+    void record_draws_in_parallel(VkCommandBuffer primary_command_buffer, const RenderGraph::PassContext& context) {
+        const uint32_t draw_count = uint32_t(draw_list_.size());
+        const uint32_t slices_per_thread = 4;
+        const uint32_t draws_per_slice = std::max(MIN_DRAWS_PER_SECONDARY,
+            (draw_count + job_system_.thread_count() * slices_per_thread - 1) / (job_system_.thread_count() * slices_per_thread));
+        secondary_command_buffers_.assign((draw_count + draws_per_slice - 1) / draws_per_slice, VK_NULL_HANDLE);
+
+        command_recorder_.begin_frame(uint32_t(current_frame));
+
+        VkCommandBufferInheritanceInfo inheritance_info = {};
+        inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance_info.renderPass = context.render_pass;
+        inheritance_info.subpass = 0;
+        inheritance_info.framebuffer = context.framebuffer;
+
+        job_system_.parallel_for(draw_count, draws_per_slice, [&](uint32_t begin, uint32_t end, uint32_t thread_index) {
+            const VkCommandBuffer command_buffer = command_recorder_.acquire_secondary(thread_index);
+
             VkCommandBufferBeginInfo begin_info = {};
             begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            // The 'flags' parameter specifies how we’re going to use the command buffer. The following values are available:
-            // • VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT: The command buffer will be rerecorded right after executing it once.
-            // • VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT: This is a secondary command buffer that will be entirely within a single render pass.
-            // • VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT: The command buffer can be resubmitted while it is also already pending execution
-            begin_info.flags = 0; // Optional
-            // The pInheritanceInfo parameter is only relevant for secondary command buffers. It specifies which state to inherit from the calling primary command buffers.
-            begin_info.pInheritanceInfo = nullptr; // Optional
-            if(vkBeginCommandBuffer(command_buffers_[i], &begin_info) != VK_SUCCESS) {
+            begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            begin_info.pInheritanceInfo = &inheritance_info;
+            if(command_buffer == VK_NULL_HANDLE || vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
                 quit_application(ERRORS::FAILED_TO_BEGIN_RECORDING_COMMAND_BUFFER);
-                return false;
             }
 
-            VkRenderPassBeginInfo render_pass_begin_info = {};
-            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            render_pass_begin_info.renderPass = render_pass_;
-            render_pass_begin_info.framebuffer = swap_chain_framebuffers_[i];
-            render_pass_begin_info.renderArea.offset = {0, 0};
-            render_pass_begin_info.renderArea.extent = swap_chain_extent_;
-            // Black with 100% opacity
-            VkClearValue clear_color = {0.0f, 0.0f, 0.0f, 1.0f};
-            render_pass_begin_info.clearValueCount = 1;
-            render_pass_begin_info.pClearValues = &clear_color;
-
-            // • VK_SUBPASS_CONTENTS_INLINE: The render pass commands will be embedded in the primary command buffer itself and no secondary command buffers will be executed.
-            // • VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS: The render pass commands will be executed from secondary command buffers.
-            vkCmdBeginRenderPass(command_buffers_[i], &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-            vkCmdBindPipeline(command_buffers_[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_);
-
-            VkBuffer vertex_buffers[] = {vertex_buffer_};
-            VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(command_buffers_[i], 0, 1, vertex_buffers, offsets);
-
-            vkCmdBindIndexBuffer(command_buffers_[i], index_buffer_, 0, VK_INDEX_TYPE_UINT16);
-            
-            vkCmdDrawIndexed(command_buffers_[i], uint32_t(indices.size()), 1, 0, 0, 0);
-            
-            vkCmdEndRenderPass(command_buffers_[i]);
-
-            if(vkEndCommandBuffer(command_buffers_[i]) != VK_SUCCESS) {
+            record_draws(command_buffer, begin, end);
+
+            if(vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
                 quit_application(ERRORS::FAILED_TO_END_RECORDING_COMMAND_BUFFER);
-                return false;
             }
+            secondary_command_buffers_[begin / draws_per_slice] = command_buffer;
+        });
+
+        vkCmdExecuteCommands(primary_command_buffer, uint32_t(secondary_command_buffers_.size()), secondary_command_buffers_.data());
+    }
+
+    bool records_in_parallel() const {
+        return options_.draw_mode == DrawMode::PER_OBJECT && draw_list_.size() >= PARALLEL_RECORDING_MIN_DRAWS &&
+            job_system_.thread_count() > 1;
+    }
+
+    // The frame graph's main pass, inside its render pass
+    void record_main_pass(VkCommandBuffer command_buffer, const RenderGraph::PassContext& context) {
+        if (options_.draw_mode != DrawMode::PER_OBJECT) {
+            record_instanced_draws(command_buffer);
+        } else if (records_in_parallel()) {
+            record_draws_in_parallel(command_buffer, context);
+        } else {
+            record_draws(command_buffer, 0, uint32_t(draw_list_.size()));
         }
-        
+    }
+
+    bool record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index) {
+        Profiler::CpuZone zone(profiler_, "record");
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        // The 'flags' parameter specifies how we’re going to use the command buffer. The following values are available:
+        // • VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT: The command buffer will be rerecorded right after executing it once.
+        // • VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT: This is a secondary command buffer that will be entirely within a single render pass.
+        // • VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT: The command buffer can be resubmitted while it is also already pending execution
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        // The pInheritanceInfo parameter is only relevant for secondary command buffers. It specifies which state to inherit from the calling primary command buffers.
+        begin_info.pInheritanceInfo = nullptr; // Optional
+        // Beginning implicitly resets the buffer, the pool was created with VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
+        if(vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+            quit_application(ERRORS::FAILED_TO_BEGIN_RECORDING_COMMAND_BUFFER);
+            return false;
+        }
+
+        // Before recording starts, the recording threads only read the results
+        resolve_variant_pipelines();
+
+        profiler_.reset_gpu_zones(command_buffer);
+        frame_graph_.bind_image(backbuffer_, swap_chain_images_[image_index], swap_chain_image_views_[image_index]);
+        // • VK_SUBPASS_CONTENTS_INLINE: The render pass commands will be embedded in the primary command buffer itself and no secondary command buffers will be executed.
+        // • VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS: The render pass commands will be executed from secondary command buffers.
+        frame_graph_.set_subpass_contents(main_pass_, records_in_parallel() ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+        frame_graph_.execute(command_buffer, &profiler_);
+
+        if(vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+            quit_application(ERRORS::FAILED_TO_END_RECORDING_COMMAND_BUFFER);
+            return false;
+        }
+
         return true;
     }
 
+    // Frame completion is FrameSync's. What's left are the binary semaphores the swap chain needs: acquire signals
+    // one per frame slot, free again once the slot's frame has waited on it, present waits on one per swap chain
+    // image, free again once that image is acquired anew.
     bool create_sync_objects() {
-        image_available_semaphores_.resize(MAX_FRAMES_IN_FLIGHT);
-        render_finished_semaphores_.resize(MAX_FRAMES_IN_FLIGHT);
-        fences_.resize(MAX_FRAMES_IN_FLIGHT);
-        images_in_flight_.resize(swap_chain_images_.size(), nullptr);
-        
+        if(!frame_sync_.init(device_, frame_sync_mode_, frames_in_flight_)) {
+            quit_application(ERRORS::FAILED_TO_CREATE_SYNC_OBJECTS);
+            return false;
+        }
+        std::cout << "Frame sync: " << FrameSync::mode_name(frame_sync_mode_) << "\n";
+        if (options_.headless) return true;
+
+        image_available_semaphores_.resize(frames_in_flight_);
         VkSemaphoreCreateInfo semaphore_create_info = {};
         semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        for(uint32_t i = 0; i < frames_in_flight_; i++){
+            if(vkCreateSemaphore(device_, &semaphore_create_info, nullptr, &image_available_semaphores_[i]) != VK_SUCCESS) {
+                quit_application(ERRORS::FAILED_TO_CREATE_SYNC_OBJECTS);
+                return false;
+            }
+        }
+        return create_render_finished_semaphores();
+    }
 
-        VkFenceCreateInfo fence_create_info = {};
-        fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-        for(int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++){
-            if(vkCreateSemaphore(device_, &semaphore_create_info, nullptr, &image_available_semaphores_[i]) != VK_SUCCESS ||
-               vkCreateSemaphore(device_, &semaphore_create_info, nullptr, &render_finished_semaphores_[i]) != VK_SUCCESS ||
-               vkCreateFence(device_, &fence_create_info, nullptr, &fences_[i])
-               ) {
+    bool create_render_finished_semaphores() {
+        render_finished_semaphores_.resize(swap_chain_images_.size());
+        VkSemaphoreCreateInfo semaphore_create_info = {};
+        semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        for (auto& semaphore : render_finished_semaphores_) {
+            if(vkCreateSemaphore(device_, &semaphore_create_info, nullptr, &semaphore) != VK_SUCCESS) {
                 quit_application(ERRORS::FAILED_TO_CREATE_SYNC_OBJECTS);
                 return false;
             }
@@ -855,171 +1771,403 @@ private:
         return true;
     }
 
-    bool create_buffer(const VkDeviceSize size, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags property_flags, VkBuffer &buffer, VkDeviceMemory& device_memory) {     
+    // Memory comes out of the allocator's blocks, so this no longer costs a vkAllocateMemory per buffer.
+    // Host visible allocations are persistently mapped, see Allocation::mapped.
+    bool create_buffer(const VkDeviceSize size, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags property_flags, VkBuffer &buffer, Allocation& allocation) {
         VkBufferCreateInfo buffer_create_info = {};
         buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         buffer_create_info.size = size;
         buffer_create_info.usage = usage_flags;
         buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        
-        if(vkCreateBuffer(device_, &buffer_create_info, nullptr, &buffer) != VK_SUCCESS) {
-            quit_application(ERRORS::FAILED_TO_CREATE_BUFFER);
-            return false;
-        }
 
-        VkMemoryRequirements memory_requirements;
-        vkGetBufferMemoryRequirements(device_, buffer, &memory_requirements);
+        // Upload destinations are written on the transfer queue and read on the graphics queue. Concurrent sharing
+        // saves the queue family ownership transfer barriers on both sides.
+        const uint32_t sharing_families[] = {
+            uint32_t(queue_families_.graphics_and_present_family), uint32_t(queue_families_.transfer_family)
+        };
+        if ((usage_flags & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && queue_families_.has_dedicated_transfer()) {
+            buffer_create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            buffer_create_info.queueFamilyIndexCount = 2;
+            buffer_create_info.pQueueFamilyIndices = sharing_families;
+        }
 
-        VkMemoryAllocateInfo memory_allocate_info = {};
-        memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        memory_allocate_info.allocationSize = memory_requirements.size;
-        memory_allocate_info.memoryTypeIndex = find_memory_type(memory_requirements.memoryTypeBits, property_flags);
+        const VkResult result = allocator_.create_buffer(buffer_create_info, property_flags, buffer, allocation);
+        if(result == VK_ERROR_FEATURE_NOT_PRESENT) {
+            quit_application(ERRORS::FAILED_TO_FIND_SUITABLE_MEMORY_TYPE);
+            return false;
+        }
+        if(result != VK_SUCCESS) {
+            quit_application(buffer == VK_NULL_HANDLE ? ERRORS::FAILED_TO_CREATE_BUFFER : ERRORS::FAILED_TO_ALLOCATE_VERTEX_BUFFER_MEMORY);
+            return false;
+        }
+        return true;
+    }
 
-        if(vkAllocateMemory(device_, &memory_allocate_info, nullptr, &device_memory) != VK_SUCCESS) {
-            quit_application(ERRORS::FAILED_TO_ALLOCATE_VERTEX_BUFFER_MEMORY);
+    bool create_uploader() {
+        if(!uploader_.init(device_, allocator_, uint32_t(queue_families_.transfer_family), transfer_queue_, STAGING_RING_CAPACITY,
+                           frame_sync_mode_ != FrameSync::Mode::FENCES)) {
+            quit_application(ERRORS::FAILED_TO_CREATE_STAGING_UPLOADER);
             return false;
         }
+        return true;
+    }
 
-        vkBindBufferMemory(device_, buffer, device_memory, 0);
+    bool upload_buffer(VkBuffer dst, const void* data, VkDeviceSize size) {
+        if(!uploader_.upload_buffer(dst, 0, data, size)) {
+            quit_application(ERRORS::FAILED_TO_UPLOAD_BUFFER);
+            return false;
+        }
         return true;
     }
 
-    bool create_vertex_buffer() {
-        const VkDeviceSize buffer_size = sizeof(vertices[0]) * vertices.size();
+    // Creates the vertex and index buffers once the loader knows the mesh size and streams the parsed pieces into
+    // them through the uploader, from whichever loader thread produced them. With a quantization the vertices are
+    // packed on the way.
+    class SceneUploadSink : public MeshSink
+    {
+    public:
+        SceneUploadSink(HelloTriangleApplication& application, const VertexQuantization* quantization)
+            : application_(application), quantization_(quantization),
+              vertex_stride_(quantization ? sizeof(PackedVertex) : sizeof(MeshVertex)) {
+        }
+
+        bool begin(uint32_t vertex_count, uint32_t index_count, MeshIndexType index_type) override {
+            index_size_ = index_size(index_type);
+            // Zero sized buffers are invalid, an empty mesh still gets (unused) buffers
+            return
+                application_.create_buffer(std::max<VkDeviceSize>(VkDeviceSize(vertex_count) * vertex_stride_, 1),
+                    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    application_.vertex_buffer_, application_.vertex_allocation_) &&
+                application_.create_buffer(std::max<VkDeviceSize>(VkDeviceSize(index_count) * index_size_, 1),
+                    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    application_.index_buffer_, application_.index_allocation_);
+        }
+
+        bool write_vertices(uint32_t first_vertex, const MeshVertex* vertices, uint32_t count) override {
+            const void* data = vertices;
+            std::vector<PackedVertex> packed;
+            if (quantization_) {
+                packed.resize(count);
+                quantize_vertices(vertices, count, *quantization_, packed.data());
+                data = packed.data();
+            }
+            return application_.uploader_.upload_buffer(application_.vertex_buffer_, VkDeviceSize(first_vertex) * vertex_stride_,
+                data, VkDeviceSize(count) * vertex_stride_);
+        }
+
+        bool write_indices(uint32_t first_index, const void* indices, uint32_t count) override {
+            return application_.uploader_.upload_buffer(application_.index_buffer_, VkDeviceSize(first_index) * index_size_,
+                indices, VkDeviceSize(count) * index_size_);
+        }
+
+    private:
+        HelloTriangleApplication& application_;
+        const VertexQuantization* quantization_;
+        VkDeviceSize vertex_stride_;
+        uint32_t index_size_ = 0;
+    };
+
+    // Uploads a mesh that is completely in memory, packing the vertices relative to its bounds if requested
+    bool upload_mesh(const std::vector<MeshVertex>& vertices, const std::vector<uint32_t>& indices, MeshInfo& info) {
+        if (options_.packed_vertices) {
+            glm::vec3 bounds_min(std::numeric_limits<float>::max());
+            glm::vec3 bounds_max(std::numeric_limits<float>::lowest());
+            for (const auto& vertex : vertices) {
+                bounds_min = glm::min(bounds_min, vertex.position);
+                bounds_max = glm::max(bounds_max, vertex.position);
+            }
+            vertex_quantization_ = vertices.empty() ? VertexQuantization() : vertex_quantization_for_bounds(bounds_min, bounds_max);
+        }
+
+        SceneUploadSink sink(*this, options_.packed_vertices ? &vertex_quantization_ : nullptr);
+        return write_mesh(vertices.data(), uint32_t(vertices.size()), indices.data(), uint32_t(indices.size()), sink, info);
+    }
+
+    // Either the --mesh file or the synthetic quads. Loaded meshes are scaled and centered into the unit cube the
+    // camera looks at, the synthetic scene already is.
+    bool create_scene() {
+        const auto start_time = std::chrono::high_resolution_clock::now();
 
-        VkBuffer staging_buffer;
-        VkDeviceMemory staging_device_memory;
-        if(!create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_device_memory))
+        MeshInfo info;
+        if (options_.mesh_path.empty()) {
+            const SyntheticMesh mesh = build_synthetic_mesh(options_.quad_count, options_.quad_vertices);
+            if (!upload_mesh(mesh.vertices, mesh.indices, info)) {
+                quit_application(ERRORS::FAILED_TO_UPLOAD_BUFFER);
                 return false;
-        
-        void* data;
-        vkMapMemory(device_, staging_device_memory, 0, buffer_size, 0, &data);
-        memcpy(data, vertices.data(), buffer_size);
-        vkUnmapMemory(device_, staging_device_memory);
-        
-        if(!create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertex_buffer_, vertex_device_memory_))
+            }
+        } else {
+            std::string error;
+            bool loaded;
+            if (options_.optimize_mesh || options_.packed_vertices) {
+                // Optimizing needs the whole mesh and packing needs its bounds before the first vertex is written,
+                // so both load into memory first instead of streaming straight into the buffers
+                MeshData mesh;
+                loaded = load_mesh(options_.mesh_path, job_system_, mesh, info, error);
+                if (loaded) {
+                    if (options_.optimize_mesh) print_mesh_optimization_report(std::cout, optimize_mesh(mesh));
+                    loaded = upload_mesh(mesh.vertices, mesh.indices, info);
+                    if (!loaded) error = "upload failed";
+                }
+            } else {
+                SceneUploadSink sink(*this, nullptr);
+                loaded = load_mesh(options_.mesh_path, job_system_, sink, info, error);
+            }
+            if (!loaded) {
+                std::cerr << "Failed to load mesh: " << error << "\n";
+                quit_application(ERRORS::FAILED_TO_LOAD_MESH);
                 return false;
+            }
+
+            const glm::vec3 extent = info.bounds_max - info.bounds_min;
+            const float largest_extent = std::max(extent.x, std::max(extent.y, extent.z));
+            const float scale = largest_extent > 0.f ? 1.f / largest_extent : 1.f;
+            scene_transform_ = glm::translate(glm::scale(glm::mat4(1.f), glm::vec3(scale)), -0.5f * (info.bounds_min + info.bounds_max));
+
+            const auto seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+            std::cout << "Loaded " << options_.mesh_path << ": " << info.vertex_count << " vertices, "
+                << info.index_count / 3 << " triangles in " << seconds * 1000.0 << " ms\n";
+        }
 
-        copy_buffer(staging_buffer, vertex_buffer_, buffer_size);
-        vkDestroyBuffer(device_, staging_buffer, nullptr);
-        vkFreeMemory(device_, staging_device_memory, nullptr);
+        // Packed positions are in [-1, 1] relative to the bounds, undoing that is part of the model transform
+        object_bounds_min_ = info.bounds_min;
+        object_bounds_max_ = info.bounds_max;
+        if (options_.packed_vertices) {
+            scene_transform_ = scene_transform_ * glm::scale(glm::translate(glm::mat4(1.f), vertex_quantization_.center), vertex_quantization_.half_extent);
+            object_bounds_min_ = glm::vec3(-1.f);
+            object_bounds_max_ = glm::vec3(1.f);
+        }
+
+        vertex_count_ = info.vertex_count;
+        index_count_ = info.index_count;
+        index_type_ = info.index_type == MeshIndexType::UINT16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+        report_.vertex_stride = options_.packed_vertices ? sizeof(PackedVertex) : sizeof(MeshVertex);
         return true;
     }
 
-    void copy_buffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size) {
-        VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
-    	command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        command_buffer_allocate_info.commandPool = command_pool_;
-        command_buffer_allocate_info.commandBufferCount = 1;
+    // Static for the whole run: the object count never changes, so the commands are uploaded once like the geometry.
+    // Batches of INSTANCES_PER_INDIRECT_COMMAND instances each need drawIndirectFirstInstance, without it a single
+    // command covers all of them.
+    bool create_indirect_buffer() {
+        if (options_.draw_mode != DrawMode::INDIRECT) return true;
+
+        const uint32_t instances_per_command = draw_indirect_first_instance_ ? INSTANCES_PER_INDIRECT_COMMAND : options_.draw_count;
+        std::vector<VkDrawIndexedIndirectCommand> commands;
+        for (uint32_t first_instance = 0; first_instance < options_.draw_count; first_instance += instances_per_command) {
+            VkDrawIndexedIndirectCommand command = {};
+            command.indexCount = index_count_;
+            command.instanceCount = std::min(instances_per_command, options_.draw_count - first_instance);
+            command.firstIndex = 0;
+            command.vertexOffset = 0;
+            command.firstInstance = first_instance;
+            commands.push_back(command);
+        }
+        indirect_command_count_ = uint32_t(commands.size());
 
-        VkCommandBuffer command_buffer;
-        vkAllocateCommandBuffers(device_, &command_buffer_allocate_info, &command_buffer);
+        const VkDeviceSize buffer_size = sizeof(commands[0]) * commands.size();
+        if(!create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indirect_buffer_, indirect_allocation_))
+                return false;
 
-        VkCommandBufferBeginInfo command_buffer_begin_info = {};
-        command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        return upload_buffer(indirect_buffer_, commands.data(), buffer_size);
+    }
 
-        vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
+    // Rewritten by the CPU every frame, so it lives in host visible memory with one slice per frame in flight. Slices
+    // start at storage buffer offset alignment, GPU culling reads them through descriptors.
+    bool create_instance_buffer() {
+        if (options_.draw_mode == DrawMode::PER_OBJECT) return true;
 
-        VkBufferCopy copy_region = {};
-        copy_region.srcOffset = 0; // Optional
-        copy_region.dstOffset = 0; // Optional
-        copy_region.size = size;
-        vkCmdCopyBuffer(command_buffer, src_buffer, dst_buffer, 1, &copy_region);
+        const VkDeviceSize alignment = std::max<VkDeviceSize>(allocator_.limits().minStorageBufferOffsetAlignment, 1);
+        instance_frame_stride_ = (options_.draw_count * sizeof(InstanceData) + alignment - 1) / alignment * alignment;
+        const VkDeviceSize buffer_size = VkDeviceSize(frames_in_flight_) * instance_frame_stride_;
+        if (!create_buffer(buffer_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instance_buffer_, instance_allocation_))
+                return false;
 
-        vkEndCommandBuffer(command_buffer);
+        // Without CPU culling the instances never move in the buffer, only their model matrices get rewritten every frame
+        for (uint32_t slot = 0; slot < frames_in_flight_; slot++) {
+            InstanceData* instances = instance_slice(slot);
+            for (uint32_t object = 0; object < options_.draw_count; object++) {
+                instances[object].color = instance_color(object);
+            }
+        }
+        return true;
+    }
 
-        VkSubmitInfo submit_info = {};
-        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers = &command_buffer;
+    InstanceData* instance_slice(uint32_t slot) const {
+        return reinterpret_cast<InstanceData*>(static_cast<char*>(instance_allocation_.mapped) + slot * instance_frame_stride_);
+    }
 
-        vkQueueSubmit(graphics_queue_, 1, &submit_info, nullptr);
-        vkQueueWaitIdle(graphics_queue_);
+    // A tint along the object list
+    glm::vec4 instance_color(uint32_t object) const {
+        const float fraction = float(object) / float(options_.draw_count);
+        return glm::vec4(1.f - 0.5f * fraction, 1.f, 0.5f + 0.5f * fraction, 1.f);
+    }
 
-        vkFreeCommandBuffers(device_, command_pool_, 1, &command_buffer);
+    // One transform per uniform update and, in the instanced modes, per instance. Object i is turned by i * 0.01
+    // radians around z, the per-frame spin is applied to all of them as the batch's parent.
+    bool create_transforms() {
+        const uint32_t count = std::max(options_.uniform_updates, options_.draw_mode == DrawMode::PER_OBJECT ? 0u : options_.draw_count);
+        transforms_.resize(count);
+        for (uint32_t object = 0; object < count; object++) {
+            transforms_.set(object, glm::vec3(0.f), glm::angleAxis(float(object) * 0.01f, glm::vec3(0.f, 0.f, 1.f)), glm::vec3(1.f));
+        }
+        transform_kernel_ = best_transform_kernel();
+        std::cout << "Transforms: " << count << " objects, " << transform_kernel_name(transform_kernel_) << " kernel\n";
+        return true;
     }
 
-    uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags property_flags) {
-        VkPhysicalDeviceMemoryProperties physical_device_memory_properties;
-        vkGetPhysicalDeviceMemoryProperties(physical_device_, &physical_device_memory_properties);
+    // Unculled, every draw is recorded and every instance drawn. Indirect commands are uploaded once with fixed
+    // instance counts, so CPU culling can't shrink them and that mode always draws everything.
+    bool create_culling() {
+        draw_list_.resize(options_.draw_count);
+        std::iota(draw_list_.begin(), draw_list_.end(), 0u);
+        instance_count_ = options_.draw_count;
 
-        for(uint32_t i = 0; i < physical_device_memory_properties.memoryTypeCount; i++) {
-            if( type_filter & (1 << i) &&
-                (physical_device_memory_properties.memoryTypes[i].propertyFlags & property_flags) == property_flags
-                ) {
-                return i;
-            }
+        culling_ = options_.cpu_culling && options_.draw_mode != DrawMode::INDIRECT;
+        if (options_.cpu_culling && !culling_) {
+            std::cout << "CPU culling doesn't apply to indirect draws, drawing everything\n";
         }
-        quit_application(ERRORS::FAILED_TO_FIND_SUITABLE_MEMORY_TYPE);
-        return 0;
+        if (!culling_) return true;
+
+        object_models_.resize(transforms_.size());
+        culling_volumes_.resize(transforms_.size());
+        visible_objects_.reserve(transforms_.size());
+        culling_kernel_ = best_culling_kernel();
+        std::cout << "CPU culling: " << transforms_.size() << " objects, " << culling_kernel_name(culling_kernel_) << " kernel\n";
+        return true;
     }
 
-    bool create_index_buffer() {
-        VkDeviceSize buffer_size = sizeof(indices[0])*indices.size();
+    // The per-instance commands carry their instance in firstInstance, so drawing them with a count also needs
+    // drawIndirectFirstInstance. Otherwise the single command with all visible instances is drawn.
+    bool create_gpu_culling() {
+        if (options_.gpu_culling && !gpu_culling_active_) {
+            std::cout << "GPU culling only applies to indirect draws\n";
+        }
+        if (!gpu_culling_active_) return true;
 
-        VkBuffer staging_buffer;
-        VkDeviceMemory staging_device_memory;
-        if(!create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_device_memory))
-                return false;
+        PFN_vkCmdDrawIndexedIndirectCountKHR draw_indirect_count = nullptr;
+        if (draw_indirect_count_supported_ && draw_indirect_first_instance_) {
+            draw_indirect_count = PFN_vkCmdDrawIndexedIndirectCountKHR(vkGetDeviceProcAddr(device_, "vkCmdDrawIndexedIndirectCountKHR"));
+        }
 
-        void* data;
-        vkMapMemory(device_, staging_device_memory, 0, buffer_size, 0, &data);
-        memcpy(data, indices.data(), buffer_size);
-        vkUnmapMemory(device_, staging_device_memory);
+        static_assert(sizeof(InstanceData) == GpuCulling::INSTANCE_SIZE, "cull_instances.comp copies whole InstanceData records");
+        if (!gpu_culling_.init(device_, allocator_, descriptor_layouts_, pipeline_cache_.handle(), frames_in_flight_,
+                               options_.draw_count, instance_buffer_, instance_frame_stride_, draw_indirect_count)) {
+            quit_application(ERRORS::FAILED_TO_CREATE_GPU_CULLING);
+            return false;
+        }
+        std::cout << "GPU culling: " << options_.draw_count << " instances, "
+            << (gpu_culling_.uses_draw_indirect_count() ? "draw indirect count" : "single indirect draw") << "\n";
+        return true;
+    }
 
-        if(!create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, index_buffer_, index_device_memory_))
-                return false;
-        copy_buffer(staging_buffer, index_buffer_, buffer_size);
-        
-        vkDestroyBuffer(device_, staging_buffer, nullptr);
-        vkFreeMemory(device_, staging_device_memory, nullptr);
+    // Everything queued by the create_*_buffer() calls goes out as one submission. The first frames read these
+    // buffers on another queue: with timeline semaphores they wait for the batch on the GPU, otherwise this is the
+    // single point where the CPU waits for the batch fence.
+    bool finish_uploads() {
+        upload_ticket_ = uploader_.flush();
+        if (uploader_.timeline() == VK_NULL_HANDLE) uploader_.wait(upload_ticket_);
         return true;
     }
 
     bool create_descriptor_set_layout() {
+        descriptor_layouts_.init(device_);
+
         VkDescriptorSetLayoutBinding ubo_descriptor_set_layout_binding = {};
         ubo_descriptor_set_layout_binding.binding = 0;
-        ubo_descriptor_set_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        ubo_descriptor_set_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         ubo_descriptor_set_layout_binding.descriptorCount = 1;
         ubo_descriptor_set_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
         ubo_descriptor_set_layout_binding.pImmutableSamplers = nullptr; // Optional
 
-        VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {};
-        descriptor_set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        descriptor_set_layout_create_info.bindingCount = 1;
-        descriptor_set_layout_create_info.pBindings = &ubo_descriptor_set_layout_binding;
-
-        if(vkCreateDescriptorSetLayout(device_, &descriptor_set_layout_create_info, nullptr, &descriptor_set_layout_) != VK_SUCCESS) {
+        descriptor_set_layout_ = descriptor_layouts_.get({ubo_descriptor_set_layout_binding});
+        if(descriptor_set_layout_ == VK_NULL_HANDLE) {
             quit_application(ERRORS::FAILED_TO_CREATE_DESCRIPTOR_SET_LAYOUR);
             return false;
         }
+        return true;
+    }
+
+    bool create_bindless_table() {
+        if (!bindless_active_) return true;
+        if (!bindless_table_.init(device_, descriptor_layouts_, bindless_limits_)) {
+            quit_application(ERRORS::FAILED_TO_CREATE_BINDLESS_TABLE);
+            return false;
+        }
+        std::cout << "Bindless descriptors: one table bound per command buffer, draws push indices\n";
+        return true;
+    }
 
-        VkPipelineLayoutCreateInfo pipeline_layout_create_info = {};
-        pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipeline_layout_create_info.setLayoutCount = 1;
-        pipeline_layout_create_info.pSetLayouts = &descriptor_set_layout_;
+    bool create_uniform_ring_buffer() {
+        // Grow past the default when the scene asks for more uniform updates than fit, the worst case alignment per
+        // update is sizeof + alignment
+        const VkDeviceSize aligned_update_size = sizeof(UniformBufferObject) + allocator_.limits().minUniformBufferOffsetAlignment;
+        const VkDeviceSize frame_capacity = std::max(UNIFORM_RING_FRAME_CAPACITY, aligned_update_size * options_.uniform_updates);
+        // The bindless vertex shader reads it as a storage buffer
+        const VkBufferUsageFlags extra_usage = bindless_active_ ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0;
+        if(!uniform_ring_buffer_.init(device_, allocator_, frames_in_flight_, frame_capacity, extra_usage)) {
+            quit_application(ERRORS::FAILED_TO_CREATE_UNIFORM_RING_BUFFER);
+            return false;
+        }
         return true;
     }
 
-    bool create_uniform_buffers() {
-        const VkDeviceSize buffer_size = sizeof(UniformBufferObject);
+    bool create_texture_streamer() {
+        if (options_.texture_paths.empty()) return true;
+        if (!texture_streamer_.init(physical_device_, device_, allocator_, job_system_, frames_in_flight_, TEXTURE_UPLOAD_FRAME_BUDGET)) {
+            quit_application(ERRORS::FAILED_TO_CREATE_TEXTURE_STREAMER);
+            return false;
+        }
+        texture_streaming_ = true;
+        for (const auto& path : options_.texture_paths) texture_streamer_.request(path);
+        texture_slots_.assign(options_.texture_paths.size(), BindlessTable::INVALID_INDEX);
+        return true;
+    }
 
-        uniform_buffers_.resize(swap_chain_images_.size());
-        uniform_device_memory_.resize(swap_chain_images_.size());
+    // The frame graph's first pass. Bindless tables get every view the streamer swapped, the slots of the previous
+    // ones are only released once the frames sampling them are done.
+    void record_texture_uploads(VkCommandBuffer command_buffer) {
+        texture_streamer_.record_uploads(command_buffer, uint32_t(current_frame), [this](VkImageView view) {
+            retire([device = device_, view] { vkDestroyImageView(device, view, nullptr); });
+        });
 
-        for(size_t i = 0; i < swap_chain_images_.size(); i++) {
-            create_buffer(buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                uniform_buffers_[i],
-                uniform_device_memory_[i]);
+        if (!bindless_active_) return;
+        for (const TextureStreamer::TextureId texture : texture_streamer_.changed()) {
+            const uint32_t previous = texture_slots_[texture];
+            texture_slots_[texture] = bindless_table_.add_image(texture_streamer_.view(texture), texture_streamer_.sampler());
+            if (previous != BindlessTable::INVALID_INDEX) retire([this, previous] { bindless_table_.release_image(previous); });
+        }
+    }
+
+    // One allocator for sets that live as long as the application, one per frame slot for sets written while
+    // recording, reset in bulk once the slot's fence has signaled
+    bool create_descriptor_allocators() {
+        descriptor_allocator_.init(device_, descriptor_layouts_, 4);
+        frame_descriptor_allocators_.resize(frames_in_flight_);
+        for (auto& frame_descriptor_allocator : frame_descriptor_allocators_) frame_descriptor_allocator.init(device_, descriptor_layouts_);
+        return true;
+    }
+
+    // A single set pointing at the whole ring buffer. Every draw binds it with its own dynamic offset. Bindless draws
+    // find the ring buffer in the table instead.
+    bool create_descriptor_sets() {
+        if (bindless_active_) {
+            uniform_buffer_index_ = bindless_table_.add_buffer(uniform_ring_buffer_.buffer());
+            if (uniform_buffer_index_ == BindlessTable::INVALID_INDEX) {
+                quit_application(ERRORS::FAILED_TO_ALLOCATE_DESCRIPTOR_SETS);
+                return false;
+            }
+            return true;
+        }
+
+        descriptor_set_ = descriptor_allocator_.allocate(descriptor_set_layout_, {
+            DescriptorWrite::buffer_write(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, uniform_ring_buffer_.buffer(), 0,
+                sizeof(UniformBufferObject)),
+        });
+        if(descriptor_set_ == VK_NULL_HANDLE) {
+            quit_application(ERRORS::FAILED_TO_ALLOCATE_DESCRIPTOR_SETS);
+            return false;
         }
-        
         return true;
     }
 
@@ -1030,91 +2178,293 @@ private:
             create_surface() &&
             pick_physical_device() &&
             create_logical_device() &&
-            create_swap_chain() &&
+            create_allocator() &&
+            create_pipeline_cache() &&
+            create_shader_compiler() &&
+            create_pipeline_variants() &&
+            create_render_targets() &&
             create_image_views() &&
-            create_render_pass() &&
+            create_frame_graph() &&
             create_descriptor_set_layout() &&
+            create_bindless_table() &&
             create_graphics_pipeline() &&
-            create_framebuffers() &&
             create_command_pool() &&
-            create_vertex_buffer() &&
-            create_index_buffer() &&
-            create_uniform_buffers() &&
+            create_uploader() &&
+            create_scene() &&
+            create_indirect_buffer() &&
+            finish_uploads() &&
+            create_instance_buffer() &&
+            create_transforms() &&
+            create_culling() &&
+            create_gpu_culling() &&
+            create_uniform_ring_buffer() &&
+            create_texture_streamer() &&
+            create_descriptor_allocators() &&
+            create_descriptor_sets() &&
             create_command_buffers() &&
+            create_thread_command_pools() &&
+            create_profiler() &&
             create_sync_objects();
     }
 
-    void update_uniform_buffer(uint32_t image_index) {
+    // Computes every object's model matrix into object_models_, their world bounds from those, and tests the bounds
+    // against the frustum. Leaves the visible objects in visible_objects_ and the draws to record in draw_list_.
+    void cull_objects(const TransformBatch& batch, const glm::mat4& view_projection) {
+        Profiler::CpuZone zone(profiler_, "cull");
+
+        // The models go to memory the CPU reads back fast, the mapped buffers may well be write combined
+        TransformOutput model_output;
+        model_output.models = object_models_.data();
+        job_system_.parallel_for(transforms_.size(), TRANSFORM_JOB_SIZE, [&](uint32_t begin, uint32_t end, uint32_t) {
+            compute_transforms(transforms_, begin, end, batch, model_output, transform_kernel_);
+            for (uint32_t object = begin; object < end; object++) {
+                culling_volumes_.set_transformed(object, object_models_[object], object_bounds_min_, object_bounds_max_);
+            }
+        });
+
+        visible_object_count_ = cull_volumes_parallel(job_system_, culling_volumes_, extract_frustum_planes(view_projection),
+            visible_objects_, culling_kernel_);
+
+        if (options_.draw_mode == DrawMode::PER_OBJECT) {
+            // Draws cycle through the objects, every round keeps the visible ones
+            draw_list_.clear();
+            for (uint32_t first_draw = 0; first_draw < options_.draw_count; first_draw += options_.uniform_updates) {
+                for (uint32_t v = 0; v < visible_object_count_; v++) {
+                    const uint32_t draw = first_draw + visible_objects_[v];
+                    if (draw >= options_.draw_count) break;
+                    draw_list_.push_back(draw);
+                }
+            }
+        } else {
+            // Transforms past the instance count only exist for the uniform updates, the list is sorted
+            visible_object_count_ = uint32_t(std::lower_bound(visible_objects_.begin(), visible_objects_.begin() + visible_object_count_,
+                options_.draw_count) - visible_objects_.begin());
+            instance_count_ = visible_object_count_;
+        }
+    }
+
+    // Writes this frame's per-draw uniforms into the ring buffer and remembers their dynamic offsets for recording.
+    // Model matrices come from the transform store in SIMD batches, spread over the job system for large counts.
+    void update_uniform_buffer() {
+        Profiler::CpuZone zone(profiler_, "update_uniforms");
         static auto start_time = std::chrono::high_resolution_clock::now();
 
         const auto current_time = std::chrono::high_resolution_clock::now();
         float time = std::chrono::duration<float, std::chrono::seconds::period>(current_time - start_time).count();
 
-        UniformBufferObject ubo = {};
-        ubo.model = glm::rotate(glm::mat4(1.f), time * glm::radians(90.f), glm::vec3(0.f, 0.f, 1.f));
-        ubo.view = glm::lookAt(glm::vec3(2.f, 2.f, 2.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 0.f, 1.f));
-        ubo.proj = glm::perspective(glm::radians(45.f), swap_chain_extent_.width/float(swap_chain_extent_.height), 0.1f, 10.f);
-        ubo.proj[1][1] *= -1;
+        const glm::mat4 view = glm::lookAt(glm::vec3(2.f, 2.f, 2.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 0.f, 1.f));
+        glm::mat4 proj = glm::perspective(glm::radians(45.f), swap_chain_extent_.width/float(swap_chain_extent_.height), 0.1f, 10.f);
+        proj[1][1] *= -1;
 
-        void* data;
-        vkMapMemory(device_, uniform_device_memory_[current_frame], 0, sizeof(ubo),0, &data);
-        memcpy(data, &ubo, sizeof(ubo));
-        vkUnmapMemory(device_, uniform_device_memory_[current_frame]);
-        
-    }
+        // Every object spins by the same angle on top of its own fixed rotation, see create_transforms()
+        TransformBatch batch;
+        batch.parent = glm::rotate(glm::mat4(1.f), time * glm::radians(90.f), glm::vec3(0.f, 0.f, 1.f));
+        batch.local = scene_transform_;
 
-    void draw_frame() {
-        vkWaitForFences(device_, 1, &fences_[current_frame], VK_TRUE, std::numeric_limits<uint64_t>::max());        
-        
-        uint32_t image_index;
-        // The last parameter specifies a variable to output the index of the swap chain image that has become available. The index refers to the VkImage in our swapChainImages array. We’re going to use that index to pick the right command buffer
-        VkResult result = vkAcquireNextImageKHR(device_, swapchain_, std::numeric_limits<uint64_t>::max(), image_available_semaphores_[current_frame], nullptr, &image_index);
-        if(result == VK_ERROR_OUT_OF_DATE_KHR)
-        {
-            recreate_swap_chain();
-            return;
-        } else if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
-        {
-            quit_application(ERRORS::FAILED_TO_ACQUIRE_NEXT_IMAGE);
-            return;
+        view_projection_ = proj * view;
+        if (culling_) cull_objects(batch, view_projection_);
+
+        uniform_ring_buffer_.begin_frame(uint32_t(current_frame));
+
+        VkDeviceSize ubo_stride;
+        uint32_t first_uniform_offset;
+        auto* ubos = static_cast<char*>(uniform_ring_buffer_.allocate_array(sizeof(UniformBufferObject), options_.uniform_updates,
+            ubo_stride, first_uniform_offset));
+        if (!ubos) {
+            quit_application(ERRORS::UNIFORM_RING_BUFFER_OVERFLOW);
         }
 
-        // Check if a previous frame is using this image (i.e. there is its fence to wait on)
-        if(images_in_flight_[image_index] != nullptr) {
-            vkWaitForFences(device_, 1, &images_in_flight_[image_index], VK_TRUE, std::numeric_limits<uint64_t>::max());
+        if (culling_) {
+            // Only blocks some draw will read, the models are already computed
+            const uint32_t count = options_.draw_mode == DrawMode::PER_OBJECT ? visible_object_count_ : std::min(1u, options_.uniform_updates);
+            job_system_.parallel_for(count, TRANSFORM_JOB_SIZE, [&](uint32_t begin, uint32_t end, uint32_t) {
+                for (uint32_t v = begin; v < end; v++) {
+                    const uint32_t update = options_.draw_mode == DrawMode::PER_OBJECT ? visible_objects_[v] : v;
+                    auto* ubo = reinterpret_cast<UniformBufferObject*>(ubos + update * ubo_stride);
+                    ubo->model = object_models_[update];
+                    ubo->view = view;
+                    ubo->proj = proj;
+                }
+            });
+        } else {
+            TransformOutput ubo_output;
+            ubo_output.models = ubos + offsetof(UniformBufferObject, model);
+            ubo_output.model_stride = ubo_stride;
+            job_system_.parallel_for(options_.uniform_updates, TRANSFORM_JOB_SIZE, [&](uint32_t begin, uint32_t end, uint32_t) {
+                for (uint32_t update = begin; update < end; update++) {
+                    auto* ubo = reinterpret_cast<UniformBufferObject*>(ubos + update * ubo_stride);
+                    ubo->view = view;
+                    ubo->proj = proj;
+                }
+                compute_transforms(transforms_, begin, end, batch, ubo_output, transform_kernel_);
+            });
         }
 
-        // Mark the image as now being in use by this frame
-        images_in_flight_[image_index] = fences_[current_frame];
+        draw_uniform_offsets_.resize(options_.uniform_updates);
+        for (uint32_t update = 0; update < options_.uniform_updates; update++) {
+            draw_uniform_offsets_[update] = first_uniform_offset + uint32_t(update * ubo_stride);
+        }
 
-        update_uniform_buffer(image_index);
+        if (options_.draw_mode != DrawMode::PER_OBJECT) {
+            InstanceData* instances = instance_slice(uint32_t(current_frame));
+            if (culling_) {
+                // The visible instances packed to the front, each with its own color
+                job_system_.parallel_for(visible_object_count_, TRANSFORM_JOB_SIZE, [&](uint32_t begin, uint32_t end, uint32_t) {
+                    for (uint32_t v = begin; v < end; v++) {
+                        instances[v].model = object_models_[visible_objects_[v]];
+                        instances[v].color = instance_color(visible_objects_[v]);
+                    }
+                });
+            } else {
+                // Same transforms the per-object path puts in its uniform blocks, the colors are already in place
+                TransformOutput instance_output;
+                instance_output.models = &instances[0].model;
+                instance_output.model_stride = sizeof(InstanceData);
+                job_system_.parallel_for(options_.draw_count, TRANSFORM_JOB_SIZE, [&](uint32_t begin, uint32_t end, uint32_t) {
+                    compute_transforms(transforms_, begin, end, batch, instance_output, transform_kernel_);
+                });
+            }
+        }
 
-        VkSubmitInfo submit_info = {};
-        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        // The GPU's count for this slot is from its previous frame, main_loop() adds the last ones
+        if (gpu_culling_active_) visible_draw_total_ += gpu_culling_.visible_count(uint32_t(current_frame));
+        else visible_draw_total_ += options_.draw_mode == DrawMode::PER_OBJECT ? draw_list_.size() : instance_count_;
+        uniform_ring_buffer_.flush();
+    }
 
-        VkSemaphore wait_semaphores[] = {image_available_semaphores_[current_frame]};
-        submit_info.waitSemaphoreCount = 1;
-        submit_info.pWaitSemaphores = wait_semaphores;
-        
-        VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submit_info.pWaitDstStageMask = wait_stages;
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers = &command_buffers_[image_index];
+    // Waits until the frame that last used this frame slot has finished on the GPU, then releases whatever was retired
+    // before that frame was submitted
+    void wait_for_frame_slot() {
+        Profiler::CpuZone zone(profiler_, "wait_for_frame_slot");
+        poll_frame_latencies();
+        frame_sync_.wait(frame_numbers_[current_frame]);
+        complete_frame_latency(uint32_t(current_frame));
+        profiler_.begin_frame(uint32_t(current_frame));
+        deletion_queue_.collect(frame_sync_.completed_frame());
+        frame_descriptor_allocators_[current_frame].reset();
+    }
 
-        VkSemaphore signal_semaphores[] = {render_finished_semaphores_[current_frame]};
-        submit_info.signalSemaphoreCount = 1;
-        submit_info.pSignalSemaphores = signal_semaphores;
+    // Low latency mode: the previous frame has to be done on the GPU before this one samples its input, instead of the
+    // input waiting in a queue of frames the GPU hasn't started on
+    void wait_for_previous_frame() {
+        if (!options_.low_latency || submitted_frames_ == 0) return;
+        Profiler::CpuZone zone(profiler_, "wait_for_previous_frame");
+        frame_sync_.wait(submitted_frames_);
+        complete_frame_latency(uint32_t((current_frame + frames_in_flight_ - 1) % frames_in_flight_));
+    }
 
-        vkResetFences(device_, 1, &fences_[current_frame]);
-        
-        if(vkQueueSubmit(graphics_queue_, 1, &submit_info, fences_[current_frame]) != VK_SUCCESS) {
+    // The animation clock stands in for input: update_uniform_buffer() reads it right after this
+    void sample_input() {
+        poll_frame_latencies();
+        wait_for_previous_frame();
+        frame_latencies_[current_frame].input = std::chrono::high_resolution_clock::now();
+    }
+
+    // Right after waiting for the slot's frame the time is exact. Frames nobody waits on are found by polling at the
+    // start of every frame, late by at most the time since the last poll.
+    void complete_frame_latency(uint32_t slot) {
+        FrameLatency& latency = frame_latencies_[slot];
+        if (!latency.pending) return;
+        latency.pending = false;
+        const auto now = std::chrono::high_resolution_clock::now();
+        report_.submit_to_present_ms.push_back(milliseconds(now - latency.submit));
+        report_.input_to_present_ms.push_back(milliseconds(now - latency.input));
+    }
+
+    void poll_frame_latencies() {
+        const uint64_t completed_frame = frame_sync_.completed_frame();
+        for (uint32_t slot = 0; slot < frames_in_flight_; slot++) {
+            if (frame_numbers_[slot] <= completed_frame) complete_frame_latency(slot);
+        }
+    }
+
+    // Submits this frame slot's command buffer as frame submitted_frames_ + 1. Binary semaphores are only there with a
+    // swap chain, the first frames wait for the startup uploads when the CPU didn't.
+    void submit_frame(VkSemaphore image_available, VkSemaphore render_finished) {
+        Profiler::CpuZone zone(profiler_, "submit");
+        FrameSync::Wait waits[2];
+        uint32_t wait_count = 0;
+        if (image_available != VK_NULL_HANDLE) {
+            waits[wait_count++] = {image_available, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        }
+        if (upload_ticket_ != 0 && uploader_.timeline() != VK_NULL_HANDLE) {
+            if (uploader_.is_complete(upload_ticket_)) upload_ticket_ = 0;
+            else waits[wait_count++] = {uploader_.timeline(), upload_ticket_, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+        }
+
+        if(frame_sync_.submit(graphics_queue_, command_buffers_[current_frame], submitted_frames_ + 1, waits, wait_count,
+                              render_finished) != VK_SUCCESS) {
             quit_application(ERRORS::FAILED_TO_SUBMIT_DRAW_COMMAND_BUFFER);
         }
+    }
+
+    // Marks the submission on this frame slot, frame number submitted_frames_ completes once its work has executed
+    void on_frame_submitted() {
+        frame_numbers_[current_frame] = ++submitted_frames_;
+        FrameLatency& latency = frame_latencies_[current_frame];
+        latency.submit = std::chrono::high_resolution_clock::now();
+        latency.pending = true;
+        report_.input_to_submit_ms.push_back(milliseconds(latency.submit - latency.input));
+        profiler_.end_frame();
+    }
+
+    // Same as draw_frame() minus acquire and present: each frame in flight owns one offscreen image, so waiting for
+    // the slot's previous frame is the only synchronization needed
+    void draw_offscreen_frame() {
+        wait_for_frame_slot();
+        update_shader_reload();
+
+        const auto image_index = static_cast<uint32_t>(current_frame);
+        sample_input();
+        update_uniform_buffer();
+        record_command_buffer(command_buffers_[current_frame], image_index);
+        submit_frame(VK_NULL_HANDLE, VK_NULL_HANDLE);
+        on_frame_submitted();
+
+        current_frame = (current_frame + 1) % frames_in_flight_;
+    }
+
+    void draw_frame() {
+        Profiler::CpuZone frame_zone(profiler_, "frame");
+        if (options_.headless) {
+            draw_offscreen_frame();
+            return;
+        }
+
+        wait_for_frame_slot();
+        update_shader_reload();
+
+        uint32_t image_index;
+        VkResult result;
+        {
+            Profiler::CpuZone zone(profiler_, "acquire");
+            // The last parameter specifies a variable to output the index of the swap chain image that has become available. The index refers to the VkImage in our swapChainImages array. We’re going to use that index to pick the right command buffer
+            result = vkAcquireNextImageKHR(device_, swapchain_, std::numeric_limits<uint64_t>::max(), image_available_semaphores_[current_frame], nullptr, &image_index);
+            if(result == VK_ERROR_OUT_OF_DATE_KHR)
+            {
+                recreate_swap_chain();
+                return;
+            } else if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+            {
+                quit_application(ERRORS::FAILED_TO_ACQUIRE_NEXT_IMAGE);
+                return;
+            }
+        }
+
+        // Whichever frame rendered to this image before is ordered before this one by the acquire semaphore, and
+        // command buffers belong to frame slots, so there is nothing to wait for on the image's account
+        sample_input();
+        update_uniform_buffer();
+        record_command_buffer(command_buffers_[current_frame], image_index);
+
+        VkSemaphore render_finished = render_finished_semaphores_[image_index];
+        submit_frame(image_available_semaphores_[current_frame], render_finished);
+        on_frame_submitted();
 
         VkPresentInfoKHR present_info = {};
         present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
         present_info.waitSemaphoreCount = 1;
-        present_info.pWaitSemaphores = signal_semaphores;
+        present_info.pWaitSemaphores = &render_finished;
 
         VkSwapchainKHR swapchains[] = {swapchain_};
         present_info.swapchainCount = 1;
@@ -1122,7 +2472,10 @@ private:
         
         present_info.pImageIndices = &image_index;
         present_info.pResults = nullptr; // Optional
-        result = vkQueuePresentKHR(graphics_queue_, &present_info);
+        {
+            Profiler::CpuZone zone(profiler_, "present");
+            result = vkQueuePresentKHR(graphics_queue_, &present_info);
+        }
         if(result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebuffer_resized) {
             framebuffer_resized = false;
             recreate_swap_chain();
@@ -1131,67 +2484,144 @@ private:
             return;
         }
 
-        current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+        current_frame = (current_frame + 1) % frames_in_flight_;
+    }
+
+    void timed_draw_frame() {
+        const auto frame_start = std::chrono::high_resolution_clock::now();
+        draw_frame();
+        report_.frame_times_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frame_start).count());
     }
 
     void main_loop() {
-        while (!glfwWindowShouldClose(window_)) {
-            glfwPollEvents();
-            draw_frame();
+        const auto start_time = std::chrono::high_resolution_clock::now();
+        uint32_t frames_drawn = 0;
+        report_.frame_times_ms.reserve(options_.frame_count);
+
+        if (options_.headless) {
+            for (; frames_drawn < options_.frame_count; frames_drawn++) {
+                timed_draw_frame();
+            }
+        } else {
+            while (!glfwWindowShouldClose(window_) && (options_.frame_count == 0 || frames_drawn < options_.frame_count)) {
+                glfwPollEvents();
+                timed_draw_frame();
+                frames_drawn++;
+            }
         }
         vkDeviceWaitIdle(device_);
+        if (gpu_culling_active_) {
+            for (uint32_t slot = 0; slot < frames_in_flight_; slot++) visible_draw_total_ += gpu_culling_.visible_count(slot);
+        }
+
+        const auto seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+        report_.total_seconds = seconds;
+        report_.draw_mode = options_.draw_mode;
+        report_.draws_per_frame = options_.draw_count;
+        report_.visible_draws_per_frame = frames_drawn > 0 ? double(visible_draw_total_) / frames_drawn : 0.0;
+        report_.draw_calls_per_frame = draw_calls_per_frame();
+        report_.uniform_updates_per_frame = options_.uniform_updates;
+        report_.vertices_per_draw = vertex_count_;
+        report_.indices_per_draw = index_count_;
+        report_.frames_in_flight = frames_in_flight_;
+        report_.present_mode = options_.headless ? "offscreen" : present_mode_name_;
+        report_.low_latency = options_.low_latency;
+        report_.frame_sync = FrameSync::mode_name(frame_sync_mode_);
+        std::cout << "Drew " << frames_drawn << " frames in " << seconds << " s";
+        if (seconds > 0.0) std::cout << " (" << frames_drawn / seconds << " fps)";
+        std::cout << "\n";
+        std::cout << "Latency with " << frames_in_flight_ << " frames in flight" << (options_.low_latency ? ", low latency" : "")
+            << ": input to submit " << average(report_.input_to_submit_ms) << " ms, submit to present "
+            << average(report_.submit_to_present_ms) << " ms, input to present " << average(report_.input_to_present_ms)
+            << " ms on average\n";
+        if (!variant_pipelines_.empty()) {
+            std::cout << "Built " << pipeline_variants_.built_count() << " of " << variant_pipelines_.size() - 1
+                << " pipeline variants on workers in " << pipeline_variants_.build_milliseconds() << " ms\n";
+        }
+        profiler_.print_summary(std::cout);
     }
 
 
     void cleanup_swap_chain()
     {
-        for(size_t i = 0; i < swap_chain_images_.size(); i++) {
-            vkDestroyBuffer(device_, uniform_buffers_[i], nullptr);
-            vkFreeMemory(device_, uniform_device_memory_[i], nullptr);
-        }
-        for (auto swap_chain_framebuffer : swap_chain_framebuffers_) {
-            vkDestroyFramebuffer(device_, swap_chain_framebuffer, nullptr);
-        }
-
-        vkFreeCommandBuffers(device_, command_pool_, static_cast<uint32_t>(command_buffers_.size()), command_buffers_.data());
-
         vkDestroyPipeline(device_, pipeline_, nullptr);
         vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
-        vkDestroyRenderPass(device_, render_pass_, nullptr);
+        frame_graph_.print_stats(std::cout);
+        frame_graph_.destroy();
 
         for (auto swap_chain_image_view : swap_chain_image_views_) {
             vkDestroyImageView(device_, swap_chain_image_view, nullptr);
         }
+
+        if (options_.headless) {
+            for (size_t i = 0; i < swap_chain_images_.size(); i++) {
+                allocator_.destroy_image(swap_chain_images_[i], offscreen_allocations_[i]);
+            }
+            return;
+        }
         
         vkDestroySwapchainKHR(device_, swapchain_, nullptr);
     }
 
-    void cleanup() {        
+    void cleanup() {
+        // main_loop() left the device idle, so everything retired can go right away
+        deletion_queue_.flush();
+        if (shader_reload_.valid()) vkDestroyPipeline(device_, shader_reload_.get().pipeline, nullptr);
+        pipeline_variants_.destroy();
         cleanup_swap_chain();
 
-        vkDestroyDescriptorSetLayout(device_, descriptor_set_layout_, nullptr);
-        
-        vkDestroyBuffer(device_, vertex_buffer_, nullptr);
-        vkFreeMemory(device_, vertex_device_memory_, nullptr);
-
-        vkDestroyBuffer(device_, index_buffer_, nullptr);
-        vkFreeMemory(device_, index_device_memory_, nullptr);
+        descriptor_allocator_.print_stats(std::cout, "Persistent");
+        descriptor_allocator_.destroy();
+        for (size_t i = 0; i < frame_descriptor_allocators_.size(); i++) {
+            frame_descriptor_allocators_[i].print_stats(std::cout, ("Frame slot " + std::to_string(i)).c_str());
+            frame_descriptor_allocators_[i].destroy();
+        }
+        if (bindless_active_) {
+            bindless_table_.print_stats(std::cout);
+            bindless_table_.destroy();
+        }
+        descriptor_layouts_.destroy();
 
-        for(int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            vkDestroySemaphore(device_, image_available_semaphores_[i], nullptr);
-            vkDestroySemaphore(device_, render_finished_semaphores_[i], nullptr);
-            vkDestroyFence(device_, fences_[i], nullptr);
+        uniform_ring_buffer_.destroy(allocator_);
+        if (texture_streaming_) {
+            texture_streamer_.print_stats(std::cout);
+            texture_streamer_.destroy(allocator_);
         }
+        
+        uploader_.destroy(allocator_);
+        allocator_.print_stats(std::cout);
+
+        allocator_.destroy_buffer(vertex_buffer_, vertex_allocation_);
+        allocator_.destroy_buffer(index_buffer_, index_allocation_);
+        if (indirect_buffer_ != VK_NULL_HANDLE) allocator_.destroy_buffer(indirect_buffer_, indirect_allocation_);
+        if (instance_buffer_ != VK_NULL_HANDLE) allocator_.destroy_buffer(instance_buffer_, instance_allocation_);
+        if (gpu_culling_active_) gpu_culling_.destroy(allocator_);
+
+        for (auto semaphore : image_available_semaphores_) vkDestroySemaphore(device_, semaphore, nullptr);
+        for (auto semaphore : render_finished_semaphores_) vkDestroySemaphore(device_, semaphore, nullptr);
+        frame_sync_.destroy();
                     
+        command_recorder_.destroy();
         vkDestroyCommandPool(device_, command_pool_, nullptr);
-        
+
+        if (!options_.trace_path.empty() && !profiler_.write_chrome_trace(options_.trace_path)) {
+            std::cerr << "Failed to write trace to " << options_.trace_path << "\n";
+        }
+        profiler_.destroy();
+
+        pipeline_cache_.save();
+        pipeline_cache_.destroy();
+
+        allocator_.destroy();
         vkDestroyDevice(device_, nullptr);
 
         if constexpr (ENABLE_VALIDATION_LAYERS) DestroyDebugUtilsMessengerEXT(instance_, callback_, nullptr);
 
-        vkDestroySurfaceKHR(instance_, surface_, nullptr);
+        if (!options_.headless) vkDestroySurfaceKHR(instance_, surface_, nullptr);
         vkDestroyInstance(instance_, nullptr);
 
+        if (options_.headless) return;
+
         glfwDestroyWindow(window_);
 
         glfwTerminate();
@@ -1200,10 +2630,16 @@ private:
     struct QueueFamilyIndices
     {
         int graphics_and_present_family = -1;
+        // A transfer-only family if the device has one, the graphics family otherwise
+        int transfer_family = -1;
 
         bool is_complete() const {
             return graphics_and_present_family >= 0;
         }
+
+        bool has_dedicated_transfer() const {
+            return transfer_family != graphics_and_present_family;
+        }
     };
 
     QueueFamilyIndices find_queue_families(VkPhysicalDevice device) const {
@@ -1217,6 +2653,27 @@ private:
 
         int i = 0;
         for (const auto& queue_family : queue_families) {
+            // Families with only the transfer bit usually map to the copy engines, which run alongside graphics work
+            constexpr VkQueueFlags non_transfer_flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+            if (queue_family.queueCount > 0 && queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT &&
+                !(queue_family.queueFlags & non_transfer_flags) && indices.transfer_family < 0) {
+                indices.transfer_family = i;
+            }
+
+            if (indices.is_complete()) {
+                ++i;
+                continue;
+            }
+
+            if (options_.headless) {
+                // No surface to present to, any graphics queue will do
+                if (queue_family.queueCount > 0 && queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                    indices.graphics_and_present_family = i;
+                }
+                ++i;
+                continue;
+            }
+
             // Note that it’s very likely that these end up being the same queue family after all, but throughout the program we will treat them as if they were separate queues for a uniform approach.
             // Nevertheless, you could add logic to explicitly prefer a physical device that supports drawing and presentation in the same queue for improved performance
             // [AP] I've decided to go with later approach, only using device that is supporting both
@@ -1226,11 +2683,12 @@ private:
                 indices.graphics_and_present_family = i;
             }
 
-            if (indices.is_complete()) break;
-
             ++i;
         }
 
+        // Graphics queues always support transfers
+        if (indices.transfer_family < 0) indices.transfer_family = indices.graphics_and_present_family;
+
         return indices;
     }
 
@@ -1259,51 +2717,158 @@ private:
         return details;
     }    
 
+    ApplicationOptions options_;
+    uint32_t frames_in_flight_;
+
     VkInstance instance_;
+    // What create_instance() asked for, VK_API_VERSION_1_0 or VK_API_VERSION_1_2
+    uint32_t api_version_ = VK_API_VERSION_1_0;
     VkDebugUtilsMessengerEXT callback_;
     VkSurfaceKHR surface_;
     
     VkPhysicalDevice physical_device_ = nullptr;
-    VkSwapchainKHR swapchain_;
+    VkSwapchainKHR swapchain_ = VK_NULL_HANDLE;
 
     GLFWwindow* window_ = nullptr;
     VkDevice device_;
     VkQueue graphics_queue_;
+    VkQueue transfer_queue_;
+    QueueFamilyIndices queue_families_;
 
     std::vector<VkImage> swap_chain_images_;
     VkFormat format_;
     VkExtent2D swap_chain_extent_;
 
-    VkRenderPass render_pass_;
+    RenderGraph frame_graph_;
+    RenderGraph::ResourceId backbuffer_ = 0;
+    RenderGraph::PassId main_pass_ = 0;
+    // The main pass's, owned by frame_graph_
+    VkRenderPass render_pass_ = VK_NULL_HANDLE;
+    DescriptorLayoutCache descriptor_layouts_;
+    BindlessTable bindless_table_;
+    bool bindless_active_ = false;
+    // VK_KHR_get_physical_device_properties2 is enabled on the instance
+    bool physical_device_properties2_ = false;
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT bindless_limits_ = {};
+    // The ring buffer's slot in the bindless table
+    uint32_t uniform_buffer_index_ = BindlessTable::INVALID_INDEX;
+    // Owned by descriptor_layouts_
     VkDescriptorSetLayout descriptor_set_layout_;
     VkPipelineLayout pipeline_layout_;
     VkPipeline pipeline_;
+    PipelineCache pipeline_cache_;
+    bool pipeline_creation_reported_ = false;
+
+    struct ShaderReload
+    {
+        // Null if the rebuild failed, error says why
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        std::string error;
+        // What it was built from and against
+        std::vector<uint32_t> vertex_code;
+        std::vector<uint32_t> fragment_code;
+        VkRenderPass render_pass = VK_NULL_HANDLE;
+        VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    };
+    ShaderCompiler shader_compiler_;
+    FileWatcher shader_watcher_;
+    // Valid while a hot reload rebuild is in flight or its result hasn't been picked up yet
+    std::future<ShaderReload> shader_reload_;
+    PipelineVariants pipeline_variants_;
+    // One per material, empty without variants
+    std::vector<VkPipeline> variant_pipelines_;
+    Profiler profiler_;
     VkCommandPool command_pool_;
 
     std::vector<VkImageView> swap_chain_image_views_;
-    std::vector<VkFramebuffer> swap_chain_framebuffers_;
     std::vector<VkCommandBuffer> command_buffers_;
+    JobSystem job_system_;
+    ParallelCommandRecorder command_recorder_;
+    std::vector<VkCommandBuffer> secondary_command_buffers_;
 
+    FrameSync::Mode frame_sync_mode_ = FrameSync::Mode::FENCES;
+    FrameSync frame_sync_;
+    // One per frame slot
     std::vector<VkSemaphore> image_available_semaphores_;
+    // One per swap chain image
     std::vector<VkSemaphore> render_finished_semaphores_;
-    std::vector<VkFence> fences_;
-    std::vector<VkFence> images_in_flight_;
-    VkBuffer vertex_buffer_;
-    VkDeviceMemory vertex_device_memory_;
-    VkBuffer index_buffer_;
-    VkDeviceMemory index_device_memory_;
-    std::vector<VkBuffer> uniform_buffers_;
-    std::vector<VkDeviceMemory> uniform_device_memory_;
+    DeviceMemoryAllocator allocator_;
+    StagingUploader uploader_;
+    // The startup uploads, until frames no longer need to wait for them
+    StagingUploader::Ticket upload_ticket_ = 0;
+    VkBuffer vertex_buffer_ = VK_NULL_HANDLE;
+    Allocation vertex_allocation_;
+    VkBuffer index_buffer_ = VK_NULL_HANDLE;
+    Allocation index_allocation_;
+    VkIndexType index_type_ = VK_INDEX_TYPE_UINT16;
+    VkBuffer instance_buffer_ = VK_NULL_HANDLE;
+    Allocation instance_allocation_;
+    VkBuffer indirect_buffer_ = VK_NULL_HANDLE;
+    Allocation indirect_allocation_;
+    uint32_t indirect_command_count_ = 0;
+    bool multi_draw_indirect_ = false;
+    bool draw_indirect_first_instance_ = false;
+    glm::mat4 scene_transform_ = glm::mat4(1.f);
+    VertexQuantization vertex_quantization_;
+    TransformStore transforms_;
+    TransformKernel transform_kernel_ = TransformKernel::SCALAR;
+    // What gets recorded: draw indices for DrawMode::PER_OBJECT, the instance count for DrawMode::INSTANCED
+    std::vector<uint32_t> draw_list_;
+    uint32_t instance_count_ = 0;
+    uint64_t visible_draw_total_ = 0;
+    bool culling_ = false;
+    // Local bounds of the drawn geometry, before the model transform
+    glm::vec3 object_bounds_min_ = glm::vec3(0.f);
+    glm::vec3 object_bounds_max_ = glm::vec3(0.f);
+    std::vector<glm::mat4> object_models_;
+    CullingVolumes culling_volumes_;
+    CullingKernel culling_kernel_ = CullingKernel::SCALAR;
+    std::vector<uint32_t> visible_objects_;
+    uint32_t visible_object_count_ = 0;
+    // This frame's, for culling
+    glm::mat4 view_projection_ = glm::mat4(1.f);
+    GpuCulling gpu_culling_;
+    bool gpu_culling_active_ = false;
+    bool draw_indirect_count_supported_ = false;
+    uint32_t vertex_count_ = 0;
+    uint32_t index_count_ = 0;
+    UniformRingBuffer uniform_ring_buffer_;
+    TextureStreamer texture_streamer_;
+    bool texture_streaming_ = false;
+    // Bindless image slot of every texture's current view, by TextureId
+    std::vector<uint32_t> texture_slots_;
+    std::vector<uint32_t> draw_uniform_offsets_;
+    DescriptorAllocator descriptor_allocator_;
+    // One per frame slot
+    std::vector<DescriptorAllocator> frame_descriptor_allocators_;
+    VkDescriptorSet descriptor_set_;
+    std::vector<Allocation> offscreen_allocations_;
 
     size_t current_frame = 0;
 
+    // Frame numbers start at 1, frame_numbers_ holds the number of the frame last submitted on each frame slot
+    uint64_t submitted_frames_ = 0;
+    std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> frame_numbers_ = {};
+    DeletionQueue deletion_queue_;
+
+    // Latency of the frame last submitted on each frame slot
+    struct FrameLatency
+    {
+        std::chrono::high_resolution_clock::time_point input;
+        std::chrono::high_resolution_clock::time_point submit;
+        // Submitted, not seen complete yet
+        bool pending = false;
+    };
+    std::array<FrameLatency, MAX_FRAMES_IN_FLIGHT> frame_latencies_ = {};
+    // Printed whenever the swap chain ends up with a different one
+    std::string present_mode_name_;
+
     bool framebuffer_resized = false;
-    
-    constexpr static int WIDTH = 800;
-    constexpr static int HEIGHT = 600;
+    RunReport report_;
 };
 
-int main() {
-    HelloTriangleApplication application;
+RunReport run_application(const ApplicationOptions& options) {
+    HelloTriangleApplication application(options);
     application.run();
+    return application.report();
 }
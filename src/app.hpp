@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class DrawMode
+{
+    // One vkCmdDrawIndexed per object, transforms in the uniform ring buffer
+    PER_OBJECT,
+    // A single instanced draw, transforms and colors in a per-instance vertex stream
+    INSTANCED,
+    // Instance stream as above, draws sourced from a VkDrawIndexedIndirectCommand buffer
+    INDIRECT,
+};
+
+inline const char* draw_mode_name(DrawMode mode) {
+    switch (mode) {
+        case DrawMode::PER_OBJECT: return "per-object";
+        case DrawMode::INSTANCED: return "instanced";
+        case DrawMode::INDIRECT: return "indirect";
+    }
+    return "unknown";
+}
+
+// What the swap chain asks the presentation engine for. Modes the surface doesn't offer fall back to FIFO, which every
+// surface supports.
+enum class PresentMode
+{
+    // MAILBOX, then IMMEDIATE, then FIFO: the lowest latency the surface offers
+    AUTO,
+    // Vsync, one queued image per vblank. Throttles the CPU to the display.
+    FIFO,
+    // Vsync, except a late image goes out right away and tears
+    FIFO_RELAXED,
+    // Vsync without throttling, newer images replace queued ones
+    MAILBOX,
+    // No vsync, tears
+    IMMEDIATE,
+};
+
+inline const char* present_mode_name(PresentMode mode) {
+    switch (mode) {
+        case PresentMode::AUTO: return "auto";
+        case PresentMode::FIFO: return "fifo";
+        case PresentMode::FIFO_RELAXED: return "fifo-relaxed";
+        case PresentMode::MAILBOX: return "mailbox";
+        case PresentMode::IMMEDIATE: return "immediate";
+    }
+    return "unknown";
+}
+
+struct ApplicationOptions
+{
+    // Render into offscreen images instead of a window. No GLFW, no surface, no present.
+    bool headless = false;
+    // Number of frames to draw before exiting, 0 means "until the window is closed"
+    uint32_t frame_count = 0;
+    uint32_t width = 800;
+    uint32_t height = 600;
+    // Frames the CPU may record ahead of the GPU, 1 to 4. More frames hide stalls on either side and favor
+    // throughput, fewer keep the input a frame shows closer to when it's shown.
+    uint32_t frames_in_flight = 2;
+    PresentMode present_mode = PresentMode::AUTO;
+    // Waits for the previous frame to finish on the GPU right before sampling input instead of only for the frame slot,
+    // and asks for the fewest swap chain images. Input is as fresh as it gets, CPU and GPU no longer overlap.
+    bool low_latency = false;
+    // Tracks frames with a timeline semaphore, and submits them with synchronization2, where the device supports them.
+    // False keeps the per-frame fences Vulkan 1.0 devices fall back to.
+    bool timeline_semaphores = true;
+    // Where the pipeline cache lives between runs, empty disables it
+    std::string pipeline_cache_path = "pipeline_cache.bin";
+    // Chrome trace JSON of every profiled zone is written here on exit, empty disables tracing
+    std::string trace_path;
+    // Compiles the shaders from their sources at startup and rebuilds the pipeline whenever one of them changes,
+    // instead of using the SPIR-V built into the executable
+    bool shader_hot_reload = false;
+    // Where the sources are, empty means the tree the executable was built from
+    std::string shader_directory;
+    // Compiled SPIR-V keyed by source hash, empty disables the cache
+    std::string shader_cache_path = "shader_cache";
+
+    // Synthetic scene: quad_count quads tessellated into grids of roughly quad_vertices vertices each, all of them
+    // drawn draw_count times per frame. Every frame writes uniform_updates uniform blocks, draws cycle through them.
+    // The defaults are the tutorial's single quad.
+    uint32_t quad_count = 1;
+    uint32_t quad_vertices = 4;
+    uint32_t draw_count = 1;
+    uint32_t uniform_updates = 1;
+    // Replaces the synthetic quads with a mesh loaded from a .obj, .gltf, .glb or .vmesh file
+    std::string mesh_path;
+    // Runs the loaded mesh through the mesh optimizer before upload. Needs the whole mesh in memory first, meshes
+    // meant to be loaded often should go through the converter instead.
+    bool optimize_mesh = false;
+    // 12 byte vertices with 16-bit positions and 8-bit colors instead of 24 bytes of floats
+    bool packed_vertices = false;
+    // How the draw_count objects are submitted
+    DrawMode draw_mode = DrawMode::PER_OBJECT;
+    // Tests every object's bounds against the view frustum each frame and records only the visible ones. Per-object
+    // and instanced draws only, indirect commands are static.
+    bool cpu_culling = false;
+    // Culls and compacts the indirect draws in a compute pass instead, DrawMode::INDIRECT only
+    bool gpu_culling = false;
+    // Spreads the objects over this many material variants (up to MATERIAL_VARIANT_COUNT), pipelines that differ in
+    // their specialization constants and are built on demand. Per-object draws only, 1 is the plain material.
+    uint32_t material_variants = 1;
+    // Per-object draws read their uniform block out of one bindless descriptor table, indexed through push constants,
+    // instead of binding a descriptor set each. Needs VK_EXT_descriptor_indexing, ignored without it.
+    bool bindless = false;
+    // PNG or KTX2 files streamed in the background while the scene renders. Repeatable.
+    std::vector<std::string> texture_paths;
+};
+
+// What a run measured, filled in once the main loop is done
+struct RunReport
+{
+    // False when Vulkan couldn't be initialized, nothing else in the report means anything then
+    bool completed = false;
+    std::string device_name;
+    // From the start of run() until the first frame can be drawn
+    double startup_seconds = 0.0;
+    double total_seconds = 0.0;
+    // CPU time of every draw_frame() call, throttled by the GPU once the frames in flight are used up
+    std::vector<double> frame_times_ms;
+
+    uint32_t frames_in_flight = 0;
+    // The mode the swap chain ended up with, "offscreen" in headless runs
+    std::string present_mode;
+    bool low_latency = false;
+    // How frame completion was tracked: "timeline", "timeline-sync2" or "fences"
+    std::string frame_sync;
+    // Per frame, from the moment it sampled its (simulated) input, the animation clock, until its vkQueueSubmit()
+    // returned
+    std::vector<double> input_to_submit_ms;
+    // Per frame, from its submit until its GPU work was seen complete, the earliest its present can be processed.
+    // The display's own scanout delay isn't included. Frames still in flight when the run ends aren't counted.
+    std::vector<double> submit_to_present_ms;
+    // The sum of both for the same frames
+    std::vector<double> input_to_present_ms;
+
+    DrawMode draw_mode = DrawMode::PER_OBJECT;
+    uint32_t draws_per_frame = 0;
+    // Average over the run of the draws (or instances) left after culling, draws_per_frame without it
+    double visible_draws_per_frame = 0.0;
+    // vkCmdDraw* calls recorded per frame, equal to draws_per_frame only for DrawMode::PER_OBJECT
+    uint32_t draw_calls_per_frame = 0;
+    uint32_t uniform_updates_per_frame = 0;
+    uint32_t vertices_per_draw = 0;
+    // Bytes per vertex in the vertex buffer
+    uint32_t vertex_stride = 0;
+    uint32_t indices_per_draw = 0;
+};
+
+// Exits with an error code on a malformed command line
+ApplicationOptions parse_options(int argc, char** argv);
+
+// Check completed in the report, a run that failed to start returns an otherwise empty one
+RunReport run_application(const ApplicationOptions& options);
@@ -0,0 +1,5 @@
+#include "app.hpp"
+
+int main(int argc, char** argv) {
+    return run_application(parse_options(argc, argv)).completed ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+#include "app.hpp"
+#include "cpu_benchmarks.hpp"
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// Headless benchmark: renders a fixed number of offscreen frames of a synthetic scene and writes what it measured as
+// JSON, so runs can be diffed between commits. Takes every option the application does (--headless is implied) plus
+// --report PATH for where the JSON goes, bench_report.json by default, --compare-draw-modes to run the same scene
+// once per DrawMode, --compare-frame-latency to run it with 1 to 3 frames in flight, each with and without
+// --low-latency, and --compare-frame-sync to run it with timeline semaphores and with fences. --cpu-benchmarks runs
+// the CPU micro-benchmarks (cpu_benchmarks.hpp) instead, no GPU needed, and fails if any of them produces wrong
+// results.
+
+namespace
+{
+    // The string as the contents of a JSON string literal, without the quotes. Device names and paths come from
+    // outside, they may hold quotes, backslashes or control characters.
+    std::string json_escape(const std::string& text) {
+        std::string escaped;
+        escaped.reserve(text.size());
+        for (const char c : text) {
+            switch (c) {
+                case '"': escaped += "\\\""; break;
+                case '\\': escaped += "\\\\"; break;
+                case '\n': escaped += "\\n"; break;
+                case '\r': escaped += "\\r"; break;
+                case '\t': escaped += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        static const char HEX_DIGITS[] = "0123456789abcdef";
+                        escaped += "\\u00";
+                        escaped += HEX_DIGITS[(c >> 4) & 0xf];
+                        escaped += HEX_DIGITS[c & 0xf];
+                    } else {
+                        escaped += c;
+                    }
+            }
+        }
+        return escaped;
+    }
+
+    double percentile(const std::vector<double>& sorted, double fraction) {
+        if (sorted.empty()) return 0.0;
+        const auto index = std::min(sorted.size() - 1, size_t(fraction * double(sorted.size())));
+        return sorted[index];
+    }
+
+    // min, avg, percentiles and max as a JSON object at the given indentation, no trailing newline
+    void write_distribution(std::ostream& out, std::vector<double> values, const std::string& indent) {
+        std::sort(values.begin(), values.end());
+        const double average = values.empty() ? 0.0 : std::accumulate(values.begin(), values.end(), 0.0) / double(values.size());
+        out << "{\n"
+            << indent << "  \"min\": " << (values.empty() ? 0.0 : values.front()) << ",\n"
+            << indent << "  \"avg\": " << average << ",\n"
+            << indent << "  \"p50\": " << percentile(values, 0.50) << ",\n"
+            << indent << "  \"p90\": " << percentile(values, 0.90) << ",\n"
+            << indent << "  \"p99\": " << percentile(values, 0.99) << ",\n"
+            << indent << "  \"max\": " << (values.empty() ? 0.0 : values.back()) << "\n"
+            << indent << "}";
+    }
+
+    void write_run(std::ostream& out, const ApplicationOptions& options, const RunReport& report) {
+        const auto frames = double(report.frame_times_ms.size());
+        const double frames_per_second = report.total_seconds > 0.0 ? frames / report.total_seconds : 0.0;
+        const double draws_per_second = frames_per_second * report.draws_per_frame;
+
+        out << std::fixed << std::setprecision(4)
+            << "    {\n"
+            << "      \"device\": \"" << json_escape(report.device_name) << "\",\n"
+            << "      \"draw_mode\": \"" << draw_mode_name(report.draw_mode) << "\",\n"
+            << "      \"scene\": {\n"
+            << "        \"width\": " << options.width << ",\n"
+            << "        \"height\": " << options.height << ",\n"
+            << "        \"mesh\": \"" << json_escape(options.mesh_path) << "\",\n"
+            << "        \"quads\": " << options.quad_count << ",\n"
+            << "        \"vertices_per_draw\": " << report.vertices_per_draw << ",\n"
+            << "        \"vertex_stride\": " << report.vertex_stride << ",\n"
+            << "        \"indices_per_draw\": " << report.indices_per_draw << ",\n"
+            << "        \"draws_per_frame\": " << report.draws_per_frame << ",\n"
+            << "        \"visible_draws_per_frame\": " << report.visible_draws_per_frame << ",\n"
+            << "        \"draw_calls_per_frame\": " << report.draw_calls_per_frame << ",\n"
+            << "        \"uniform_updates_per_frame\": " << report.uniform_updates_per_frame << "\n"
+            << "      },\n"
+            << "      \"startup_ms\": " << report.startup_seconds * 1000.0 << ",\n"
+            << "      \"frames\": " << report.frame_times_ms.size() << ",\n"
+            << "      \"total_seconds\": " << report.total_seconds << ",\n"
+            << "      \"frame_time_ms\": ";
+        write_distribution(out, report.frame_times_ms, "      ");
+        out << ",\n"
+            << "      \"latency\": {\n"
+            << "        \"frames_in_flight\": " << report.frames_in_flight << ",\n"
+            << "        \"present_mode\": \"" << report.present_mode << "\",\n"
+            << "        \"low_latency\": " << (report.low_latency ? "true" : "false") << ",\n"
+            << "        \"frame_sync\": \"" << report.frame_sync << "\",\n"
+            << "        \"input_to_submit_ms\": ";
+        write_distribution(out, report.input_to_submit_ms, "        ");
+        out << ",\n"
+            << "        \"submit_to_present_ms\": ";
+        write_distribution(out, report.submit_to_present_ms, "        ");
+        out << ",\n"
+            << "        \"input_to_present_ms\": ";
+        write_distribution(out, report.input_to_present_ms, "        ");
+        out << "\n"
+            << "      },\n"
+            << "      \"throughput\": {\n"
+            << "        \"frames_per_second\": " << frames_per_second << ",\n"
+            << "        \"draws_per_second\": " << draws_per_second << ",\n"
+            << "        \"vertices_per_second\": " << draws_per_second * report.vertices_per_draw << ",\n"
+            << "        \"triangles_per_second\": " << draws_per_second * (report.indices_per_draw / 3) << "\n"
+            << "      }\n"
+            << "    }";
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string report_path = "bench_report.json";
+    bool compare_draw_modes = false;
+    bool compare_frame_latency = false;
+    bool compare_frame_sync = false;
+    bool cpu_benchmarks = false;
+
+    // Pull out the bench's own options, everything else goes to the application parser
+    std::vector<char*> application_arguments = {argv[0], const_cast<char*>("--headless")};
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--report" && i + 1 < argc) {
+            report_path = argv[++i];
+        } else if (std::string(argv[i]) == "--compare-draw-modes") {
+            compare_draw_modes = true;
+        } else if (std::string(argv[i]) == "--compare-frame-latency") {
+            compare_frame_latency = true;
+        } else if (std::string(argv[i]) == "--compare-frame-sync") {
+            compare_frame_sync = true;
+        } else if (std::string(argv[i]) == "--cpu-benchmarks") {
+            cpu_benchmarks = true;
+        } else {
+            application_arguments.push_back(argv[i]);
+        }
+    }
+
+    if (cpu_benchmarks) {
+        JobSystem job_system;
+        std::ofstream file(report_path, std::ios::trunc);
+        file << "{\n";
+        const bool valid = run_cpu_benchmarks(job_system, file);
+        file << "\n}\n";
+        if (!file) {
+            std::cerr << "Failed to write " << report_path << "\n";
+            return 1;
+        }
+        std::cout << "Wrote " << report_path << "\n";
+        return valid ? 0 : 1;
+    }
+
+    const ApplicationOptions options = parse_options(int(application_arguments.size()), application_arguments.data());
+
+    std::vector<ApplicationOptions> runs = {options};
+    if (compare_draw_modes) {
+        runs.clear();
+        for (const auto mode : {DrawMode::PER_OBJECT, DrawMode::INSTANCED, DrawMode::INDIRECT}) {
+            runs.push_back(options);
+            runs.back().draw_mode = mode;
+        }
+    }
+    if (compare_frame_latency) {
+        const std::vector<ApplicationOptions> base_runs = runs;
+        runs.clear();
+        for (const auto& base : base_runs) {
+            for (uint32_t frames_in_flight = 1; frames_in_flight <= 3; frames_in_flight++) {
+                for (const bool low_latency : {false, true}) {
+                    runs.push_back(base);
+                    runs.back().frames_in_flight = frames_in_flight;
+                    runs.back().low_latency = low_latency;
+                }
+            }
+        }
+    }
+
+    if (compare_frame_sync) {
+        const std::vector<ApplicationOptions> base_runs = runs;
+        runs.clear();
+        for (const auto& base : base_runs) {
+            for (const bool timeline_semaphores : {true, false}) {
+                runs.push_back(base);
+                runs.back().timeline_semaphores = timeline_semaphores;
+            }
+        }
+    }
+
+    std::vector<RunReport> reports;
+    for (const auto& run : runs) {
+        reports.push_back(run_application(run));
+        // An empty report would read as a successful run
+        if (!reports.back().completed) {
+            std::cerr << "Run " << reports.size() << " of " << runs.size() << " failed, no report written\n";
+            return 1;
+        }
+    }
+
+    std::ofstream file(report_path, std::ios::trunc);
+    file << "{\n  \"runs\": [\n";
+    for (size_t i = 0; i < reports.size(); i++) {
+        write_run(file, runs[i], reports[i]);
+        file << (i + 1 < reports.size() ? ",\n" : "\n");
+    }
+    file << "  ]\n}\n";
+    if (!file) {
+        std::cerr << "Failed to write " << report_path << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << report_path << "\n";
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include "bindless_table.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    // Plenty for this renderer, devices allow up to hundreds of thousands
+    constexpr uint32_t MAX_BUFFERS = 1024;
+    constexpr uint32_t MAX_IMAGES = 4096;
+
+    const VkDescriptorBindingFlagsEXT BINDING_FLAGS = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+}
+
+VkPhysicalDeviceDescriptorIndexingFeaturesEXT BindlessTable::required_features() {
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    features.runtimeDescriptorArray = VK_TRUE;
+    features.descriptorBindingPartiallyBound = VK_TRUE;
+    features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    return features;
+}
+
+bool BindlessTable::has_required_features(const VkPhysicalDeviceDescriptorIndexingFeaturesEXT& supported) {
+    return supported.runtimeDescriptorArray && supported.descriptorBindingPartiallyBound &&
+        supported.descriptorBindingUpdateUnusedWhilePending && supported.descriptorBindingStorageBufferUpdateAfterBind &&
+        supported.descriptorBindingSampledImageUpdateAfterBind;
+}
+
+void BindlessTable::enable_core_features(VkPhysicalDeviceFeatures& features) {
+    features.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+    features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+}
+
+bool BindlessTable::has_core_features(const VkPhysicalDeviceFeatures& supported) {
+    return supported.shaderStorageBufferArrayDynamicIndexing && supported.shaderSampledImageArrayDynamicIndexing;
+}
+
+bool BindlessTable::init(VkDevice device, DescriptorLayoutCache& descriptor_layouts,
+                         const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& limits) {
+    device_ = device;
+    buffers_.capacity = std::min({MAX_BUFFERS, limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+        limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers, limits.maxPerStageUpdateAfterBindResources});
+    images_.capacity = std::min({MAX_IMAGES, limits.maxDescriptorSetUpdateAfterBindSampledImages,
+        limits.maxPerStageDescriptorUpdateAfterBindSampledImages, limits.maxDescriptorSetUpdateAfterBindSamplers,
+        limits.maxPerStageDescriptorUpdateAfterBindSamplers, limits.maxPerStageUpdateAfterBindResources - buffers_.capacity});
+    if (buffers_.capacity == 0 || images_.capacity == 0) return false;
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+    bindings[BUFFER_BINDING].binding = BUFFER_BINDING;
+    bindings[BUFFER_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[BUFFER_BINDING].descriptorCount = buffers_.capacity;
+    bindings[BUFFER_BINDING].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[IMAGE_BINDING].binding = IMAGE_BINDING;
+    bindings[IMAGE_BINDING].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[IMAGE_BINDING].descriptorCount = images_.capacity;
+    bindings[IMAGE_BINDING].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    layout_ = descriptor_layouts.get(bindings, {BINDING_FLAGS, BINDING_FLAGS});
+    if (layout_ == VK_NULL_HANDLE) return false;
+
+    const VkDescriptorPoolSize pool_sizes[] = {
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffers_.capacity},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, images_.capacity},
+    };
+    VkDescriptorPoolCreateInfo pool_create_info = {};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_create_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    pool_create_info.maxSets = 1;
+    pool_create_info.poolSizeCount = 2;
+    pool_create_info.pPoolSizes = pool_sizes;
+    if (vkCreateDescriptorPool(device_, &pool_create_info, nullptr, &pool_) != VK_SUCCESS) return false;
+
+    VkDescriptorSetAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool = pool_;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &layout_;
+    return vkAllocateDescriptorSets(device_, &allocate_info, &set_) == VK_SUCCESS;
+}
+
+void BindlessTable::destroy() {
+    vkDestroyDescriptorPool(device_, pool_, nullptr);
+    pool_ = VK_NULL_HANDLE;
+    set_ = VK_NULL_HANDLE;
+}
+
+uint32_t BindlessTable::Slots::acquire() {
+    if (!free_list.empty()) {
+        const uint32_t index = free_list.back();
+        free_list.pop_back();
+        return index;
+    }
+    return next < capacity ? next++ : INVALID_INDEX;
+}
+
+void BindlessTable::Slots::release(uint32_t index) {
+    free_list.push_back(index);
+}
+
+void BindlessTable::write(uint32_t binding, uint32_t index, VkDescriptorType type, const VkDescriptorBufferInfo* buffer_info,
+                          const VkDescriptorImageInfo* image_info) {
+    VkWriteDescriptorSet descriptor_write = {};
+    descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptor_write.dstSet = set_;
+    descriptor_write.dstBinding = binding;
+    descriptor_write.dstArrayElement = index;
+    descriptor_write.descriptorCount = 1;
+    descriptor_write.descriptorType = type;
+    descriptor_write.pBufferInfo = buffer_info;
+    descriptor_write.pImageInfo = image_info;
+    vkUpdateDescriptorSets(device_, 1, &descriptor_write, 0, nullptr);
+}
+
+uint32_t BindlessTable::add_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    const uint32_t index = buffers_.acquire();
+    if (index == INVALID_INDEX) return INVALID_INDEX;
+    const VkDescriptorBufferInfo buffer_info = {buffer, offset, range};
+    write(BUFFER_BINDING, index, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &buffer_info, nullptr);
+    return index;
+}
+
+uint32_t BindlessTable::add_image(VkImageView view, VkSampler sampler, VkImageLayout layout) {
+    const uint32_t index = images_.acquire();
+    if (index == INVALID_INDEX) return INVALID_INDEX;
+    const VkDescriptorImageInfo image_info = {sampler, view, layout};
+    write(IMAGE_BINDING, index, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nullptr, &image_info);
+    return index;
+}
+
+// Partially bound: the stale descriptor stays in the slot, harmless as long as nothing indexes it
+void BindlessTable::release_buffer(uint32_t index) {
+    buffers_.release(index);
+}
+
+void BindlessTable::release_image(uint32_t index) {
+    images_.release(index);
+}
+
+void BindlessTable::bind(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point, VkPipelineLayout pipeline_layout, uint32_t set) const {
+    vkCmdBindDescriptorSets(command_buffer, bind_point, pipeline_layout, set, 1, &set_, 0, nullptr);
+}
+
+void BindlessTable::print_stats(std::ostream& stream) const {
+    stream << "Bindless table: " << buffers_.used() << " of " << buffers_.capacity << " buffers, "
+        << images_.used() << " of " << images_.capacity << " images\n";
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "descriptor_allocator.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Every buffer and image the shaders can reach, in one descriptor set of two big arrays (VK_EXT_descriptor_indexing).
+// Resources are addressed by their index into the arrays, from push constants or instance data, so the set is bound
+// once per command buffer however many objects and materials there are. The bindings are partially bound and
+// update-after-bind: slots get written while the set is bound, even with frames in flight, as long as those frames
+// don't read the slots being written.
+//  - binding 0: storage buffers, declared in GLSL as `buffer ... { ... } buffers[]`
+//  - binding 1: combined image samplers, `sampler2D images[]`
+class BindlessTable
+{
+public:
+    static constexpr uint32_t BUFFER_BINDING = 0;
+    static constexpr uint32_t IMAGE_BINDING = 1;
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+    // The features init() relies on, to chain into VkDeviceCreateInfo. supported tells whether the device has them.
+    static VkPhysicalDeviceDescriptorIndexingFeaturesEXT required_features();
+    static bool has_required_features(const VkPhysicalDeviceDescriptorIndexingFeaturesEXT& supported);
+    // Indexing the arrays with anything but a constant also needs these core features
+    static void enable_core_features(VkPhysicalDeviceFeatures& features);
+    static bool has_core_features(const VkPhysicalDeviceFeatures& supported);
+
+    // The arrays are as large as the device allows for update-after-bind sets, up to a few thousand slots
+    bool init(VkDevice device, DescriptorLayoutCache& descriptor_layouts, const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& limits);
+    void destroy();
+
+    // The slot's index, INVALID_INDEX once the array is full
+    uint32_t add_buffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+    uint32_t add_image(VkImageView view, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    // Makes the slot available again. Only once no frame in flight reads it anymore, e.g. from the deletion queue.
+    void release_buffer(uint32_t index);
+    void release_image(uint32_t index);
+
+    void bind(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point, VkPipelineLayout pipeline_layout, uint32_t set = 0) const;
+
+    VkDescriptorSetLayout layout() const { return layout_; }
+
+    void print_stats(std::ostream& stream) const;
+
+private:
+    struct Slots
+    {
+        uint32_t capacity = 0;
+        // Slots below next have been handed out at least once, the released ones wait in free_list
+        uint32_t next = 0;
+        std::vector<uint32_t> free_list;
+
+        uint32_t acquire();
+        void release(uint32_t index);
+        uint32_t used() const { return next - uint32_t(free_list.size()); }
+    };
+
+    void write(uint32_t binding, uint32_t index, VkDescriptorType type, const VkDescriptorBufferInfo* buffer_info,
+               const VkDescriptorImageInfo* image_info);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    // Owned by the layout cache
+    VkDescriptorSetLayout layout_ = VK_NULL_HANDLE;
+    // Update-after-bind sets need a pool created for them, so the table has its own
+    VkDescriptorPool pool_ = VK_NULL_HANDLE;
+    VkDescriptorSet set_ = VK_NULL_HANDLE;
+
+    Slots buffers_;
+    Slots images_;
+};
@@ -0,0 +1,209 @@
+#include "cpu_benchmarks.hpp"
+
+#include "frustum_culling.hpp"
+#include "transform_system.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+    const uint32_t OBJECT_COUNTS[] = {1000, 10000, 100000, 1000000};
+    // Enough repetitions of the smaller cases for stable timings
+    constexpr uint32_t OBJECTS_PER_MEASUREMENT = 4000000;
+
+    struct TransformScene
+    {
+        TransformStore store;
+        TransformBatch batch;
+    };
+
+    // Random transforms, the kernels' results are checked against glm by the transforms test group
+    TransformScene build_transform_scene(uint32_t count) {
+        TransformScene scene;
+        std::mt19937 random(count);
+        std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+        scene.batch.parent = glm::rotate(glm::mat4(1.f), 0.3f, glm::vec3(0.f, 0.f, 1.f));
+        scene.batch.local = glm::translate(glm::scale(glm::mat4(1.f), glm::vec3(0.5f)), glm::vec3(-0.5f, 0.25f, 0.f));
+        scene.batch.view_projection = glm::perspective(0.8f, 16.f / 9.f, 0.1f, 100.f) *
+            glm::lookAt(glm::vec3(20.f, 20.f, 20.f), glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f));
+
+        scene.store.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            const glm::vec3 position(10.f * unit(random), 10.f * unit(random), 10.f * unit(random));
+            glm::vec3 axis(unit(random), unit(random), unit(random));
+            axis = glm::length(axis) > 1e-3f ? glm::normalize(axis) : glm::vec3(0.f, 0.f, 1.f);
+            const glm::quat rotation = glm::angleAxis(3.f * unit(random), axis);
+            const glm::vec3 scale(1.f + 0.5f * unit(random), 1.f + 0.5f * unit(random), 1.f + 0.5f * unit(random));
+            scene.store.set(i, position, rotation, scale);
+        }
+        return scene;
+    }
+
+    // Best of several repetitions, in seconds per batch
+    template <typename Function>
+    double measure(uint32_t count, Function function) {
+        const uint32_t repetitions = std::max(3u, OBJECTS_PER_MEASUREMENT / count);
+        double best = 1e30;
+        for (uint32_t r = 0; r < repetitions; r++) {
+            const auto start_time = std::chrono::steady_clock::now();
+            function();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+        }
+        return best;
+    }
+
+    void benchmark_transforms(JobSystem& job_system, std::ostream& out) {
+        bool first = true;
+        out << "    \"transforms\": [\n";
+
+        for (const uint32_t count : OBJECT_COUNTS) {
+            TransformScene scene = build_transform_scene(count);
+            std::vector<glm::mat4> models(count);
+            std::vector<glm::mat4> mvps(count);
+            TransformOutput output;
+            output.models = models.data();
+            output.mvps = mvps.data();
+
+            for (const auto kernel : {TransformKernel::SCALAR, TransformKernel::SSE2, TransformKernel::AVX2}) {
+                if (!transform_kernel_supported(kernel)) continue;
+                for (const bool parallel : {false, true}) {
+                    if (parallel && (kernel != best_transform_kernel() || job_system.thread_count() == 1)) continue;
+
+                    const auto run = [&]() {
+                        if (parallel) compute_transforms_parallel(job_system, scene.store, scene.batch, output, kernel);
+                        else compute_transforms(scene.store, 0, count, scene.batch, output, kernel);
+                    };
+                    const double seconds = measure(count, run);
+                    const uint32_t threads = parallel ? job_system.thread_count() : 1;
+                    out << (first ? "" : ",\n") << std::setprecision(4)
+                        << "      {\"kernel\": \"" << transform_kernel_name(kernel) << "\", \"threads\": " << threads
+                        << ", \"objects\": " << count << ", \"ms\": " << std::fixed << seconds * 1000.0
+                        << ", \"ns_per_object\": " << seconds * 1e9 / count << "}" << std::defaultfloat;
+                    first = false;
+
+                    std::cout << std::fixed << std::setprecision(3) << "transforms " << std::setw(7) << count << " x "
+                        << transform_kernel_name(kernel) << " on " << threads << " threads: " << seconds * 1000.0 << " ms, "
+                        << seconds * 1e9 / count << " ns/object\n" << std::defaultfloat;
+                }
+            }
+        }
+
+        out << "\n    ]";
+    }
+
+    struct CullingScene
+    {
+        CullingVolumes volumes;
+        Frustum frustum;
+        std::vector<uint32_t> reference_visible;
+    };
+
+    // Randomly rotated and scaled boxes all around a camera looking down +x, roughly a tenth of them in view
+    CullingScene build_culling_scene(uint32_t count) {
+        CullingScene scene;
+        std::mt19937 random(count);
+        std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+        const glm::mat4 view_projection = glm::perspective(1.f, 16.f / 9.f, 0.1f, 100.f) *
+            glm::lookAt(glm::vec3(0.f), glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 0.f, 1.f));
+        scene.frustum = extract_frustum_planes(view_projection);
+
+        scene.volumes.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            const glm::vec3 position(100.f * unit(random), 100.f * unit(random), 100.f * unit(random));
+            glm::vec3 axis(unit(random), unit(random), unit(random));
+            axis = glm::length(axis) > 1e-3f ? glm::normalize(axis) : glm::vec3(0.f, 0.f, 1.f);
+            const glm::vec3 scale(1.5f + unit(random), 1.5f + unit(random), 1.5f + unit(random));
+            const glm::mat4 model = glm::translate(glm::mat4(1.f), position) * glm::mat4_cast(glm::angleAxis(3.f * unit(random), axis)) *
+                glm::scale(glm::mat4(1.f), scale);
+            scene.volumes.set_transformed(i, model, glm::vec3(-0.5f), glm::vec3(0.5f));
+        }
+
+        // Straight from the definition, with the operations in the kernels' order so the lists match exactly
+        for (uint32_t i = 0; i < count; i++) {
+            const glm::vec3 center(scene.volumes.component(CullingVolumes::CENTER_X)[i], scene.volumes.component(CullingVolumes::CENTER_Y)[i],
+                scene.volumes.component(CullingVolumes::CENTER_Z)[i]);
+            const glm::vec3 half_extent(scene.volumes.component(CullingVolumes::HALF_EXTENT_X)[i],
+                scene.volumes.component(CullingVolumes::HALF_EXTENT_Y)[i], scene.volumes.component(CullingVolumes::HALF_EXTENT_Z)[i]);
+            const float radius = scene.volumes.component(CullingVolumes::RADIUS)[i];
+
+            bool inside = true;
+            for (const auto& plane : scene.frustum.planes) {
+                const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+                const float box_reach = glm::dot(glm::abs(glm::vec3(plane)), half_extent);
+                if (distance + std::min(radius, box_reach) < 0.f) inside = false;
+            }
+            if (inside) scene.reference_visible.push_back(i);
+        }
+        return scene;
+    }
+
+    bool benchmark_culling(JobSystem& job_system, std::ostream& out) {
+        bool valid = true;
+        bool first = true;
+        out << "    \"culling\": [\n";
+
+        for (const uint32_t count : OBJECT_COUNTS) {
+            CullingScene scene = build_culling_scene(count);
+            std::vector<uint32_t> visible(count);
+
+            for (const auto kernel : {CullingKernel::SCALAR, CullingKernel::SSE2, CullingKernel::AVX2}) {
+                if (!culling_kernel_supported(kernel)) continue;
+                for (const bool parallel : {false, true}) {
+                    if (parallel && (kernel != best_culling_kernel() || job_system.thread_count() == 1)) continue;
+
+                    uint32_t visible_count = 0;
+                    const auto run = [&]() {
+                        if (parallel) visible_count = cull_volumes_parallel(job_system, scene.volumes, scene.frustum, visible, kernel);
+                        else visible_count = cull_volumes(scene.volumes, 0, count, scene.frustum, visible.data(), kernel);
+                    };
+                    run();
+                    if (visible_count != scene.reference_visible.size() ||
+                        !std::equal(scene.reference_visible.begin(), scene.reference_visible.end(), visible.begin())) {
+                        std::cerr << "Culling kernel " << culling_kernel_name(kernel) << (parallel ? " (parallel)" : "")
+                            << " kept " << visible_count << " of " << count << " objects instead of "
+                            << scene.reference_visible.size() << "\n";
+                        valid = false;
+                    }
+
+                    const double seconds = measure(count, run);
+                    const uint32_t threads = parallel ? job_system.thread_count() : 1;
+                    const double objects_per_ms_per_core = count / (seconds * 1000.0) / threads;
+                    out << (first ? "" : ",\n") << std::fixed << std::setprecision(4)
+                        << "      {\"kernel\": \"" << culling_kernel_name(kernel) << "\", \"threads\": " << threads
+                        << ", \"objects\": " << count << ", \"visible\": " << visible_count << ", \"ms\": " << seconds * 1000.0
+                        << ", \"objects_per_ms_per_core\": " << std::setprecision(0) << objects_per_ms_per_core << "}"
+                        << std::defaultfloat;
+                    first = false;
+
+                    std::cout << std::fixed << std::setprecision(3) << "culling    " << std::setw(7) << count << " x "
+                        << culling_kernel_name(kernel) << " on " << threads << " threads: " << seconds * 1000.0 << " ms, "
+                        << std::setprecision(0) << objects_per_ms_per_core << " objects/ms/core, " << visible_count
+                        << " visible\n" << std::defaultfloat;
+                }
+            }
+        }
+
+        out << "\n    ]";
+        return valid;
+    }
+}
+
+bool run_cpu_benchmarks(JobSystem& job_system, std::ostream& out) {
+    out << "  \"cpu_benchmarks\": {\n";
+    benchmark_transforms(job_system, out);
+    out << ",\n";
+    const bool valid = benchmark_culling(job_system, out);
+    out << "\n  }";
+    return valid;
+}
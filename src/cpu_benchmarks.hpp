@@ -0,0 +1,10 @@
+#pragma once
+
+#include "job_system.hpp"
+
+#include <ostream>
+
+// Micro-benchmarks of the per-frame CPU systems, no Vulkan device involved. The transform kernels are checked against
+// glm by the transforms test group (tests/transform_tests.cpp). Culling cases are compared with a plain reference
+// before they are timed, and the function returns false if any visible list is off. Writes a JSON object to out.
+bool run_cpu_benchmarks(JobSystem& job_system, std::ostream& out);
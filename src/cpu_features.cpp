@@ -0,0 +1,29 @@
+#include "cpu_features.hpp"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace
+{
+    bool detect_avx2() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        int registers[4];
+        __cpuid(registers, 1);
+        // AVX and OSXSAVE, and the OS saving the YMM registers on context switches
+        const bool avx = (registers[2] & (1 << 28)) != 0 && (registers[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+        __cpuidex(registers, 7, 0);
+        return avx && (registers[1] & (1 << 5)) != 0;
+#else
+        return false;
+#endif
+    }
+}
+
+bool cpu_supports_avx2() {
+    static const bool supported = detect_avx2();
+    return supported;
+}
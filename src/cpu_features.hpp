@@ -0,0 +1,4 @@
+#pragma once
+
+// Runtime CPU checks for code paths compiled for more than the baseline instruction set. Cached after the first call.
+bool cpu_supports_avx2();
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+
+// Defers destruction of Vulkan objects until the GPU is done with them. Each deleter is tagged with the last frame
+// that could still reference the object and runs once that frame is known to be complete.
+class DeletionQueue
+{
+public:
+    void push(uint64_t last_use_frame, std::function<void()> deleter) {
+        entries_.push_back({last_use_frame, std::move(deleter)});
+    }
+
+    // Frames complete in submission order, so entries are in non-decreasing frame order as well
+    void collect(uint64_t completed_frame) {
+        while (!entries_.empty() && entries_.front().frame <= completed_frame) {
+            entries_.front().deleter();
+            entries_.pop_front();
+        }
+    }
+
+    // Only valid once the device is idle
+    void flush() {
+        for (auto& entry : entries_) entry.deleter();
+        entries_.clear();
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t frame;
+        std::function<void()> deleter;
+    };
+
+    std::deque<Entry> entries_;
+};
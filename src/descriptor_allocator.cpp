@@ -0,0 +1,250 @@
+#include "descriptor_allocator.hpp"
+
+#include "hash.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+    // Pools stop growing here, beyond that more pools are cheaper than bigger ones
+    constexpr uint32_t MAX_POOL_SETS = 4096;
+
+    // Descriptors per set of each type a pool is sized for. Sets using more of a type just fill pools up faster.
+    constexpr VkDescriptorPoolSize POOL_RATIOS[] = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4},
+    };
+
+    uint64_t hash_bindings(const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+        uint64_t hash = FNV1A_OFFSET_BASIS;
+        for (const auto& binding : bindings) {
+            hash = fnv1a(&binding.binding, sizeof(binding.binding), hash);
+            hash = fnv1a(&binding.descriptorType, sizeof(binding.descriptorType), hash);
+            hash = fnv1a(&binding.descriptorCount, sizeof(binding.descriptorCount), hash);
+            hash = fnv1a(&binding.stageFlags, sizeof(binding.stageFlags), hash);
+        }
+        return hash;
+    }
+
+    bool same_bindings(const std::vector<VkDescriptorSetLayoutBinding>& a, const std::vector<VkDescriptorSetLayoutBinding>& b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const VkDescriptorSetLayoutBinding& x, const VkDescriptorSetLayoutBinding& y) {
+            return x.binding == y.binding && x.descriptorType == y.descriptorType && x.descriptorCount == y.descriptorCount &&
+                x.stageFlags == y.stageFlags && x.pImmutableSamplers == y.pImmutableSamplers;
+        });
+    }
+
+    // Index of the type in POOL_RATIOS, size of POOL_RATIOS for types pools don't hold
+    size_t pool_type_index(VkDescriptorType type) {
+        for (size_t i = 0; i < std::size(POOL_RATIOS); i++) {
+            if (POOL_RATIOS[i].type == type) return i;
+        }
+        return std::size(POOL_RATIOS);
+    }
+
+    bool is_buffer_type(VkDescriptorType type) {
+        return type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+            type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER || type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    }
+}
+
+DescriptorWrite DescriptorWrite::buffer_write(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset,
+                                              VkDeviceSize range) {
+    DescriptorWrite write;
+    write.binding = binding;
+    write.type = type;
+    write.buffer = {buffer, offset, range};
+    return write;
+}
+
+DescriptorWrite DescriptorWrite::image_write(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler,
+                                             VkImageLayout layout) {
+    DescriptorWrite write;
+    write.binding = binding;
+    write.type = type;
+    write.image = {sampler, view, layout};
+    return write;
+}
+
+void DescriptorLayoutCache::init(VkDevice device) {
+    device_ = device;
+}
+
+void DescriptorLayoutCache::destroy() {
+    for (const auto& entry : layouts_) vkDestroyDescriptorSetLayout(device_, entry.second.layout, nullptr);
+    layouts_.clear();
+    entries_by_layout_.clear();
+}
+
+const std::vector<VkDescriptorSetLayoutBinding>* DescriptorLayoutCache::bindings(VkDescriptorSetLayout layout) const {
+    const auto it = entries_by_layout_.find(layout);
+    return it != entries_by_layout_.end() ? &it->second->bindings : nullptr;
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::get(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+                                                 const std::vector<VkDescriptorBindingFlagsEXT>& binding_flags) {
+    uint64_t hash = hash_bindings(bindings);
+    if (!binding_flags.empty()) hash = fnv1a(binding_flags.data(), binding_flags.size() * sizeof(VkDescriptorBindingFlagsEXT), hash);
+    const auto range = layouts_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (same_bindings(it->second.bindings, bindings) && it->second.binding_flags == binding_flags) return it->second.layout;
+    }
+
+    VkDescriptorSetLayoutCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    create_info.bindingCount = uint32_t(bindings.size());
+    create_info.pBindings = bindings.data();
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_create_info = {};
+    if (!binding_flags.empty()) {
+        flags_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        flags_create_info.bindingCount = uint32_t(binding_flags.size());
+        flags_create_info.pBindingFlags = binding_flags.data();
+        create_info.pNext = &flags_create_info;
+        for (const auto flags : binding_flags) {
+            if (flags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT) {
+                create_info.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+            }
+        }
+    }
+
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    if (vkCreateDescriptorSetLayout(device_, &create_info, nullptr, &layout) != VK_SUCCESS) return VK_NULL_HANDLE;
+
+    const auto entry = layouts_.emplace(hash, Entry{bindings, binding_flags, layout});
+    entries_by_layout_.emplace(layout, &entry->second);
+    return layout;
+}
+
+void DescriptorAllocator::init(VkDevice device, const DescriptorLayoutCache& layouts, uint32_t first_pool_sets) {
+    device_ = device;
+    layouts_ = &layouts;
+    first_pool_sets_ = std::max(first_pool_sets, 1u);
+    remaining_sets_ = 0;
+    remaining_descriptors_.assign(std::size(POOL_RATIOS), 0);
+}
+
+void DescriptorAllocator::destroy() {
+    for (const auto& pool : used_pools_) vkDestroyDescriptorPool(device_, pool.pool, nullptr);
+    for (const auto& pool : free_pools_) vkDestroyDescriptorPool(device_, pool.pool, nullptr);
+    used_pools_.clear();
+    free_pools_.clear();
+    remaining_sets_ = 0;
+}
+
+DescriptorAllocator::Pool DescriptorAllocator::create_pool(uint32_t max_sets) {
+    VkDescriptorPoolSize pool_sizes[std::size(POOL_RATIOS)];
+    for (size_t i = 0; i < std::size(POOL_RATIOS); i++) {
+        pool_sizes[i] = {POOL_RATIOS[i].type, POOL_RATIOS[i].descriptorCount * max_sets};
+    }
+
+    VkDescriptorPoolCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    create_info.maxSets = max_sets;
+    create_info.poolSizeCount = uint32_t(std::size(pool_sizes));
+    create_info.pPoolSizes = pool_sizes;
+
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    if (vkCreateDescriptorPool(device_, &create_info, nullptr, &pool) != VK_SUCCESS) return {VK_NULL_HANDLE, 0};
+    pool_count_++;
+    return {pool, max_sets};
+}
+
+bool DescriptorAllocator::next_pool() {
+    Pool pool;
+    if (!free_pools_.empty()) {
+        pool = free_pools_.back();
+        free_pools_.pop_back();
+    } else {
+        const uint32_t doublings = std::min(pool_count_, 31u);
+        pool = create_pool(uint32_t(std::min<uint64_t>(uint64_t(first_pool_sets_) << doublings, MAX_POOL_SETS)));
+        if (pool.pool == VK_NULL_HANDLE) return false;
+    }
+
+    used_pools_.push_back(pool);
+    remaining_sets_ = pool.max_sets;
+    for (size_t i = 0; i < std::size(POOL_RATIOS); i++) remaining_descriptors_[i] = POOL_RATIOS[i].descriptorCount * pool.max_sets;
+    return true;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+    const std::vector<VkDescriptorSetLayoutBinding>* bindings = layouts_->bindings(layout);
+    if (bindings == nullptr) return VK_NULL_HANDLE;
+
+    std::vector<uint32_t> needed(std::size(POOL_RATIOS), 0);
+    for (const auto& binding : *bindings) {
+        const size_t index = pool_type_index(binding.descriptorType);
+        if (index == std::size(POOL_RATIOS)) return VK_NULL_HANDLE;
+        needed[index] += binding.descriptorCount;
+    }
+
+    // Pools only ever hand out sets until reset(), so the counts are exact and a set that doesn't fit what is left
+    // needs the next pool. Sets that even the biggest pool can't hold never fit.
+    const auto fits = [&] {
+        if (remaining_sets_ == 0) return false;
+        for (size_t i = 0; i < needed.size(); i++) {
+            if (needed[i] > remaining_descriptors_[i]) return false;
+        }
+        return true;
+    };
+    for (size_t i = 0; i < needed.size(); i++) {
+        if (needed[i] > POOL_RATIOS[i].descriptorCount * MAX_POOL_SETS) return VK_NULL_HANDLE;
+    }
+    while (used_pools_.empty() || !fits()) {
+        if (!next_pool()) return VK_NULL_HANDLE;
+    }
+
+    VkDescriptorSetAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool = used_pools_.back().pool;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &layout;
+
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    if (vkAllocateDescriptorSets(device_, &allocate_info, &set) != VK_SUCCESS) return VK_NULL_HANDLE;
+
+    remaining_sets_--;
+    for (size_t i = 0; i < needed.size(); i++) remaining_descriptors_[i] -= needed[i];
+    allocated_sets_++;
+    return set;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout, const std::vector<DescriptorWrite>& writes) {
+    const VkDescriptorSet set = allocate(layout);
+    if (set == VK_NULL_HANDLE) return VK_NULL_HANDLE;
+
+    std::vector<VkWriteDescriptorSet> descriptor_writes(writes.size());
+    for (size_t i = 0; i < writes.size(); i++) {
+        VkWriteDescriptorSet& descriptor_write = descriptor_writes[i];
+        descriptor_write = {};
+        descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptor_write.dstSet = set;
+        descriptor_write.dstBinding = writes[i].binding;
+        descriptor_write.descriptorCount = 1;
+        descriptor_write.descriptorType = writes[i].type;
+        if (is_buffer_type(writes[i].type)) {
+            descriptor_write.pBufferInfo = &writes[i].buffer;
+        } else {
+            descriptor_write.pImageInfo = &writes[i].image;
+        }
+    }
+    vkUpdateDescriptorSets(device_, uint32_t(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+    return set;
+}
+
+void DescriptorAllocator::reset() {
+    for (const auto& pool : used_pools_) {
+        vkResetDescriptorPool(device_, pool.pool, 0);
+        free_pools_.push_back(pool);
+    }
+    used_pools_.clear();
+    remaining_sets_ = 0;
+    reset_count_++;
+}
+
+void DescriptorAllocator::print_stats(std::ostream& stream, const char* name) const {
+    stream << name << " descriptors: " << allocated_sets_ << " sets allocated from " << pool_count_ << " pools, "
+        << reset_count_ << " resets\n";
+}
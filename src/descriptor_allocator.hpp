@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+// One descriptor of a set, a buffer or an image/sampler depending on type. Unused fields stay zero.
+struct DescriptorWrite
+{
+    uint32_t binding = 0;
+    VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    VkDescriptorBufferInfo buffer = {};
+    VkDescriptorImageInfo image = {};
+
+    static DescriptorWrite buffer_write(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+    static DescriptorWrite image_write(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout);
+};
+
+// Set layouts by their bindings: asking twice for the same bindings returns the same layout. Layouts live until
+// destroy(). Binding flags (VK_EXT_descriptor_indexing) are part of the key, one per binding or none at all; a layout
+// with an update-after-bind binding gets the matching layout flag and needs a pool created for it.
+class DescriptorLayoutCache
+{
+public:
+    void init(VkDevice device);
+    void destroy();
+
+    // Null on failure
+    VkDescriptorSetLayout get(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+                              const std::vector<VkDescriptorBindingFlagsEXT>& binding_flags = {});
+    // The bindings a layout from get() was created with, null for layouts this cache didn't create
+    const std::vector<VkDescriptorSetLayoutBinding>* bindings(VkDescriptorSetLayout layout) const;
+
+private:
+    struct Entry
+    {
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+        std::vector<VkDescriptorBindingFlagsEXT> binding_flags;
+        VkDescriptorSetLayout layout;
+    };
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    std::unordered_multimap<uint64_t, Entry> layouts_;
+    std::unordered_map<VkDescriptorSetLayout, const Entry*> entries_by_layout_;
+};
+
+// Hands out descriptor sets from a growing list of pools, each one twice the size of the last up to a cap, so nothing
+// has to know up front how many sets there will be. Sets are never freed one by one: reset() recycles every pool at
+// once with vkResetDescriptorPool, which is what a per-frame allocator does once the frame's fence has signaled.
+// Without VK_KHR_maintenance1 allocating from a full pool is invalid rather than an error, so the allocator counts
+// what is left in the current pool and moves to the next one before it runs out. That needs the bindings of every
+// layout, which is why layouts have to come from the DescriptorLayoutCache given to init().
+// Not thread safe, give each thread its own.
+class DescriptorAllocator
+{
+public:
+    void init(VkDevice device, const DescriptorLayoutCache& layouts, uint32_t first_pool_sets = 64);
+    void destroy();
+
+    // A set to write yourself, null if even a new pool can't provide one or the layout isn't from the layout cache
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+    // A set of the layout with these descriptors, already written. Null on failure.
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout, const std::vector<DescriptorWrite>& writes);
+
+    // Every set handed out so far becomes invalid
+    void reset();
+
+    void print_stats(std::ostream& stream, const char* name) const;
+
+private:
+    struct Pool
+    {
+        VkDescriptorPool pool;
+        uint32_t max_sets;
+    };
+
+    Pool create_pool(uint32_t max_sets);
+    // Makes the next free or new pool the current one, false if none could be created
+    bool next_pool();
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    const DescriptorLayoutCache* layouts_ = nullptr;
+    uint32_t first_pool_sets_ = 0;
+    // Pools with sets handed out since the last reset(), the last one is where allocations go
+    std::vector<Pool> used_pools_;
+    std::vector<Pool> free_pools_;
+    // What is left in used_pools_.back(): sets, then descriptors of each pool size type
+    uint32_t remaining_sets_ = 0;
+    std::vector<uint32_t> remaining_descriptors_;
+
+    uint32_t pool_count_ = 0;
+    uint64_t allocated_sets_ = 0;
+    uint64_t reset_count_ = 0;
+};
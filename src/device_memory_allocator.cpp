@@ -0,0 +1,351 @@
+#include "device_memory_allocator.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+    VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+        return alignment <= 1 ? value : (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Linear and optimal resources may not share a bufferImageGranularity page
+    bool kinds_conflict(AllocationKind a, AllocationKind b) {
+        return (a == AllocationKind::LINEAR && b == AllocationKind::OPTIMAL) ||
+            (a == AllocationKind::OPTIMAL && b == AllocationKind::LINEAR);
+    }
+
+    bool on_same_page(VkDeviceSize last_byte_of_a, VkDeviceSize first_byte_of_b, VkDeviceSize page_size) {
+        return page_size > 1 && last_byte_of_a / page_size == first_byte_of_b / page_size;
+    }
+
+    double to_mib(VkDeviceSize bytes) {
+        return double(bytes) / (1024.0 * 1024.0);
+    }
+}
+
+void DeviceMemoryAllocator::init(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize preferred_block_size) {
+    device_ = device;
+    preferred_block_size_ = preferred_block_size;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties_);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    limits_ = properties.limits;
+}
+
+void DeviceMemoryAllocator::destroy() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& block : blocks_) {
+        if (block.memory != VK_NULL_HANDLE) vkFreeMemory(device_, block.memory, nullptr);
+    }
+    blocks_.clear();
+    device_memory_count_ = 0;
+}
+
+uint32_t DeviceMemoryAllocator::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags property_flags) const {
+    for (uint32_t i = 0; i < memory_properties_.memoryTypeCount; i++) {
+        if (type_filter & (1 << i) &&
+            (memory_properties_.memoryTypes[i].propertyFlags & property_flags) == property_flags) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+bool DeviceMemoryAllocator::is_host_coherent(uint32_t memory_type) const {
+    return (memory_properties_.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+VkDeviceSize DeviceMemoryAllocator::block_size_for(uint32_t memory_type) const {
+    // Small heaps (e.g. the 256 MiB host visible device local one) shouldn't be eaten up by a couple of blocks
+    const auto heap_size = memory_properties_.memoryHeaps[memory_properties_.memoryTypes[memory_type].heapIndex].size;
+    return std::min(preferred_block_size_, heap_size / 8);
+}
+
+VkResult DeviceMemoryAllocator::allocate_device_memory(uint32_t memory_type, VkDeviceSize size,
+                                                       VkDeviceMemory& memory, void*& mapped) {
+    if (device_memory_count_ >= limits_.maxMemoryAllocationCount) return VK_ERROR_TOO_MANY_OBJECTS;
+
+    VkMemoryAllocateInfo memory_allocate_info = {};
+    memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memory_allocate_info.allocationSize = size;
+    memory_allocate_info.memoryTypeIndex = memory_type;
+
+    VkResult result = vkAllocateMemory(device_, &memory_allocate_info, nullptr, &memory);
+    if (result != VK_SUCCESS) return result;
+
+    mapped = nullptr;
+    if (memory_properties_.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        result = vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+        if (result != VK_SUCCESS) {
+            vkFreeMemory(device_, memory, nullptr);
+            return result;
+        }
+    }
+
+    device_memory_count_++;
+    return VK_SUCCESS;
+}
+
+void DeviceMemoryAllocator::free_device_memory(VkDeviceMemory memory) {
+    // Freeing implicitly unmaps
+    vkFreeMemory(device_, memory, nullptr);
+    device_memory_count_--;
+}
+
+uint32_t DeviceMemoryAllocator::create_block(uint32_t memory_type) {
+    Block block;
+    block.size = block_size_for(memory_type);
+    block.memory_type = memory_type;
+    if (allocate_device_memory(memory_type, block.size, block.memory, block.mapped) != VK_SUCCESS) return UINT32_MAX;
+    block.ranges.push_back({0, block.size, AllocationKind::FREE});
+
+    for (uint32_t i = 0; i < blocks_.size(); i++) {
+        if (blocks_[i].memory == VK_NULL_HANDLE) {
+            blocks_[i] = std::move(block);
+            return i;
+        }
+    }
+    blocks_.push_back(std::move(block));
+    return uint32_t(blocks_.size() - 1);
+}
+
+bool DeviceMemoryAllocator::try_allocate_from_block(uint32_t block_index, const VkMemoryRequirements& requirements,
+                                                    AllocationKind kind, Allocation& allocation) {
+    Block& block = blocks_[block_index];
+    auto& ranges = block.ranges;
+    const VkDeviceSize granularity = limits_.bufferImageGranularity;
+
+    // Best fit: the smallest free range that still holds the allocation after alignment
+    size_t best_range = SIZE_MAX;
+    VkDeviceSize best_offset = 0;
+    VkDeviceSize best_remainder = ~VkDeviceSize(0);
+
+    for (size_t i = 0; i < ranges.size(); i++) {
+        const Range& range = ranges[i];
+        if (range.kind != AllocationKind::FREE || range.size < requirements.size) continue;
+
+        VkDeviceSize offset = align_up(range.offset, requirements.alignment);
+        // Free ranges are always surrounded by used ones (or the block edges), so only those can conflict
+        if (i > 0) {
+            const Range& previous = ranges[i - 1];
+            if (kinds_conflict(previous.kind, kind) && on_same_page(previous.offset + previous.size - 1, offset, granularity)) {
+                offset = align_up(offset, granularity);
+            }
+        }
+
+        const VkDeviceSize end = offset + requirements.size;
+        if (end > range.offset + range.size) continue;
+        if (i + 1 < ranges.size()) {
+            const Range& next = ranges[i + 1];
+            if (kinds_conflict(kind, next.kind) && on_same_page(end - 1, next.offset, granularity)) continue;
+        }
+
+        const VkDeviceSize remainder = range.size - requirements.size;
+        if (remainder < best_remainder) {
+            best_range = i;
+            best_offset = offset;
+            best_remainder = remainder;
+            if (remainder == 0) break;
+        }
+    }
+
+    if (best_range == SIZE_MAX) return false;
+
+    const Range free_range = ranges[best_range];
+    const VkDeviceSize end = best_offset + requirements.size;
+    const VkDeviceSize free_end = free_range.offset + free_range.size;
+
+    std::vector<Range> split;
+    if (best_offset > free_range.offset) split.push_back({free_range.offset, best_offset - free_range.offset, AllocationKind::FREE});
+    split.push_back({best_offset, requirements.size, kind});
+    if (end < free_end) split.push_back({end, free_end - end, AllocationKind::FREE});
+
+    ranges.erase(ranges.begin() + best_range);
+    ranges.insert(ranges.begin() + best_range, split.begin(), split.end());
+    block.allocation_count++;
+
+    allocation.memory = block.memory;
+    allocation.offset = best_offset;
+    allocation.size = requirements.size;
+    allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + best_offset : nullptr;
+    allocation.memory_type = block.memory_type;
+    allocation.block = block_index;
+    return true;
+}
+
+VkResult DeviceMemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags property_flags,
+                                         AllocationKind kind, Allocation& allocation) {
+    const uint32_t memory_type = find_memory_type(requirements.memoryTypeBits, property_flags);
+    if (memory_type == UINT32_MAX) return VK_ERROR_FEATURE_NOT_PRESENT;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (requirements.size > block_size_for(memory_type) / 2) {
+        Allocation dedicated;
+        const VkResult result = allocate_device_memory(memory_type, requirements.size, dedicated.memory, dedicated.mapped);
+        if (result != VK_SUCCESS) return result;
+        dedicated.size = requirements.size;
+        dedicated.memory_type = memory_type;
+        dedicated.block = DEDICATED_BLOCK;
+        dedicated_allocation_count_++;
+        dedicated_bytes_ += requirements.size;
+        allocation = dedicated;
+        return VK_SUCCESS;
+    }
+
+    for (uint32_t i = 0; i < blocks_.size(); i++) {
+        if (blocks_[i].memory == VK_NULL_HANDLE || blocks_[i].memory_type != memory_type) continue;
+        if (try_allocate_from_block(i, requirements, kind, allocation)) return VK_SUCCESS;
+    }
+
+    const uint32_t block_index = create_block(memory_type);
+    if (block_index == UINT32_MAX) return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    return try_allocate_from_block(block_index, requirements, kind, allocation) ? VK_SUCCESS : VK_ERROR_OUT_OF_DEVICE_MEMORY;
+}
+
+void DeviceMemoryAllocator::release_block_if_redundant(uint32_t block_index) {
+    const Block& block = blocks_[block_index];
+    if (block.allocation_count != 0) return;
+
+    // Keep one empty block per memory type around, so that a free/allocate pattern doesn't hit vkAllocateMemory
+    for (uint32_t i = 0; i < blocks_.size(); i++) {
+        if (i == block_index || blocks_[i].memory == VK_NULL_HANDLE) continue;
+        if (blocks_[i].memory_type == block.memory_type && blocks_[i].allocation_count == 0) {
+            free_device_memory(block.memory);
+            blocks_[block_index] = Block();
+            return;
+        }
+    }
+}
+
+void DeviceMemoryAllocator::free(Allocation& allocation) {
+    if (!allocation.is_valid()) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (allocation.block == DEDICATED_BLOCK) {
+        free_device_memory(allocation.memory);
+        dedicated_allocation_count_--;
+        dedicated_bytes_ -= allocation.size;
+        allocation = Allocation();
+        return;
+    }
+
+    Block& block = blocks_[allocation.block];
+    auto& ranges = block.ranges;
+    auto it = std::lower_bound(ranges.begin(), ranges.end(), allocation.offset,
+        [](const Range& range, VkDeviceSize offset) { return range.offset < offset; });
+    if (it == ranges.end() || it->offset != allocation.offset || it->kind == AllocationKind::FREE) {
+        std::cerr << "DeviceMemoryAllocator: freeing unknown allocation at offset " << allocation.offset << "\n";
+        return;
+    }
+
+    it->kind = AllocationKind::FREE;
+    auto next = it + 1;
+    if (next != ranges.end() && next->kind == AllocationKind::FREE) {
+        it->size += next->size;
+        ranges.erase(next);
+    }
+    if (it != ranges.begin()) {
+        auto previous = it - 1;
+        if (previous->kind == AllocationKind::FREE) {
+            previous->size += it->size;
+            ranges.erase(it);
+        }
+    }
+
+    block.allocation_count--;
+    release_block_if_redundant(allocation.block);
+    allocation = Allocation();
+}
+
+VkResult DeviceMemoryAllocator::create_buffer(const VkBufferCreateInfo& create_info, VkMemoryPropertyFlags property_flags,
+                                              VkBuffer& buffer, Allocation& allocation) {
+    VkResult result = vkCreateBuffer(device_, &create_info, nullptr, &buffer);
+    if (result != VK_SUCCESS) return result;
+
+    VkMemoryRequirements memory_requirements;
+    vkGetBufferMemoryRequirements(device_, buffer, &memory_requirements);
+
+    result = allocate(memory_requirements, property_flags, AllocationKind::LINEAR, allocation);
+    if (result != VK_SUCCESS) {
+        vkDestroyBuffer(device_, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+        return result;
+    }
+
+    return vkBindBufferMemory(device_, buffer, allocation.memory, allocation.offset);
+}
+
+VkResult DeviceMemoryAllocator::create_image(const VkImageCreateInfo& create_info, VkMemoryPropertyFlags property_flags,
+                                             VkImage& image, Allocation& allocation) {
+    VkResult result = vkCreateImage(device_, &create_info, nullptr, &image);
+    if (result != VK_SUCCESS) return result;
+
+    VkMemoryRequirements memory_requirements;
+    vkGetImageMemoryRequirements(device_, image, &memory_requirements);
+
+    const auto kind = create_info.tiling == VK_IMAGE_TILING_OPTIMAL ? AllocationKind::OPTIMAL : AllocationKind::LINEAR;
+    result = allocate(memory_requirements, property_flags, kind, allocation);
+    if (result != VK_SUCCESS) {
+        vkDestroyImage(device_, image, nullptr);
+        image = VK_NULL_HANDLE;
+        return result;
+    }
+
+    return vkBindImageMemory(device_, image, allocation.memory, allocation.offset);
+}
+
+void DeviceMemoryAllocator::destroy_buffer(VkBuffer& buffer, Allocation& allocation) {
+    if (buffer != VK_NULL_HANDLE) vkDestroyBuffer(device_, buffer, nullptr);
+    buffer = VK_NULL_HANDLE;
+    free(allocation);
+}
+
+void DeviceMemoryAllocator::destroy_image(VkImage& image, Allocation& allocation) {
+    if (image != VK_NULL_HANDLE) vkDestroyImage(device_, image, nullptr);
+    image = VK_NULL_HANDLE;
+    free(allocation);
+}
+
+AllocatorStats DeviceMemoryAllocator::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    AllocatorStats stats;
+    stats.device_memory_count = device_memory_count_;
+    stats.dedicated_allocation_count = dedicated_allocation_count_;
+    stats.allocation_count = dedicated_allocation_count_;
+    stats.reserved_bytes = dedicated_bytes_;
+    stats.used_bytes = dedicated_bytes_;
+
+    for (const auto& block : blocks_) {
+        if (block.memory == VK_NULL_HANDLE) continue;
+        stats.block_count++;
+        stats.allocation_count += block.allocation_count;
+        stats.reserved_bytes += block.size;
+        for (const auto& range : block.ranges) {
+            if (range.kind == AllocationKind::FREE) {
+                stats.free_bytes += range.size;
+                stats.free_range_count++;
+                stats.largest_free_range = std::max(stats.largest_free_range, range.size);
+            } else {
+                stats.used_bytes += range.size;
+            }
+        }
+    }
+    return stats;
+}
+
+void DeviceMemoryAllocator::print_stats(std::ostream& stream) const {
+    const auto s = stats();
+    stream << std::fixed << std::setprecision(2)
+        << "Device memory: " << s.allocation_count << " allocations in "
+        << s.block_count << " blocks + " << s.dedicated_allocation_count << " dedicated ("
+        << s.device_memory_count << "/" << limits_.maxMemoryAllocationCount << " VkDeviceMemory objects), "
+        << to_mib(s.used_bytes) << " MiB used of " << to_mib(s.reserved_bytes) << " MiB reserved, "
+        << s.free_range_count << " free ranges, fragmentation " << s.fragmentation() << "\n";
+    stream.unsetf(std::ios_base::floatfield);
+}
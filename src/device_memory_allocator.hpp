@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// What is going to be bound to an allocation. Linear resources (buffers, linear images) and optimal tiling images
+// must not share a bufferImageGranularity page, so the allocator has to know which is which.
+enum class AllocationKind : uint8_t
+{
+    FREE = 0,
+    LINEAR,
+    OPTIMAL,
+};
+
+struct Allocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // Host visible blocks stay mapped for their whole lifetime, this points at the start of the allocation
+    void* mapped = nullptr;
+    uint32_t memory_type = 0;
+    uint32_t block = UINT32_MAX;
+
+    bool is_valid() const { return memory != VK_NULL_HANDLE; }
+};
+
+struct AllocatorStats
+{
+    // Number of live vkAllocateMemory objects, this is what maxMemoryAllocationCount limits
+    uint32_t device_memory_count = 0;
+    uint32_t block_count = 0;
+    uint32_t dedicated_allocation_count = 0;
+    uint32_t allocation_count = 0;
+    VkDeviceSize reserved_bytes = 0;
+    VkDeviceSize used_bytes = 0;
+    VkDeviceSize free_bytes = 0;
+    VkDeviceSize largest_free_range = 0;
+    uint32_t free_range_count = 0;
+
+    // 0 when all free memory is one contiguous range, approaches 1 as it gets split into many small ranges
+    float fragmentation() const {
+        return free_bytes == 0 ? 0.f : 1.f - float(largest_free_range) / float(free_bytes);
+    }
+};
+
+// Grabs large VkDeviceMemory blocks per memory type and sub-allocates buffers and images out of them with a
+// best-fit free list. Adjacent free ranges are merged back on free(). Allocations bigger than half a block get a
+// dedicated VkDeviceMemory of their own.
+class DeviceMemoryAllocator
+{
+public:
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+    void init(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize preferred_block_size = DEFAULT_BLOCK_SIZE);
+    void destroy();
+
+    // Returns VK_ERROR_FEATURE_NOT_PRESENT when no memory type satisfies both the requirements and property_flags
+    VkResult allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags property_flags,
+                      AllocationKind kind, Allocation& allocation);
+    void free(Allocation& allocation);
+
+    VkResult create_buffer(const VkBufferCreateInfo& create_info, VkMemoryPropertyFlags property_flags,
+                           VkBuffer& buffer, Allocation& allocation);
+    VkResult create_image(const VkImageCreateInfo& create_info, VkMemoryPropertyFlags property_flags,
+                          VkImage& image, Allocation& allocation);
+    void destroy_buffer(VkBuffer& buffer, Allocation& allocation);
+    void destroy_image(VkImage& image, Allocation& allocation);
+
+    // UINT32_MAX if there is no such memory type
+    uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags property_flags) const;
+    bool is_host_coherent(uint32_t memory_type) const;
+
+    AllocatorStats stats() const;
+    void print_stats(std::ostream& stream) const;
+
+    const VkPhysicalDeviceLimits& limits() const { return limits_; }
+
+private:
+    static constexpr uint32_t DEDICATED_BLOCK = UINT32_MAX - 1;
+
+    struct Range
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        AllocationKind kind;
+    };
+
+    struct Block
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        uint32_t memory_type = 0;
+        void* mapped = nullptr;
+        uint32_t allocation_count = 0;
+        // Sorted by offset and covering the whole block, free ranges are never adjacent to each other
+        std::vector<Range> ranges;
+    };
+
+    VkResult allocate_device_memory(uint32_t memory_type, VkDeviceSize size, VkDeviceMemory& memory, void*& mapped);
+    void free_device_memory(VkDeviceMemory memory);
+    VkDeviceSize block_size_for(uint32_t memory_type) const;
+    bool try_allocate_from_block(uint32_t block_index, const VkMemoryRequirements& requirements,
+                                 AllocationKind kind, Allocation& allocation);
+    uint32_t create_block(uint32_t memory_type);
+    void release_block_if_redundant(uint32_t block_index);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memory_properties_ = {};
+    VkPhysicalDeviceLimits limits_ = {};
+    VkDeviceSize preferred_block_size_ = DEFAULT_BLOCK_SIZE;
+
+    // Released blocks keep their slot (with a null memory handle) so block indices stored in allocations stay valid
+    std::vector<Block> blocks_;
+    uint32_t device_memory_count_ = 0;
+    uint32_t dedicated_allocation_count_ = 0;
+    VkDeviceSize dedicated_bytes_ = 0;
+
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,28 @@
+#include "file_watcher.hpp"
+
+#include <algorithm>
+
+void FileWatcher::watch(const std::string& path) {
+    const bool watched = std::any_of(files_.begin(), files_.end(), [&path](const WatchedFile& file) { return file.path == path; });
+    if (watched) return;
+
+    std::error_code error;
+    const auto last_write_time = std::filesystem::last_write_time(path, error);
+    files_.push_back({path, error ? std::filesystem::file_time_type::min() : last_write_time});
+}
+
+std::vector<std::string> FileWatcher::poll() {
+    std::vector<std::string> changed;
+    const auto now = std::chrono::steady_clock::now();
+    if (now < next_poll_) return changed;
+    next_poll_ = now + interval_;
+
+    for (auto& file : files_) {
+        std::error_code error;
+        const auto last_write_time = std::filesystem::last_write_time(file.path, error);
+        if (error || last_write_time == file.last_write_time) continue;
+        file.last_write_time = last_write_time;
+        changed.push_back(file.path);
+    }
+    return changed;
+}
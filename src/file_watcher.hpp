@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Polls the modification times of a handful of files. Cheap enough to call every frame: the files are only looked at
+// once per interval, a few stat() calls each time. A file that can't be read (e.g. mid save) keeps its last time.
+class FileWatcher
+{
+public:
+    explicit FileWatcher(std::chrono::milliseconds interval = std::chrono::milliseconds(250)) : interval_(interval) {}
+
+    void watch(const std::string& path);
+
+    // The watched files modified since the last poll() that looked at them
+    std::vector<std::string> poll();
+
+private:
+    struct WatchedFile
+    {
+        std::string path;
+        std::filesystem::file_time_type last_write_time;
+    };
+
+    std::vector<WatchedFile> files_;
+    std::chrono::milliseconds interval_;
+    std::chrono::steady_clock::time_point next_poll_;
+};
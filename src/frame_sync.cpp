@@ -0,0 +1,224 @@
+#include "frame_sync.hpp"
+
+#include <algorithm>
+#include <limits>
+
+bool TimelineSemaphore::init(VkDevice device) {
+    device_ = device;
+    // Core entry points, only there when the device was created for Vulkan 1.2
+    get_counter_value_ = PFN_vkGetSemaphoreCounterValue(vkGetDeviceProcAddr(device_, "vkGetSemaphoreCounterValue"));
+    wait_semaphores_ = PFN_vkWaitSemaphores(vkGetDeviceProcAddr(device_, "vkWaitSemaphores"));
+    if (get_counter_value_ == nullptr || wait_semaphores_ == nullptr) return false;
+
+    VkSemaphoreTypeCreateInfo type_create_info = {};
+    type_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_create_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphore_create_info = {};
+    semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_create_info.pNext = &type_create_info;
+    return vkCreateSemaphore(device_, &semaphore_create_info, nullptr, &semaphore_) == VK_SUCCESS;
+}
+
+void TimelineSemaphore::destroy() {
+    vkDestroySemaphore(device_, semaphore_, nullptr);
+    semaphore_ = VK_NULL_HANDLE;
+}
+
+uint64_t TimelineSemaphore::value() const {
+    uint64_t value = 0;
+    get_counter_value_(device_, semaphore_, &value);
+    return value;
+}
+
+void TimelineSemaphore::wait(uint64_t value) const {
+    VkSemaphoreWaitInfo wait_info = {};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &semaphore_;
+    wait_info.pValues = &value;
+    wait_semaphores_(device_, &wait_info, std::numeric_limits<uint64_t>::max());
+}
+
+bool FrameSync::init(VkDevice device, Mode mode, uint32_t frame_count) {
+    device_ = device;
+    mode_ = mode;
+    completed_frame_ = 0;
+
+    if (mode_ == Mode::FENCES) {
+        // Signaled, so the first frame on each slot doesn't wait for a frame that was never submitted
+        VkFenceCreateInfo fence_create_info = {};
+        fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        fences_.resize(frame_count, VK_NULL_HANDLE);
+        fence_frames_.assign(frame_count, 0);
+        for (auto& fence : fences_) {
+            if (vkCreateFence(device_, &fence_create_info, nullptr, &fence) != VK_SUCCESS) return false;
+        }
+        return true;
+    }
+
+    if (mode_ == Mode::TIMELINE_SYNCHRONIZATION2) {
+        queue_submit2_ = PFN_vkQueueSubmit2KHR(vkGetDeviceProcAddr(device_, "vkQueueSubmit2KHR"));
+        if (queue_submit2_ == nullptr) return false;
+    }
+    return timeline_.init(device_);
+}
+
+void FrameSync::destroy() {
+    for (const auto fence : fences_) vkDestroyFence(device_, fence, nullptr);
+    fences_.clear();
+    fence_frames_.clear();
+    if (timeline_.handle() != VK_NULL_HANDLE) timeline_.destroy();
+}
+
+const char* FrameSync::mode_name(Mode mode) {
+    switch (mode) {
+        case Mode::FENCES: return "fences";
+        case Mode::TIMELINE: return "timeline";
+        case Mode::TIMELINE_SYNCHRONIZATION2: return "timeline-sync2";
+    }
+    return "unknown";
+}
+
+VkResult FrameSync::submit(VkQueue queue, VkCommandBuffer command_buffer, uint64_t frame, const Wait* waits,
+                           uint32_t wait_count, VkSemaphore signal_semaphore) {
+    wait_count = std::min(wait_count, MAX_WAITS);
+    switch (mode_) {
+        case Mode::FENCES: return submit_fence(queue, command_buffer, frame, waits, wait_count, signal_semaphore);
+        case Mode::TIMELINE: return submit_timeline(queue, command_buffer, frame, waits, wait_count, signal_semaphore);
+        case Mode::TIMELINE_SYNCHRONIZATION2:
+            return submit_synchronization2(queue, command_buffer, frame, waits, wait_count, signal_semaphore);
+    }
+    return VK_ERROR_INITIALIZATION_FAILED;
+}
+
+VkResult FrameSync::submit_fence(VkQueue queue, VkCommandBuffer command_buffer, uint64_t frame, const Wait* waits,
+                                 uint32_t wait_count, VkSemaphore signal_semaphore) {
+    const auto slot = uint32_t(frame % fences_.size());
+    // The slot's previous frame is normally long done, a fence can only be reset once it is
+    wait(fence_frames_[slot]);
+
+    VkSemaphore wait_semaphores[MAX_WAITS];
+    VkPipelineStageFlags wait_stages[MAX_WAITS];
+    for (uint32_t i = 0; i < wait_count; i++) {
+        wait_semaphores[i] = waits[i].semaphore;
+        wait_stages[i] = waits[i].stages;
+    }
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.waitSemaphoreCount = wait_count;
+    submit_info.pWaitSemaphores = wait_semaphores;
+    submit_info.pWaitDstStageMask = wait_stages;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+    submit_info.signalSemaphoreCount = signal_semaphore != VK_NULL_HANDLE ? 1 : 0;
+    submit_info.pSignalSemaphores = &signal_semaphore;
+
+    vkResetFences(device_, 1, &fences_[slot]);
+    fence_frames_[slot] = frame;
+    return vkQueueSubmit(queue, 1, &submit_info, fences_[slot]);
+}
+
+VkResult FrameSync::submit_timeline(VkQueue queue, VkCommandBuffer command_buffer, uint64_t frame, const Wait* waits,
+                                    uint32_t wait_count, VkSemaphore signal_semaphore) const {
+    VkSemaphore wait_semaphores[MAX_WAITS];
+    uint64_t wait_values[MAX_WAITS];
+    VkPipelineStageFlags wait_stages[MAX_WAITS];
+    for (uint32_t i = 0; i < wait_count; i++) {
+        wait_semaphores[i] = waits[i].semaphore;
+        wait_values[i] = waits[i].value;
+        wait_stages[i] = waits[i].stages;
+    }
+    // The present semaphore is binary, its value is ignored
+    const VkSemaphore signal_semaphores[] = {timeline_.handle(), signal_semaphore};
+    const uint64_t signal_values[] = {frame, 0};
+    const uint32_t signal_count = signal_semaphore != VK_NULL_HANDLE ? 2 : 1;
+
+    VkTimelineSemaphoreSubmitInfo timeline_submit_info = {};
+    timeline_submit_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_submit_info.waitSemaphoreValueCount = wait_count;
+    timeline_submit_info.pWaitSemaphoreValues = wait_values;
+    timeline_submit_info.signalSemaphoreValueCount = signal_count;
+    timeline_submit_info.pSignalSemaphoreValues = signal_values;
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_submit_info;
+    submit_info.waitSemaphoreCount = wait_count;
+    submit_info.pWaitSemaphores = wait_semaphores;
+    submit_info.pWaitDstStageMask = wait_stages;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffer;
+    submit_info.signalSemaphoreCount = signal_count;
+    submit_info.pSignalSemaphores = signal_semaphores;
+    return vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE);
+}
+
+VkResult FrameSync::submit_synchronization2(VkQueue queue, VkCommandBuffer command_buffer, uint64_t frame,
+                                            const Wait* waits, uint32_t wait_count, VkSemaphore signal_semaphore) const {
+    // The stage bits of synchronization2 keep the values of the original ones
+    VkSemaphoreSubmitInfoKHR wait_infos[MAX_WAITS] = {};
+    for (uint32_t i = 0; i < wait_count; i++) {
+        wait_infos[i].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+        wait_infos[i].semaphore = waits[i].semaphore;
+        wait_infos[i].value = waits[i].value;
+        wait_infos[i].stageMask = waits[i].stages;
+    }
+
+    // The frame's value once everything is done, the present semaphore as soon as the color output is
+    VkSemaphoreSubmitInfoKHR signal_infos[2] = {};
+    signal_infos[0].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+    signal_infos[0].semaphore = timeline_.handle();
+    signal_infos[0].value = frame;
+    signal_infos[0].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+    signal_infos[1].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+    signal_infos[1].semaphore = signal_semaphore;
+    signal_infos[1].stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR;
+
+    VkCommandBufferSubmitInfoKHR command_buffer_info = {};
+    command_buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
+    command_buffer_info.commandBuffer = command_buffer;
+
+    VkSubmitInfo2KHR submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR;
+    submit_info.waitSemaphoreInfoCount = wait_count;
+    submit_info.pWaitSemaphoreInfos = wait_infos;
+    submit_info.commandBufferInfoCount = 1;
+    submit_info.pCommandBufferInfos = &command_buffer_info;
+    submit_info.signalSemaphoreInfoCount = signal_semaphore != VK_NULL_HANDLE ? 2 : 1;
+    submit_info.pSignalSemaphoreInfos = signal_infos;
+    return queue_submit2_(queue, 1, &submit_info, VK_NULL_HANDLE);
+}
+
+uint64_t FrameSync::completed_frame() {
+    if (mode_ != Mode::FENCES) {
+        completed_frame_ = std::max(completed_frame_, timeline_.value());
+        return completed_frame_;
+    }
+    for (size_t slot = 0; slot < fences_.size(); slot++) {
+        if (fence_frames_[slot] > completed_frame_ && vkGetFenceStatus(device_, fences_[slot]) == VK_SUCCESS) {
+            completed_frame_ = fence_frames_[slot];
+        }
+    }
+    return completed_frame_;
+}
+
+void FrameSync::wait(uint64_t frame) {
+    if (frame <= completed_frame_) return;
+    if (mode_ != Mode::FENCES) {
+        timeline_.wait(frame);
+    } else {
+        // A slot holding a later frame means this one completed before the slot was reused, an earlier one that it
+        // hasn't been submitted
+        const auto slot = size_t(frame % fences_.size());
+        if (fence_frames_[slot] < frame) return;
+        if (fence_frames_[slot] == frame) {
+            vkWaitForFences(device_, 1, &fences_[slot], VK_TRUE, std::numeric_limits<uint64_t>::max());
+        }
+    }
+    completed_frame_ = frame;
+}
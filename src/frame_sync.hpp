@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// A VK_SEMAPHORE_TYPE_TIMELINE semaphore, core in Vulkan 1.2. Its value only grows: submissions signal the values
+// handed out to them, in order, and the CPU polls or waits for any of those values.
+class TimelineSemaphore
+{
+public:
+    bool init(VkDevice device);
+    void destroy();
+
+    VkSemaphore handle() const { return semaphore_; }
+    // The highest value signaled so far
+    uint64_t value() const;
+    void wait(uint64_t value) const;
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkSemaphore semaphore_ = VK_NULL_HANDLE;
+    PFN_vkGetSemaphoreCounterValue get_counter_value_ = nullptr;
+    PFN_vkWaitSemaphores wait_semaphores_ = nullptr;
+};
+
+// Tracks GPU progress by frame number: frame N is the one submitted with number N, numbers start at 1 and go up by
+// one per submission. A frame is complete once its commands have executed, frames complete in order.
+// With timeline semaphores every submission signals one semaphore with its frame number, so waiting for any frame
+// is a single vkWaitSemaphores and polling is a single counter read. With synchronization2 on top, submissions go
+// through vkQueueSubmit2KHR. On Vulkan 1.0 devices each of frame_count slots has a fence instead, frame N uses slot
+// N % frame_count and at most frame_count frames may be in flight.
+class FrameSync
+{
+public:
+    enum class Mode : uint8_t
+    {
+        FENCES,
+        TIMELINE,
+        TIMELINE_SYNCHRONIZATION2,
+    };
+
+    // A semaphore the submission waits on before the given stages. value is ignored for binary semaphores, timeline
+    // semaphores can only be waited on in the timeline modes.
+    struct Wait
+    {
+        VkSemaphore semaphore;
+        uint64_t value;
+        VkPipelineStageFlags stages;
+    };
+    static constexpr uint32_t MAX_WAITS = 4;
+
+    bool init(VkDevice device, Mode mode, uint32_t frame_count);
+    // The device must be idle
+    void destroy();
+
+    Mode mode() const { return mode_; }
+    static const char* mode_name(Mode mode);
+
+    // Submits frame with up to MAX_WAITS waits and an optional binary semaphore to signal, e.g. for present
+    VkResult submit(VkQueue queue, VkCommandBuffer command_buffer, uint64_t frame, const Wait* waits, uint32_t wait_count,
+                    VkSemaphore signal_semaphore);
+
+    // The last frame known complete, asks the GPU without blocking
+    uint64_t completed_frame();
+    // Returns once frame is complete, right away for frame 0
+    void wait(uint64_t frame);
+
+private:
+    VkResult submit_fence(VkQueue queue, VkCommandBuffer command_buffer, uint64_t frame, const Wait* waits,
+                          uint32_t wait_count, VkSemaphore signal_semaphore);
+    VkResult submit_timeline(VkQueue queue, VkCommandBuffer command_buffer, uint64_t frame, const Wait* waits,
+                             uint32_t wait_count, VkSemaphore signal_semaphore) const;
+    VkResult submit_synchronization2(VkQueue queue, VkCommandBuffer command_buffer, uint64_t frame, const Wait* waits,
+                                     uint32_t wait_count, VkSemaphore signal_semaphore) const;
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    Mode mode_ = Mode::FENCES;
+    uint64_t completed_frame_ = 0;
+
+    TimelineSemaphore timeline_;
+    PFN_vkQueueSubmit2KHR queue_submit2_ = nullptr;
+
+    // Fences mode: each slot's fence and the frame it was last submitted with
+    std::vector<VkFence> fences_;
+    std::vector<uint64_t> fence_frames_;
+};
@@ -0,0 +1,222 @@
+#include "frustum_culling.hpp"
+
+#include "cpu_features.hpp"
+#include "frustum_culling_kernels.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULLING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    glm::vec4 normalize_plane(const glm::vec4& plane) {
+        const float length = glm::length(glm::vec3(plane));
+        return length > 0.f ? plane / length : plane;
+    }
+}
+
+Frustum extract_frustum_planes(const glm::mat4& view_projection) {
+    // glm is column major, m[column][row]
+    glm::vec4 rows[4];
+    for (int row = 0; row < 4; row++) {
+        rows[row] = glm::vec4(view_projection[0][row], view_projection[1][row], view_projection[2][row], view_projection[3][row]);
+    }
+
+    // -w <= x <= w, -w <= y <= w and 0 <= z <= w in clip space
+    Frustum frustum;
+    frustum.planes[0] = normalize_plane(rows[3] + rows[0]);
+    frustum.planes[1] = normalize_plane(rows[3] - rows[0]);
+    frustum.planes[2] = normalize_plane(rows[3] + rows[1]);
+    frustum.planes[3] = normalize_plane(rows[3] - rows[1]);
+    frustum.planes[4] = normalize_plane(rows[2]);
+    frustum.planes[5] = normalize_plane(rows[3] - rows[2]);
+    return frustum;
+}
+
+void CullingVolumes::resize(uint32_t count) {
+    // Padding past the end lets the kernels load whole vectors for the last volumes, the lanes are masked off
+    const size_t padded = (size_t(count) + CULLING_LANE_PADDING - 1) / CULLING_LANE_PADDING * CULLING_LANE_PADDING + CULLING_LANE_PADDING;
+    for (int c = 0; c < COMPONENT_COUNT; c++) {
+        if (count < count_) std::fill(components_[c].begin() + count, components_[c].end(), 0.f);
+        components_[c].resize(padded, 0.f);
+    }
+    count_ = count;
+}
+
+void CullingVolumes::set(uint32_t index, const glm::vec3& center, float radius, const glm::vec3& half_extent) {
+    components_[CENTER_X][index] = center.x;
+    components_[CENTER_Y][index] = center.y;
+    components_[CENTER_Z][index] = center.z;
+    components_[RADIUS][index] = radius;
+    components_[HALF_EXTENT_X][index] = half_extent.x;
+    components_[HALF_EXTENT_Y][index] = half_extent.y;
+    components_[HALF_EXTENT_Z][index] = half_extent.z;
+}
+
+void CullingVolumes::set_transformed(uint32_t index, const glm::mat4& model, const glm::vec3& bounds_min, const glm::vec3& bounds_max) {
+    const glm::vec3 local_center = 0.5f * (bounds_min + bounds_max);
+    const glm::vec3 local_half_extent = 0.5f * (bounds_max - bounds_min);
+
+    // Arvo: every world axis collects the absolute projections of the three transformed local half axes
+    glm::vec3 half_extent(0.f);
+    for (int axis = 0; axis < 3; axis++) {
+        half_extent += glm::abs(glm::vec3(model[axis])) * local_half_extent[axis];
+    }
+    const float largest_scale = std::max(glm::length(glm::vec3(model[0])),
+        std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+    set(index, glm::vec3(model * glm::vec4(local_center, 1.f)), glm::length(local_half_extent) * largest_scale, half_extent);
+}
+
+const char* culling_kernel_name(CullingKernel kernel) {
+    switch (kernel) {
+        case CullingKernel::SCALAR: return "scalar";
+        case CullingKernel::SSE2: return "sse2";
+        case CullingKernel::AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+bool culling_kernel_supported(CullingKernel kernel) {
+    switch (kernel) {
+        case CullingKernel::SCALAR: return true;
+#ifdef FRUSTUM_CULLING_SSE2
+        case CullingKernel::SSE2: return true;
+#else
+        case CullingKernel::SSE2: return false;
+#endif
+        case CullingKernel::AVX2: return culling_kernel_avx2_compiled() && cpu_supports_avx2();
+    }
+    return false;
+}
+
+CullingKernel best_culling_kernel() {
+    if (culling_kernel_supported(CullingKernel::AVX2)) return CullingKernel::AVX2;
+    if (culling_kernel_supported(CullingKernel::SSE2)) return CullingKernel::SSE2;
+    return CullingKernel::SCALAR;
+}
+
+uint32_t cull_volumes(const CullingVolumes& volumes, uint32_t begin, uint32_t end, const Frustum& frustum,
+                      uint32_t* visible, CullingKernel kernel) {
+    if (begin >= end) return 0;
+
+    CullingKernelArgs args;
+    for (int axis = 0; axis < 3; axis++) {
+        args.center[axis] = volumes.component(CullingVolumes::Component(CullingVolumes::CENTER_X + axis));
+        args.half_extent[axis] = volumes.component(CullingVolumes::Component(CullingVolumes::HALF_EXTENT_X + axis));
+    }
+    args.radius = volumes.component(CullingVolumes::RADIUS);
+    args.begin = begin;
+    args.end = end;
+    for (int plane = 0; plane < 6; plane++) {
+        for (int c = 0; c < 4; c++) args.planes[plane][c] = frustum.planes[plane][c];
+    }
+    args.visible = visible;
+
+    if (!culling_kernel_supported(kernel)) kernel = best_culling_kernel();
+    switch (kernel) {
+        case CullingKernel::SCALAR: return culling_kernel_scalar(args);
+        case CullingKernel::SSE2: return culling_kernel_sse2(args);
+        case CullingKernel::AVX2: return culling_kernel_avx2(args);
+    }
+    return 0;
+}
+
+uint32_t cull_volumes_parallel(JobSystem& job_system, const CullingVolumes& volumes, const Frustum& frustum,
+                               std::vector<uint32_t>& visible, CullingKernel kernel) {
+    const uint32_t count = volumes.size();
+    visible.resize(count);
+    std::vector<uint32_t> chunk_counts((count + CULLING_JOB_SIZE - 1) / CULLING_JOB_SIZE);
+
+    job_system.parallel_for(count, CULLING_JOB_SIZE, [&](uint32_t begin, uint32_t end, uint32_t) {
+        chunk_counts[begin / CULLING_JOB_SIZE] = cull_volumes(volumes, begin, end, frustum, visible.data() + begin, kernel);
+    });
+
+    // Every chunk's survivors start at its first index, close the gaps. Destinations never pass their sources.
+    uint32_t visible_count = chunk_counts.empty() ? 0 : chunk_counts[0];
+    for (size_t chunk = 1; chunk < chunk_counts.size(); chunk++) {
+        const auto source = visible.begin() + chunk * CULLING_JOB_SIZE;
+        std::copy(source, source + chunk_counts[chunk], visible.begin() + visible_count);
+        visible_count += chunk_counts[chunk];
+    }
+    return visible_count;
+}
+
+// Same operations in the same order as the vector kernels, so all of them agree on every volume
+uint32_t culling_kernel_scalar(const CullingKernelArgs& args) {
+    float abs_normals[6][3];
+    for (int plane = 0; plane < 6; plane++) {
+        for (int axis = 0; axis < 3; axis++) abs_normals[plane][axis] = std::fabs(args.planes[plane][axis]);
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = args.begin; i < args.end; i++) {
+        const float cx = args.center[0][i], cy = args.center[1][i], cz = args.center[2][i];
+        const float ex = args.half_extent[0][i], ey = args.half_extent[1][i], ez = args.half_extent[2][i];
+        const float radius = args.radius[i];
+
+        bool outside = false;
+        for (int plane = 0; plane < 6; plane++) {
+            const float* p = args.planes[plane];
+            const float distance = p[0] * cx + p[1] * cy + p[2] * cz + p[3];
+            const float box_reach = abs_normals[plane][0] * ex + abs_normals[plane][1] * ey + abs_normals[plane][2] * ez;
+            outside |= distance + std::min(radius, box_reach) < 0.f;
+        }
+
+        // Branchless compaction: always write, only advance past visible ones
+        args.visible[count] = i;
+        count += outside ? 0 : 1;
+    }
+    return count;
+}
+
+#ifdef FRUSTUM_CULLING_SSE2
+
+uint32_t culling_kernel_sse2(const CullingKernelArgs& args) {
+    __m128 planes[6][4], abs_normals[6][3];
+    const __m128 sign_mask = _mm_set1_ps(-0.f);
+    for (int plane = 0; plane < 6; plane++) {
+        for (int c = 0; c < 4; c++) planes[plane][c] = _mm_set1_ps(args.planes[plane][c]);
+        for (int axis = 0; axis < 3; axis++) abs_normals[plane][axis] = _mm_andnot_ps(sign_mask, planes[plane][axis]);
+    }
+    const __m128 zero = _mm_setzero_ps();
+
+    uint32_t count = 0;
+    for (uint32_t i = args.begin; i < args.end; i += 4) {
+        const __m128 cx = _mm_loadu_ps(args.center[0] + i), cy = _mm_loadu_ps(args.center[1] + i), cz = _mm_loadu_ps(args.center[2] + i);
+        const __m128 ex = _mm_loadu_ps(args.half_extent[0] + i), ey = _mm_loadu_ps(args.half_extent[1] + i);
+        const __m128 ez = _mm_loadu_ps(args.half_extent[2] + i);
+        const __m128 radius = _mm_loadu_ps(args.radius + i);
+
+        __m128 outside = zero;
+        for (int plane = 0; plane < 6; plane++) {
+            const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[plane][0], cx), _mm_mul_ps(planes[plane][1], cy)),
+                _mm_mul_ps(planes[plane][2], cz)), planes[plane][3]);
+            const __m128 box_reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs_normals[plane][0], ex), _mm_mul_ps(abs_normals[plane][1], ey)),
+                _mm_mul_ps(abs_normals[plane][2], ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, _mm_min_ps(radius, box_reach)), zero));
+        }
+
+        const uint32_t mask = uint32_t(_mm_movemask_ps(outside));
+        const uint32_t lanes = std::min(4u, args.end - i);
+        for (uint32_t lane = 0; lane < lanes; lane++) {
+            args.visible[count] = i + lane;
+            count += ((mask >> lane) & 1) ^ 1;
+        }
+    }
+    return count;
+}
+
+#else
+
+uint32_t culling_kernel_sse2(const CullingKernelArgs& args) {
+    return culling_kernel_scalar(args);
+}
+
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "job_system.hpp"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Left, right, bottom, top, near, far. Each plane is (normal, distance) with a unit normal pointing into the frustum,
+// a point p is inside when dot(normal, p) + distance >= 0 for all six.
+struct Frustum
+{
+    glm::vec4 planes[6];
+};
+
+// Gribb/Hartmann plane extraction from the rows of view_projection, for Vulkan's clip volume (depth in [0, 1]). The
+// planes are in whatever space view_projection transforms from, world space for projection * view.
+Frustum extract_frustum_planes(const glm::mat4& view_projection);
+
+// World space bounding volumes as structure of arrays, two per object around the same center: a sphere and an axis
+// aligned box. Against a plane the box reaches dot(abs(normal), half_extent) out from the center, the sphere radius.
+// Spheres are tight for rotated objects, whose world boxes grow, boxes for long or flat ones, and the kernels simply
+// use the smaller reach of the two per plane. Padded like TransformStore, with empty volumes.
+class CullingVolumes
+{
+public:
+    enum Component
+    {
+        CENTER_X, CENTER_Y, CENTER_Z,
+        RADIUS,
+        HALF_EXTENT_X, HALF_EXTENT_Y, HALF_EXTENT_Z,
+        COMPONENT_COUNT,
+    };
+
+    void resize(uint32_t count);
+    uint32_t size() const { return count_; }
+
+    void set(uint32_t index, const glm::vec3& center, float radius, const glm::vec3& half_extent);
+    // Volumes of the local box [bounds_min, bounds_max] after model, which may scale and rotate but not project
+    void set_transformed(uint32_t index, const glm::mat4& model, const glm::vec3& bounds_min, const glm::vec3& bounds_max);
+
+    float* component(Component component) { return components_[component].data(); }
+    const float* component(Component component) const { return components_[component].data(); }
+
+private:
+    uint32_t count_ = 0;
+    std::vector<float> components_[COMPONENT_COUNT];
+};
+
+enum class CullingKernel
+{
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+const char* culling_kernel_name(CullingKernel kernel);
+bool culling_kernel_supported(CullingKernel kernel);
+// The widest kernel both this build and this CPU support
+CullingKernel best_culling_kernel();
+
+// Tests volumes [begin, end) against the frustum and writes the indices of the ones at least partially inside to
+// visible, in increasing order. Returns how many were written, visible needs room for end - begin.
+uint32_t cull_volumes(const CullingVolumes& volumes, uint32_t begin, uint32_t end, const Frustum& frustum,
+                      uint32_t* visible, CullingKernel kernel);
+
+// Volumes per job of cull_volumes_parallel(), below that the work stays on the calling thread
+constexpr uint32_t CULLING_JOB_SIZE = 8192;
+
+// All volumes, split over the job system. Every job culls its chunk into its own range of visible, the chunks are
+// then moved together, so the result is the same ordered list cull_volumes() produces. visible is resized to the
+// volume count, only the returned number of entries at its front are meaningful.
+uint32_t cull_volumes_parallel(JobSystem& job_system, const CullingVolumes& volumes, const Frustum& frustum,
+                               std::vector<uint32_t>& visible, CullingKernel kernel);
@@ -0,0 +1,70 @@
+// Built with AVX2 code generation enabled (see CMakeLists.txt), only ever entered after a CPU check. Includes nothing
+// but the kernel interface and intrinsics, see frustum_culling_kernels.hpp.
+#include "frustum_culling_kernels.hpp"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+bool culling_kernel_avx2_compiled() {
+    return true;
+}
+
+// Eight volumes at a time, otherwise the SSE2 kernel
+uint32_t culling_kernel_avx2(const CullingKernelArgs& args) {
+    __m256 planes[6][4], abs_normals[6][3];
+    const __m256 sign_mask = _mm256_set1_ps(-0.f);
+    for (int plane = 0; plane < 6; plane++) {
+        for (int c = 0; c < 4; c++) planes[plane][c] = _mm256_set1_ps(args.planes[plane][c]);
+        for (int axis = 0; axis < 3; axis++) abs_normals[plane][axis] = _mm256_andnot_ps(sign_mask, planes[plane][axis]);
+    }
+    const __m256 zero = _mm256_setzero_ps();
+
+    uint32_t count = 0;
+    for (uint32_t i = args.begin; i < args.end; i += 8) {
+        const __m256 cx = _mm256_loadu_ps(args.center[0] + i), cy = _mm256_loadu_ps(args.center[1] + i);
+        const __m256 cz = _mm256_loadu_ps(args.center[2] + i);
+        const __m256 ex = _mm256_loadu_ps(args.half_extent[0] + i), ey = _mm256_loadu_ps(args.half_extent[1] + i);
+        const __m256 ez = _mm256_loadu_ps(args.half_extent[2] + i);
+        const __m256 radius = _mm256_loadu_ps(args.radius + i);
+
+        __m256 outside = zero;
+        for (int plane = 0; plane < 6; plane++) {
+            const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[plane][0], cx),
+                _mm256_mul_ps(planes[plane][1], cy)), _mm256_mul_ps(planes[plane][2], cz)), planes[plane][3]);
+            const __m256 box_reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(abs_normals[plane][0], ex),
+                _mm256_mul_ps(abs_normals[plane][1], ey)), _mm256_mul_ps(abs_normals[plane][2], ez));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, _mm256_min_ps(radius, box_reach)), zero, _CMP_LT_OQ));
+        }
+
+        // Whole groups of eight inside or outside are the common case away from the frustum's edges
+        const uint32_t mask = uint32_t(_mm256_movemask_ps(outside));
+        const uint32_t remaining = args.end - i;
+        const uint32_t lanes = remaining < 8 ? remaining : 8;
+        if (mask == 0xff) continue;
+        if (mask == 0 && lanes == 8) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(args.visible + count),
+                _mm256_add_epi32(_mm256_set1_epi32(int(i)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+            count += 8;
+            continue;
+        }
+        for (uint32_t lane = 0; lane < lanes; lane++) {
+            args.visible[count] = i + lane;
+            count += ((mask >> lane) & 1) ^ 1;
+        }
+    }
+    return count;
+}
+
+#else
+
+// Compiler without AVX2 support or a non-x86 target, never called
+bool culling_kernel_avx2_compiled() {
+    return false;
+}
+
+uint32_t culling_kernel_avx2(const CullingKernelArgs& args) {
+    return culling_kernel_sse2(args);
+}
+
+#endif
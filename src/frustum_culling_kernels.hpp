@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+// Internal to frustum_culling: what the culling kernels see. Plain data only, for the same reason as
+// transform_kernels.hpp.
+struct CullingKernelArgs
+{
+    // Structure of arrays, readable up to a multiple of CULLING_LANE_PADDING past end
+    const float* center[3];
+    const float* radius;
+    const float* half_extent[3];
+    uint32_t begin;
+    uint32_t end;
+
+    // (normal, distance), see Frustum
+    float planes[6][4];
+
+    uint32_t* visible;
+};
+
+// Widest vector the kernels use, the volumes pad their arrays to a multiple of it
+constexpr uint32_t CULLING_LANE_PADDING = 8;
+
+// All return the number of indices written to visible
+uint32_t culling_kernel_scalar(const CullingKernelArgs& args);
+uint32_t culling_kernel_sse2(const CullingKernelArgs& args);
+// Only callable when culling_kernel_avx2_compiled() and the CPU supports AVX2
+uint32_t culling_kernel_avx2(const CullingKernelArgs& args);
+bool culling_kernel_avx2_compiled();
@@ -0,0 +1,191 @@
+#include "gpu_culling.hpp"
+
+#include "shader_bin/cull_instances_comp.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+    constexpr uint32_t WORKGROUP_SIZE = 64;
+
+    // Mirrors the shader's push constant block, std430: each vec3 shares its 16 bytes with the uint after it
+    struct CullingPushConstants
+    {
+        float planes[6][4];
+        float bounds_center[3];
+        uint32_t instance_count;
+        float bounds_half_extent[3];
+        uint32_t index_count;
+    };
+    // The minimum maxPushConstantsSize every device supports
+    static_assert(sizeof(CullingPushConstants) == 128, "push constants must fit the guaranteed 128 bytes");
+
+    VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+bool GpuCulling::init(VkDevice device, DeviceMemoryAllocator& allocator, DescriptorLayoutCache& descriptor_layouts,
+                      VkPipelineCache pipeline_cache, uint32_t frame_count, uint32_t max_instances, VkBuffer instances,
+                      VkDeviceSize instance_frame_stride, PFN_vkCmdDrawIndexedIndirectCountKHR draw_indirect_count) {
+    device_ = device;
+    max_instances_ = max_instances;
+    instances_ = instances;
+    instance_frame_stride_ = instance_frame_stride;
+    draw_indirect_count_ = draw_indirect_count;
+
+    return create_buffers(allocator, frame_count) && create_pipeline(descriptor_layouts, pipeline_cache);
+}
+
+void GpuCulling::destroy(DeviceMemoryAllocator& allocator) {
+    vkDestroyPipeline(device_, pipeline_, nullptr);
+    vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
+    if (culled_instances_ != VK_NULL_HANDLE) allocator.destroy_buffer(culled_instances_, culled_instances_allocation_);
+    if (commands_ != VK_NULL_HANDLE) allocator.destroy_buffer(commands_, commands_allocation_);
+    if (all_visible_ != VK_NULL_HANDLE) allocator.destroy_buffer(all_visible_, all_visible_allocation_);
+}
+
+bool GpuCulling::create_buffers(DeviceMemoryAllocator& allocator, uint32_t frame_count) {
+    const VkDeviceSize alignment = std::max<VkDeviceSize>(allocator.limits().minStorageBufferOffsetAlignment, 1);
+    culled_instances_stride_ = align_up(VkDeviceSize(max_instances_) * INSTANCE_SIZE, alignment);
+    commands_stride_ = align_up(VkDeviceSize(max_instances_) * sizeof(VkDrawIndexedIndirectCommand), alignment);
+    all_visible_stride_ = align_up(sizeof(VkDrawIndexedIndirectCommand), alignment);
+
+    VkBufferCreateInfo buffer_create_info = {};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    buffer_create_info.size = culled_instances_stride_ * frame_count;
+    buffer_create_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    if (allocator.create_buffer(buffer_create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, culled_instances_, culled_instances_allocation_) != VK_SUCCESS) {
+        return false;
+    }
+
+    buffer_create_info.size = commands_stride_ * frame_count;
+    buffer_create_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    if (allocator.create_buffer(buffer_create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, commands_, commands_allocation_) != VK_SUCCESS) {
+        return false;
+    }
+
+    buffer_create_info.size = all_visible_stride_ * frame_count;
+    buffer_create_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if (allocator.create_buffer(buffer_create_info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                all_visible_, all_visible_allocation_) != VK_SUCCESS) {
+        return false;
+    }
+    // visible_count() of a slot that hasn't culled anything yet
+    memset(all_visible_allocation_.mapped, 0, size_t(buffer_create_info.size));
+    return true;
+}
+
+bool GpuCulling::create_pipeline(DescriptorLayoutCache& descriptor_layouts, VkPipelineCache pipeline_cache) {
+    std::vector<VkDescriptorSetLayoutBinding> bindings(4);
+    for (uint32_t binding = 0; binding < 4; binding++) {
+        bindings[binding].binding = binding;
+        bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[binding].descriptorCount = 1;
+        bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    descriptor_set_layout_ = descriptor_layouts.get(bindings);
+    if (descriptor_set_layout_ == VK_NULL_HANDLE) return false;
+
+    VkPushConstantRange push_constant_range = {};
+    push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(CullingPushConstants);
+
+    VkPipelineLayoutCreateInfo layout_create_info = {};
+    layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_create_info.setLayoutCount = 1;
+    layout_create_info.pSetLayouts = &descriptor_set_layout_;
+    layout_create_info.pushConstantRangeCount = 1;
+    layout_create_info.pPushConstantRanges = &push_constant_range;
+    if (vkCreatePipelineLayout(device_, &layout_create_info, nullptr, &pipeline_layout_) != VK_SUCCESS) return false;
+
+    VkShaderModuleCreateInfo module_create_info = {};
+    module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    module_create_info.codeSize = sizeof(cull_instances_comp);
+    module_create_info.pCode = cull_instances_comp;
+    VkShaderModule shader_module;
+    if (vkCreateShaderModule(device_, &module_create_info, nullptr, &shader_module) != VK_SUCCESS) return false;
+
+    VkComputePipelineCreateInfo pipeline_create_info = {};
+    pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_create_info.stage.module = shader_module;
+    pipeline_create_info.stage.pName = "main";
+    pipeline_create_info.layout = pipeline_layout_;
+    pipeline_create_info.basePipelineIndex = -1;
+
+    const VkResult result = vkCreateComputePipelines(device_, pipeline_cache, 1, &pipeline_create_info, nullptr, &pipeline_);
+    vkDestroyShaderModule(device_, shader_module, nullptr);
+    return result == VK_SUCCESS;
+}
+
+bool GpuCulling::record_cull(VkCommandBuffer command_buffer, DescriptorAllocator& frame_descriptors, uint32_t frame,
+                             uint32_t instance_count, uint32_t index_count, const Frustum& frustum, const glm::vec3& bounds_min,
+                             const glm::vec3& bounds_max) {
+    // The frame slot's slices of the four buffers
+    const VkDescriptorSet descriptor_set = frame_descriptors.allocate(descriptor_set_layout_, {
+        DescriptorWrite::buffer_write(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, instances_, frame * instance_frame_stride_,
+            VkDeviceSize(max_instances_) * INSTANCE_SIZE),
+        DescriptorWrite::buffer_write(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, culled_instances_, frame * culled_instances_stride_,
+            VkDeviceSize(max_instances_) * INSTANCE_SIZE),
+        DescriptorWrite::buffer_write(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, commands_, frame * commands_stride_,
+            VkDeviceSize(max_instances_) * sizeof(VkDrawIndexedIndirectCommand)),
+        DescriptorWrite::buffer_write(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, all_visible_, frame * all_visible_stride_,
+            sizeof(VkDrawIndexedIndirectCommand)),
+    });
+    if (descriptor_set == VK_NULL_HANDLE) return false;
+
+    // The previous cull in this slot finished before its fence signaled, only this frame's reset has to be ordered
+    const VkDrawIndexedIndirectCommand reset = {index_count, 0, 0, 0, 0};
+    vkCmdUpdateBuffer(command_buffer, all_visible_, frame * all_visible_stride_, sizeof(reset), &reset);
+
+    VkMemoryBarrier reset_barrier = {};
+    reset_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    reset_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    reset_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        1, &reset_barrier, 0, nullptr, 0, nullptr);
+
+    CullingPushConstants push_constants;
+    for (int plane = 0; plane < 6; plane++) {
+        for (int c = 0; c < 4; c++) push_constants.planes[plane][c] = frustum.planes[plane][c];
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        push_constants.bounds_center[axis] = 0.5f * (bounds_min[axis] + bounds_max[axis]);
+        push_constants.bounds_half_extent[axis] = 0.5f * (bounds_max[axis] - bounds_min[axis]);
+    }
+    push_constants.instance_count = std::min(instance_count, max_instances_);
+    push_constants.index_count = index_count;
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_, 0, 1, &descriptor_set, 0, nullptr);
+    vkCmdPushConstants(command_buffer, pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+    vkCmdDispatch(command_buffer, (push_constants.instance_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+    return true;
+}
+
+void GpuCulling::record_draw(VkCommandBuffer command_buffer, uint32_t frame, uint32_t instance_binding) const {
+    const VkDeviceSize instance_offset = frame * culled_instances_stride_;
+    vkCmdBindVertexBuffers(command_buffer, instance_binding, 1, &culled_instances_, &instance_offset);
+
+    const VkDeviceSize all_visible_offset = frame * all_visible_stride_;
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    if (draw_indirect_count_) {
+        draw_indirect_count_(command_buffer, commands_, frame * commands_stride_, all_visible_,
+            all_visible_offset + offsetof(VkDrawIndexedIndirectCommand, instanceCount), max_instances_, stride);
+    } else {
+        vkCmdDrawIndexedIndirect(command_buffer, all_visible_, all_visible_offset, 1, stride);
+    }
+}
+
+uint32_t GpuCulling::visible_count(uint32_t frame) const {
+    const auto* all_visible = reinterpret_cast<const VkDrawIndexedIndirectCommand*>(
+        static_cast<const char*>(all_visible_allocation_.mapped) + frame * all_visible_stride_);
+    return all_visible->instanceCount;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "descriptor_allocator.hpp"
+#include "device_memory_allocator.hpp"
+#include "frustum_culling.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Frustum culling and draw compaction in a compute pass (shaders/cull_instances.comp), the CPU never looks at the
+// instances. Every frame slot owns a culled copy of the instance stream, one VkDrawIndexedIndirectCommand per visible
+// instance and a single command whose instanceCount is the number of visible instances:
+//  - with VK_KHR_draw_indirect_count the per-instance commands are drawn with vkCmdDrawIndexedIndirectCountKHR, the
+//    count read from that instanceCount
+//  - without it the single command is drawn on its own, still one draw covering exactly the visible instances
+// The instance records are the instanced shader's {mat4 model; vec4 color}.
+class GpuCulling
+{
+public:
+    static constexpr VkDeviceSize INSTANCE_SIZE = 80;
+
+    // instances holds frame_count slices of max_instances records, slice f at f * instance_frame_stride, which has
+    // to be a multiple of minStorageBufferOffsetAlignment. draw_indirect_count may be null, see above.
+    bool init(VkDevice device, DeviceMemoryAllocator& allocator, DescriptorLayoutCache& descriptor_layouts,
+              VkPipelineCache pipeline_cache, uint32_t frame_count, uint32_t max_instances, VkBuffer instances,
+              VkDeviceSize instance_frame_stride, PFN_vkCmdDrawIndexedIndirectCountKHR draw_indirect_count);
+    void destroy(DeviceMemoryAllocator& allocator);
+
+    // Outside of a render pass. Culls the frame slot's first instance_count instances against the frustum, bounds
+    // being the local box the model matrices are applied to. The shader writes are left for the caller to make
+    // visible to the draw's indirect and vertex input reads, and to the host for visible_count(). The descriptor set
+    // comes from frame_descriptors, which must not be reset before the frame has finished. False, with nothing
+    // recorded, when no descriptor set could be allocated: the frame's indirect commands are stale then.
+    bool record_cull(VkCommandBuffer command_buffer, DescriptorAllocator& frame_descriptors, uint32_t frame,
+                     uint32_t instance_count, uint32_t index_count, const Frustum& frustum, const glm::vec3& bounds_min,
+                     const glm::vec3& bounds_max);
+    // Inside the render pass, with the index and vertex buffers bound. Binds the culled instances to instance_binding
+    // and draws them.
+    void record_draw(VkCommandBuffer command_buffer, uint32_t frame, uint32_t instance_binding) const;
+
+    // Instances the frame slot's last cull kept, readable once the slot's fence has signaled. 0 before the first.
+    uint32_t visible_count(uint32_t frame) const;
+    bool uses_draw_indirect_count() const { return draw_indirect_count_ != nullptr; }
+
+private:
+    bool create_buffers(DeviceMemoryAllocator& allocator, uint32_t frame_count);
+    bool create_pipeline(DescriptorLayoutCache& descriptor_layouts, VkPipelineCache pipeline_cache);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    PFN_vkCmdDrawIndexedIndirectCountKHR draw_indirect_count_ = nullptr;
+    uint32_t max_instances_ = 0;
+    VkBuffer instances_ = VK_NULL_HANDLE;
+    VkDeviceSize instance_frame_stride_ = 0;
+
+    // frame_count slices each, slice starts aligned for storage buffer descriptors
+    VkBuffer culled_instances_ = VK_NULL_HANDLE;
+    Allocation culled_instances_allocation_;
+    VkDeviceSize culled_instances_stride_ = 0;
+    VkBuffer commands_ = VK_NULL_HANDLE;
+    Allocation commands_allocation_;
+    VkDeviceSize commands_stride_ = 0;
+    // Host visible, so visible_count() can read it back
+    VkBuffer all_visible_ = VK_NULL_HANDLE;
+    Allocation all_visible_allocation_;
+    VkDeviceSize all_visible_stride_ = 0;
+
+    // Owned by the layout cache
+    VkDescriptorSetLayout descriptor_set_layout_ = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+    VkPipeline pipeline_ = VK_NULL_HANDLE;
+};
@@ -0,0 +1,351 @@
+#include "image_loader.hpp"
+
+#include "inflate.hpp"
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const uint8_t PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    const uint8_t KTX2_IDENTIFIER[12] = {0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+
+    // Decoders refuse anything larger, 16k x 16k RGBA is already a gigabyte
+    constexpr uint32_t MAX_IMAGE_DIMENSION = 16384;
+
+    uint32_t read_be32(const uint8_t* bytes) {
+        return uint32_t(bytes[0]) << 24 | uint32_t(bytes[1]) << 16 | uint32_t(bytes[2]) << 8 | bytes[3];
+    }
+
+    uint32_t read_le32(const uint8_t* bytes) {
+        return uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+    }
+
+    uint64_t read_le64(const uint8_t* bytes) {
+        return uint64_t(read_le32(bytes)) | uint64_t(read_le32(bytes + 4)) << 32;
+    }
+
+    uint32_t png_channels(uint8_t color_type) {
+        switch (color_type) {
+            case 0: return 1; // gray
+            case 2: return 3; // RGB
+            case 3: return 1; // palette index
+            case 4: return 2; // gray, alpha
+            case 6: return 4; // RGBA
+        }
+        return 0;
+    }
+
+    uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+        const int p = int(a) + int(b) - int(c);
+        const int pa = std::abs(p - int(a));
+        const int pb = std::abs(p - int(b));
+        const int pc = std::abs(p - int(c));
+        if (pa <= pb && pa <= pc) return a;
+        return pb <= pc ? b : c;
+    }
+
+    // In place, filtered holds height rows of (1 filter byte + row_bytes)
+    bool unfilter(uint8_t* filtered, uint32_t height, size_t row_bytes, uint32_t pixel_bytes, std::string& error) {
+        const uint8_t* previous = nullptr;
+        for (uint32_t y = 0; y < height; y++) {
+            uint8_t* row = filtered + y * (row_bytes + 1) + 1;
+            const uint8_t filter = row[-1];
+            for (size_t x = 0; x < row_bytes; x++) {
+                const uint8_t left = x >= pixel_bytes ? row[x - pixel_bytes] : 0;
+                const uint8_t up = previous ? previous[x] : 0;
+                const uint8_t up_left = previous && x >= pixel_bytes ? previous[x - pixel_bytes] : 0;
+                switch (filter) {
+                    case 0: break;
+                    case 1: row[x] = uint8_t(row[x] + left); break;
+                    case 2: row[x] = uint8_t(row[x] + up); break;
+                    case 3: row[x] = uint8_t(row[x] + (int(left) + int(up)) / 2); break;
+                    case 4: row[x] = uint8_t(row[x] + paeth(left, up, up_left)); break;
+                    default:
+                        error = "invalid PNG filter type";
+                        return false;
+                }
+            }
+            previous = row;
+        }
+        return true;
+    }
+}
+
+bool format_block(VkFormat format, uint32_t& block_bytes, uint32_t& block_width, uint32_t& block_height) {
+    block_width = 1;
+    block_height = 1;
+    switch (format) {
+        case VK_FORMAT_R8_UNORM: block_bytes = 1; return true;
+        case VK_FORMAT_R8G8_UNORM: block_bytes = 2; return true;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB: block_bytes = 4; return true;
+        case VK_FORMAT_R16G16B16A16_SFLOAT: block_bytes = 8; return true;
+        default: break;
+    }
+    block_width = 4;
+    block_height = 4;
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK: block_bytes = 8; return true;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK: block_bytes = 16; return true;
+        default: return false;
+    }
+}
+
+bool decode_png(const uint8_t* data, size_t size, ImageData& image, std::string& error) {
+    if (size < 8 || memcmp(data, PNG_SIGNATURE, 8) != 0) {
+        error = "not a PNG file";
+        return false;
+    }
+
+    uint32_t width = 0, height = 0;
+    uint8_t bit_depth = 0, color_type = 0;
+    uint8_t palette[256][4] = {};
+    uint32_t palette_size = 0;
+    uint8_t transparent_gray[2] = {}, transparent_rgb[6] = {};
+    bool has_transparent_color = false;
+    std::vector<uint8_t> compressed;
+
+    // Chunks are a big endian length, a type, the data and a CRC, which is skipped: zlib checks the image data itself
+    size_t position = 8;
+    bool ended = false;
+    while (!ended) {
+        if (position + 12 > size) {
+            error = "truncated PNG chunk";
+            return false;
+        }
+        const uint32_t length = read_be32(data + position);
+        const uint8_t* type = data + position + 4;
+        const uint8_t* chunk = data + position + 8;
+        if (length > size - position - 12) {
+            error = "truncated PNG chunk";
+            return false;
+        }
+        position += size_t(length) + 12;
+
+        if (memcmp(type, "IHDR", 4) == 0) {
+            if (length != 13) {
+                error = "malformed PNG header";
+                return false;
+            }
+            width = read_be32(chunk);
+            height = read_be32(chunk + 4);
+            bit_depth = chunk[8];
+            color_type = chunk[9];
+            if (chunk[10] != 0 || chunk[11] != 0) {
+                error = "unknown PNG compression or filter method";
+                return false;
+            }
+            if (chunk[12] != 0) {
+                error = "interlaced PNGs aren't supported";
+                return false;
+            }
+        } else if (memcmp(type, "PLTE", 4) == 0) {
+            palette_size = length / 3;
+            if (palette_size > 256) {
+                error = "PNG palette too large";
+                return false;
+            }
+            for (uint32_t i = 0; i < palette_size; i++) {
+                palette[i][0] = chunk[i * 3];
+                palette[i][1] = chunk[i * 3 + 1];
+                palette[i][2] = chunk[i * 3 + 2];
+                palette[i][3] = 255;
+            }
+        } else if (memcmp(type, "tRNS", 4) == 0) {
+            if (color_type == 3) {
+                for (uint32_t i = 0; i < length && i < palette_size; i++) palette[i][3] = chunk[i];
+            } else if (color_type == 0 && length >= 2) {
+                memcpy(transparent_gray, chunk, 2);
+                has_transparent_color = true;
+            } else if (color_type == 2 && length >= 6) {
+                memcpy(transparent_rgb, chunk, 6);
+                has_transparent_color = true;
+            }
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            compressed.insert(compressed.end(), chunk, chunk + length);
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            ended = true;
+        } else if (!(type[0] & 0x20)) {
+            // Lowercase first letter: ancillary, safe to ignore. Anything else changes how the image decodes.
+            error = "unknown critical PNG chunk " + std::string(reinterpret_cast<const char*>(type), 4);
+            return false;
+        }
+    }
+
+    const uint32_t channels = png_channels(color_type);
+    if (width == 0 || height == 0 || width > MAX_IMAGE_DIMENSION || height > MAX_IMAGE_DIMENSION || channels == 0) {
+        error = "unsupported PNG dimensions or color type";
+        return false;
+    }
+    if (!(bit_depth == 8 || (bit_depth == 16 && color_type != 3))) {
+        error = "PNG bit depth " + std::to_string(bit_depth) + " isn't supported";
+        return false;
+    }
+    if (color_type == 3 && palette_size == 0) {
+        error = "PNG palette missing";
+        return false;
+    }
+
+    const uint32_t pixel_bytes = channels * bit_depth / 8;
+    const size_t row_bytes = size_t(width) * pixel_bytes;
+    // The exact size of the image data, a stream inflating to more is corrupt or hostile and stops right there
+    const size_t filtered_size = (row_bytes + 1) * height;
+    std::vector<uint8_t> filtered;
+    filtered.reserve(filtered_size);
+    if (!zlib_decompress(compressed.data(), compressed.size(), filtered_size, filtered, error)) return false;
+    if (filtered.size() < filtered_size) {
+        error = "PNG image data too short";
+        return false;
+    }
+    if (!unfilter(filtered.data(), height, row_bytes, pixel_bytes, error)) return false;
+
+    image.format = VK_FORMAT_R8G8B8A8_SRGB;
+    image.levels.assign(1, {width, height, 0, size_t(width) * height * 4});
+    image.pixels.resize(image.levels[0].size);
+    // 16-bit channels keep their high byte, which is the first one
+    const uint32_t sample_stride = bit_depth / 8;
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* row = filtered.data() + y * (row_bytes + 1) + 1;
+        uint8_t* out = image.pixels.data() + size_t(y) * width * 4;
+        for (uint32_t x = 0; x < width; x++, out += 4) {
+            const uint8_t* pixel = row + size_t(x) * pixel_bytes;
+            const auto sample = [&](uint32_t channel) { return pixel[channel * sample_stride]; };
+            switch (color_type) {
+                case 0:
+                    out[0] = out[1] = out[2] = sample(0);
+                    out[3] = has_transparent_color && memcmp(pixel, transparent_gray + 2 - sample_stride, sample_stride) == 0 ? 0 : 255;
+                    break;
+                case 2:
+                    out[0] = sample(0);
+                    out[1] = sample(1);
+                    out[2] = sample(2);
+                    out[3] = 255;
+                    if (has_transparent_color) {
+                        // tRNS holds 16-bit samples, an 8-bit image compares against their low bytes
+                        bool transparent = true;
+                        for (uint32_t c = 0; c < 3; c++) {
+                            transparent &= memcmp(pixel + c * sample_stride, transparent_rgb + c * 2 + 2 - sample_stride, sample_stride) == 0;
+                        }
+                        if (transparent) out[3] = 0;
+                    }
+                    break;
+                case 3:
+                    if (pixel[0] >= palette_size) {
+                        error = "PNG palette index out of range";
+                        return false;
+                    }
+                    memcpy(out, palette[pixel[0]], 4);
+                    break;
+                case 4:
+                    out[0] = out[1] = out[2] = sample(0);
+                    out[3] = sample(1);
+                    break;
+                case 6:
+                    out[0] = sample(0);
+                    out[1] = sample(1);
+                    out[2] = sample(2);
+                    out[3] = sample(3);
+                    break;
+            }
+        }
+    }
+    return true;
+}
+
+bool decode_ktx2(const uint8_t* data, size_t size, ImageData& image, std::string& error) {
+    // Identifier, 9 header words, the index (4 words and 2 longs) and at least one level entry
+    constexpr size_t HEADER_SIZE = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+    constexpr size_t LEVEL_ENTRY_SIZE = 3 * 8;
+    if (size < HEADER_SIZE + LEVEL_ENTRY_SIZE || memcmp(data, KTX2_IDENTIFIER, 12) != 0) {
+        error = "not a KTX2 file";
+        return false;
+    }
+
+    const auto format = VkFormat(read_le32(data + 12));
+    const uint32_t width = read_le32(data + 20);
+    const uint32_t height = read_le32(data + 24);
+    const uint32_t depth = read_le32(data + 28);
+    const uint32_t layer_count = read_le32(data + 32);
+    const uint32_t face_count = read_le32(data + 36);
+    // 0 asks the loader to generate the mips, which is the same as a single level here
+    const uint32_t level_count = std::max(read_le32(data + 40), 1u);
+    const uint32_t supercompression = read_le32(data + 44);
+
+    uint32_t block_bytes, block_width, block_height;
+    if (!format_block(format, block_bytes, block_width, block_height)) {
+        error = "unsupported KTX2 format " + std::to_string(uint32_t(format));
+        return false;
+    }
+    if (width == 0 || height == 0 || width > MAX_IMAGE_DIMENSION || height > MAX_IMAGE_DIMENSION || depth > 1 ||
+        layer_count > 1 || face_count != 1) {
+        error = "only single 2D KTX2 images are supported";
+        return false;
+    }
+    if (supercompression != 0) {
+        error = "supercompressed KTX2 files aren't supported";
+        return false;
+    }
+    if (level_count > 32 || ((width >> (level_count - 1)) == 0 && (height >> (level_count - 1)) == 0)) {
+        error = "too many KTX2 levels";
+        return false;
+    }
+    if (size < HEADER_SIZE + LEVEL_ENTRY_SIZE * level_count) {
+        error = "truncated KTX2 level index";
+        return false;
+    }
+
+    image.format = format;
+    image.levels.resize(level_count);
+    size_t total = 0;
+    for (uint32_t level = 0; level < level_count; level++) {
+        ImageLevel& out = image.levels[level];
+        out.width = std::max(width >> level, 1u);
+        out.height = std::max(height >> level, 1u);
+        out.offset = total;
+        out.size = size_t((out.width + block_width - 1) / block_width) * ((out.height + block_height - 1) / block_height) * block_bytes;
+        total += out.size;
+    }
+
+    image.pixels.resize(total);
+    for (uint32_t level = 0; level < level_count; level++) {
+        const uint8_t* entry = data + HEADER_SIZE + LEVEL_ENTRY_SIZE * level;
+        const uint64_t offset = read_le64(entry);
+        const uint64_t length = read_le64(entry + 8);
+        if (length != image.levels[level].size || offset > size || length > size - offset) {
+            error = "KTX2 level " + std::to_string(level) + " has the wrong size or lies outside the file";
+            return false;
+        }
+        memcpy(image.pixels.data() + image.levels[level].offset, data + offset, size_t(length));
+    }
+    return true;
+}
+
+bool load_image(const std::string& path, ImageData& image, std::string& error) {
+    MappedFile file;
+    if (!file.open(path)) {
+        error = "can't open " + path;
+        return false;
+    }
+    const auto* data = reinterpret_cast<const uint8_t*>(file.data());
+    bool decoded = false;
+    if (file.size() >= sizeof(KTX2_IDENTIFIER) && memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0) {
+        decoded = decode_ktx2(data, file.size(), image, error);
+    } else {
+        decoded = decode_png(data, file.size(), image, error);
+    }
+    if (!decoded) error = path + ": " + error;
+    return decoded;
+}
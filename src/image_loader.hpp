@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ImageLevel
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // Into ImageData::pixels, rows tightly packed
+    size_t offset = 0;
+    size_t size = 0;
+};
+
+// A decoded 2D image, ready to be copied into a VkImage level by level
+struct ImageData
+{
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    // Level 0 is the full resolution one. A single level means the file had no mips, they're up to the caller.
+    std::vector<ImageLevel> levels;
+    std::vector<uint8_t> pixels;
+};
+
+// Texel block of a format: bytes per block and its size in texels, 1x1 for uncompressed formats. False for formats
+// the loaders don't know.
+bool format_block(VkFormat format, uint32_t& block_bytes, uint32_t& block_width, uint32_t& block_height);
+
+// PNG: non-interlaced, 8 or 16 bits per channel (palettes 8 only), any color type. 1, 2 and 4 bit images are rejected.
+// Always decoded to VK_FORMAT_R8G8B8A8_SRGB.
+bool decode_png(const uint8_t* data, size_t size, ImageData& image, std::string& error);
+// KTX2: single 2D image with any number of precomputed levels, no supercompression, in one of the formats
+// format_block() knows
+bool decode_ktx2(const uint8_t* data, size_t size, ImageData& image, std::string& error);
+
+// Either of the above depending on the file's signature. Blocking, meant to run on a worker.
+bool load_image(const std::string& path, ImageData& image, std::string& error);
@@ -0,0 +1,304 @@
+#include "inflate.hpp"
+
+#include <utility>
+
+namespace
+{
+    constexpr uint32_t MAX_CODE_BITS = 15;
+
+    // Base lengths and extra bits of the length codes 257..285, then of the distance codes 0..29
+    const uint16_t LENGTH_BASE[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99,
+                                    115, 131, 163, 195, 227, 258};
+    const uint8_t LENGTH_EXTRA[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    const uint16_t DISTANCE_BASE[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+                                      1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    const uint8_t DISTANCE_EXTRA[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+                                      12, 12, 13, 13};
+    // Order in which the code length code lengths are stored
+    const uint8_t CODE_LENGTH_ORDER[] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+    class BitReader
+    {
+    public:
+        BitReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+        // Past the end reads zeros and sets overrun(), callers check once per block or symbol
+        uint32_t bits(uint32_t count) {
+            while (bit_count_ < count) {
+                const uint32_t byte = position_ < size_ ? data_[position_] : 0;
+                if (position_ >= size_) overrun_ = true;
+                position_++;
+                bit_buffer_ |= byte << bit_count_;
+                bit_count_ += 8;
+            }
+            const uint32_t value = bit_buffer_ & ((1u << count) - 1);
+            bit_buffer_ >>= count;
+            bit_count_ -= count;
+            return value;
+        }
+
+        // Stored blocks start on a byte boundary
+        void align_to_byte() {
+            bit_buffer_ = 0;
+            bit_count_ = 0;
+        }
+
+        const uint8_t* bytes(size_t count) {
+            if (position_ + count > size_) {
+                overrun_ = true;
+                return nullptr;
+            }
+            const uint8_t* start = data_ + position_;
+            position_ += count;
+            return start;
+        }
+
+        bool overrun() const { return overrun_; }
+
+    private:
+        const uint8_t* data_;
+        size_t size_;
+        size_t position_ = 0;
+        uint32_t bit_buffer_ = 0;
+        uint32_t bit_count_ = 0;
+        bool overrun_ = false;
+    };
+
+    // Canonical Huffman code as symbol counts per length plus the symbols sorted by code, decoded one bit at a time
+    struct Huffman
+    {
+        uint16_t counts[MAX_CODE_BITS + 1] = {};
+        uint16_t symbols[288] = {};
+
+        // False for over-subscribed codes, incomplete ones are allowed (a single distance code is legal)
+        bool build(const uint8_t* lengths, uint32_t count) {
+            for (auto& c : counts) c = 0;
+            for (uint32_t symbol = 0; symbol < count; symbol++) counts[lengths[symbol]]++;
+            counts[0] = 0;
+
+            int32_t left = 1;
+            for (uint32_t length = 1; length <= MAX_CODE_BITS; length++) {
+                left = left * 2 - counts[length];
+                if (left < 0) return false;
+            }
+
+            uint16_t offsets[MAX_CODE_BITS + 1] = {};
+            for (uint32_t length = 1; length < MAX_CODE_BITS; length++) offsets[length + 1] = offsets[length] + counts[length];
+            for (uint32_t symbol = 0; symbol < count; symbol++) {
+                if (lengths[symbol] != 0) symbols[offsets[lengths[symbol]]++] = uint16_t(symbol);
+            }
+            return true;
+        }
+
+        // -1 on an invalid code
+        int32_t decode(BitReader& reader) const {
+            int32_t code = 0;
+            int32_t first = 0;
+            int32_t index = 0;
+            for (uint32_t length = 1; length <= MAX_CODE_BITS; length++) {
+                code |= int32_t(reader.bits(1));
+                const int32_t count = counts[length];
+                if (code - first < count) return symbols[index + code - first];
+                index += count;
+                first = (first + count) << 1;
+                code <<= 1;
+            }
+            return -1;
+        }
+    };
+
+    constexpr const char* OUTPUT_TOO_LARGE = "deflate stream decompresses to more than expected";
+
+    // out_limit is the size out must not grow past
+    bool inflate_codes(BitReader& reader, const Huffman& lengths, const Huffman& distances, std::vector<uint8_t>& out,
+                       size_t stream_start, size_t out_limit, std::string& error) {
+        for (;;) {
+            const int32_t symbol = lengths.decode(reader);
+            if (symbol < 0 || reader.overrun()) {
+                error = "corrupt deflate stream";
+                return false;
+            }
+            if (symbol < 256) {
+                if (out.size() >= out_limit) {
+                    error = OUTPUT_TOO_LARGE;
+                    return false;
+                }
+                out.push_back(uint8_t(symbol));
+                continue;
+            }
+            if (symbol == 256) return true;
+
+            const uint32_t length_code = uint32_t(symbol) - 257;
+            if (length_code >= 29) {
+                error = "invalid deflate length code";
+                return false;
+            }
+            const uint32_t length = LENGTH_BASE[length_code] + reader.bits(LENGTH_EXTRA[length_code]);
+            const int32_t distance_code = distances.decode(reader);
+            if (distance_code < 0 || distance_code >= 30) {
+                error = "invalid deflate distance code";
+                return false;
+            }
+            const size_t distance = DISTANCE_BASE[distance_code] + reader.bits(DISTANCE_EXTRA[distance_code]);
+            if (distance > out.size() - stream_start) {
+                error = "deflate distance reaches before the start of the stream";
+                return false;
+            }
+            if (length > out_limit - out.size()) {
+                error = OUTPUT_TOO_LARGE;
+                return false;
+            }
+            // Byte by byte, the source may overlap what is being written
+            const size_t from = out.size() - distance;
+            for (uint32_t i = 0; i < length; i++) out.push_back(out[from + i]);
+        }
+    }
+
+    bool inflate_fixed(BitReader& reader, std::vector<uint8_t>& out, size_t stream_start, size_t out_limit, std::string& error) {
+        static const auto codes = [] {
+            std::pair<Huffman, Huffman> fixed;
+            uint8_t lengths[288];
+            for (uint32_t symbol = 0; symbol < 288; symbol++) {
+                lengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+            }
+            fixed.first.build(lengths, 288);
+            for (auto& length : lengths) length = 5;
+            fixed.second.build(lengths, 30);
+            return fixed;
+        }();
+        return inflate_codes(reader, codes.first, codes.second, out, stream_start, out_limit, error);
+    }
+
+    bool inflate_dynamic(BitReader& reader, std::vector<uint8_t>& out, size_t stream_start, size_t out_limit, std::string& error) {
+        const uint32_t length_count = reader.bits(5) + 257;
+        const uint32_t distance_count = reader.bits(5) + 1;
+        const uint32_t code_length_count = reader.bits(4) + 4;
+        if (length_count > 286 || distance_count > 30) {
+            error = "too many deflate codes";
+            return false;
+        }
+
+        uint8_t lengths[286 + 30] = {};
+        for (uint32_t i = 0; i < code_length_count; i++) lengths[CODE_LENGTH_ORDER[i]] = uint8_t(reader.bits(3));
+        Huffman code_lengths;
+        if (!code_lengths.build(lengths, 19)) {
+            error = "invalid deflate code length code";
+            return false;
+        }
+
+        for (uint32_t i = 0; i < length_count + distance_count;) {
+            const int32_t symbol = code_lengths.decode(reader);
+            if (symbol < 0 || reader.overrun()) {
+                error = "corrupt deflate code lengths";
+                return false;
+            }
+            if (symbol < 16) {
+                lengths[i++] = uint8_t(symbol);
+                continue;
+            }
+            uint8_t repeated = 0;
+            uint32_t repeat = 0;
+            if (symbol == 16) {
+                if (i == 0) {
+                    error = "deflate code length repeat without a previous length";
+                    return false;
+                }
+                repeated = lengths[i - 1];
+                repeat = 3 + reader.bits(2);
+            } else if (symbol == 17) {
+                repeat = 3 + reader.bits(3);
+            } else {
+                repeat = 11 + reader.bits(7);
+            }
+            if (i + repeat > length_count + distance_count) {
+                error = "deflate code lengths overflow";
+                return false;
+            }
+            while (repeat-- > 0) lengths[i++] = repeated;
+        }
+        if (lengths[256] == 0) {
+            error = "deflate block without an end code";
+            return false;
+        }
+
+        Huffman length_codes, distance_codes;
+        if (!length_codes.build(lengths, length_count) || !distance_codes.build(lengths + length_count, distance_count)) {
+            error = "invalid deflate codes";
+            return false;
+        }
+        return inflate_codes(reader, length_codes, distance_codes, out, stream_start, out_limit, error);
+    }
+
+    uint32_t adler32(const uint8_t* data, size_t size) {
+        uint32_t a = 1, b = 0;
+        while (size > 0) {
+            // The largest run that can't overflow b before the modulo
+            const size_t run = size < 5552 ? size : 5552;
+            for (size_t i = 0; i < run; i++) {
+                a += data[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+            data += run;
+            size -= run;
+        }
+        return (b << 16) | a;
+    }
+}
+
+bool zlib_decompress(const uint8_t* data, size_t size, size_t max_size, std::vector<uint8_t>& out, std::string& error) {
+    if (size < 6 || (data[0] & 0x0f) != 8 || ((data[0] << 8) | data[1]) % 31 != 0) {
+        error = "not a zlib stream";
+        return false;
+    }
+    if (data[1] & 0x20) {
+        error = "zlib preset dictionaries aren't supported";
+        return false;
+    }
+
+    const size_t stream_start = out.size();
+    const size_t out_limit = max_size > SIZE_MAX - stream_start ? SIZE_MAX : stream_start + max_size;
+    BitReader reader(data + 2, size - 6);
+    bool last = false;
+    while (!last) {
+        last = reader.bits(1) != 0;
+        const uint32_t type = reader.bits(2);
+        bool ok = false;
+        if (type == 0) {
+            reader.align_to_byte();
+            const uint8_t* header = reader.bytes(4);
+            if (header == nullptr || (header[0] | header[1] << 8) != (~(header[2] | header[3] << 8) & 0xffff)) {
+                error = "corrupt stored deflate block";
+                return false;
+            }
+            const size_t length = header[0] | header[1] << 8;
+            const uint8_t* bytes = reader.bytes(length);
+            if (bytes == nullptr) {
+                error = "truncated stored deflate block";
+                return false;
+            }
+            if (length > out_limit - out.size()) {
+                error = OUTPUT_TOO_LARGE;
+                return false;
+            }
+            out.insert(out.end(), bytes, bytes + length);
+            ok = true;
+        } else if (type == 1) {
+            ok = inflate_fixed(reader, out, stream_start, out_limit, error);
+        } else if (type == 2) {
+            ok = inflate_dynamic(reader, out, stream_start, out_limit, error);
+        } else {
+            error = "invalid deflate block type";
+        }
+        if (!ok) return false;
+    }
+
+    const uint8_t* checksum = data + size - 4;
+    const uint32_t expected = uint32_t(checksum[0]) << 24 | uint32_t(checksum[1]) << 16 | uint32_t(checksum[2]) << 8 | checksum[3];
+    if (adler32(out.data() + stream_start, out.size() - stream_start) != expected) {
+        error = "zlib checksum mismatch";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Decompresses a zlib stream (RFC 1950 around RFC 1951 deflate) and checks its Adler-32. Appends to out, which may be
+// reserved up front when the decompressed size is known. Preset dictionaries aren't supported, PNG never uses them.
+// Fails as soon as the stream would append more than max_size bytes: a few kilobytes of deflate can expand to
+// gigabytes, the caller knows how much a valid stream holds.
+bool zlib_decompress(const uint8_t* data, size_t size, size_t max_size, std::vector<uint8_t>& out, std::string& error);
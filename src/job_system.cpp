@@ -0,0 +1,123 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+
+JobSystem::JobSystem(uint32_t worker_count) {
+    if (worker_count == 0) {
+        const uint32_t hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        worker_count = std::max(hardware_threads, 2u) - 1;
+    }
+
+    queues_.reserve(worker_count);
+    for (uint32_t i = 0; i < worker_count; i++) {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+    workers_.reserve(worker_count);
+    for (uint32_t i = 0; i < worker_count; i++) {
+        workers_.emplace_back(&JobSystem::worker_loop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_up_.notify_all();
+    for (auto& worker : workers_) worker.join();
+}
+
+void JobSystem::push(uint32_t queue_index, Task task) {
+    {
+        std::lock_guard<std::mutex> lock(queues_[queue_index]->mutex);
+        queues_[queue_index]->tasks.push_back(std::move(task));
+    }
+    {
+        // Taking the sleep mutex orders the counter update with a worker that is about to go to sleep
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        queued_jobs_++;
+    }
+    wake_up_.notify_one();
+}
+
+bool JobSystem::pop_or_steal(uint32_t queue_index, bool include_background, Job& job) {
+    const auto queue_count = uint32_t(queues_.size());
+    for (uint32_t i = 0; i < queue_count; i++) {
+        const uint32_t victim = (queue_index + i) % queue_count;
+        auto& queue = *queues_[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+
+        // Own queue LIFO (still hot in cache), other queues FIFO (biggest remaining piece of work)
+        const bool own_queue = i == 0 && include_background;
+        auto it = own_queue ? queue.tasks.end() - 1 : queue.tasks.begin();
+        if (!include_background) {
+            it = std::find_if(queue.tasks.begin(), queue.tasks.end(), [](const Task& task) { return !task.background; });
+            if (it == queue.tasks.end()) continue;
+        }
+
+        job = std::move(it->job);
+        queue.tasks.erase(it);
+        queued_jobs_--;
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::worker_loop(uint32_t worker_index) {
+    const uint32_t thread_index = worker_index + 1;
+    for (;;) {
+        Job job;
+        if (pop_or_steal(worker_index, true, job)) {
+            job(thread_index);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wake_up_.wait(lock, [this] { return stopping_ || queued_jobs_ > 0; });
+        if (stopping_ && queued_jobs_ == 0) return;
+    }
+}
+
+void JobSystem::submit(Job job) {
+    if (queues_.empty()) {
+        job(0);
+        return;
+    }
+    push(next_queue_++ % uint32_t(queues_.size()), {std::move(job), true});
+}
+
+void JobSystem::parallel_for(uint32_t count, uint32_t chunk_size, const RangeJob& job) {
+    if (count == 0) return;
+    chunk_size = std::max(chunk_size, 1u);
+    const uint32_t chunk_count = (count + chunk_size - 1) / chunk_size;
+
+    if (queues_.empty() || chunk_count == 1) {
+        job(0, count, 0);
+        return;
+    }
+
+    std::atomic<uint32_t> remaining{chunk_count};
+    // The first chunk stays on the calling thread, the rest is spread over the worker deques
+    for (uint32_t chunk = 1; chunk < chunk_count; chunk++) {
+        const uint32_t begin = chunk * chunk_size;
+        const uint32_t end = std::min(begin + chunk_size, count);
+        push(chunk % uint32_t(queues_.size()), {[&job, &remaining, begin, end](uint32_t thread_index) {
+            job(begin, end, thread_index);
+            remaining--;
+        }, false});
+    }
+
+    job(0, std::min(chunk_size, count), 0);
+    remaining--;
+
+    // Help out instead of idling, but only with parallel_for chunks - they're short and bounded
+    while (remaining > 0) {
+        Job stolen;
+        if (pop_or_steal(0, false, stolen)) {
+            stolen(0);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads, each with its own work-stealing deque: a worker pops its newest job from the back
+// of its own deque and, when that runs dry, steals the oldest job from the front of someone else's.
+// Jobs receive the index of the thread running them, so they can use per-thread resources (command pools, scratch
+// buffers) without locking. Index 0 is reserved for the thread that calls parallel_for(), workers are 1..N.
+class JobSystem
+{
+public:
+    using Job = std::function<void(uint32_t thread_index)>;
+    using RangeJob = std::function<void(uint32_t begin, uint32_t end, uint32_t thread_index)>;
+
+    // 0 workers means one per hardware thread, minus the calling thread
+    explicit JobSystem(uint32_t worker_count = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Workers plus the calling thread, i.e. the number of distinct thread indices jobs can see
+    uint32_t thread_count() const { return uint32_t(workers_.size()) + 1; }
+
+    // Fire and forget, runs on one of the workers
+    void submit(Job job);
+
+    // Splits [0, count) into chunks of chunk_size, runs them on the workers and the calling thread and returns once
+    // every chunk is done. Must not be called from inside a job.
+    void parallel_for(uint32_t count, uint32_t chunk_size, const RangeJob& job);
+
+private:
+    struct Task
+    {
+        Job job;
+        // submit()ed work may run for a long time, the thread inside parallel_for() must not pick it up
+        bool background;
+    };
+
+    struct WorkQueue
+    {
+        std::deque<Task> tasks;
+        std::mutex mutex;
+    };
+
+    void push(uint32_t queue_index, Task task);
+    bool pop_or_steal(uint32_t queue_index, bool include_background, Job& job);
+    void worker_loop(uint32_t worker_index);
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<uint32_t> next_queue_{0};
+    std::atomic<uint32_t> queued_jobs_{0};
+
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_up_;
+    bool stopping_ = false;
+};
@@ -0,0 +1,226 @@
+#include "json.hpp"
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+    const JsonValue NULL_VALUE;
+}
+
+size_t JsonValue::size() const {
+    if (type_ == Type::ARRAY) return array_.size();
+    if (type_ == Type::OBJECT) return object_.size();
+    return 0;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+    if (type_ != Type::ARRAY || index >= array_.size()) return NULL_VALUE;
+    return array_[index];
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const {
+    if (type_ != Type::OBJECT) return NULL_VALUE;
+    for (const auto& member : object_) {
+        if (member.first == key) return member.second;
+    }
+    return NULL_VALUE;
+}
+
+// Recursive descent over the whole input, errors carry the byte offset they happened at
+class JsonParser
+{
+public:
+    JsonParser(const char* begin, const char* end) : begin_(begin), current_(begin), end_(end) {}
+
+    bool parse_document(JsonValue& value) {
+        if (!parse_value(value, 0)) return false;
+        skip_whitespace();
+        return current_ == end_ || fail("trailing characters");
+    }
+
+    std::string error;
+
+private:
+    // Deep enough for any glTF, shallow enough that malicious input can't overflow the stack
+    static constexpr int MAX_DEPTH = 128;
+
+    bool fail(const char* message) {
+        error = std::string(message) + " at offset " + std::to_string(current_ - begin_);
+        return false;
+    }
+
+    void skip_whitespace() {
+        while (current_ != end_ && (*current_ == ' ' || *current_ == '\t' || *current_ == '\n' || *current_ == '\r')) {
+            ++current_;
+        }
+    }
+
+    bool consume(const char* literal) {
+        const char* position = current_;
+        for (; *literal != '\0'; ++literal, ++position) {
+            if (position == end_ || *position != *literal) return false;
+        }
+        current_ = position;
+        return true;
+    }
+
+    bool parse_value(JsonValue& value, int depth) {
+        if (depth > MAX_DEPTH) return fail("nesting too deep");
+        skip_whitespace();
+        if (current_ == end_) return fail("unexpected end of input");
+
+        switch (*current_) {
+            case '{': return parse_object(value, depth);
+            case '[': return parse_array(value, depth);
+            case '"':
+                value.type_ = JsonValue::Type::STRING;
+                return parse_string(value.string_);
+            case 't':
+                value.type_ = JsonValue::Type::BOOLEAN;
+                value.boolean_ = true;
+                return consume("true") || fail("invalid literal");
+            case 'f':
+                value.type_ = JsonValue::Type::BOOLEAN;
+                value.boolean_ = false;
+                return consume("false") || fail("invalid literal");
+            case 'n':
+                value.type_ = JsonValue::Type::NUL;
+                return consume("null") || fail("invalid literal");
+            default:
+                return parse_number(value);
+        }
+    }
+
+    bool parse_number(JsonValue& value) {
+        // strtod needs a terminated string, numbers are short so copy the candidate characters out first
+        std::string text;
+        while (current_ != end_ && (isdigit(static_cast<unsigned char>(*current_)) || *current_ == '-' || *current_ == '+' ||
+                                    *current_ == '.' || *current_ == 'e' || *current_ == 'E')) {
+            text.push_back(*current_++);
+        }
+        if (text.empty()) return fail("unexpected character");
+
+        char* parsed_end = nullptr;
+        value.type_ = JsonValue::Type::NUMBER;
+        value.number_ = std::strtod(text.c_str(), &parsed_end);
+        return parsed_end == text.c_str() + text.size() || fail("invalid number");
+    }
+
+    bool parse_hex4(uint32_t& code_point) {
+        code_point = 0;
+        for (int i = 0; i < 4; i++) {
+            if (current_ == end_) return fail("truncated escape");
+            const char c = *current_++;
+            code_point <<= 4;
+            if (c >= '0' && c <= '9') code_point |= uint32_t(c - '0');
+            else if (c >= 'a' && c <= 'f') code_point |= uint32_t(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') code_point |= uint32_t(c - 'A' + 10);
+            else return fail("invalid escape");
+        }
+        return true;
+    }
+
+    static void append_utf8(std::string& out, uint32_t code_point) {
+        if (code_point < 0x80) {
+            out.push_back(char(code_point));
+        } else if (code_point < 0x800) {
+            out.push_back(char(0xc0 | (code_point >> 6)));
+            out.push_back(char(0x80 | (code_point & 0x3f)));
+        } else if (code_point < 0x10000) {
+            out.push_back(char(0xe0 | (code_point >> 12)));
+            out.push_back(char(0x80 | ((code_point >> 6) & 0x3f)));
+            out.push_back(char(0x80 | (code_point & 0x3f)));
+        } else {
+            out.push_back(char(0xf0 | (code_point >> 18)));
+            out.push_back(char(0x80 | ((code_point >> 12) & 0x3f)));
+            out.push_back(char(0x80 | ((code_point >> 6) & 0x3f)));
+            out.push_back(char(0x80 | (code_point & 0x3f)));
+        }
+    }
+
+    bool parse_string(std::string& out) {
+        ++current_; // opening quote
+        while (current_ != end_ && *current_ != '"') {
+            if (*current_ != '\\') {
+                out.push_back(*current_++);
+                continue;
+            }
+            if (++current_ == end_) break;
+            const char escaped = *current_++;
+            switch (escaped) {
+                case '"': out.push_back('"'); break;
+                case '\\': out.push_back('\\'); break;
+                case '/': out.push_back('/'); break;
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'n': out.push_back('\n'); break;
+                case 'r': out.push_back('\r'); break;
+                case 't': out.push_back('\t'); break;
+                case 'u': {
+                    uint32_t code_point;
+                    if (!parse_hex4(code_point)) return false;
+                    // Surrogate pair
+                    if (code_point >= 0xd800 && code_point < 0xdc00 && consume("\\u")) {
+                        uint32_t low;
+                        if (!parse_hex4(low)) return false;
+                        code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    append_utf8(out, code_point);
+                    break;
+                }
+                default: return fail("invalid escape");
+            }
+        }
+        if (current_ == end_) return fail("unterminated string");
+        ++current_; // closing quote
+        return true;
+    }
+
+    bool parse_array(JsonValue& value, int depth) {
+        value.type_ = JsonValue::Type::ARRAY;
+        ++current_;
+        skip_whitespace();
+        if (consume("]")) return true;
+        for (;;) {
+            value.array_.emplace_back();
+            if (!parse_value(value.array_.back(), depth + 1)) return false;
+            skip_whitespace();
+            if (consume("]")) return true;
+            if (!consume(",")) return fail("expected ',' or ']'");
+        }
+    }
+
+    bool parse_object(JsonValue& value, int depth) {
+        value.type_ = JsonValue::Type::OBJECT;
+        ++current_;
+        skip_whitespace();
+        if (consume("}")) return true;
+        for (;;) {
+            skip_whitespace();
+            if (current_ == end_ || *current_ != '"') return fail("expected key");
+            value.object_.emplace_back();
+            if (!parse_string(value.object_.back().first)) return false;
+            skip_whitespace();
+            if (!consume(":")) return fail("expected ':'");
+            if (!parse_value(value.object_.back().second, depth + 1)) return false;
+            skip_whitespace();
+            if (consume("}")) return true;
+            if (!consume(",")) return fail("expected ',' or '}'");
+        }
+    }
+
+    const char* begin_;
+    const char* current_;
+    const char* end_;
+};
+
+bool parse_json(const char* begin, const char* end, JsonValue& value, std::string& error) {
+    value = JsonValue();
+    JsonParser parser(begin, end);
+    if (parser.parse_document(value)) return true;
+    error = parser.error;
+    return false;
+}
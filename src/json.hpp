@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal read-only JSON document, just enough for glTF. Lookups never fail: a missing key or index yields a null
+// value, so nested accesses like doc["meshes"][0]["primitives"] can be chained and checked once at the end.
+class JsonValue
+{
+public:
+    enum class Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+    Type type() const { return type_; }
+    bool is_null() const { return type_ == Type::NUL; }
+    bool is_number() const { return type_ == Type::NUMBER; }
+    bool is_string() const { return type_ == Type::STRING; }
+    bool is_array() const { return type_ == Type::ARRAY; }
+    bool is_object() const { return type_ == Type::OBJECT; }
+
+    bool boolean(bool fallback = false) const { return type_ == Type::BOOLEAN ? boolean_ : fallback; }
+    double number(double fallback = 0.0) const { return type_ == Type::NUMBER ? number_ : fallback; }
+    const std::string& string() const { return string_; }
+
+    // Element count of arrays and objects, 0 for everything else
+    size_t size() const;
+    const JsonValue& operator[](size_t index) const;
+    const JsonValue& operator[](const std::string& key) const;
+    bool has(const std::string& key) const { return !(*this)[key].is_null(); }
+
+private:
+    friend class JsonParser;
+
+    Type type_ = Type::NUL;
+    bool boolean_ = false;
+    double number_ = 0.0;
+    std::string string_;
+    std::vector<JsonValue> array_;
+    std::vector<std::pair<std::string, JsonValue>> object_;
+};
+
+bool parse_json(const char* begin, const char* end, JsonValue& value, std::string& error);
@@ -0,0 +1,92 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        file_ = nullptr;
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size)) {
+        close();
+        return false;
+    }
+    size_ = size_t(size.QuadPart);
+    // Mapping an empty file fails, an empty mapping is still a valid (empty) file
+    if (size_ == 0) return true;
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ == nullptr) {
+        close();
+        return false;
+    }
+    data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_ != nullptr) UnmapViewOfFile(data_);
+    if (mapping_ != nullptr) CloseHandle(mapping_);
+    if (file_ != nullptr) CloseHandle(file_);
+    data_ = nullptr;
+    mapping_ = nullptr;
+    file_ = nullptr;
+    size_ = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+    file_ = ::open(path.c_str(), O_RDONLY);
+    if (file_ < 0) return false;
+
+    struct stat file_stat;
+    if (fstat(file_, &file_stat) != 0) {
+        close();
+        return false;
+    }
+    size_ = size_t(file_stat.st_size);
+    if (size_ == 0) return true;
+
+    void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file_, 0);
+    if (mapping == MAP_FAILED) {
+        close();
+        return false;
+    }
+    // Parsers walk the file front to back, let the kernel read ahead aggressively
+    madvise(mapping, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(mapping);
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_ != nullptr) munmap(const_cast<char*>(data_), size_);
+    if (file_ >= 0) ::close(file_);
+    data_ = nullptr;
+    file_ = -1;
+    size_ = 0;
+}
+
+#endif
@@ -0,0 +1,181 @@
+#include "mesh_cache.hpp"
+
+#include "mapped_file.hpp"
+#include "vertex_formats.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    constexpr uint32_t MESH_VERTEX_ATTRIBUTE_COUNT = uint32_t(VertexLayout<MeshVertex>::attributes.size());
+
+    // The one layout the loader produces and the pipeline consumes, anything else in a file is rejected for now
+    std::array<VMeshAttribute, MESH_VERTEX_ATTRIBUTE_COUNT> mesh_vertex_attributes() {
+        std::array<VMeshAttribute, MESH_VERTEX_ATTRIBUTE_COUNT> attributes = {};
+        for (uint32_t a = 0; a < MESH_VERTEX_ATTRIBUTE_COUNT; a++) {
+            const VertexAttribute& attribute = VertexLayout<MeshVertex>::attributes[a];
+            attributes[a] = {attribute.location, uint32_t(attribute.format), attribute.offset, 0};
+        }
+        return attributes;
+    }
+
+    uint64_t align_up(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    bool write_padding(std::ofstream& file, uint64_t offset) {
+        static const char zeros[VMESH_BLOB_ALIGNMENT] = {};
+        const auto position = uint64_t(file.tellp());
+        if (position > offset) return false;
+        file.write(zeros, std::streamsize(offset - position));
+        return bool(file);
+    }
+}
+
+bool write_vmesh(const std::string& path, const MeshData& mesh, const MeshInfo& info, std::string& error) {
+    const uint32_t index_bytes = index_size(mesh.index_type);
+
+    VMeshHeader header = {};
+    header.magic = VMESH_MAGIC;
+    header.version = VMESH_VERSION;
+    header.vertex_count = uint32_t(mesh.vertices.size());
+    header.vertex_stride = sizeof(MeshVertex);
+    header.index_count = uint32_t(mesh.indices.size());
+    header.index_size = index_bytes;
+    header.attribute_count = MESH_VERTEX_ATTRIBUTE_COUNT;
+    header.lod_count = 1;
+    for (int axis = 0; axis < 3; axis++) {
+        header.bounds_min[axis] = info.bounds_min[axis];
+        header.bounds_max[axis] = info.bounds_max[axis];
+    }
+    const uint64_t tables_end = sizeof(VMeshHeader) + sizeof(VMeshAttribute) * header.attribute_count + sizeof(VMeshLod) * header.lod_count;
+    header.vertex_offset = align_up(tables_end, VMESH_BLOB_ALIGNMENT);
+    header.index_offset = align_up(header.vertex_offset + uint64_t(header.vertex_count) * header.vertex_stride, VMESH_BLOB_ALIGNMENT);
+
+    VMeshLod lod = {};
+    lod.first_index = 0;
+    lod.index_count = header.index_count;
+
+    // Same write-then-rename as the pipeline cache, a crash mid-write must not leave a truncated mesh behind
+    const std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            error = "can't open " + temporary_path + " for writing";
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        const auto attributes = mesh_vertex_attributes();
+        file.write(reinterpret_cast<const char*>(attributes.data()), sizeof(attributes));
+        file.write(reinterpret_cast<const char*>(&lod), sizeof(lod));
+
+        write_padding(file, header.vertex_offset);
+        file.write(reinterpret_cast<const char*>(mesh.vertices.data()), std::streamsize(mesh.vertices.size() * sizeof(MeshVertex)));
+
+        write_padding(file, header.index_offset);
+        if (mesh.index_type == MeshIndexType::UINT16) {
+            std::vector<uint16_t> short_indices(mesh.indices.begin(), mesh.indices.end());
+            file.write(reinterpret_cast<const char*>(short_indices.data()), std::streamsize(short_indices.size() * sizeof(uint16_t)));
+        } else {
+            file.write(reinterpret_cast<const char*>(mesh.indices.data()), std::streamsize(mesh.indices.size() * sizeof(uint32_t)));
+        }
+
+        if (!file) {
+            error = "failed writing " + temporary_path;
+            return false;
+        }
+    }
+
+    std::remove(path.c_str());
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        error = "can't rename " + temporary_path + " to " + path;
+        return false;
+    }
+    return true;
+}
+
+bool load_vmesh(const std::string& path, MeshSink& sink, MeshInfo& info, std::string& error) {
+    MappedFile file;
+    if (!file.open(path)) {
+        error = "can't open " + path;
+        return false;
+    }
+
+    VMeshHeader header;
+    if (file.size() < sizeof(header)) {
+        error = path + ": truncated header";
+        return false;
+    }
+    memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != VMESH_MAGIC) {
+        error = path + ": not a .vmesh file";
+        return false;
+    }
+    if (header.version != VMESH_VERSION) {
+        error = path + ": .vmesh version " + std::to_string(header.version) + ", expected " +
+            std::to_string(VMESH_VERSION) + ", convert the mesh again";
+        return false;
+    }
+
+    const uint64_t tables_end = sizeof(VMeshHeader) + uint64_t(sizeof(VMeshAttribute)) * header.attribute_count +
+        uint64_t(sizeof(VMeshLod)) * header.lod_count;
+    const uint64_t vertex_bytes = uint64_t(header.vertex_count) * header.vertex_stride;
+    const uint64_t index_bytes = uint64_t(header.index_count) * header.index_size;
+    // Offsets are checked against the file before anything is dereferenced, a corrupt header must not read past the
+    // mapping. Offsets come first and lengths are compared to what is left after them, so no sum can wrap around.
+    if (tables_end > file.size() || header.vertex_offset > file.size() || header.index_offset > file.size() ||
+        header.vertex_offset < tables_end || header.index_offset < header.vertex_offset ||
+        header.vertex_offset % VMESH_BLOB_ALIGNMENT != 0 || header.index_offset % VMESH_BLOB_ALIGNMENT != 0 ||
+        vertex_bytes > header.index_offset - header.vertex_offset || index_bytes > file.size() - header.index_offset ||
+        header.lod_count == 0) {
+        error = path + ": corrupt .vmesh header";
+        return false;
+    }
+
+    const auto* attributes = reinterpret_cast<const VMeshAttribute*>(file.data() + sizeof(VMeshHeader));
+    if (header.vertex_stride != sizeof(MeshVertex) || header.attribute_count != MESH_VERTEX_ATTRIBUTE_COUNT ||
+        memcmp(attributes, mesh_vertex_attributes().data(), sizeof(VMeshAttribute) * MESH_VERTEX_ATTRIBUTE_COUNT) != 0) {
+        error = path + ": unsupported vertex layout";
+        return false;
+    }
+
+    MeshIndexType index_type;
+    if (header.index_size == 2) index_type = MeshIndexType::UINT16;
+    else if (header.index_size == 4) index_type = MeshIndexType::UINT32;
+    else {
+        error = path + ": unsupported index size";
+        return false;
+    }
+
+    // Only LOD 0 is drawn so far, the table is there for the converter to fill in
+    VMeshLod lod;
+    memcpy(&lod, file.data() + sizeof(VMeshHeader) + sizeof(VMeshAttribute) * header.attribute_count, sizeof(lod));
+    if (uint64_t(lod.first_index) + lod.index_count > header.index_count) {
+        error = path + ": corrupt LOD table";
+        return false;
+    }
+
+    info.vertex_count = header.vertex_count;
+    info.index_count = lod.index_count;
+    info.index_type = index_type;
+    info.bounds_min = glm::vec3(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]);
+    info.bounds_max = glm::vec3(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]);
+
+    // The blobs are already in their GPU layout: the mapping goes to the sink as-is, which for the renderer means a
+    // single memcpy from the page cache into staging memory
+    if (!sink.begin(info.vertex_count, info.index_count, index_type)) {
+        error = "mesh sink rejected " + path;
+        return false;
+    }
+    if (!sink.write_vertices(0, reinterpret_cast<const MeshVertex*>(file.data() + header.vertex_offset), header.vertex_count) ||
+        !sink.write_indices(0, file.data() + header.index_offset + uint64_t(lod.first_index) * header.index_size, lod.index_count)) {
+        error = "mesh sink failed to take " + path;
+        return false;
+    }
+    return true;
+}
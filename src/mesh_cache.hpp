@@ -0,0 +1,62 @@
+#pragma once
+
+#include "mesh_loader.hpp"
+
+#include <cstdint>
+#include <string>
+
+// .vmesh: a mesh ready to be copied into GPU buffers as-is. Everything is little endian and laid out so the file can
+// be memory mapped and its blobs handed to the uploader without any parsing or conversion:
+//
+//   VMeshHeader
+//   VMeshAttribute[attribute_count]   vertex layout the blob was written with
+//   VMeshLod[lod_count]               index ranges, LOD 0 is the full detail mesh
+//   vertex blob                       vertex_count * vertex_stride bytes, VMESH_BLOB_ALIGNMENT aligned
+//   index blob                        index_count * index_size bytes, VMESH_BLOB_ALIGNMENT aligned
+//
+// Any change to the layout or to MeshVertex bumps VMESH_VERSION, older files are rejected and have to be converted
+// again rather than being misread.
+constexpr uint32_t VMESH_MAGIC = 0x48534d56; // "VMSH"
+constexpr uint32_t VMESH_VERSION = 1;
+constexpr uint32_t VMESH_BLOB_ALIGNMENT = 16;
+
+struct VMeshHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t vertex_stride;
+    uint32_t index_count;
+    // 2 or 4
+    uint32_t index_size;
+    uint32_t attribute_count;
+    uint32_t lod_count;
+    float bounds_min[3];
+    float bounds_max[3];
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+};
+static_assert(sizeof(VMeshHeader) == 72, "VMeshHeader layout is part of the file format");
+
+struct VMeshAttribute
+{
+    uint32_t location;
+    // A VkFormat value
+    uint32_t format;
+    uint32_t offset;
+    uint32_t reserved;
+};
+
+struct VMeshLod
+{
+    uint32_t first_index;
+    uint32_t index_count;
+    // Screen space error the LOD was simplified for, 0 for full detail
+    float error;
+    uint32_t reserved;
+};
+
+bool write_vmesh(const std::string& path, const MeshData& mesh, const MeshInfo& info, std::string& error);
+
+// Maps the file and streams the blobs straight from the mapping into the sink, the mapping is the only copy on the CPU
+bool load_vmesh(const std::string& path, MeshSink& sink, MeshInfo& info, std::string& error);
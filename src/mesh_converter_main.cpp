@@ -0,0 +1,127 @@
+#include "job_system.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_loader.hpp"
+#include "mesh_optimizer.hpp"
+#include "vertex_formats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <iostream>
+#include <string>
+
+// Offline converter: loads a .obj, .gltf or .glb mesh the same way the application does, runs it through the mesh
+// optimizer and writes it out as .vmesh, which the application then maps and uploads without parsing anything.
+//
+//   vulkan_tutorial_mesh_converter [--verify] [--no-optimize] INPUT OUTPUT.vmesh
+//
+// --verify loads OUTPUT back through load_mesh() and checks it matches what was converted bit for bit.
+// --no-optimize keeps the source's triangle and vertex order, the vertex cache simulation is still reported.
+
+namespace
+{
+    bool load(const std::string& path, JobSystem& job_system, MeshData& mesh, MeshInfo& info) {
+        std::string error;
+        if (!load_mesh(path, job_system, mesh, info, error)) {
+            std::cerr << error << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    // What --packed-vertices would lose on this mesh: the largest position error relative to the mesh extent
+    void report_packed_precision(const MeshData& mesh, const MeshInfo& info) {
+        const VertexQuantization quantization = vertex_quantization_for_bounds(info.bounds_min, info.bounds_max);
+        std::vector<PackedVertex> packed(mesh.vertices.size());
+        std::vector<MeshVertex> unpacked(mesh.vertices.size());
+        quantize_vertices(mesh.vertices.data(), mesh.vertices.size(), quantization, packed.data());
+        dequantize_vertices(packed.data(), packed.size(), quantization, unpacked.data());
+
+        float max_error = 0.f;
+        for (size_t v = 0; v < mesh.vertices.size(); v++) {
+            for (int axis = 0; axis < 3; axis++) {
+                max_error = std::max(max_error, std::abs(mesh.vertices[v].position[axis] - unpacked[v].position[axis]));
+            }
+        }
+        const glm::vec3& half_extent = quantization.half_extent;
+        const float extent = 2.f * std::max(half_extent.x, std::max(half_extent.y, half_extent.z));
+        std::cout << "Packed vertices: " << sizeof(PackedVertex) << " instead of " << sizeof(MeshVertex)
+            << " bytes, max position error " << max_error / extent << " of the extent\n";
+    }
+
+    bool verify(const std::string& path, JobSystem& job_system, const MeshData& expected, const MeshInfo& expected_info) {
+        MeshData mesh;
+        MeshInfo info;
+        if (!load(path, job_system, mesh, info)) return false;
+
+        const char* mismatch = nullptr;
+        if (mesh.vertices.size() != expected.vertices.size() ||
+            memcmp(mesh.vertices.data(), expected.vertices.data(), mesh.vertices.size() * sizeof(MeshVertex)) != 0) {
+            mismatch = "vertices";
+        } else if (mesh.indices != expected.indices) {
+            mismatch = "indices";
+        } else if (mesh.index_type != expected.index_type || info.index_type != expected_info.index_type) {
+            mismatch = "index type";
+        } else if (info.bounds_min != expected_info.bounds_min || info.bounds_max != expected_info.bounds_max) {
+            mismatch = "bounds";
+        }
+
+        if (mismatch) {
+            std::cerr << path << ": " << mismatch << " differ from the source mesh\n";
+            return false;
+        }
+        std::cout << "Verified " << path << "\n";
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    bool verify_output = false;
+    bool optimize = true;
+    bool valid_command_line = true;
+    std::string input_path;
+    std::string output_path;
+    for (int i = 1; i < argc; i++) {
+        const std::string argument = argv[i];
+        if (argument == "--verify") verify_output = true;
+        else if (argument == "--no-optimize") optimize = false;
+        else if (input_path.empty()) input_path = argument;
+        else if (output_path.empty()) output_path = argument;
+        else valid_command_line = false;
+    }
+    if (!valid_command_line || input_path.empty() || output_path.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--verify] [--no-optimize] INPUT OUTPUT.vmesh\n";
+        return 1;
+    }
+
+    JobSystem job_system;
+    const auto start_time = std::chrono::steady_clock::now();
+
+    MeshData mesh;
+    MeshInfo info;
+    if (!load(input_path, job_system, mesh, info)) return 1;
+
+    if (optimize) {
+        print_mesh_optimization_report(std::cout, optimize_mesh(mesh));
+    } else {
+        const VertexCacheStats stats = analyze_vertex_cache(mesh.indices, info.vertex_count);
+        std::cout << "FIFO" << VERTEX_CACHE_SIZE << " simulation: ACMR " << stats.acmr << "  ATVR " << stats.atvr << "\n";
+    }
+
+    report_packed_precision(mesh, info);
+
+    std::string error;
+    if (!write_vmesh(output_path, mesh, info, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    std::cout << "Converted " << input_path << " to " << output_path << ": " << info.vertex_count << " vertices, "
+        << info.index_count << " indices (" << index_size(info.index_type) * 8 << "-bit) in " << seconds << " s\n";
+
+    if (verify_output && !verify(output_path, job_system, mesh, info)) return 1;
+    return 0;
+}
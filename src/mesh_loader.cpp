@@ -0,0 +1,839 @@
+#include "mesh_loader.hpp"
+
+#include "json.hpp"
+#include "mapped_file.hpp"
+#include "mesh_cache.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    // Elements a loader thread collects before handing them to the sink
+    constexpr uint32_t STREAM_BATCH = 64 * 1024;
+    // Smallest piece of an OBJ file one job parses, below that the per-job overhead starts to show
+    constexpr size_t MIN_OBJ_CHUNK_SIZE = 1 << 20;
+    // Jobs per thread, a few more than one so a chunk full of faces doesn't hold up everyone else
+    constexpr size_t CHUNKS_PER_THREAD = 4;
+
+    struct Bounds
+    {
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+        void add(const glm::vec3& point) {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+
+        void add(const Bounds& other) {
+            min = glm::min(min, other.min);
+            max = glm::max(max, other.max);
+        }
+    };
+
+    // Shared by all jobs of a load, the first error wins since later ones are usually consequences of it
+    class LoadErrors
+    {
+    public:
+        bool failed() const { return failed_; }
+
+        bool fail(const std::string& message) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!failed_) {
+                message_ = message;
+                failed_ = true;
+            }
+            return false;
+        }
+
+        const std::string& message() const { return message_; }
+
+    private:
+        std::atomic<bool> failed_{false};
+        std::mutex mutex_;
+        std::string message_;
+    };
+
+    // Collects vertices of one job and passes them on to the sink every STREAM_BATCH vertices
+    class VertexStream
+    {
+    public:
+        VertexStream(MeshSink& sink, uint32_t first_vertex) : sink_(sink), next_vertex_(first_vertex) {
+            vertices_.reserve(STREAM_BATCH);
+        }
+
+        bool push(const MeshVertex& vertex) {
+            vertices_.push_back(vertex);
+            return vertices_.size() < STREAM_BATCH || flush();
+        }
+
+        bool flush() {
+            if (vertices_.empty()) return true;
+            const bool written = sink_.write_vertices(next_vertex_, vertices_.data(), uint32_t(vertices_.size()));
+            next_vertex_ += uint32_t(vertices_.size());
+            vertices_.clear();
+            return written;
+        }
+
+    private:
+        MeshSink& sink_;
+        uint32_t next_vertex_;
+        std::vector<MeshVertex> vertices_;
+    };
+
+    // Same for indices, converted to the mesh's index type on the way in
+    class IndexStream
+    {
+    public:
+        IndexStream(MeshSink& sink, MeshIndexType index_type, uint32_t first_index)
+            : sink_(sink), index_type_(index_type), next_index_(first_index) {
+            if (index_type_ == MeshIndexType::UINT16) short_indices_.reserve(STREAM_BATCH);
+            else indices_.reserve(STREAM_BATCH);
+        }
+
+        bool push(uint32_t index) {
+            if (index_type_ == MeshIndexType::UINT16) short_indices_.push_back(uint16_t(index));
+            else indices_.push_back(index);
+            return size() < STREAM_BATCH || flush();
+        }
+
+        bool flush() {
+            const auto count = uint32_t(size());
+            if (count == 0) return true;
+            const void* data = index_type_ == MeshIndexType::UINT16 ? static_cast<const void*>(short_indices_.data()) : indices_.data();
+            const bool written = sink_.write_indices(next_index_, data, count);
+            next_index_ += count;
+            short_indices_.clear();
+            indices_.clear();
+            return written;
+        }
+
+    private:
+        size_t size() const { return index_type_ == MeshIndexType::UINT16 ? short_indices_.size() : indices_.size(); }
+
+        MeshSink& sink_;
+        MeshIndexType index_type_;
+        uint32_t next_index_;
+        std::vector<uint16_t> short_indices_;
+        std::vector<uint32_t> indices_;
+    };
+
+    // Something to tell the parts of an uncolored mesh apart: maps every coordinate smoothly into [0, 1]
+    glm::vec3 color_from_position(const glm::vec3& position) {
+        return glm::vec3(0.5f) + 0.5f * position / (glm::vec3(1.f) + glm::abs(position));
+    }
+
+    glm::vec3 color_from_normal(const glm::vec3& normal) {
+        return glm::vec3(0.5f) + 0.5f * normal;
+    }
+
+    bool begin_mesh(MeshSink& sink, uint64_t vertex_count, uint64_t index_count, MeshInfo& info, std::string& error) {
+        if (vertex_count > std::numeric_limits<uint32_t>::max() || index_count > std::numeric_limits<uint32_t>::max()) {
+            error = "mesh has more than 2^32 vertices or indices";
+            return false;
+        }
+        info.vertex_count = uint32_t(vertex_count);
+        info.index_count = uint32_t(index_count);
+        info.index_type = choose_index_type(vertex_count);
+        if (!sink.begin(info.vertex_count, info.index_count, info.index_type)) {
+            error = "mesh sink rejected the mesh";
+            return false;
+        }
+        return true;
+    }
+
+    // --- OBJ ---
+
+    bool is_blank(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    const char* skip_blanks(const char* current, const char* end) {
+        while (current != end && is_blank(*current)) ++current;
+        return current;
+    }
+
+    const char* skip_token(const char* current, const char* end) {
+        while (current != end && !is_blank(*current)) ++current;
+        return current;
+    }
+
+    // Locale independent and bounded by end, unlike strtof which needs a terminated string. Exact to a few ulp,
+    // which is plenty for vertex data.
+    bool parse_float(const char*& current, const char* end, float& value) {
+        const char* p = skip_blanks(current, end);
+        bool negative = false;
+        if (p != end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        bool any_digit = false;
+        for (; p != end && isdigit(static_cast<unsigned char>(*p)); ++p, any_digit = true) {
+            // Digits beyond what 64 bits hold only shift the exponent
+            if (mantissa < 1000000000000000000ull) mantissa = mantissa * 10 + uint64_t(*p - '0');
+            else ++exponent;
+        }
+        if (p != end && *p == '.') {
+            for (++p; p != end && isdigit(static_cast<unsigned char>(*p)); ++p, any_digit = true) {
+                if (mantissa < 1000000000000000000ull) {
+                    mantissa = mantissa * 10 + uint64_t(*p - '0');
+                    --exponent;
+                }
+            }
+        }
+        if (!any_digit) return false;
+
+        if (p != end && (*p == 'e' || *p == 'E')) {
+            const char* exponent_start = p++;
+            bool negative_exponent = false;
+            if (p != end && (*p == '-' || *p == '+')) negative_exponent = *p++ == '-';
+            int explicit_exponent = 0;
+            bool any_exponent_digit = false;
+            for (; p != end && isdigit(static_cast<unsigned char>(*p)); ++p, any_exponent_digit = true) {
+                if (explicit_exponent < 10000) explicit_exponent = explicit_exponent * 10 + (*p - '0');
+            }
+            if (any_exponent_digit) exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+            else p = exponent_start;
+        }
+
+        double result = double(mantissa);
+        static const double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+                                               1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        while (exponent > 22) { result *= 1e22; exponent -= 22; }
+        while (exponent < -22) { result /= 1e22; exponent += 22; }
+        result = exponent >= 0 ? result * POWERS_OF_TEN[exponent] : result / POWERS_OF_TEN[-exponent];
+
+        value = float(negative ? -result : result);
+        current = p;
+        return true;
+    }
+
+    bool parse_integer(const char*& current, const char* end, int64_t& value) {
+        const char* p = current;
+        bool negative = false;
+        if (p != end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+        if (p == end || !isdigit(static_cast<unsigned char>(*p))) return false;
+
+        int64_t result = 0;
+        for (; p != end && isdigit(static_cast<unsigned char>(*p)); ++p) {
+            if (result < (int64_t(1) << 40)) result = result * 10 + (*p - '0');
+        }
+        value = negative ? -result : result;
+        current = p;
+        return true;
+    }
+
+    enum class ObjLine { OTHER, VERTEX, FACE };
+
+    // Points current past the keyword
+    ObjLine classify_obj_line(const char*& current, const char* end) {
+        current = skip_blanks(current, end);
+        if (end - current < 2 || !is_blank(current[1])) return ObjLine::OTHER;
+        const char keyword = current[0];
+        current += 2;
+        if (keyword == 'v') return ObjLine::VERTEX;
+        if (keyword == 'f') return ObjLine::FACE;
+        return ObjLine::OTHER;
+    }
+
+    template <typename LineFunction>
+    bool for_each_line(const char* begin, const char* end, LineFunction function) {
+        while (begin < end) {
+            const auto* newline = static_cast<const char*>(memchr(begin, '\n', size_t(end - begin)));
+            const char* line_end = newline != nullptr ? newline : end;
+            if (!function(begin, line_end)) return false;
+            begin = line_end + 1;
+        }
+        return true;
+    }
+
+    struct ObjChunk
+    {
+        const char* begin;
+        const char* end;
+        uint64_t vertex_count = 0;
+        uint64_t index_count = 0;
+        uint64_t first_vertex = 0;
+        uint64_t first_index = 0;
+        Bounds bounds;
+    };
+
+    std::vector<ObjChunk> split_into_chunks(const char* data, size_t size, uint32_t thread_count) {
+        const size_t chunk_size = std::max(MIN_OBJ_CHUNK_SIZE, size / (size_t(thread_count) * CHUNKS_PER_THREAD));
+        std::vector<ObjChunk> chunks;
+        size_t start = 0;
+        while (start < size) {
+            size_t end = std::min(start + chunk_size, size);
+            // Chunks end right after a newline so no line is ever split
+            if (end < size) {
+                const auto* newline = static_cast<const char*>(memchr(data + end, '\n', size - end));
+                end = newline != nullptr ? size_t(newline - data) + 1 : size;
+            }
+            ObjChunk chunk;
+            chunk.begin = data + start;
+            chunk.end = data + end;
+            chunks.push_back(chunk);
+            start = end;
+        }
+        return chunks;
+    }
+
+    // Only positions (and the optional "v x y z r g b" colors) are used, texture coordinate and normal references
+    // in faces are skipped. Polygons are triangulated as fans.
+    bool load_obj(const std::string& path, JobSystem& job_system, MeshSink& sink, MeshInfo& info, std::string& error) {
+        MappedFile file;
+        if (!file.open(path)) {
+            error = "can't open " + path;
+            return false;
+        }
+
+        auto chunks = split_into_chunks(file.data(), file.size(), job_system.thread_count());
+
+        // First pass: count what every chunk contributes, so each one knows where its output goes
+        job_system.parallel_for(uint32_t(chunks.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+            for (uint32_t c = begin; c < end; c++) {
+                auto& chunk = chunks[c];
+                for_each_line(chunk.begin, chunk.end, [&](const char* line, const char* line_end) {
+                    const ObjLine kind = classify_obj_line(line, line_end);
+                    if (kind == ObjLine::VERTEX) {
+                        chunk.vertex_count++;
+                    } else if (kind == ObjLine::FACE) {
+                        uint32_t corners = 0;
+                        for (line = skip_blanks(line, line_end); line != line_end; line = skip_blanks(skip_token(line, line_end), line_end)) {
+                            corners++;
+                        }
+                        if (corners >= 3) chunk.index_count += (corners - 2) * 3;
+                    }
+                    return true;
+                });
+            }
+        });
+
+        uint64_t vertex_count = 0;
+        uint64_t index_count = 0;
+        for (auto& chunk : chunks) {
+            chunk.first_vertex = vertex_count;
+            chunk.first_index = index_count;
+            vertex_count += chunk.vertex_count;
+            index_count += chunk.index_count;
+        }
+        if (!begin_mesh(sink, vertex_count, index_count, info, error)) return false;
+
+        // Second pass: parse for real and stream the results out
+        LoadErrors errors;
+        job_system.parallel_for(uint32_t(chunks.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+            for (uint32_t c = begin; c < end && !errors.failed(); c++) {
+                auto& chunk = chunks[c];
+                VertexStream vertices(sink, uint32_t(chunk.first_vertex));
+                IndexStream indices(sink, info.index_type, uint32_t(chunk.first_index));
+                uint64_t vertices_so_far = chunk.first_vertex;
+
+                const bool parsed = for_each_line(chunk.begin, chunk.end, [&](const char* line, const char* line_end) {
+                    const ObjLine kind = classify_obj_line(line, line_end);
+                    if (kind == ObjLine::VERTEX) {
+                        MeshVertex vertex;
+                        if (!parse_float(line, line_end, vertex.position.x) || !parse_float(line, line_end, vertex.position.y) ||
+                            !parse_float(line, line_end, vertex.position.z)) {
+                            return errors.fail(path + ": malformed vertex");
+                        }
+                        if (!parse_float(line, line_end, vertex.color.r) || !parse_float(line, line_end, vertex.color.g) ||
+                            !parse_float(line, line_end, vertex.color.b)) {
+                            vertex.color = color_from_position(vertex.position);
+                        }
+                        chunk.bounds.add(vertex.position);
+                        vertices_so_far++;
+                        return vertices.push(vertex) || errors.fail("mesh sink failed to take vertices");
+                    }
+                    if (kind != ObjLine::FACE) return true;
+
+                    uint32_t corners = 0;
+                    uint32_t first_corner = 0;
+                    uint32_t previous_corner = 0;
+                    for (line = skip_blanks(line, line_end); line != line_end; line = skip_blanks(skip_token(line, line_end), line_end)) {
+                        int64_t index;
+                        if (!parse_integer(line, line_end, index) || index == 0) return errors.fail(path + ": malformed face");
+                        // Negative indices count back from the last vertex defined so far
+                        const int64_t resolved = index > 0 ? index - 1 : int64_t(vertices_so_far) + index;
+                        if (resolved < 0 || uint64_t(resolved) >= vertex_count) return errors.fail(path + ": face index out of range");
+
+                        const auto corner = uint32_t(resolved);
+                        if (corners == 0) first_corner = corner;
+                        if (corners >= 2 && !(indices.push(first_corner) && indices.push(previous_corner) && indices.push(corner))) {
+                            return errors.fail("mesh sink failed to take indices");
+                        }
+                        previous_corner = corner;
+                        corners++;
+                    }
+                    return true;
+                });
+
+                if (parsed && !(vertices.flush() && indices.flush())) errors.fail("mesh sink failed to take the last batch");
+            }
+        });
+        if (errors.failed()) {
+            error = errors.message();
+            return false;
+        }
+
+        Bounds bounds;
+        for (const auto& chunk : chunks) bounds.add(chunk.bounds);
+        info.bounds_min = vertex_count > 0 ? bounds.min : glm::vec3(0.f);
+        info.bounds_max = vertex_count > 0 ? bounds.max : glm::vec3(0.f);
+        return true;
+    }
+
+    // --- glTF ---
+
+    constexpr uint32_t COMPONENT_UNSIGNED_BYTE = 5121;
+    constexpr uint32_t COMPONENT_UNSIGNED_SHORT = 5123;
+    constexpr uint32_t COMPONENT_UNSIGNED_INT = 5125;
+    constexpr uint32_t COMPONENT_FLOAT = 5126;
+    constexpr uint32_t PRIMITIVE_MODE_TRIANGLES = 4;
+
+    constexpr uint32_t GLB_MAGIC = 0x46546c67; // "glTF"
+    constexpr uint32_t GLB_CHUNK_JSON = 0x4e4f534a; // "JSON"
+    constexpr uint32_t GLB_CHUNK_BIN = 0x004e4942; // "BIN\0"
+
+    struct ByteSpan
+    {
+        const char* data = nullptr;
+        size_t size = 0;
+    };
+
+    // A typed, strided window into one of the buffers
+    struct AccessorView
+    {
+        const char* data = nullptr;
+        uint32_t count = 0;
+        uint32_t stride = 0;
+        uint32_t component_type = 0;
+        uint32_t components = 0;
+        bool normalized = false;
+    };
+
+    uint32_t component_size(uint32_t component_type) {
+        switch (component_type) {
+            case COMPONENT_UNSIGNED_BYTE: return 1;
+            case COMPONENT_UNSIGNED_SHORT: return 2;
+            case COMPONENT_UNSIGNED_INT:
+            case COMPONENT_FLOAT: return 4;
+            default: return 0;
+        }
+    }
+
+    uint32_t component_count(const std::string& type) {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4") return 4;
+        return 0;
+    }
+
+    // A count, index or byte offset from the document: a non-negative integer no larger than max, fallback when the
+    // key is missing. Checked while it's still a double, converting one out of range is undefined behaviour.
+    bool read_unsigned(const JsonValue& value, uint64_t fallback, uint64_t max, uint64_t& result) {
+        if (value.is_null()) {
+            result = fallback;
+            return true;
+        }
+        // Every integer up to here is exact as a double, bigger ones can't be valid in files we can map anyway
+        constexpr double MAX_EXACT_INTEGER = 9007199254740992.0;
+        const double number = value.number(-1.0);
+        if (!value.is_number() || !(number >= 0.0) || number >= MAX_EXACT_INTEGER || number > double(max) ||
+            number != std::floor(number)) {
+            return false;
+        }
+        result = uint64_t(number);
+        return true;
+    }
+
+    bool resolve_accessor(const JsonValue& document, const std::vector<ByteSpan>& buffers, const JsonValue& index,
+                          AccessorView& view, std::string& error) {
+        constexpr uint64_t MAX_UINT32 = std::numeric_limits<uint32_t>::max();
+        constexpr uint64_t MAX_SIZE = std::numeric_limits<size_t>::max();
+
+        uint64_t accessor_index = 0;
+        if (index.is_null() || !read_unsigned(index, 0, MAX_SIZE, accessor_index) ||
+            document["accessors"][size_t(accessor_index)].is_null()) {
+            error = "invalid accessor index";
+            return false;
+        }
+        const JsonValue& accessor = document["accessors"][size_t(accessor_index)];
+        if (accessor.has("sparse") || !accessor.has("bufferView")) {
+            error = "sparse accessors and accessors without a buffer view aren't supported";
+            return false;
+        }
+
+        uint64_t buffer_view_index = 0;
+        uint64_t buffer_index = 0;
+        if (!read_unsigned(accessor["bufferView"], 0, MAX_SIZE, buffer_view_index) ||
+            document["bufferViews"][size_t(buffer_view_index)].is_null()) {
+            error = "invalid buffer view";
+            return false;
+        }
+        const JsonValue& buffer_view = document["bufferViews"][size_t(buffer_view_index)];
+        if (buffer_view["buffer"].is_null() || !read_unsigned(buffer_view["buffer"], 0, MAX_SIZE, buffer_index) ||
+            buffer_index >= buffers.size()) {
+            error = "invalid buffer view";
+            return false;
+        }
+
+        uint64_t component_type = 0;
+        uint64_t count = 0;
+        if (!read_unsigned(accessor["componentType"], 0, MAX_UINT32, component_type) ||
+            !read_unsigned(accessor["count"], 0, MAX_UINT32, count)) {
+            error = "invalid accessor";
+            return false;
+        }
+        view.component_type = uint32_t(component_type);
+        view.components = component_count(accessor["type"].string());
+        view.normalized = accessor["normalized"].boolean();
+        view.count = uint32_t(count);
+        const uint32_t element_size = component_size(view.component_type) * view.components;
+        if (element_size == 0) {
+            error = "unsupported accessor type";
+            return false;
+        }
+
+        uint64_t stride = 0;
+        uint64_t view_offset = 0;
+        uint64_t view_length = 0;
+        uint64_t accessor_offset = 0;
+        if (!read_unsigned(buffer_view["byteStride"], element_size, MAX_UINT32, stride) ||
+            !read_unsigned(buffer_view["byteOffset"], 0, MAX_SIZE, view_offset) ||
+            !read_unsigned(buffer_view["byteLength"], 0, MAX_SIZE, view_length) ||
+            !read_unsigned(accessor["byteOffset"], 0, MAX_SIZE, accessor_offset)) {
+            error = "invalid buffer view";
+            return false;
+        }
+        view.stride = uint32_t(stride);
+
+        // Every length is compared to what is left after the offset before it, so a huge offset or count can't wrap
+        // the sums around and point outside the buffer. stride * (count - 1) can't overflow, both are 32-bit.
+        const uint64_t buffer_size = buffers[buffer_index].size;
+        bool in_bounds = view_offset <= buffer_size && view_length <= buffer_size - view_offset && accessor_offset <= view_length;
+        if (in_bounds && view.count > 0) {
+            const uint64_t available = view_length - accessor_offset;
+            in_bounds = element_size <= available && stride * (view.count - 1) <= available - element_size;
+        }
+        if (!in_bounds) {
+            error = "accessor reaches past the end of its buffer";
+            return false;
+        }
+        view.data = buffers[buffer_index].data + view_offset + accessor_offset;
+        return true;
+    }
+
+    float read_component(const char* data, uint32_t component_type, bool normalized) {
+        switch (component_type) {
+            case COMPONENT_FLOAT: {
+                float value;
+                memcpy(&value, data, sizeof(value));
+                return value;
+            }
+            case COMPONENT_UNSIGNED_BYTE: {
+                const auto value = float(uint8_t(*data));
+                return normalized ? value / 255.f : value;
+            }
+            case COMPONENT_UNSIGNED_SHORT: {
+                uint16_t value;
+                memcpy(&value, data, sizeof(value));
+                return normalized ? float(value) / 65535.f : float(value);
+            }
+            default: return 0.f;
+        }
+    }
+
+    glm::vec3 read_vec3(const AccessorView& view, uint32_t element) {
+        glm::vec3 value(0.f);
+        const char* data = view.data + size_t(element) * view.stride;
+        const uint32_t size = component_size(view.component_type);
+        for (uint32_t component = 0; component < std::min(view.components, 3u); component++) {
+            value[component] = read_component(data + component * size, view.component_type, view.normalized);
+        }
+        return value;
+    }
+
+    uint32_t read_index(const AccessorView& view, uint32_t element) {
+        const char* data = view.data + size_t(element) * view.stride;
+        switch (view.component_type) {
+            case COMPONENT_UNSIGNED_BYTE: return uint8_t(*data);
+            case COMPONENT_UNSIGNED_SHORT: {
+                uint16_t value;
+                memcpy(&value, data, sizeof(value));
+                return value;
+            }
+            default: {
+                uint32_t value;
+                memcpy(&value, data, sizeof(value));
+                return value;
+            }
+        }
+    }
+
+    struct GltfPrimitive
+    {
+        AccessorView positions;
+        AccessorView colors;
+        AccessorView normals;
+        AccessorView indices;
+        bool has_colors = false;
+        bool has_normals = false;
+        bool has_indices = false;
+        uint64_t first_vertex = 0;
+        uint64_t first_index = 0;
+        uint32_t index_count = 0;
+    };
+
+    // A range of a primitive's vertices or indices, converted and streamed by one job
+    struct GltfJob
+    {
+        uint32_t primitive;
+        bool indices;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    bool split_glb(const MappedFile& file, ByteSpan& json, ByteSpan& binary, std::string& error) {
+        uint32_t header[3];
+        if (file.size() < sizeof(header)) {
+            error = "truncated GLB header";
+            return false;
+        }
+        memcpy(header, file.data(), sizeof(header));
+        if (header[0] != GLB_MAGIC || header[1] != 2 || header[2] > file.size()) {
+            error = "not a glTF 2.0 binary";
+            return false;
+        }
+
+        size_t offset = sizeof(header);
+        while (offset + 8 <= header[2]) {
+            uint32_t chunk_header[2];
+            memcpy(chunk_header, file.data() + offset, sizeof(chunk_header));
+            offset += sizeof(chunk_header);
+            if (offset + chunk_header[0] > header[2]) break;
+
+            const ByteSpan chunk = {file.data() + offset, chunk_header[0]};
+            if (chunk_header[1] == GLB_CHUNK_JSON && json.data == nullptr) json = chunk;
+            else if (chunk_header[1] == GLB_CHUNK_BIN && binary.data == nullptr) binary = chunk;
+            // Chunks are 4 byte aligned
+            offset += (chunk_header[0] + 3) & ~3u;
+        }
+        if (json.data == nullptr) {
+            error = "GLB without JSON chunk";
+            return false;
+        }
+        return true;
+    }
+
+    // All triangle primitives of all meshes are merged into one mesh as they are, the node hierarchy and its
+    // transforms are ignored
+    bool load_gltf(const std::string& path, bool binary, JobSystem& job_system, MeshSink& sink, MeshInfo& info, std::string& error) {
+        MappedFile file;
+        if (!file.open(path)) {
+            error = "can't open " + path;
+            return false;
+        }
+
+        // A .gltf is all JSON, a .glb has JSON and binary chunks
+        ByteSpan json = binary ? ByteSpan() : ByteSpan{file.data(), file.size()};
+        ByteSpan glb_binary;
+        if (binary && !split_glb(file, json, glb_binary, error)) return false;
+
+        JsonValue document;
+        if (!parse_json(json.data, json.data + json.size, document, error)) {
+            error = path + ": " + error;
+            return false;
+        }
+
+        // External buffers are mapped as well, relative to the .gltf
+        const std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+        std::vector<std::unique_ptr<MappedFile>> buffer_files;
+        std::vector<ByteSpan> buffers;
+        for (size_t i = 0; i < document["buffers"].size(); i++) {
+            const JsonValue& uri = document["buffers"][i]["uri"];
+            if (uri.is_null()) {
+                // Only the first buffer of a GLB may leave out the uri, it's the BIN chunk
+                buffers.push_back(i == 0 ? glb_binary : ByteSpan());
+                continue;
+            }
+            if (uri.string().compare(0, 5, "data:") == 0) {
+                error = path + ": embedded data URIs aren't supported, use a .glb or external .bin";
+                return false;
+            }
+            buffer_files.push_back(std::make_unique<MappedFile>());
+            if (!buffer_files.back()->open(directory + uri.string())) {
+                error = "can't open " + directory + uri.string();
+                return false;
+            }
+            buffers.push_back({buffer_files.back()->data(), buffer_files.back()->size()});
+        }
+
+        std::vector<GltfPrimitive> primitives;
+        uint64_t vertex_count = 0;
+        uint64_t index_count = 0;
+        for (size_t m = 0; m < document["meshes"].size(); m++) {
+            const JsonValue& mesh_primitives = document["meshes"][m]["primitives"];
+            for (size_t p = 0; p < mesh_primitives.size(); p++) {
+                const JsonValue& primitive_json = mesh_primitives[p];
+                if (primitive_json["mode"].number(PRIMITIVE_MODE_TRIANGLES) != PRIMITIVE_MODE_TRIANGLES) continue;
+
+                const JsonValue& attributes = primitive_json["attributes"];
+                GltfPrimitive primitive;
+                if (!resolve_accessor(document, buffers, attributes["POSITION"], primitive.positions, error)) {
+                    error = path + ": POSITION: " + error;
+                    return false;
+                }
+                primitive.has_colors = attributes.has("COLOR_0");
+                if (primitive.has_colors && !resolve_accessor(document, buffers, attributes["COLOR_0"], primitive.colors, error)) {
+                    error = path + ": COLOR_0: " + error;
+                    return false;
+                }
+                primitive.has_normals = attributes.has("NORMAL");
+                if (primitive.has_normals && !resolve_accessor(document, buffers, attributes["NORMAL"], primitive.normals, error)) {
+                    error = path + ": NORMAL: " + error;
+                    return false;
+                }
+                primitive.has_indices = primitive_json.has("indices");
+                if (primitive.has_indices && !resolve_accessor(document, buffers, primitive_json["indices"], primitive.indices, error)) {
+                    error = path + ": indices: " + error;
+                    return false;
+                }
+
+                primitive.first_vertex = vertex_count;
+                primitive.first_index = index_count;
+                primitive.index_count = primitive.has_indices ? primitive.indices.count : primitive.positions.count;
+                vertex_count += primitive.positions.count;
+                index_count += primitive.index_count;
+                primitives.push_back(primitive);
+            }
+        }
+        if (!begin_mesh(sink, vertex_count, index_count, info, error)) return false;
+
+        std::vector<GltfJob> jobs;
+        for (uint32_t p = 0; p < uint32_t(primitives.size()); p++) {
+            for (uint32_t begin = 0; begin < primitives[p].positions.count; begin += STREAM_BATCH) {
+                jobs.push_back({p, false, begin, std::min(begin + STREAM_BATCH, primitives[p].positions.count)});
+            }
+            for (uint32_t begin = 0; begin < primitives[p].index_count; begin += STREAM_BATCH) {
+                jobs.push_back({p, true, begin, std::min(begin + STREAM_BATCH, primitives[p].index_count)});
+            }
+        }
+
+        LoadErrors errors;
+        std::vector<Bounds> job_bounds(jobs.size());
+        job_system.parallel_for(uint32_t(jobs.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+            for (uint32_t j = begin; j < end && !errors.failed(); j++) {
+                const GltfJob& job = jobs[j];
+                const GltfPrimitive& primitive = primitives[job.primitive];
+
+                if (job.indices) {
+                    IndexStream indices(sink, info.index_type, uint32_t(primitive.first_index) + job.begin);
+                    for (uint32_t i = job.begin; i < job.end; i++) {
+                        const uint32_t index = primitive.has_indices ? read_index(primitive.indices, i) : i;
+                        if (index >= primitive.positions.count) {
+                            errors.fail(path + ": index out of range");
+                            break;
+                        }
+                        if (!indices.push(uint32_t(primitive.first_vertex) + index)) errors.fail("mesh sink failed to take indices");
+                    }
+                    if (!indices.flush()) errors.fail("mesh sink failed to take indices");
+                    continue;
+                }
+
+                VertexStream vertices(sink, uint32_t(primitive.first_vertex) + job.begin);
+                for (uint32_t v = job.begin; v < job.end; v++) {
+                    MeshVertex vertex;
+                    vertex.position = read_vec3(primitive.positions, v);
+                    if (primitive.has_colors) vertex.color = read_vec3(primitive.colors, v);
+                    else if (primitive.has_normals) vertex.color = color_from_normal(read_vec3(primitive.normals, v));
+                    else vertex.color = color_from_position(vertex.position);
+                    job_bounds[j].add(vertex.position);
+                    if (!vertices.push(vertex)) errors.fail("mesh sink failed to take vertices");
+                }
+                if (!vertices.flush()) errors.fail("mesh sink failed to take vertices");
+            }
+        });
+        if (errors.failed()) {
+            error = errors.message();
+            return false;
+        }
+
+        Bounds bounds;
+        for (const auto& b : job_bounds) bounds.add(b);
+        info.bounds_min = vertex_count > 0 ? bounds.min : glm::vec3(0.f);
+        info.bounds_max = vertex_count > 0 ? bounds.max : glm::vec3(0.f);
+        return true;
+    }
+
+    std::string lowercase_extension(const std::string& path) {
+        const size_t dot = path.find_last_of('.');
+        if (dot == std::string::npos) return {};
+        std::string extension = path.substr(dot);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(tolower(c)); });
+        return extension;
+    }
+}
+
+bool MeshData::begin(uint32_t vertex_count, uint32_t index_count, MeshIndexType type) {
+    vertices.resize(vertex_count);
+    indices.resize(index_count);
+    index_type = type;
+    return true;
+}
+
+bool MeshData::write_vertices(uint32_t first_vertex, const MeshVertex* data, uint32_t count) {
+    if (size_t(first_vertex) + count > vertices.size()) return false;
+    std::copy(data, data + count, vertices.begin() + first_vertex);
+    return true;
+}
+
+bool MeshData::write_indices(uint32_t first_index, const void* data, uint32_t count) {
+    if (size_t(first_index) + count > indices.size()) return false;
+    if (index_type == MeshIndexType::UINT16) {
+        const auto* short_indices = static_cast<const uint16_t*>(data);
+        std::copy(short_indices, short_indices + count, indices.begin() + first_index);
+    } else {
+        memcpy(indices.data() + first_index, data, size_t(count) * sizeof(uint32_t));
+    }
+    return true;
+}
+
+bool load_mesh(const std::string& path, JobSystem& job_system, MeshSink& sink, MeshInfo& info, std::string& error) {
+    const std::string extension = lowercase_extension(path);
+    if (extension == ".vmesh") return load_vmesh(path, sink, info, error);
+    if (extension == ".obj") return load_obj(path, job_system, sink, info, error);
+    if (extension == ".gltf") return load_gltf(path, false, job_system, sink, info, error);
+    if (extension == ".glb") return load_gltf(path, true, job_system, sink, info, error);
+    error = "unknown mesh format: " + path;
+    return false;
+}
+
+bool write_mesh(const MeshVertex* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count,
+                MeshSink& sink, MeshInfo& info) {
+    std::string error;
+    if (!begin_mesh(sink, vertex_count, index_count, info, error)) return false;
+
+    Bounds bounds;
+    for (uint32_t v = 0; v < vertex_count; v++) bounds.add(vertices[v].position);
+    info.bounds_min = vertex_count > 0 ? bounds.min : glm::vec3(0.f);
+    info.bounds_max = vertex_count > 0 ? bounds.max : glm::vec3(0.f);
+
+    if (!sink.write_vertices(0, vertices, vertex_count)) return false;
+
+    IndexStream stream(sink, info.index_type, 0);
+    for (uint32_t i = 0; i < index_count; i++) {
+        if (!stream.push(indices[i])) return false;
+    }
+    return stream.flush();
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "job_system.hpp"
+
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct MeshVertex
+{
+    glm::vec3 position;
+    glm::vec3 color;
+};
+
+enum class MeshIndexType
+{
+    UINT16,
+    UINT32,
+};
+
+// 16-bit indices whenever they can address every vertex, half the index memory and fetch bandwidth
+inline MeshIndexType choose_index_type(uint64_t vertex_count) {
+    return vertex_count <= 65536 ? MeshIndexType::UINT16 : MeshIndexType::UINT32;
+}
+
+inline uint32_t index_size(MeshIndexType index_type) {
+    return index_type == MeshIndexType::UINT16 ? 2 : 4;
+}
+
+// Receives a mesh piece by piece while it's being parsed. begin() is called once with the final counts before
+// anything else. write_vertices()/write_indices() are then called from the loader threads concurrently and in no
+// particular order, every call covering its own range. Indices arrive already converted to the announced type.
+class MeshSink
+{
+public:
+    virtual ~MeshSink() = default;
+
+    virtual bool begin(uint32_t vertex_count, uint32_t index_count, MeshIndexType index_type) = 0;
+    virtual bool write_vertices(uint32_t first_vertex, const MeshVertex* vertices, uint32_t count) = 0;
+    virtual bool write_indices(uint32_t first_index, const void* indices, uint32_t count) = 0;
+};
+
+// Sink that simply keeps the whole mesh in memory, indices widened to 32 bits. For tools working on complete meshes.
+class MeshData : public MeshSink
+{
+public:
+    bool begin(uint32_t vertex_count, uint32_t index_count, MeshIndexType index_type) override;
+    bool write_vertices(uint32_t first_vertex, const MeshVertex* vertices, uint32_t count) override;
+    bool write_indices(uint32_t first_index, const void* indices, uint32_t count) override;
+
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    MeshIndexType index_type = MeshIndexType::UINT16;
+};
+
+struct MeshInfo
+{
+    uint32_t vertex_count = 0;
+    uint32_t index_count = 0;
+    MeshIndexType index_type = MeshIndexType::UINT16;
+    glm::vec3 bounds_min = glm::vec3(0.f);
+    glm::vec3 bounds_max = glm::vec3(0.f);
+};
+
+// Loads a triangle mesh from a .obj, .gltf, .glb or .vmesh (see mesh_cache.hpp) file. The file is memory mapped and
+// parsed in chunks on the job system, each chunk goes to the sink as soon as it's parsed, so the whole mesh is never
+// held in memory at once.
+// Vertex colors come from the file where present and are derived from normals or positions otherwise.
+bool load_mesh(const std::string& path, JobSystem& job_system, MeshSink& sink, MeshInfo& info, std::string& error);
+
+// Feeds an in-memory mesh through the same sink, e.g. generated geometry
+bool write_mesh(const MeshVertex* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count,
+                MeshSink& sink, MeshInfo& info);
@@ -0,0 +1,273 @@
+#include "mesh_optimizer.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+    constexpr uint32_t NO_VERTEX = std::numeric_limits<uint32_t>::max();
+
+    // Triangles using each vertex, triangles of vertex v are triangles[offsets[v]..offsets[v + 1])
+    struct Adjacency
+    {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> triangles;
+    };
+
+    Adjacency build_adjacency(const std::vector<uint32_t>& indices, uint32_t vertex_count) {
+        Adjacency adjacency;
+        adjacency.offsets.assign(size_t(vertex_count) + 1, 0);
+        for (const uint32_t index : indices) adjacency.offsets[index + 1]++;
+        std::partial_sum(adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin());
+
+        adjacency.triangles.resize(indices.size());
+        std::vector<uint32_t> cursors(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++) adjacency.triangles[cursors[indices[i]]++] = uint32_t(i / 3);
+        return adjacency;
+    }
+
+    // FIFO cache without the queue: every miss takes the next timestamp, a vertex is still cached as long as fewer than
+    // cache_size misses happened since its own. Moving time forward by cache_size + 1 empties the cache.
+    class CacheSimulator
+    {
+    public:
+        CacheSimulator(uint32_t vertex_count, uint32_t cache_size)
+            : timestamps_(vertex_count, 0), cache_size_(cache_size), time_(cache_size + 1) {
+        }
+
+        bool cached(uint32_t vertex) const { return time_ - timestamps_[vertex] <= cache_size_; }
+        uint32_t age(uint32_t vertex) const { return time_ - timestamps_[vertex]; }
+
+        // Returns whether it was a miss
+        bool access(uint32_t vertex) {
+            if (cached(vertex)) return false;
+            timestamps_[vertex] = time_++;
+            return true;
+        }
+
+        void flush() { time_ += cache_size_ + 1; }
+
+    private:
+        std::vector<uint32_t> timestamps_;
+        uint32_t cache_size_;
+        uint32_t time_;
+    };
+}
+
+VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t>& indices, uint32_t vertex_count, uint32_t cache_size) {
+    VertexCacheStats stats;
+    if (indices.empty()) return stats;
+
+    CacheSimulator cache(vertex_count, cache_size);
+    std::vector<bool> referenced(vertex_count, false);
+    uint64_t misses = 0;
+    uint64_t referenced_count = 0;
+    for (const uint32_t index : indices) {
+        if (cache.access(index)) misses++;
+        if (!referenced[index]) {
+            referenced[index] = true;
+            referenced_count++;
+        }
+    }
+
+    stats.acmr = double(misses) / double(indices.size() / 3);
+    stats.atvr = double(misses) / double(referenced_count);
+    return stats;
+}
+
+std::vector<uint32_t> optimize_vertex_cache(std::vector<uint32_t>& indices, uint32_t vertex_count, uint32_t cache_size) {
+    std::vector<uint32_t> clusters;
+    const auto triangle_count = uint32_t(indices.size() / 3);
+    if (triangle_count == 0) return clusters;
+
+    const Adjacency adjacency = build_adjacency(indices, vertex_count);
+    std::vector<uint32_t> live_triangles(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; v++) live_triangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+    CacheSimulator cache(vertex_count, cache_size);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint32_t> dead_ends;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    uint32_t scan_cursor = 0;
+
+    // Fan around one vertex at a time, emitting all of its remaining triangles, then move on to whichever vertex
+    // touched by the fan will still be cached once its own fan is emitted, preferring the oldest
+    clusters.push_back(0);
+    uint32_t fanning = indices[0];
+    while (fanning != NO_VERTEX) {
+        candidates.clear();
+        for (uint32_t a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; a++) {
+            const uint32_t triangle = adjacency.triangles[a];
+            if (emitted[triangle]) continue;
+            emitted[triangle] = true;
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                const uint32_t vertex = indices[triangle * 3 + corner];
+                output.push_back(vertex);
+                dead_ends.push_back(vertex);
+                candidates.push_back(vertex);
+                live_triangles[vertex]--;
+                cache.access(vertex);
+            }
+        }
+
+        uint32_t next = NO_VERTEX;
+        int64_t best_priority = -1;
+        for (const uint32_t vertex : candidates) {
+            if (live_triangles[vertex] == 0) continue;
+            int64_t priority = 0;
+            if (cache.age(vertex) + 2 * live_triangles[vertex] <= cache_size) priority = cache.age(vertex);
+            if (priority > best_priority) {
+                best_priority = priority;
+                next = vertex;
+            }
+        }
+
+        if (next == NO_VERTEX) {
+            // Dead end: restart from the most recent vertex that still has triangles left, failing that the first
+            // one in input order. Either way the cache is as good as cold, which makes this a cluster boundary.
+            while (!dead_ends.empty() && next == NO_VERTEX) {
+                const uint32_t vertex = dead_ends.back();
+                dead_ends.pop_back();
+                if (live_triangles[vertex] > 0) next = vertex;
+            }
+            while (scan_cursor < vertex_count && next == NO_VERTEX) {
+                if (live_triangles[scan_cursor] > 0) next = scan_cursor;
+                scan_cursor++;
+            }
+            const auto emitted_triangles = uint32_t(output.size() / 3);
+            if (next != NO_VERTEX && clusters.back() != emitted_triangles) clusters.push_back(emitted_triangles);
+        }
+        fanning = next;
+    }
+
+    indices.swap(output);
+    return clusters;
+}
+
+void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<uint32_t>& hard_clusters,
+                       const std::vector<MeshVertex>& vertices, float threshold, uint32_t cache_size) {
+    const auto triangle_count = uint32_t(indices.size() / 3);
+    if (triangle_count == 0 || hard_clusters.empty()) return;
+
+    // Soft boundaries: within each hard cluster, cut wherever restarting with a cold cache costs less than threshold
+    // times the cluster's own ACMR. Smaller clusters sort better, this bounds what sorting them can cost.
+    std::vector<uint32_t> clusters;
+    CacheSimulator cache(uint32_t(vertices.size()), cache_size);
+    for (size_t c = 0; c < hard_clusters.size(); c++) {
+        const uint32_t begin = hard_clusters[c];
+        const uint32_t end = c + 1 < hard_clusters.size() ? hard_clusters[c + 1] : triangle_count;
+
+        cache.flush();
+        uint32_t cluster_misses = 0;
+        for (uint32_t i = begin * 3; i < end * 3; i++) cluster_misses += cache.access(indices[i]);
+        const float miss_threshold = threshold * float(cluster_misses) / float(end - begin);
+
+        cache.flush();
+        clusters.push_back(begin);
+        uint32_t soft_begin = begin;
+        uint32_t soft_misses = 0;
+        for (uint32_t triangle = begin; triangle < end; triangle++) {
+            for (uint32_t corner = 0; corner < 3; corner++) soft_misses += cache.access(indices[triangle * 3 + corner]);
+            if (triangle + 1 < end && float(soft_misses) <= miss_threshold * float(triangle + 1 - soft_begin)) {
+                soft_begin = triangle + 1;
+                soft_misses = 0;
+                clusters.push_back(soft_begin);
+                cache.flush();
+            }
+        }
+    }
+
+    // Area weighted centroid and normal of every cluster
+    const auto cluster_count = uint32_t(clusters.size());
+    std::vector<glm::vec3> centroids(cluster_count, glm::vec3(0.f));
+    std::vector<glm::vec3> normals(cluster_count, glm::vec3(0.f));
+    glm::vec3 mesh_centroid(0.f);
+    float mesh_area = 0.f;
+    for (uint32_t c = 0; c < cluster_count; c++) {
+        const uint32_t end = c + 1 < cluster_count ? clusters[c + 1] : triangle_count;
+        float cluster_area = 0.f;
+        for (uint32_t triangle = clusters[c]; triangle < end; triangle++) {
+            const glm::vec3& p0 = vertices[indices[triangle * 3 + 0]].position;
+            const glm::vec3& p1 = vertices[indices[triangle * 3 + 1]].position;
+            const glm::vec3& p2 = vertices[indices[triangle * 3 + 2]].position;
+            const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            const float area = glm::length(normal);
+            centroids[c] += (area / 3.f) * (p0 + p1 + p2);
+            normals[c] += normal;
+            cluster_area += area;
+        }
+        mesh_centroid += centroids[c];
+        mesh_area += cluster_area;
+        if (cluster_area > 0.f) centroids[c] = (1.f / cluster_area) * centroids[c];
+    }
+    if (mesh_area > 0.f) mesh_centroid = (1.f / mesh_area) * mesh_centroid;
+
+    std::vector<float> sort_keys(cluster_count);
+    for (uint32_t c = 0; c < cluster_count; c++) {
+        const float length = glm::length(normals[c]);
+        sort_keys[c] = length > 0.f ? glm::dot(centroids[c] - mesh_centroid, normals[c]) / length : 0.f;
+    }
+    std::vector<uint32_t> order(cluster_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sort_keys[a] > sort_keys[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (const uint32_t c : order) {
+        const uint32_t end = c + 1 < cluster_count ? clusters[c + 1] : triangle_count;
+        output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + end * 3);
+    }
+    indices.swap(output);
+}
+
+void optimize_vertex_fetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices) {
+    std::vector<uint32_t> remap(vertices.size(), NO_VERTEX);
+    uint32_t next_vertex = 0;
+    for (uint32_t& index : indices) {
+        if (remap[index] == NO_VERTEX) remap[index] = next_vertex++;
+        index = remap[index];
+    }
+    for (uint32_t& new_index : remap) {
+        if (new_index == NO_VERTEX) new_index = next_vertex++;
+    }
+
+    std::vector<MeshVertex> reordered(vertices.size());
+    for (size_t v = 0; v < vertices.size(); v++) reordered[remap[v]] = vertices[v];
+    vertices.swap(reordered);
+}
+
+MeshOptimizationReport optimize_mesh(MeshData& mesh) {
+    const auto start_time = std::chrono::steady_clock::now();
+    const auto vertex_count = uint32_t(mesh.vertices.size());
+
+    MeshOptimizationReport report;
+    report.original = analyze_vertex_cache(mesh.indices, vertex_count);
+    const std::vector<uint32_t> clusters = optimize_vertex_cache(mesh.indices, vertex_count);
+    report.vertex_cache = analyze_vertex_cache(mesh.indices, vertex_count);
+    optimize_overdraw(mesh.indices, clusters, mesh.vertices);
+    report.overdraw = analyze_vertex_cache(mesh.indices, vertex_count);
+    optimize_vertex_fetch(mesh.vertices, mesh.indices);
+
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    return report;
+}
+
+void print_mesh_optimization_report(std::ostream& out, const MeshOptimizationReport& report) {
+    const auto print_stats = [&](const char* name, const VertexCacheStats& stats) {
+        out << "  " << std::left << std::setw(14) << name << std::right << " ACMR " << stats.acmr << "  ATVR " << stats.atvr << "\n";
+    };
+
+    out << std::fixed << std::setprecision(3)
+        << "Mesh optimized in " << report.seconds * 1000.0 << " ms, FIFO" << VERTEX_CACHE_SIZE << " simulation:\n";
+    print_stats("original", report.original);
+    print_stats("vertex cache", report.vertex_cache);
+    print_stats("overdraw", report.overdraw);
+    out.unsetf(std::ios_base::floatfield);
+}
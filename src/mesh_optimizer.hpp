@@ -0,0 +1,59 @@
+#pragma once
+
+#include "mesh_loader.hpp"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Index and vertex reordering for complete meshes, run before upload. Nothing here changes what gets drawn, only the
+// order triangles and vertices are stored in:
+//  - optimize_vertex_cache() reorders triangles so recently transformed vertices get reused (Tipsify, Sander et al.
+//    2007), fewer vertex shader invocations
+//  - optimize_overdraw() then reorders clusters of those triangles so outward facing ones come first, more fragments
+//    fail the depth test early, at a bounded cost in cache efficiency
+//  - optimize_vertex_fetch() finally renumbers vertices in the order the index buffer first touches them, so vertex
+//    fetch walks memory roughly linearly
+// analyze_vertex_cache() simulates a FIFO post-transform cache to measure the effect without a GPU.
+
+// Cache size the optimizer targets and the simulator models. Real hardware hasn't used strict FIFOs for a while, but
+// meshes ordered for 16 entries do well on all of it.
+constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats
+{
+    // Average cache miss ratio, vertex shader invocations per triangle: 3 is the worst, ~0.5 the best for regular grids
+    double acmr = 0.0;
+    // Average transform to vertex ratio, vertex shader invocations per referenced vertex: 1 is ideal
+    double atvr = 0.0;
+};
+
+VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t>& indices, uint32_t vertex_count,
+                                      uint32_t cache_size = VERTEX_CACHE_SIZE);
+
+// Returns the first triangle of every cluster, i.e. the points where the walk hit a dead end and restarted with a
+// cold cache. optimize_overdraw() takes them as its hard boundaries.
+std::vector<uint32_t> optimize_vertex_cache(std::vector<uint32_t>& indices, uint32_t vertex_count,
+                                            uint32_t cache_size = VERTEX_CACHE_SIZE);
+
+// Splits the clusters further wherever the ACMR so far is within threshold of the whole cluster's, then sorts them
+// by how much they face away from the mesh center. A threshold of 1.05 gives up at most ~5% of the cache efficiency.
+void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<uint32_t>& clusters,
+                       const std::vector<MeshVertex>& vertices, float threshold = 1.05f,
+                       uint32_t cache_size = VERTEX_CACHE_SIZE);
+
+// Vertices never referenced keep their data but move to the end
+void optimize_vertex_fetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices);
+
+struct MeshOptimizationReport
+{
+    VertexCacheStats original;
+    VertexCacheStats vertex_cache;
+    VertexCacheStats overdraw;
+    double seconds = 0.0;
+};
+
+// All three passes in order
+MeshOptimizationReport optimize_mesh(MeshData& mesh);
+
+void print_mesh_optimization_report(std::ostream& out, const MeshOptimizationReport& report);
@@ -0,0 +1,51 @@
+#include "parallel_command_recorder.hpp"
+
+bool ParallelCommandRecorder::init(VkDevice device, uint32_t queue_family, uint32_t frame_count, uint32_t thread_count) {
+    device_ = device;
+    thread_count_ = thread_count;
+    pools_.resize(size_t(frame_count) * thread_count);
+
+    VkCommandPoolCreateInfo command_pool_create_info = {};
+    command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    command_pool_create_info.queueFamilyIndex = queue_family;
+    // Reset as a whole every frame, never per buffer
+    command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    for (auto& thread_pool : pools_) {
+        if (vkCreateCommandPool(device_, &command_pool_create_info, nullptr, &thread_pool.pool) != VK_SUCCESS) return false;
+    }
+    return true;
+}
+
+void ParallelCommandRecorder::destroy() {
+    for (auto& thread_pool : pools_) {
+        vkDestroyCommandPool(device_, thread_pool.pool, nullptr);
+    }
+    pools_.clear();
+}
+
+void ParallelCommandRecorder::begin_frame(uint32_t frame_index) {
+    frame_index_ = frame_index;
+    for (uint32_t thread = 0; thread < thread_count_; thread++) {
+        auto& thread_pool = pools_[size_t(frame_index) * thread_count_ + thread];
+        if (thread_pool.used == 0) continue;
+        vkResetCommandPool(device_, thread_pool.pool, 0);
+        thread_pool.used = 0;
+    }
+}
+
+VkCommandBuffer ParallelCommandRecorder::acquire_secondary(uint32_t thread_index) {
+    auto& thread_pool = pools_[size_t(frame_index_) * thread_count_ + thread_index];
+    if (thread_pool.used == thread_pool.buffers.size()) {
+        VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
+        command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        command_buffer_allocate_info.commandPool = thread_pool.pool;
+        command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        command_buffer_allocate_info.commandBufferCount = 1;
+
+        VkCommandBuffer command_buffer;
+        if (vkAllocateCommandBuffers(device_, &command_buffer_allocate_info, &command_buffer) != VK_SUCCESS) return VK_NULL_HANDLE;
+        thread_pool.buffers.push_back(command_buffer);
+    }
+    return thread_pool.buffers[thread_pool.used++];
+}
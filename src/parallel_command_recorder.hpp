@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Command pools are externally synchronized, so recording from several threads needs one pool per thread. This
+// keeps a pool per (frame in flight, thread) pair and hands out secondary command buffers from them. A frame's pools
+// are reset in one go by begin_frame() once the frame's fence has signaled, buffers get reused instead of freed.
+class ParallelCommandRecorder
+{
+public:
+    bool init(VkDevice device, uint32_t queue_family, uint32_t frame_count, uint32_t thread_count);
+    void destroy();
+
+    void begin_frame(uint32_t frame_index);
+
+    // Only ever called by the thread owning thread_index
+    VkCommandBuffer acquire_secondary(uint32_t thread_index);
+
+private:
+    struct ThreadPool
+    {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> buffers;
+        uint32_t used = 0;
+    };
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    uint32_t thread_count_ = 0;
+    uint32_t frame_index_ = 0;
+    // frame_count * thread_count entries, frame major
+    std::vector<ThreadPool> pools_;
+};
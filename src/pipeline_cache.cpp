@@ -0,0 +1,98 @@
+#include "pipeline_cache.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace
+{
+    // Layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE, see the vkGetPipelineCacheData documentation
+    struct PipelineCacheHeader
+    {
+        uint32_t header_size;
+        uint32_t header_version;
+        uint32_t vendor_id;
+        uint32_t device_id;
+        uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+    };
+    static_assert(sizeof(PipelineCacheHeader) == 16 + VK_UUID_SIZE, "Unexpected padding in pipeline cache header");
+
+    std::vector<char> read_file(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return {};
+        return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+}
+
+bool PipelineCache::init(VkPhysicalDevice physical_device, VkDevice device, const std::string& path) {
+    device_ = device;
+    path_ = path;
+    vkGetPhysicalDeviceProperties(physical_device, &properties_);
+
+    std::vector<char> data = path_.empty() ? std::vector<char>() : read_file(path_);
+    if (!data.empty() && !is_compatible(data)) {
+        std::cout << "Pipeline cache " << path_ << " doesn't match this device/driver, starting cold\n";
+        data.clear();
+    }
+
+    VkPipelineCacheCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.initialDataSize = data.size();
+    create_info.pInitialData = data.empty() ? nullptr : data.data();
+
+    if (vkCreatePipelineCache(device_, &create_info, nullptr, &cache_) == VK_SUCCESS) {
+        warm_ = !data.empty();
+        return true;
+    }
+
+    // A valid header followed by garbage can still be rejected by the driver
+    create_info.initialDataSize = 0;
+    create_info.pInitialData = nullptr;
+    warm_ = false;
+    return vkCreatePipelineCache(device_, &create_info, nullptr, &cache_) == VK_SUCCESS;
+}
+
+bool PipelineCache::is_compatible(const std::vector<char>& data) const {
+    if (data.size() < sizeof(PipelineCacheHeader)) return false;
+
+    PipelineCacheHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+
+    return header.header_size >= sizeof(PipelineCacheHeader) &&
+        header.header_size <= data.size() &&
+        header.header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+        header.vendor_id == properties_.vendorID &&
+        header.device_id == properties_.deviceID &&
+        memcmp(header.pipeline_cache_uuid, properties_.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::save() const {
+    if (cache_ == VK_NULL_HANDLE || path_.empty()) return;
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device_, cache_, &size, nullptr) != VK_SUCCESS || size == 0) return;
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(device_, cache_, &size, data.data()) != VK_SUCCESS) return;
+
+    // Write next to the target and rename, so a crash mid-write never leaves a truncated cache behind
+    const std::string temporary_path = path_ + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!file.write(data.data(), std::streamsize(size))) {
+            std::cerr << "Failed to write pipeline cache " << temporary_path << "\n";
+            return;
+        }
+    }
+    std::remove(path_.c_str());
+    if (std::rename(temporary_path.c_str(), path_.c_str()) != 0) {
+        std::cerr << "Failed to replace pipeline cache " << path_ << "\n";
+    }
+}
+
+void PipelineCache::destroy() {
+    vkDestroyPipelineCache(device_, cache_, nullptr);
+    cache_ = VK_NULL_HANDLE;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+// VkPipelineCache backed by a file. The file is only used when its header matches the current driver
+// (vendorID, deviceID and pipelineCacheUUID), anything else - missing, truncated, corrupted or written by another
+// device/driver version - silently falls back to an empty cache that overwrites the file on save().
+class PipelineCache
+{
+public:
+    bool init(VkPhysicalDevice physical_device, VkDevice device, const std::string& path);
+    void save() const;
+    void destroy();
+
+    VkPipelineCache handle() const { return cache_; }
+    // True if the cache was primed from disk, i.e. pipeline creation should be warm
+    bool is_warm() const { return warm_; }
+
+private:
+    bool is_compatible(const std::vector<char>& data) const;
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkPipelineCache cache_ = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties_ = {};
+    std::string path_;
+    bool warm_ = false;
+};
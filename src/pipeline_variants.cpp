@@ -0,0 +1,119 @@
+#include "pipeline_variants.hpp"
+
+#include "hash.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+
+namespace
+{
+    const VkSpecializationMapEntry MATERIAL_SPECIALIZATION_ENTRIES[] = {
+        {0, offsetof(MaterialVariant, vertex_color), sizeof(VkBool32)},
+        {1, offsetof(MaterialVariant, grayscale), sizeof(VkBool32)},
+        {2, offsetof(MaterialVariant, checker), sizeof(VkBool32)},
+        {3, offsetof(MaterialVariant, posterize_levels), sizeof(uint32_t)},
+    };
+
+    bool is_default(const MaterialVariant& variant) {
+        const MaterialVariant default_variant;
+        return memcmp(&variant, &default_variant, sizeof(MaterialVariant)) == 0;
+    }
+}
+
+MaterialVariant material_variant(uint32_t index) {
+    static const uint32_t posterize_levels[] = {0, 2, 4, 8};
+
+    MaterialVariant variant;
+    variant.vertex_color = (index & 1) ? VK_FALSE : VK_TRUE;
+    variant.grayscale = (index & 2) ? VK_TRUE : VK_FALSE;
+    variant.checker = (index & 4) ? VK_TRUE : VK_FALSE;
+    variant.posterize_levels = posterize_levels[(index >> 3) & 3];
+    return variant;
+}
+
+void material_specialization_info(const MaterialVariant& variant, VkSpecializationInfo& info) {
+    info.mapEntryCount = uint32_t(std::size(MATERIAL_SPECIALIZATION_ENTRIES));
+    info.pMapEntries = MATERIAL_SPECIALIZATION_ENTRIES;
+    info.dataSize = sizeof(MaterialVariant);
+    info.pData = &variant;
+}
+
+uint64_t pipeline_variant_key(uint64_t state_hash, const MaterialVariant& variant) {
+    return fnv1a(&variant, sizeof(variant), fnv1a(&state_hash, sizeof(state_hash)));
+}
+
+void PipelineVariants::init(VkDevice device, JobSystem& job_system) {
+    device_ = device;
+    job_system_ = &job_system;
+}
+
+void PipelineVariants::destroy() {
+    wait_idle();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : pipelines_) vkDestroyPipeline(device_, entry.second, nullptr);
+    pipelines_.clear();
+}
+
+void PipelineVariants::reset(uint64_t state_hash, Builder builder, VkPipeline fallback, const Retire& retire) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : pipelines_) {
+        if (entry.second != VK_NULL_HANDLE) retire(entry.second);
+    }
+    pipelines_.clear();
+    state_hash_ = state_hash;
+    builder_ = std::move(builder);
+    fallback_ = fallback;
+    generation_++;
+}
+
+void PipelineVariants::wait_idle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return builds_in_flight_ == 0; });
+}
+
+VkPipeline PipelineVariants::get(const MaterialVariant& variant) {
+    // The fallback is that very pipeline
+    if (is_default(variant)) return fallback_;
+
+    const uint64_t key = pipeline_variant_key(state_hash_, variant);
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto found = pipelines_.find(key);
+    if (found != pipelines_.end()) return found->second != VK_NULL_HANDLE ? found->second : fallback_;
+
+    pipelines_.emplace(key, VK_NULL_HANDLE);
+    builds_in_flight_++;
+    job_system_->submit([this, key, variant, builder = builder_, generation = generation_](uint32_t) {
+        VkSpecializationInfo specialization = {};
+        material_specialization_info(variant, specialization);
+        const auto start = std::chrono::high_resolution_clock::now();
+        const VkPipeline pipeline = builder(specialization);
+        const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation == generation_) {
+            pipelines_[key] = pipeline;
+        } else {
+            // Never handed out, nothing can be using it
+            vkDestroyPipeline(device_, pipeline, nullptr);
+        }
+        if (pipeline != VK_NULL_HANDLE) {
+            built_count_++;
+            build_milliseconds_ += milliseconds;
+        }
+        builds_in_flight_--;
+        idle_.notify_all();
+    });
+    return fallback_;
+}
+
+uint32_t PipelineVariants::built_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return built_count_;
+}
+
+double PipelineVariants::build_milliseconds() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return build_milliseconds_;
+}
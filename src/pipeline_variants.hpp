@@ -0,0 +1,78 @@
+#pragma once
+
+#include "job_system.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+// Material feature toggles, fill_triangle.frag's specialization constants in constant_id order. The defaults are the
+// constants' defaults in the shader, i.e. a pipeline built without specialization.
+struct MaterialVariant
+{
+    VkBool32 vertex_color = VK_TRUE;
+    VkBool32 grayscale = VK_FALSE;
+    VkBool32 checker = VK_FALSE;
+    // 0 disables posterization
+    uint32_t posterize_levels = 0;
+};
+
+// Every combination of the toggles, posterize_levels being one of 0, 2, 4 and 8
+constexpr uint32_t MATERIAL_VARIANT_COUNT = 32;
+
+// Index 0 is the default material
+MaterialVariant material_variant(uint32_t index);
+
+// Points info at the variant's constants and the map entries describing MaterialVariant
+void material_specialization_info(const MaterialVariant& variant, VkSpecializationInfo& info);
+
+// A variant's key: the pipeline state it is built against (shaders, layout, render pass, vertex input - whatever the
+// caller hashes into state_hash) plus its constants
+uint64_t pipeline_variant_key(uint64_t state_hash, const MaterialVariant& variant);
+
+// Pipelines for material variants, built on demand on JobSystem workers. get() never waits: a variant that isn't
+// built yet queues its build (once) and gets the fallback pipeline until the build is done, so a variant's first use
+// draws a frame or two with the default material instead of hitching. Failed builds stay on the fallback.
+// reset() moves to new pipeline state (reloaded shaders, another render pass), retiring every variant of the old one.
+class PipelineVariants
+{
+public:
+    // Builds a pipeline with the given fragment specialization, on a worker. Null on failure.
+    using Builder = std::function<VkPipeline(const VkSpecializationInfo& specialization)>;
+    using Retire = std::function<void(VkPipeline)>;
+
+    void init(VkDevice device, JobSystem& job_system);
+    // Waits for the builds in flight, then destroys every variant. The fallback isn't owned.
+    void destroy();
+
+    void reset(uint64_t state_hash, Builder builder, VkPipeline fallback, const Retire& retire);
+    // Returns once no build is in flight, e.g. before the objects they're built against go away
+    void wait_idle();
+
+    VkPipeline get(const MaterialVariant& variant);
+
+    uint32_t built_count() const;
+    // Summed over all builds, i.e. worker time rather than wall time
+    double build_milliseconds() const;
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    JobSystem* job_system_ = nullptr;
+
+    mutable std::mutex mutex_;
+    std::condition_variable idle_;
+    // Null pipelines are builds in flight or failed ones
+    std::unordered_map<uint64_t, VkPipeline> pipelines_;
+    uint64_t state_hash_ = 0;
+    Builder builder_;
+    VkPipeline fallback_ = VK_NULL_HANDLE;
+    // Bumped by reset(), builds finishing for an older generation are thrown away
+    uint32_t generation_ = 0;
+    uint32_t builds_in_flight_ = 0;
+    uint32_t built_count_ = 0;
+    double build_milliseconds_ = 0.0;
+};
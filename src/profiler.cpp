@@ -0,0 +1,167 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+
+namespace
+{
+    // Small stable ids read better in the trace viewer than hashed std::thread::ids, 0 is taken by the GPU track
+    uint32_t current_thread_id() {
+        static std::atomic<uint32_t> next_thread_id{1};
+        thread_local const uint32_t thread_id = next_thread_id++;
+        return thread_id;
+    }
+}
+
+Profiler::CpuZone::CpuZone(Profiler& profiler, const char* name)
+    : profiler_(profiler), name_(name), begin_us_(profiler.now_us()) {
+}
+
+Profiler::CpuZone::~CpuZone() {
+    profiler_.record(name_, false, current_thread_id(), begin_us_, profiler_.now_us() - begin_us_);
+}
+
+bool Profiler::init(VkPhysicalDevice physical_device, VkDevice device, uint32_t timestamp_valid_bits, uint32_t frame_count, bool trace) {
+    device_ = device;
+    trace_ = trace;
+    start_time_ = std::chrono::steady_clock::now();
+    slots_.assign(frame_count, {});
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    timestamp_period_ns_ = properties.limits.timestampPeriod;
+
+    // Without timestamp support on this queue the CPU zones still work, GPU zones are just dropped
+    if (timestamp_valid_bits == 0) return true;
+    timestamp_mask_ = timestamp_valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << timestamp_valid_bits) - 1;
+
+    VkQueryPoolCreateInfo create_info = {};
+    create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    create_info.queryCount = frame_count * MAX_GPU_ZONES_PER_FRAME * 2;
+
+    return vkCreateQueryPool(device_, &create_info, nullptr, &query_pool_) == VK_SUCCESS;
+}
+
+void Profiler::destroy() {
+    if (query_pool_ != VK_NULL_HANDLE) vkDestroyQueryPool(device_, query_pool_, nullptr);
+    query_pool_ = VK_NULL_HANDLE;
+}
+
+double Profiler::now_us() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start_time_).count();
+}
+
+void Profiler::record(const char* name, bool gpu, uint32_t thread_id, double begin_us, double duration_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto& history = histories_[name];
+    history.gpu = gpu;
+    const auto sample_ms = float(duration_us / 1000.0);
+    if (history.samples_ms.size() < HISTORY_SIZE) {
+        history.samples_ms.push_back(sample_ms);
+    } else {
+        history.samples_ms[history.next] = sample_ms;
+    }
+    history.next = (history.next + 1) % HISTORY_SIZE;
+
+    if (trace_) trace_events_.push_back({name, thread_id, begin_us, duration_us});
+}
+
+void Profiler::begin_frame(uint32_t frame_slot) {
+    current_slot_ = frame_slot;
+    auto& slot = slots_[frame_slot];
+    if (slot.gpu_zones.empty()) return;
+
+    const auto query_count = uint32_t(slot.gpu_zones.size() * 2);
+    std::vector<uint64_t> timestamps(query_count);
+    // No WAIT_BIT: the slot's fence has signaled so the results are there, and if they aren't the frame is skipped
+    // rather than stalling the CPU
+    const VkResult result = vkGetQueryPoolResults(device_, query_pool_, frame_slot * MAX_GPU_ZONES_PER_FRAME * 2,
+        query_count, timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+    if (result == VK_SUCCESS) {
+        // There is no common clock without VK_EXT_calibrated_timestamps, the first zone is assumed to start when
+        // the frame got submitted. Good enough to line GPU work up with the CPU frame that produced it.
+        const uint64_t origin = timestamps[0];
+        for (size_t zone = 0; zone < slot.gpu_zones.size(); zone++) {
+            const uint64_t begin = timestamps[zone * 2];
+            const uint64_t end = timestamps[zone * 2 + 1];
+            // Masking the differences keeps them right across a wrap of the valid timestamp bits
+            const double begin_us = slot.submit_us + double((begin - origin) & timestamp_mask_) * timestamp_period_ns_ / 1000.0;
+            const double duration_us = double((end - begin) & timestamp_mask_) * timestamp_period_ns_ / 1000.0;
+            record(slot.gpu_zones[zone], true, GPU_THREAD_ID, begin_us, duration_us);
+        }
+    }
+    slot.gpu_zones.clear();
+}
+
+void Profiler::end_frame() {
+    slots_[current_slot_].submit_us = now_us();
+}
+
+void Profiler::reset_gpu_zones(VkCommandBuffer command_buffer) {
+    if (query_pool_ == VK_NULL_HANDLE) return;
+    vkCmdResetQueryPool(command_buffer, query_pool_, current_slot_ * MAX_GPU_ZONES_PER_FRAME * 2, MAX_GPU_ZONES_PER_FRAME * 2);
+}
+
+uint32_t Profiler::begin_gpu_zone(VkCommandBuffer command_buffer, const char* name) {
+    auto& slot = slots_[current_slot_];
+    if (query_pool_ == VK_NULL_HANDLE || slot.gpu_zones.size() == MAX_GPU_ZONES_PER_FRAME) return UINT32_MAX;
+
+    const auto zone = uint32_t(slot.gpu_zones.size());
+    slot.gpu_zones.push_back(name);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_, (current_slot_ * MAX_GPU_ZONES_PER_FRAME + zone) * 2);
+    return zone;
+}
+
+void Profiler::end_gpu_zone(VkCommandBuffer command_buffer, uint32_t zone) {
+    if (zone == UINT32_MAX) return;
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_, (current_slot_ * MAX_GPU_ZONES_PER_FRAME + zone) * 2 + 1);
+}
+
+void Profiler::print_summary(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    out << std::fixed << std::setprecision(3)
+        << "Zone timings over the last " << HISTORY_SIZE << " samples (ms):\n";
+    for (const auto& entry : histories_) {
+        auto samples = entry.second.samples_ms;
+        if (samples.empty()) continue;
+        std::sort(samples.begin(), samples.end());
+
+        const double average = std::accumulate(samples.begin(), samples.end(), 0.0) / double(samples.size());
+        const size_t p99_index = std::min(samples.size() - 1, size_t(double(samples.size()) * 0.99));
+        out << "  " << (entry.second.gpu ? "gpu " : "cpu ") << std::left << std::setw(24) << entry.first << std::right
+            << " min " << samples.front() << "  avg " << average << "  p99 " << samples[p99_index] << "\n";
+    }
+    out.unsetf(std::ios_base::floatfield);
+}
+
+bool Profiler::write_chrome_trace(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Same write-then-rename as the pipeline cache, a crash mid-write must not leave a truncated trace behind
+    const std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::trunc);
+        if (!file) return false;
+
+        // Complete ("X") events, timestamps in microseconds. Zone names are string literals, nothing to escape.
+        file << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << GPU_THREAD_ID << ",\"args\":{\"name\":\"GPU\"}}";
+        for (const auto& event : trace_events_) {
+            file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread_id
+                << ",\"ts\":" << event.begin_us << ",\"dur\":" << event.duration_us << "}";
+        }
+        file << "\n]}\n";
+        if (!file) return false;
+    }
+
+    std::remove(path.c_str());
+    return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Frame instrumentation. CPU phases are timed with scoped CpuZone objects, GPU work with pairs of vkCmdWriteTimestamp
+// queries. Every frame slot owns its own range of queries which is only read back in begin_frame(), after the slot's
+// fence has signaled, so collecting results never stalls. Each zone feeds a rolling window for min/avg/p99 summaries
+// and, when tracing is enabled, a list of events that can be exported as Chrome trace JSON (chrome://tracing, Perfetto).
+class Profiler
+{
+public:
+    class CpuZone
+    {
+    public:
+        CpuZone(Profiler& profiler, const char* name);
+        ~CpuZone();
+
+        CpuZone(const CpuZone&) = delete;
+        CpuZone& operator=(const CpuZone&) = delete;
+
+    private:
+        Profiler& profiler_;
+        const char* name_;
+        double begin_us_;
+    };
+
+    // timestamp_valid_bits comes from the queue family the GPU zones are recorded on, 0 disables GPU timing
+    bool init(VkPhysicalDevice physical_device, VkDevice device, uint32_t timestamp_valid_bits, uint32_t frame_count, bool trace);
+    void destroy();
+
+    // Call once the frame slot's fence has signaled, collects the GPU zones the slot recorded the last time around
+    void begin_frame(uint32_t frame_slot);
+    // Call right after the frame is submitted, the frame's GPU zones are placed on the trace relative to this point
+    void end_frame();
+
+    // Must be recorded outside of a render pass, before any GPU zone of the frame
+    void reset_gpu_zones(VkCommandBuffer command_buffer);
+    // Zones are only valid within the command buffer they're recorded into, names must outlive the profiler
+    uint32_t begin_gpu_zone(VkCommandBuffer command_buffer, const char* name);
+    void end_gpu_zone(VkCommandBuffer command_buffer, uint32_t zone);
+
+    void print_summary(std::ostream& out) const;
+    bool write_chrome_trace(const std::string& path) const;
+
+private:
+    // Upper bound of GPU zones per frame, each one takes two queries
+    static constexpr uint32_t MAX_GPU_ZONES_PER_FRAME = 32;
+    // Samples per zone the summary is computed over
+    static constexpr size_t HISTORY_SIZE = 512;
+    static constexpr uint32_t GPU_THREAD_ID = 0;
+
+    struct FrameSlot
+    {
+        std::vector<const char*> gpu_zones;
+        double submit_us = 0.0;
+    };
+
+    struct TraceEvent
+    {
+        const char* name;
+        uint32_t thread_id;
+        double begin_us;
+        double duration_us;
+    };
+
+    struct ZoneHistory
+    {
+        bool gpu = false;
+        std::vector<float> samples_ms;
+        size_t next = 0;
+    };
+
+    double now_us() const;
+    void record(const char* name, bool gpu, uint32_t thread_id, double begin_us, double duration_us);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkQueryPool query_pool_ = VK_NULL_HANDLE;
+    double timestamp_period_ns_ = 1.0;
+    uint64_t timestamp_mask_ = 0;
+    bool trace_ = false;
+
+    std::chrono::steady_clock::time_point start_time_;
+    std::vector<FrameSlot> slots_;
+    uint32_t current_slot_ = 0;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, ZoneHistory> histories_;
+    std::vector<TraceEvent> trace_events_;
+};
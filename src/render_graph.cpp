@@ -0,0 +1,730 @@
+#include "render_graph.hpp"
+
+#include "hash.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace
+{
+    const VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+        VK_ACCESS_MEMORY_WRITE_BIT;
+
+    struct AccessInfo
+    {
+        VkPipelineStageFlags stages;
+        VkAccessFlags access;
+        // Undefined for accesses only buffers can have
+        VkImageLayout layout;
+        bool write;
+        VkImageUsageFlags usage;
+    };
+
+    AccessInfo access_info(ResourceAccess access, PassKind kind) {
+        const VkPipelineStageFlags shader_stages = kind == PassKind::GRAPHICS ?
+            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        const VkPipelineStageFlags depth_stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        switch (access) {
+            case ResourceAccess::NONE:
+                return {0, 0, VK_IMAGE_LAYOUT_UNDEFINED, false, 0};
+            case ResourceAccess::COLOR_ATTACHMENT:
+                return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+            case ResourceAccess::DEPTH_ATTACHMENT:
+                return {depth_stages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+            case ResourceAccess::DEPTH_READ:
+                return {depth_stages, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                        false, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+            case ResourceAccess::SAMPLED:
+                return {shader_stages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, VK_IMAGE_USAGE_SAMPLED_BIT};
+            case ResourceAccess::STORAGE_READ:
+                return {shader_stages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false, VK_IMAGE_USAGE_STORAGE_BIT};
+            case ResourceAccess::STORAGE_WRITE:
+                return {shader_stages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true,
+                        VK_IMAGE_USAGE_STORAGE_BIT};
+            case ResourceAccess::UNIFORM_READ:
+                return {shader_stages, VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, 0};
+            case ResourceAccess::VERTEX_READ:
+                return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, 0};
+            case ResourceAccess::INDEX_READ:
+                return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, 0};
+            case ResourceAccess::INDIRECT_READ:
+                return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, 0};
+            case ResourceAccess::TRANSFER_READ:
+                return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false,
+                        VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+            case ResourceAccess::TRANSFER_WRITE:
+                return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true,
+                        VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+            case ResourceAccess::HOST_READ:
+                return {VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false, 0};
+            case ResourceAccess::PRESENT:
+                return {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false, 0};
+        }
+        return {0, 0, VK_IMAGE_LAYOUT_UNDEFINED, false, 0};
+    }
+
+    bool is_attachment_access(ResourceAccess access) {
+        return access == ResourceAccess::COLOR_ATTACHMENT || access == ResourceAccess::DEPTH_ATTACHMENT ||
+            access == ResourceAccess::DEPTH_READ;
+    }
+
+    VkImageAspectFlags aspect_mask(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_D16_UNORM:
+            case VK_FORMAT_X8_D24_UNORM_PACK32:
+            case VK_FORMAT_D32_SFLOAT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT;
+            case VK_FORMAT_D16_UNORM_S8_UINT:
+            case VK_FORMAT_D24_UNORM_S8_UINT:
+            case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+            case VK_FORMAT_S8_UINT:
+                return VK_IMAGE_ASPECT_STENCIL_BIT;
+            default:
+                return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+    }
+
+    VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+void RenderGraph::init(VkDevice device, DeviceMemoryAllocator& allocator) {
+    device_ = device;
+    allocator_ = &allocator;
+}
+
+void RenderGraph::destroy() {
+    reset([](std::function<void()> deleter) { deleter(); });
+    for (const auto& entry : render_passes_) vkDestroyRenderPass(device_, entry.second.render_pass, nullptr);
+    render_passes_.clear();
+}
+
+void RenderGraph::reset(const Retire& retire) {
+    std::vector<VkFramebuffer> framebuffers;
+    for (const auto& pass : passes_) {
+        for (const auto& entry : pass.framebuffers) framebuffers.push_back(entry.second);
+    }
+    std::vector<std::pair<VkImage, VkImageView>> images;
+    for (const auto& resource : resources_) {
+        if (resource.image && !resource.imported && resource.handle != VK_NULL_HANDLE) images.emplace_back(resource.handle, resource.view);
+    }
+    std::vector<Allocation> allocations;
+    for (const auto& group : memory_groups_) allocations.push_back(group.allocation);
+
+    if (!framebuffers.empty() || !images.empty() || !allocations.empty()) {
+        retire([device = device_, allocator = allocator_, framebuffers, images, allocations]() mutable {
+            for (const auto framebuffer : framebuffers) vkDestroyFramebuffer(device, framebuffer, nullptr);
+            for (const auto& image : images) {
+                vkDestroyImageView(device, image.second, nullptr);
+                vkDestroyImage(device, image.first, nullptr);
+            }
+            for (auto& allocation : allocations) {
+                if (allocation.is_valid()) allocator->free(allocation);
+            }
+        });
+    }
+
+    resources_.clear();
+    passes_.clear();
+    memory_groups_.clear();
+    final_barrier_ = {};
+    barrier_count_ = 0;
+    transient_bytes_ = 0;
+    aliased_bytes_ = 0;
+}
+
+RenderGraph::ResourceId RenderGraph::import_image(const char* name, VkFormat format, VkExtent2D extent,
+                                                  ResourceAccess initial_access, ResourceAccess final_access) {
+    Resource resource = {name, true, true};
+    resource.format = format;
+    resource.extent = extent;
+    resource.initial_access = initial_access;
+    resource.final_access = final_access;
+    resources_.push_back(resource);
+    return ResourceId(resources_.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::import_buffer(const char* name, ResourceAccess initial_access, ResourceAccess final_access) {
+    Resource resource = {name, false, true};
+    resource.initial_access = initial_access;
+    resource.final_access = final_access;
+    resources_.push_back(resource);
+    return ResourceId(resources_.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::create_image(const char* name, VkFormat format, VkExtent2D extent) {
+    Resource resource = {name, true, false};
+    resource.format = format;
+    resource.extent = extent;
+    resources_.push_back(resource);
+    return ResourceId(resources_.size() - 1);
+}
+
+RenderGraph::PassId RenderGraph::add_pass(const char* name, PassKind kind, Record record) {
+    Pass pass;
+    pass.name = name;
+    pass.kind = kind;
+    pass.record = std::move(record);
+    passes_.push_back(std::move(pass));
+    return PassId(passes_.size() - 1);
+}
+
+void RenderGraph::keep(PassId pass) {
+    passes_[pass].keep = true;
+}
+
+void RenderGraph::color_attachment(PassId pass, ResourceId image, const VkClearColorValue* clear) {
+    Use use = {image, ResourceAccess::COLOR_ATTACHMENT, true, clear != nullptr, {}};
+    if (clear) use.clear_value.color = *clear;
+    passes_[pass].uses.push_back(use);
+}
+
+void RenderGraph::depth_attachment(PassId pass, ResourceId image, const VkClearDepthStencilValue* clear, bool read_only) {
+    Use use = {image, read_only ? ResourceAccess::DEPTH_READ : ResourceAccess::DEPTH_ATTACHMENT, true, clear != nullptr, {}};
+    if (clear) use.clear_value.depthStencil = *clear;
+    passes_[pass].uses.push_back(use);
+}
+
+void RenderGraph::use(PassId pass, ResourceId resource, ResourceAccess access) {
+    passes_[pass].uses.push_back({resource, access, false, false, {}});
+}
+
+bool RenderGraph::validate(std::string& error) const {
+    for (const auto& pass : passes_) {
+        const std::string where = std::string("render graph pass ") + pass.name + ": ";
+        const Use* first_attachment = nullptr;
+        for (const auto& use : pass.uses) {
+            const Resource& resource = resources_[use.resource];
+            if (use.attachment) {
+                if (pass.kind != PassKind::GRAPHICS || !resource.image) {
+                    error = where + resource.name + " can only be an attachment of a graphics pass, and only if it's an image";
+                    return false;
+                }
+                if (first_attachment == nullptr) first_attachment = &use;
+                const VkExtent2D extent = resources_[first_attachment->resource].extent;
+                if (resource.extent.width != extent.width || resource.extent.height != extent.height) {
+                    error = where + "attachments " + resource.name + " and " + resources_[first_attachment->resource].name +
+                        " differ in size";
+                    return false;
+                }
+            } else if (is_attachment_access(use.access)) {
+                error = where + resource.name + " has to be declared with color_attachment() or depth_attachment()";
+                return false;
+            }
+            if (resource.image && !use.attachment && access_info(use.access, pass.kind).layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+                error = where + "image " + resource.name + " used with a buffer-only access";
+                return false;
+            }
+            // The attachment's layout would be fighting with the other use's
+            for (const auto& other : pass.uses) {
+                if (&other != &use && other.resource == use.resource && other.attachment != use.attachment) {
+                    error = where + resource.name + " is both an attachment and something else";
+                    return false;
+                }
+            }
+        }
+        if (pass.kind == PassKind::GRAPHICS && first_attachment == nullptr) {
+            error = where + "graphics passes need at least one attachment";
+            return false;
+        }
+    }
+    return true;
+}
+
+void RenderGraph::cull_passes() {
+    std::vector<bool> needed(resources_.size());
+    for (size_t i = 0; i < resources_.size(); i++) {
+        needed[i] = resources_[i].imported && resources_[i].final_access != ResourceAccess::NONE;
+    }
+
+    for (size_t i = passes_.size(); i-- > 0;) {
+        Pass& pass = passes_[i];
+        pass.live = pass.keep;
+        for (const auto& use : pass.uses) {
+            if (access_info(use.access, pass.kind).write && needed[use.resource]) pass.live = true;
+        }
+        if (!pass.live) continue;
+        // What it reads has to be produced, attachments it loads included
+        for (const auto& use : pass.uses) {
+            if (!access_info(use.access, pass.kind).write || (use.attachment && !use.clear)) needed[use.resource] = true;
+        }
+    }
+
+    for (uint32_t i = 0; i < passes_.size(); i++) {
+        if (!passes_[i].live) continue;
+        for (const auto& use : passes_[i].uses) {
+            Resource& resource = resources_[use.resource];
+            resource.first_pass = std::min(resource.first_pass, i);
+            resource.last_pass = std::max(resource.last_pass, i);
+            resource.usage |= access_info(use.access, passes_[i].kind).usage;
+        }
+    }
+}
+
+bool RenderGraph::create_transients(std::string& error) {
+    for (auto& resource : resources_) {
+        if (!resource.image || resource.imported || resource.first_pass == UINT32_MAX) continue;
+
+        // Nothing survives from one frame to the next, its first use has to write it
+        const Pass& first = passes_[resource.first_pass];
+        const auto first_use = std::find_if(first.uses.begin(), first.uses.end(), [&](const Use& use) {
+            return &resources_[use.resource] == &resource;
+        });
+        if (!access_info(first_use->access, first.kind).write) {
+            error = std::string("render graph: transient image ") + resource.name + " is read by " + first.name +
+                " before anything writes it";
+            return false;
+        }
+
+        VkImageCreateInfo image_create_info = {};
+        image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_create_info.imageType = VK_IMAGE_TYPE_2D;
+        image_create_info.format = resource.format;
+        image_create_info.extent = {resource.extent.width, resource.extent.height, 1};
+        image_create_info.mipLevels = 1;
+        image_create_info.arrayLayers = 1;
+        image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_create_info.usage = resource.usage;
+        image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (vkCreateImage(device_, &image_create_info, nullptr, &resource.handle) != VK_SUCCESS) {
+            resource.handle = VK_NULL_HANDLE;
+            error = std::string("render graph: failed to create transient image ") + resource.name;
+            return false;
+        }
+        vkGetImageMemoryRequirements(device_, resource.handle, &resource.memory_requirements);
+    }
+
+    place_transients();
+
+    for (auto& group : memory_groups_) {
+        const VkMemoryRequirements requirements = {group.size, group.alignment, group.memory_type_bits};
+        if (allocator_->allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, AllocationKind::OPTIMAL, group.allocation) != VK_SUCCESS) {
+            error = "render graph: out of device memory for transient images";
+            return false;
+        }
+    }
+
+    for (auto& resource : resources_) {
+        if (resource.memory_group == UINT32_MAX) continue;
+        const Allocation& allocation = memory_groups_[resource.memory_group].allocation;
+        if (vkBindImageMemory(device_, resource.handle, allocation.memory, allocation.offset + resource.memory_offset) != VK_SUCCESS) {
+            error = std::string("render graph: failed to bind transient image ") + resource.name;
+            return false;
+        }
+
+        VkImageViewCreateInfo view_create_info = {};
+        view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_create_info.image = resource.handle;
+        view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_create_info.format = resource.format;
+        view_create_info.subresourceRange = {aspect_mask(resource.format), 0, 1, 0, 1};
+        if (vkCreateImageView(device_, &view_create_info, nullptr, &resource.view) != VK_SUCCESS) {
+            resource.view = VK_NULL_HANDLE;
+            error = std::string("render graph: failed to create a view of transient image ") + resource.name;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Biggest first, each at the lowest offset of the first compatible group where it doesn't overlap anything alive at
+// the same time. Lifetimes are ranges of live pass indices.
+void RenderGraph::place_transients() {
+    std::vector<ResourceId> order;
+    for (ResourceId id = 0; id < resources_.size(); id++) {
+        if (resources_[id].handle != VK_NULL_HANDLE && !resources_[id].imported) order.push_back(id);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](ResourceId a, ResourceId b) {
+        return resources_[a].memory_requirements.size > resources_[b].memory_requirements.size;
+    });
+
+    VkDeviceSize total_size = 0;
+    std::vector<ResourceId> placed;
+    for (const ResourceId id : order) {
+        Resource& resource = resources_[id];
+        const VkMemoryRequirements& requirements = resource.memory_requirements;
+        total_size += requirements.size;
+
+        uint32_t group_index = 0;
+        while (group_index < memory_groups_.size() && !(memory_groups_[group_index].memory_type_bits & requirements.memoryTypeBits)) {
+            group_index++;
+        }
+        if (group_index == memory_groups_.size()) {
+            memory_groups_.emplace_back();
+            memory_groups_.back().memory_type_bits = requirements.memoryTypeBits;
+        }
+        MemoryGroup& group = memory_groups_[group_index];
+
+        // Ranges taken by whatever in the group is alive at the same time, by offset
+        std::vector<std::pair<VkDeviceSize, VkDeviceSize>> taken;
+        for (const ResourceId other_id : placed) {
+            const Resource& other = resources_[other_id];
+            if (other.memory_group == group_index && other.first_pass <= resource.last_pass && resource.first_pass <= other.last_pass) {
+                taken.emplace_back(other.memory_offset, other.memory_offset + other.memory_requirements.size);
+            }
+        }
+        std::sort(taken.begin(), taken.end());
+        VkDeviceSize offset = 0;
+        for (const auto& range : taken) {
+            if (align_up(offset, requirements.alignment) + requirements.size <= range.first) break;
+            offset = std::max(offset, range.second);
+        }
+        offset = align_up(offset, requirements.alignment);
+
+        resource.memory_group = group_index;
+        resource.memory_offset = offset;
+        group.memory_type_bits &= requirements.memoryTypeBits;
+        group.alignment = std::max(group.alignment, requirements.alignment);
+        group.size = std::max(group.size, offset + requirements.size);
+        placed.push_back(id);
+    }
+
+    transient_bytes_ = 0;
+    for (const auto& group : memory_groups_) transient_bytes_ += group.size;
+    aliased_bytes_ = total_size - transient_bytes_;
+}
+
+RenderGraph::State RenderGraph::transient_initial_state(ResourceId id) const {
+    const Resource& resource = resources_[id];
+    const VkDeviceSize begin = resource.memory_offset;
+    const VkDeviceSize end = begin + resource.memory_requirements.size;
+
+    State state;
+    for (const auto& other : resources_) {
+        if (other.memory_group != resource.memory_group || other.memory_offset >= end ||
+            other.memory_offset + other.memory_requirements.size <= begin) {
+            continue;
+        }
+        // Every use, not just the last one: cheaper to find and the barrier is the same one either way
+        for (uint32_t i = other.first_pass; i <= other.last_pass; i++) {
+            if (!passes_[i].live) continue;
+            for (const auto& use : passes_[i].uses) {
+                if (&resources_[use.resource] != &other) continue;
+                const AccessInfo info = access_info(use.access, passes_[i].kind);
+                state.write_stages |= info.stages;
+                state.write_access |= info.access & WRITE_ACCESS;
+            }
+        }
+    }
+    return state;
+}
+
+bool RenderGraph::transition(const Resource& resource, State& state, ResourceAccess access, PassKind kind, Barrier& barrier) const {
+    const AccessInfo info = access_info(access, kind);
+    const bool layout_change = resource.image && info.layout != state.layout;
+
+    VkPipelineStageFlags src_stages = 0;
+    VkAccessFlags src_access = 0;
+    bool needed = layout_change;
+    if (info.write) {
+        // Write after write and write after read
+        src_stages = state.write_stages | state.read_stages;
+        src_access = state.write_access;
+        needed |= src_stages != 0;
+    } else {
+        const bool visible = (state.visible_stages & info.stages) == info.stages && (state.visible_access & info.access) == info.access;
+        if (state.write_stages != 0 && !visible) {
+            src_stages = state.write_stages;
+            src_access = state.write_access;
+            needed = true;
+        }
+        // A layout transition rewrites the image, whatever read it before has to be done first
+        if (layout_change) {
+            src_stages |= state.write_stages | state.read_stages;
+            src_access = state.write_access;
+        }
+    }
+
+    if (needed) {
+        barrier.src_stages |= src_stages != 0 ? src_stages : VkPipelineStageFlags(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+        barrier.dst_stages |= info.stages != 0 ? info.stages : VkPipelineStageFlags(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+        if (layout_change) {
+            barrier.images.push_back({ResourceId(&resource - resources_.data()), state.layout, info.layout, src_access, info.access});
+        } else if (src_access != 0) {
+            barrier.memory = true;
+            barrier.memory_src_access |= src_access;
+            barrier.memory_dst_access |= info.access;
+        }
+    }
+
+    if (info.write) {
+        state.write_stages = info.stages;
+        state.write_access = info.access & WRITE_ACCESS;
+        state.read_stages = 0;
+        state.visible_stages = 0;
+        state.visible_access = 0;
+    } else if (layout_change) {
+        // The transition is a write of its own, done before the barrier's second scope and visible to it only
+        state.write_stages = info.stages;
+        state.write_access = 0;
+        state.read_stages = info.stages;
+        state.visible_stages = info.stages;
+        state.visible_access = info.access;
+    } else {
+        state.read_stages |= info.stages;
+        if (needed) {
+            state.visible_stages |= info.stages;
+            state.visible_access |= info.access;
+        }
+    }
+    if (resource.image) state.layout = info.layout;
+    return needed;
+}
+
+bool RenderGraph::create_render_pass(uint32_t pass_index, std::vector<State>& states, std::vector<bool>& final_done, std::string& error) {
+    Pass& pass = passes_[pass_index];
+    std::vector<VkAttachmentDescription> attachments;
+    std::vector<VkAttachmentReference> color_references;
+    VkAttachmentReference depth_reference = {VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED};
+    Barrier dependency;
+
+    for (const auto& use : pass.uses) {
+        if (!use.attachment) continue;
+        const Resource& resource = resources_[use.resource];
+        State& state = states[use.resource];
+        const AccessInfo info = access_info(use.access, pass.kind);
+
+        VkAttachmentDescription description = {};
+        description.format = resource.format;
+        description.samples = VK_SAMPLE_COUNT_1_BIT;
+        const VkAttachmentLoadOp load_op = use.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR :
+            state.layout != VK_IMAGE_LAYOUT_UNDEFINED ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        // Nothing later reads what only this pass wrote
+        const VkAttachmentStoreOp store_op = resource.imported || resource.last_pass > pass_index ?
+            VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        const bool has_stencil = (aspect_mask(resource.format) & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+        description.loadOp = load_op;
+        description.storeOp = store_op;
+        description.stencilLoadOp = has_stencil ? load_op : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        description.stencilStoreOp = has_stencil ? store_op : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        description.initialLayout = state.layout;
+        description.finalLayout = info.layout;
+
+        transition(resource, state, use.access, pass.kind, dependency);
+
+        // An image presented after its last use leaves the render pass ready for it, the acquire/present semaphores
+        // do the rest. Any other final access needs the memory dependency of the final barrier.
+        if (resource.imported && resource.last_pass == pass_index && resource.final_access == ResourceAccess::PRESENT) {
+            description.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            state.layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            final_done[use.resource] = true;
+        }
+
+        const VkAttachmentReference reference = {uint32_t(attachments.size()), info.layout};
+        if (use.access == ResourceAccess::COLOR_ATTACHMENT) {
+            color_references.push_back(reference);
+        } else {
+            depth_reference = reference;
+        }
+        attachments.push_back(description);
+        pass.attachments.push_back(use.resource);
+        pass.clear_values.push_back(use.clear_value);
+        pass.extent = resource.extent;
+    }
+
+    VkSubpassDependency subpass_dependency = {};
+    subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    subpass_dependency.dstSubpass = 0;
+    if (!dependency.empty()) {
+        subpass_dependency.srcStageMask = dependency.src_stages;
+        subpass_dependency.dstStageMask = dependency.dst_stages;
+        subpass_dependency.srcAccessMask = dependency.memory_src_access;
+        subpass_dependency.dstAccessMask = dependency.memory_dst_access;
+        for (const auto& image : dependency.images) {
+            subpass_dependency.srcAccessMask |= image.src_access;
+            subpass_dependency.dstAccessMask |= image.dst_access;
+        }
+        barrier_count_++;
+    }
+
+    uint64_t key = fnv1a(attachments.data(), attachments.size() * sizeof(VkAttachmentDescription));
+    key = fnv1a(&subpass_dependency, sizeof(subpass_dependency), key);
+    const auto range = render_passes_.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        const CachedRenderPass& cached = it->second;
+        if (cached.attachments.size() == attachments.size() &&
+            memcmp(cached.attachments.data(), attachments.data(), attachments.size() * sizeof(VkAttachmentDescription)) == 0 &&
+            memcmp(&cached.dependency, &subpass_dependency, sizeof(subpass_dependency)) == 0) {
+            pass.render_pass = cached.render_pass;
+            return true;
+        }
+    }
+
+    VkSubpassDescription subpass_description = {};
+    subpass_description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass_description.colorAttachmentCount = uint32_t(color_references.size());
+    subpass_description.pColorAttachments = color_references.data();
+    subpass_description.pDepthStencilAttachment = depth_reference.attachment != VK_ATTACHMENT_UNUSED ? &depth_reference : nullptr;
+
+    VkRenderPassCreateInfo render_pass_create_info = {};
+    render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_create_info.attachmentCount = uint32_t(attachments.size());
+    render_pass_create_info.pAttachments = attachments.data();
+    render_pass_create_info.subpassCount = 1;
+    render_pass_create_info.pSubpasses = &subpass_description;
+    render_pass_create_info.dependencyCount = dependency.empty() ? 0 : 1;
+    render_pass_create_info.pDependencies = &subpass_dependency;
+    if (vkCreateRenderPass(device_, &render_pass_create_info, nullptr, &pass.render_pass) != VK_SUCCESS) {
+        pass.render_pass = VK_NULL_HANDLE;
+        error = std::string("render graph: failed to create the render pass of ") + pass.name;
+        return false;
+    }
+    render_passes_.emplace(key, CachedRenderPass{attachments, subpass_dependency, pass.render_pass});
+    return true;
+}
+
+bool RenderGraph::compile(std::string& error) {
+    if (!validate(error)) return false;
+    cull_passes();
+    if (!create_transients(error)) return false;
+
+    std::vector<State> states(resources_.size());
+    for (ResourceId id = 0; id < resources_.size(); id++) {
+        const Resource& resource = resources_[id];
+        if (!resource.imported) {
+            if (resource.memory_group != UINT32_MAX) states[id] = transient_initial_state(id);
+            continue;
+        }
+        // Whatever used it before the frame, the presentation engine through the acquire semaphore's wait stage
+        const AccessInfo info = access_info(resource.initial_access, PassKind::GRAPHICS);
+        const VkPipelineStageFlags stages = resource.initial_access == ResourceAccess::PRESENT ?
+            VkPipelineStageFlags(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT) : info.stages;
+        if (info.write) {
+            states[id].write_stages = stages;
+            states[id].write_access = info.access & WRITE_ACCESS;
+        } else {
+            states[id].read_stages = stages;
+        }
+    }
+
+    std::vector<bool> final_done(resources_.size());
+    for (uint32_t i = 0; i < passes_.size(); i++) {
+        Pass& pass = passes_[i];
+        if (!pass.live) continue;
+        for (const auto& use : pass.uses) {
+            if (!use.attachment) transition(resources_[use.resource], states[use.resource], use.access, pass.kind, pass.barrier);
+        }
+        if (!pass.barrier.empty()) barrier_count_++;
+        if (pass.kind == PassKind::GRAPHICS && !create_render_pass(i, states, final_done, error)) return false;
+    }
+
+    for (ResourceId id = 0; id < resources_.size(); id++) {
+        const Resource& resource = resources_[id];
+        if (resource.imported && resource.final_access != ResourceAccess::NONE && !final_done[id]) {
+            transition(resource, states[id], resource.final_access, PassKind::GRAPHICS, final_barrier_);
+        }
+    }
+    if (!final_barrier_.empty()) barrier_count_++;
+    return true;
+}
+
+VkRenderPass RenderGraph::render_pass(PassId pass) const {
+    return passes_[pass].render_pass;
+}
+
+bool RenderGraph::is_culled(PassId pass) const {
+    return !passes_[pass].live;
+}
+
+void RenderGraph::bind_image(ResourceId image, VkImage handle, VkImageView view) {
+    resources_[image].handle = handle;
+    resources_[image].view = view;
+}
+
+void RenderGraph::set_subpass_contents(PassId pass, VkSubpassContents contents) {
+    passes_[pass].contents = contents;
+}
+
+VkFramebuffer RenderGraph::framebuffer(Pass& pass) {
+    std::vector<VkImageView> views;
+    for (const ResourceId id : pass.attachments) views.push_back(resources_[id].view);
+    for (const auto& entry : pass.framebuffers) {
+        if (entry.first == views) return entry.second;
+    }
+
+    VkFramebufferCreateInfo framebuffer_create_info = {};
+    framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebuffer_create_info.renderPass = pass.render_pass;
+    framebuffer_create_info.attachmentCount = uint32_t(views.size());
+    framebuffer_create_info.pAttachments = views.data();
+    framebuffer_create_info.width = pass.extent.width;
+    framebuffer_create_info.height = pass.extent.height;
+    framebuffer_create_info.layers = 1;
+    VkFramebuffer framebuffer;
+    if (vkCreateFramebuffer(device_, &framebuffer_create_info, nullptr, &framebuffer) != VK_SUCCESS) return VK_NULL_HANDLE;
+    pass.framebuffers.emplace_back(std::move(views), framebuffer);
+    return framebuffer;
+}
+
+void RenderGraph::record_barrier(VkCommandBuffer command_buffer, const Barrier& barrier) const {
+    if (barrier.empty()) return;
+
+    std::vector<VkImageMemoryBarrier> image_barriers(barrier.images.size());
+    for (size_t i = 0; i < barrier.images.size(); i++) {
+        const ImageBarrier& image = barrier.images[i];
+        const Resource& resource = resources_[image.resource];
+        VkImageMemoryBarrier& image_barrier = image_barriers[i];
+        image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        image_barrier.srcAccessMask = image.src_access;
+        image_barrier.dstAccessMask = image.dst_access;
+        image_barrier.oldLayout = image.old_layout;
+        image_barrier.newLayout = image.new_layout;
+        image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.image = resource.handle;
+        image_barrier.subresourceRange = {aspect_mask(resource.format), 0, 1, 0, 1};
+    }
+
+    VkMemoryBarrier memory_barrier = {};
+    memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask = barrier.memory_src_access;
+    memory_barrier.dstAccessMask = barrier.memory_dst_access;
+    vkCmdPipelineBarrier(command_buffer, barrier.src_stages, barrier.dst_stages, 0, barrier.memory ? 1 : 0, &memory_barrier,
+        0, nullptr, uint32_t(image_barriers.size()), image_barriers.data());
+}
+
+void RenderGraph::execute(VkCommandBuffer command_buffer, Profiler* profiler) {
+    for (auto& pass : passes_) {
+        if (!pass.live) continue;
+        const uint32_t zone = profiler ? profiler->begin_gpu_zone(command_buffer, pass.name) : 0;
+        record_barrier(command_buffer, pass.barrier);
+
+        if (pass.kind == PassKind::GRAPHICS) {
+            const PassContext context = {pass.render_pass, framebuffer(pass), pass.extent};
+            VkRenderPassBeginInfo render_pass_begin_info = {};
+            render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            render_pass_begin_info.renderPass = context.render_pass;
+            render_pass_begin_info.framebuffer = context.framebuffer;
+            render_pass_begin_info.renderArea.extent = context.extent;
+            render_pass_begin_info.clearValueCount = uint32_t(pass.clear_values.size());
+            render_pass_begin_info.pClearValues = pass.clear_values.data();
+            vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, pass.contents);
+            pass.record(command_buffer, context);
+            vkCmdEndRenderPass(command_buffer);
+        } else {
+            pass.record(command_buffer, {});
+        }
+
+        if (profiler) profiler->end_gpu_zone(command_buffer, zone);
+    }
+    record_barrier(command_buffer, final_barrier_);
+}
+
+void RenderGraph::print_stats(std::ostream& stream) const {
+    const auto live = std::count_if(passes_.begin(), passes_.end(), [](const Pass& pass) { return pass.live; });
+    const auto transients = std::count_if(resources_.begin(), resources_.end(), [](const Resource& resource) {
+        return resource.memory_group != UINT32_MAX;
+    });
+    stream << "Render graph: " << live << " of " << passes_.size() << " passes live, " << barrier_count_
+        << " barriers and dependencies per frame, " << transients << " transient images in "
+        << transient_bytes_ / 1024 << " KiB (" << aliased_bytes_ / 1024 << " KiB saved by aliasing)\n";
+}
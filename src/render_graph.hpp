@@ -0,0 +1,244 @@
+#pragma once
+
+#include "device_memory_allocator.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Profiler;
+
+// How a pass uses a resource. Each one implies the pipeline stages, access flags and, for images, the layout.
+// Shader accesses happen in the vertex and fragment stages of graphics passes and in the compute stage otherwise.
+enum class ResourceAccess : uint8_t
+{
+    NONE,
+    COLOR_ATTACHMENT,
+    DEPTH_ATTACHMENT,
+    DEPTH_READ,
+    SAMPLED,
+    STORAGE_READ,
+    STORAGE_WRITE,
+    UNIFORM_READ,
+    VERTEX_READ,
+    INDEX_READ,
+    INDIRECT_READ,
+    TRANSFER_READ,
+    TRANSFER_WRITE,
+    HOST_READ,
+    // Swap chain images: the presentation engine's use before acquire and after present
+    PRESENT,
+};
+
+enum class PassKind : uint8_t
+{
+    GRAPHICS,
+    COMPUTE,
+    TRANSFER,
+};
+
+// A frame described as passes that declare what they read and write. compile() turns the declarations into:
+//  - the passes that contribute to an output, the others are culled: an output is an imported resource with a final
+//    access, or anything written by a pass marked keep()
+//  - one VkRenderPass per graphics pass, attachments transitioned by its layouts and synchronized by its external
+//    dependency, load and store ops derived from whether the contents are needed before and after
+//  - a single vkCmdPipelineBarrier per pass for everything else, and only where a hazard or a layout change exists.
+//    Buffers get global memory barriers, they're never transitioned.
+//  - transient images (create_image()) placed in shared memory: images whose lifetimes don't overlap share bytes
+// Execution order is declaration order. Imported images start every frame undefined, their previous contents are
+// discarded. Pass names are kept as pointers and show up as GPU profiler zones, use literals.
+class RenderGraph
+{
+public:
+    using ResourceId = uint32_t;
+    using PassId = uint32_t;
+
+    // What a graphics pass records into, for secondary command buffers' inheritance info
+    struct PassContext
+    {
+        VkRenderPass render_pass = VK_NULL_HANDLE;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+        VkExtent2D extent = {};
+    };
+    using Record = std::function<void(VkCommandBuffer command_buffer, const PassContext& context)>;
+    // Takes ownership of objects that frames in flight may still use
+    using Retire = std::function<void(std::function<void()> deleter)>;
+
+    void init(VkDevice device, DeviceMemoryAllocator& allocator);
+    // Destroys everything, cached render passes included. The device must be idle.
+    void destroy();
+
+    // Starts a new declaration. The compiled objects of the previous one go to retire, render passes stay cached.
+    void reset(const Retire& retire);
+
+    // Bound every frame with bind_image(). initial_access is the use before the frame starts, final_access the one it
+    // has to be ready for once the frame ends.
+    ResourceId import_image(const char* name, VkFormat format, VkExtent2D extent, ResourceAccess initial_access,
+                            ResourceAccess final_access);
+    // Buffers are only tracked for synchronization, nothing needs binding
+    ResourceId import_buffer(const char* name, ResourceAccess initial_access, ResourceAccess final_access);
+    // Owned by the graph, with the usage flags its accesses need
+    ResourceId create_image(const char* name, VkFormat format, VkExtent2D extent);
+
+    PassId add_pass(const char* name, PassKind kind, Record record);
+    // Never culled, for passes with effects the graph doesn't see
+    void keep(PassId pass);
+    // clear is null to load the previous contents, or not care about them when there are none
+    void color_attachment(PassId pass, ResourceId image, const VkClearColorValue* clear = nullptr);
+    void depth_attachment(PassId pass, ResourceId image, const VkClearDepthStencilValue* clear = nullptr, bool read_only = false);
+    void use(PassId pass, ResourceId resource, ResourceAccess access);
+
+    // False with the reason in error for an inconsistent declaration or a failed Vulkan call
+    bool compile(std::string& error);
+
+    // Valid after compile() for live graphics passes, null otherwise
+    VkRenderPass render_pass(PassId pass) const;
+    bool is_culled(PassId pass) const;
+
+    // Per frame, before execute()
+    void bind_image(ResourceId image, VkImage handle, VkImageView view);
+    void set_subpass_contents(PassId pass, VkSubpassContents contents);
+    // Records every live pass with its barriers, each pass in a GPU zone of its own if there is a profiler
+    void execute(VkCommandBuffer command_buffer, Profiler* profiler = nullptr);
+
+    void print_stats(std::ostream& stream) const;
+
+private:
+    struct Resource
+    {
+        const char* name;
+        bool image;
+        bool imported;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent = {};
+        ResourceAccess initial_access = ResourceAccess::NONE;
+        ResourceAccess final_access = ResourceAccess::NONE;
+
+        // Derived by compile()
+        VkImageUsageFlags usage = 0;
+        uint32_t first_pass = UINT32_MAX;
+        uint32_t last_pass = 0;
+        // Transient images: where they live in their memory group
+        uint32_t memory_group = UINT32_MAX;
+        VkDeviceSize memory_offset = 0;
+        VkMemoryRequirements memory_requirements = {};
+
+        VkImage handle = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+    };
+
+    struct Use
+    {
+        ResourceId resource;
+        ResourceAccess access;
+        bool attachment;
+        bool clear;
+        VkClearValue clear_value;
+    };
+
+    struct ImageBarrier
+    {
+        ResourceId resource;
+        VkImageLayout old_layout;
+        VkImageLayout new_layout;
+        VkAccessFlags src_access;
+        VkAccessFlags dst_access;
+    };
+
+    // Everything one vkCmdPipelineBarrier does
+    struct Barrier
+    {
+        VkPipelineStageFlags src_stages = 0;
+        VkPipelineStageFlags dst_stages = 0;
+        VkAccessFlags memory_src_access = 0;
+        VkAccessFlags memory_dst_access = 0;
+        bool memory = false;
+        std::vector<ImageBarrier> images;
+
+        // An execution dependency alone is still a barrier
+        bool empty() const { return src_stages == 0; }
+    };
+
+    struct Pass
+    {
+        const char* name;
+        PassKind kind;
+        Record record;
+        bool keep = false;
+        std::vector<Use> uses;
+
+        // Derived by compile()
+        bool live = false;
+        Barrier barrier;
+        VkRenderPass render_pass = VK_NULL_HANDLE;
+        std::vector<ResourceId> attachments;
+        std::vector<VkClearValue> clear_values;
+        VkExtent2D extent = {};
+        VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE;
+        // By attachment views, imported images change from frame to frame
+        std::vector<std::pair<std::vector<VkImageView>, VkFramebuffer>> framebuffers;
+    };
+
+    // Synchronization state of a resource while compile() walks the passes
+    struct State
+    {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags write_stages = 0;
+        VkAccessFlags write_access = 0;
+        VkPipelineStageFlags read_stages = 0;
+        // Stages and accesses the last write has been made visible to
+        VkPipelineStageFlags visible_stages = 0;
+        VkAccessFlags visible_access = 0;
+    };
+
+    struct MemoryGroup
+    {
+        uint32_t memory_type_bits = 0;
+        VkDeviceSize alignment = 1;
+        VkDeviceSize size = 0;
+        Allocation allocation;
+    };
+
+    bool validate(std::string& error) const;
+    void cull_passes();
+    bool create_transients(std::string& error);
+    void place_transients();
+    // First use of a transient waits for every access to memory it shares, its own last frame's included
+    State transient_initial_state(ResourceId resource) const;
+    // Adds what taking resource from state to access needs to barrier, false if nothing does
+    bool transition(const Resource& resource, State& state, ResourceAccess access, PassKind kind, Barrier& barrier) const;
+    // Attachments of a live graphics pass: descriptions from their states, the external dependency from what the
+    // transitions would have needed. final_done marks imported images whose final layout the pass leaves them in.
+    bool create_render_pass(uint32_t pass_index, std::vector<State>& states, std::vector<bool>& final_done, std::string& error);
+    VkFramebuffer framebuffer(Pass& pass);
+    void record_barrier(VkCommandBuffer command_buffer, const Barrier& barrier) const;
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    DeviceMemoryAllocator* allocator_ = nullptr;
+
+    std::vector<Resource> resources_;
+    std::vector<Pass> passes_;
+    // Imported images' transitions after the last pass
+    Barrier final_barrier_;
+    std::vector<MemoryGroup> memory_groups_;
+
+    // By a hash of their create info, so rebuilding an identical graph hands out the very same render passes and
+    // pipelines built against them stay valid
+    struct CachedRenderPass
+    {
+        std::vector<VkAttachmentDescription> attachments;
+        VkSubpassDependency dependency;
+        VkRenderPass render_pass;
+    };
+    std::unordered_multimap<uint64_t, CachedRenderPass> render_passes_;
+
+    uint32_t barrier_count_ = 0;
+    VkDeviceSize transient_bytes_ = 0;
+    VkDeviceSize aliased_bytes_ = 0;
+};
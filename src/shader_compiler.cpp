@@ -0,0 +1,126 @@
+#include "shader_compiler.hpp"
+
+#include "hash.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+    bool read_file(const std::string& path, std::string& contents) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // Anything that isn't a whole number of words starting with the magic number is treated as a miss
+    bool read_spirv(const std::string& path, std::vector<uint32_t>& spirv) {
+        std::string contents;
+        if (!read_file(path, contents) || contents.size() < sizeof(uint32_t) || contents.size() % sizeof(uint32_t) != 0) {
+            return false;
+        }
+        spirv.resize(contents.size() / sizeof(uint32_t));
+        memcpy(spirv.data(), contents.data(), contents.size());
+        return spirv[0] == SPIRV_MAGIC;
+    }
+
+    // Every field ends in a separator, so {"ab", "c"} and {"a", "bc"} differ
+    uint64_t hash_field(uint64_t hash, const std::string& field) {
+        const uint8_t separator = 0xff;
+        return fnv1a(&separator, 1, fnv1a(field.data(), field.size(), hash));
+    }
+
+    std::string shell_quoted(const std::string& argument) {
+        return "\"" + argument + "\"";
+    }
+}
+
+uint64_t shader_cache_key(const std::string& extension, const std::vector<std::string>& defines, const std::string& source) {
+    uint64_t hash = hash_field(FNV1A_OFFSET_BASIS, extension);
+    for (const auto& define : defines) hash = hash_field(hash, define);
+    return hash_field(hash, source);
+}
+
+void ShaderCompiler::init(const std::string& compiler_path, const std::string& cache_directory) {
+    compiler_path_ = compiler_path;
+    cache_directory_ = cache_directory;
+    if (!cache_directory_.empty()) {
+        std::error_code ignored;
+        std::filesystem::create_directories(cache_directory_, ignored);
+    }
+}
+
+bool ShaderCompiler::compile(const std::string& source_path, const std::vector<std::string>& defines,
+                             std::vector<uint32_t>& spirv, std::string& error) {
+    std::string source;
+    if (!read_file(source_path, source)) {
+        error = "can't read " + source_path;
+        return false;
+    }
+
+    const std::string extension = std::filesystem::path(source_path).extension().string();
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(shader_cache_key(extension, defines, source)));
+    const std::string cache_path = cache_directory_.empty() ? std::string() : cache_directory_ + "/" + key + ".spv";
+    if (!cache_path.empty() && read_spirv(cache_path, spirv)) {
+        cache_hits_++;
+        return true;
+    }
+
+    if (compiler_path_.empty()) {
+        error = "no shader compiler to build " + source_path + " with";
+        return false;
+    }
+
+    // Same write-then-rename as the pipeline cache, a reader must never see a half written module
+    const std::string temporary_directory = cache_directory_.empty() ?
+        std::filesystem::temp_directory_path().string() : cache_directory_;
+    const std::string temporary_path = temporary_directory + "/" + key + "." + std::to_string(next_temporary_++) + ".tmp";
+    if (!run_compiler(source_path, defines, temporary_path, error)) {
+        std::remove(temporary_path.c_str());
+        return false;
+    }
+    if (!read_spirv(temporary_path, spirv)) {
+        std::remove(temporary_path.c_str());
+        error = "the compiler wrote no valid SPIR-V for " + source_path;
+        return false;
+    }
+    compilations_++;
+
+    if (cache_path.empty()) {
+        std::remove(temporary_path.c_str());
+    } else {
+        // Another thread may have compiled the same key meanwhile, either copy is fine
+        std::remove(cache_path.c_str());
+        if (std::rename(temporary_path.c_str(), cache_path.c_str()) != 0) std::remove(temporary_path.c_str());
+    }
+    return true;
+}
+
+bool ShaderCompiler::run_compiler(const std::string& source_path, const std::vector<std::string>& defines,
+                                  const std::string& output_path, std::string& error) {
+    const std::string log_path = output_path + ".log";
+    std::string command = shell_quoted(compiler_path_) + " -V " + shell_quoted(source_path);
+    for (const auto& define : defines) command += " " + shell_quoted("-D" + define);
+    command += " -o " + shell_quoted(output_path) + " > " + shell_quoted(log_path) + " 2>&1";
+#ifdef _WIN32
+    // cmd.exe strips the outer quotes of a command line that starts with one
+    command = "\"" + command + "\"";
+#endif
+
+    const int status = std::system(command.c_str());
+    if (status != 0) {
+        std::string log;
+        read_file(log_path, log);
+        error = source_path + " failed to compile:\n" + log;
+    }
+    std::remove(log_path.c_str());
+    return status == 0;
+}
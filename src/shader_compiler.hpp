@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GLSL to SPIR-V at runtime, by running glslangValidator on the source file. The stage comes from the file extension
+// (.vert, .frag, .comp, ...) like it does for the build step. Results land in an on-disk cache as <key>.spv, the key
+// being a hash of the extension, the defines and the source text, so an unchanged shader costs one file read and never
+// starts the compiler. Sources pulling in other files with #include aren't supported, their changes wouldn't reach the
+// key.
+// compile() is safe to call from several threads at once.
+class ShaderCompiler
+{
+public:
+    // An empty cache_directory disables the cache
+    void init(const std::string& compiler_path, const std::string& cache_directory);
+
+    // Fills spirv, or error with what went wrong - the compiler's output for a broken shader
+    bool compile(const std::string& source_path, const std::vector<std::string>& defines, std::vector<uint32_t>& spirv,
+                 std::string& error);
+
+    uint32_t cache_hits() const { return cache_hits_; }
+    uint32_t compilations() const { return compilations_; }
+
+private:
+    bool run_compiler(const std::string& source_path, const std::vector<std::string>& defines,
+                      const std::string& output_path, std::string& error);
+
+    std::string compiler_path_;
+    std::string cache_directory_;
+    std::atomic<uint32_t> cache_hits_{0};
+    std::atomic<uint32_t> compilations_{0};
+    // Keeps the temporary files of concurrent compilations apart
+    std::atomic<uint32_t> next_temporary_{0};
+};
+
+// Cache key of a shader, a hash of everything that changes the SPIR-V
+uint64_t shader_cache_key(const std::string& extension, const std::vector<std::string>& defines, const std::string& source);
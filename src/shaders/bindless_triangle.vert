@@ -0,0 +1,33 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : enable
+
+// Same as sp_triangle.vert, but the uniform block is read from the bindless table (bindless_table.hpp): the push
+// constants say which buffer holds it and where it starts, so draws never rebind descriptors
+layout(set = 0, binding = 0) readonly buffer UniformBlocks {
+    vec4 data[];
+} buffers[];
+
+layout(push_constant) uniform DrawIndices {
+    uint uniform_buffer;
+    // In vec4s from the start of the buffer, the block is {mat4 model; mat4 view; mat4 proj;}
+    uint uniform_offset;
+} draw;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+mat4 load_mat4(uint offset) {
+    return mat4(buffers[draw.uniform_buffer].data[offset], buffers[draw.uniform_buffer].data[offset + 1],
+                buffers[draw.uniform_buffer].data[offset + 2], buffers[draw.uniform_buffer].data[offset + 3]);
+}
+
+void main() {
+    mat4 model = load_mat4(draw.uniform_offset);
+    mat4 view = load_mat4(draw.uniform_offset + 4);
+    mat4 proj = load_mat4(draw.uniform_offset + 8);
+    gl_Position = proj * view * model * vec4(inPosition, 1.0);
+    fragColor = inColor;
+}
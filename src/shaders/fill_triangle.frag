@@ -1,10 +1,29 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// Material feature toggles, one pipeline variant per combination (pipeline_variants.hpp). The defaults are the plain
+// vertex colored material.
+layout(constant_id = 0) const bool VERTEX_COLOR = true;
+layout(constant_id = 1) const bool GRAYSCALE = false;
+layout(constant_id = 2) const bool CHECKER = false;
+// 0 disables posterization
+layout(constant_id = 3) const uint POSTERIZE_LEVELS = 0;
+
 layout(location = 0) in vec3 fragColor;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+    vec3 color = VERTEX_COLOR ? fragColor : vec3(1.0);
+    if (CHECKER) {
+        ivec2 cell = ivec2(gl_FragCoord.xy) / 8;
+        if (((cell.x + cell.y) & 1) == 1) color *= 0.5;
+    }
+    if (GRAYSCALE) {
+        color = vec3(dot(color, vec3(0.299, 0.587, 0.114)));
+    }
+    if (POSTERIZE_LEVELS > 0u) {
+        color = floor(color * float(POSTERIZE_LEVELS)) / float(POSTERIZE_LEVELS);
+    }
+    outColor = vec4(color, 1.0);
+}
@@ -0,0 +1,23 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Same as sp_triangle.vert, but the model matrix and a color tint come from a per-instance vertex stream instead of
+// the uniform block, so one draw can cover any number of objects
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+// A mat4 attribute takes four consecutive locations, 2 to 5
+layout(location = 2) in mat4 inInstanceModel;
+layout(location = 6) in vec4 inInstanceColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = ubo.proj * ubo.view * inInstanceModel * vec4(inPosition, 1.0);
+    fragColor = inColor * inInstanceColor.rgb;
+}
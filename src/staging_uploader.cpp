@@ -0,0 +1,217 @@
+#include "staging_uploader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+bool StagingUploader::init(VkDevice device, DeviceMemoryAllocator& allocator, uint32_t queue_family, VkQueue queue,
+                           VkDeviceSize staging_capacity, bool timeline) {
+    device_ = device;
+    queue_ = queue;
+    capacity_ = staging_capacity;
+    // vkCmdCopyBuffer itself has no alignment requirements, but drivers copy faster from aligned sources
+    alignment_ = std::max<VkDeviceSize>(allocator.limits().optimalBufferCopyOffsetAlignment, 4);
+
+    VkCommandPoolCreateInfo command_pool_create_info = {};
+    command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    command_pool_create_info.queueFamilyIndex = queue_family;
+    command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    if (vkCreateCommandPool(device_, &command_pool_create_info, nullptr, &command_pool_) != VK_SUCCESS) return false;
+    if (timeline && !timeline_.init(device_)) return false;
+
+    VkBufferCreateInfo buffer_create_info = {};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size = capacity_;
+    buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    return allocator.create_buffer(buffer_create_info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        staging_buffer_, staging_allocation_) == VK_SUCCESS;
+}
+
+void StagingUploader::destroy(DeviceMemoryAllocator& allocator) {
+    wait(flush());
+
+    for (const auto& batch : free_batches_) {
+        vkDestroyFence(device_, batch.fence, nullptr);
+    }
+    free_batches_.clear();
+    if (timeline_.handle() != VK_NULL_HANDLE) timeline_.destroy();
+
+    // Destroying the pool frees the command buffers
+    vkDestroyCommandPool(device_, command_pool_, nullptr);
+    allocator.destroy_buffer(staging_buffer_, staging_allocation_);
+}
+
+bool StagingUploader::upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Anything bigger than half the ring goes in pieces, so a huge upload can't deadlock waiting for space
+    const VkDeviceSize max_chunk = capacity_ / 2;
+    const auto* bytes = static_cast<const char*>(data);
+
+    while (size > 0) {
+        const VkDeviceSize chunk = std::min(size, max_chunk);
+        VkDeviceSize staging_offset;
+        if (!allocate_staging(chunk, staging_offset)) return false;
+
+        memcpy(static_cast<char*>(staging_allocation_.mapped) + staging_offset, bytes, chunk);
+
+        VkBufferCopy copy_region = {};
+        copy_region.srcOffset = staging_offset;
+        copy_region.dstOffset = dst_offset;
+        copy_region.size = chunk;
+        pending_copies_[dst].push_back(copy_region);
+
+        bytes += chunk;
+        dst_offset += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+bool StagingUploader::allocate_staging(VkDeviceSize size, VkDeviceSize& offset) {
+    for (;;) {
+        if (used_ == 0) head_ = 0;
+
+        VkDeviceSize aligned = align_up(head_, alignment_);
+        VkDeviceSize consumed = aligned + size - head_;
+        if (aligned + size > capacity_) {
+            // Doesn't fit before the end, skip the tail of the ring and start over at 0
+            aligned = 0;
+            consumed = capacity_ - head_ + size;
+        }
+
+        if (used_ + consumed <= capacity_) {
+            offset = aligned;
+            head_ = aligned + size;
+            used_ += consumed;
+            pending_staging_bytes_ += consumed;
+            return true;
+        }
+
+        retire_completed_batches();
+        if (used_ + consumed <= capacity_) continue;
+
+        // Still full: whatever is pending has to go out so its space can eventually be reclaimed
+        if (!pending_copies_.empty()) flush_locked();
+        if (in_flight_.empty()) return false;
+        wait_oldest_batch();
+    }
+}
+
+bool StagingUploader::acquire_batch_objects(Batch& batch) {
+    if (!free_batches_.empty()) {
+        batch = free_batches_.back();
+        free_batches_.pop_back();
+        if (batch.fence != VK_NULL_HANDLE) vkResetFences(device_, 1, &batch.fence);
+        return true;
+    }
+
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {};
+    command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_allocate_info.commandPool = command_pool_;
+    command_buffer_allocate_info.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device_, &command_buffer_allocate_info, &batch.command_buffer) != VK_SUCCESS) return false;
+    if (timeline_.handle() != VK_NULL_HANDLE) return true;
+
+    VkFenceCreateInfo fence_create_info = {};
+    fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    return vkCreateFence(device_, &fence_create_info, nullptr, &batch.fence) == VK_SUCCESS;
+}
+
+StagingUploader::Ticket StagingUploader::flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return flush_locked();
+}
+
+StagingUploader::Ticket StagingUploader::flush_locked() {
+    if (pending_copies_.empty()) return next_ticket_ - 1;
+
+    Batch batch;
+    if (!acquire_batch_objects(batch)) return next_ticket_ - 1;
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {};
+    command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(batch.command_buffer, &command_buffer_begin_info);
+
+    for (const auto& [dst, regions] : pending_copies_) {
+        vkCmdCopyBuffer(batch.command_buffer, staging_buffer_, dst, uint32_t(regions.size()), regions.data());
+    }
+
+    vkEndCommandBuffer(batch.command_buffer);
+
+    batch.staging_bytes = pending_staging_bytes_;
+    batch.ticket = next_ticket_++;
+
+    const VkSemaphore timeline = timeline_.handle();
+    VkTimelineSemaphoreSubmitInfo timeline_submit_info = {};
+    timeline_submit_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_submit_info.signalSemaphoreValueCount = 1;
+    timeline_submit_info.pSignalSemaphoreValues = &batch.ticket;
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &batch.command_buffer;
+    if (timeline != VK_NULL_HANDLE) {
+        submit_info.pNext = &timeline_submit_info;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &timeline;
+    }
+    vkQueueSubmit(queue_, 1, &submit_info, batch.fence);
+    in_flight_.push_back(batch);
+
+    pending_copies_.clear();
+    pending_staging_bytes_ = 0;
+    return batch.ticket;
+}
+
+void StagingUploader::retire_completed_batches() {
+    // Batches are retired strictly in submission order, that keeps the ring accounting a simple FIFO
+    while (!in_flight_.empty() && is_batch_complete(in_flight_.front())) {
+        const Batch& batch = in_flight_.front();
+        used_ -= batch.staging_bytes;
+        completed_ticket_ = batch.ticket;
+        free_batches_.push_back(batch);
+        in_flight_.pop_front();
+    }
+}
+
+bool StagingUploader::is_batch_complete(const Batch& batch) const {
+    if (batch.fence == VK_NULL_HANDLE) return timeline_.value() >= batch.ticket;
+    return vkGetFenceStatus(device_, batch.fence) == VK_SUCCESS;
+}
+
+void StagingUploader::wait_oldest_batch() {
+    const Batch& batch = in_flight_.front();
+    if (batch.fence == VK_NULL_HANDLE) {
+        timeline_.wait(batch.ticket);
+    } else {
+        vkWaitForFences(device_, 1, &batch.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
+    retire_completed_batches();
+}
+
+bool StagingUploader::is_complete(Ticket ticket) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    retire_completed_batches();
+    return ticket <= completed_ticket_;
+}
+
+void StagingUploader::wait(Ticket ticket) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    retire_completed_batches();
+    while (ticket > completed_ticket_ && !in_flight_.empty()) {
+        wait_oldest_batch();
+    }
+}
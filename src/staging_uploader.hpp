@@ -0,0 +1,80 @@
+#pragma once
+
+#include "device_memory_allocator.hpp"
+#include "frame_sync.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Batches buffer uploads through a reusable, persistently mapped staging ring. Copies queued with upload_buffer()
+// are recorded into a single command buffer and submitted together by flush(), preferably on a transfer-only queue.
+// Completion is tracked per batch, staging space is recycled as batches retire. With timeline semaphores each batch
+// signals its ticket on one semaphore, which other queues can wait on instead of the CPU; without, each batch has a
+// fence. upload_buffer() and flush() may be called from several threads.
+class StagingUploader
+{
+public:
+    using Ticket = uint64_t;
+
+    bool init(VkDevice device, DeviceMemoryAllocator& allocator, uint32_t queue_family, VkQueue queue, VkDeviceSize staging_capacity,
+              bool timeline);
+    void destroy(DeviceMemoryAllocator& allocator);
+
+    // Copies data into staging memory right away, the copy into dst happens with the next flush(). Only blocks when
+    // the staging ring is full, in which case the oldest batch is waited for.
+    bool upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size);
+
+    // Submits everything queued so far as one batch. The returned ticket is signaled once the batch has executed.
+    Ticket flush();
+
+    bool is_complete(Ticket ticket);
+    void wait(Ticket ticket);
+    // Reaches a ticket's value once its batch has executed, null without timeline semaphores
+    VkSemaphore timeline() const { return timeline_.handle(); }
+
+private:
+    struct Batch
+    {
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        // Null with timeline semaphores
+        VkFence fence = VK_NULL_HANDLE;
+        VkDeviceSize staging_bytes = 0;
+        Ticket ticket = 0;
+    };
+
+    bool allocate_staging(VkDeviceSize size, VkDeviceSize& offset);
+    Ticket flush_locked();
+    void retire_completed_batches();
+    void wait_oldest_batch();
+    bool acquire_batch_objects(Batch& batch);
+    bool is_batch_complete(const Batch& batch) const;
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkQueue queue_ = VK_NULL_HANDLE;
+    VkCommandPool command_pool_ = VK_NULL_HANDLE;
+    TimelineSemaphore timeline_;
+
+    VkBuffer staging_buffer_ = VK_NULL_HANDLE;
+    Allocation staging_allocation_;
+    VkDeviceSize capacity_ = 0;
+    VkDeviceSize alignment_ = 4;
+    VkDeviceSize head_ = 0;
+    // Bytes between the oldest in-flight batch and head_, wrap-around padding included
+    VkDeviceSize used_ = 0;
+
+    // Copies recorded since the last flush, grouped by destination so each buffer costs a single vkCmdCopyBuffer
+    std::unordered_map<VkBuffer, std::vector<VkBufferCopy>> pending_copies_;
+    VkDeviceSize pending_staging_bytes_ = 0;
+
+    std::deque<Batch> in_flight_;
+    std::vector<Batch> free_batches_;
+    Ticket next_ticket_ = 1;
+    Ticket completed_ticket_ = 0;
+
+    std::mutex mutex_;
+};
@@ -0,0 +1,142 @@
+#include "tests.hpp"
+
+#include "mesh_cache.hpp"
+
+#include <glm/common.hpp>
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::string temporary_path(const char* name) {
+        return (std::filesystem::temp_directory_path() / (std::string("vulkan_tutorial_tests_") + name + ".vmesh")).string();
+    }
+
+    std::vector<char> read_file(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    void write_file(const std::string& path, const std::vector<char>& bytes) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), std::streamsize(bytes.size()));
+    }
+
+    // A small strip of quads with odd values in every component, so any byte out of place shows
+    MeshData make_mesh(MeshIndexType index_type, MeshInfo& info) {
+        MeshData mesh;
+        mesh.index_type = index_type;
+        const uint32_t quad_count = 5;
+        for (uint32_t q = 0; q <= quad_count; q++) {
+            for (uint32_t side = 0; side < 2; side++) {
+                MeshVertex vertex;
+                vertex.position = glm::vec3(0.37f * float(q), side ? 1.25f : -1.25f, 0.001f * float(q * q));
+                vertex.color = glm::vec3(float(q) / quad_count, float(side), 1.f / 3.f);
+                mesh.vertices.push_back(vertex);
+            }
+        }
+        for (uint32_t q = 0; q < quad_count; q++) {
+            const uint32_t first = 2 * q;
+            for (const uint32_t corner : {0u, 1u, 2u, 2u, 1u, 3u}) mesh.indices.push_back(first + corner);
+        }
+
+        info.vertex_count = uint32_t(mesh.vertices.size());
+        info.index_count = uint32_t(mesh.indices.size());
+        info.index_type = index_type;
+        info.bounds_min = info.bounds_max = mesh.vertices[0].position;
+        for (const auto& vertex : mesh.vertices) {
+            info.bounds_min = glm::min(info.bounds_min, vertex.position);
+            info.bounds_max = glm::max(info.bounds_max, vertex.position);
+        }
+        return mesh;
+    }
+
+    bool round_trip(MeshIndexType index_type) {
+        bool passed = true;
+        MeshInfo expected_info;
+        const MeshData expected = make_mesh(index_type, expected_info);
+        const std::string path = temporary_path(index_type == MeshIndexType::UINT16 ? "round_trip_16" : "round_trip_32");
+
+        std::string error;
+        CHECK(write_vmesh(path, expected, expected_info, error));
+
+        JobSystem job_system;
+        MeshData mesh;
+        MeshInfo info;
+        const bool loaded = load_mesh(path, job_system, mesh, info, error);
+        CHECK(loaded);
+        if (!loaded) std::cerr << error << "\n";
+
+        CHECK(mesh.vertices.size() == expected.vertices.size());
+        CHECK(mesh.vertices.size() == expected.vertices.size() &&
+              memcmp(mesh.vertices.data(), expected.vertices.data(), mesh.vertices.size() * sizeof(MeshVertex)) == 0);
+        CHECK(mesh.indices == expected.indices);
+        CHECK(mesh.index_type == index_type);
+        CHECK(info.index_type == index_type);
+        CHECK(info.vertex_count == expected_info.vertex_count);
+        CHECK(info.index_count == expected_info.index_count);
+        CHECK(memcmp(&info.bounds_min, &expected_info.bounds_min, sizeof(glm::vec3)) == 0);
+        CHECK(memcmp(&info.bounds_max, &expected_info.bounds_max, sizeof(glm::vec3)) == 0);
+
+        std::filesystem::remove(path);
+        return passed;
+    }
+
+    // Writes a valid file, lets corrupt() damage its bytes and expects load_mesh() to turn it down
+    template <typename Corrupt>
+    bool rejects(const char* name, Corrupt corrupt) {
+        bool passed = true;
+        MeshInfo info;
+        const MeshData source = make_mesh(MeshIndexType::UINT16, info);
+        const std::string path = temporary_path(name);
+
+        std::string error;
+        CHECK(write_vmesh(path, source, info, error));
+        std::vector<char> bytes = read_file(path);
+        corrupt(bytes);
+        write_file(path, bytes);
+
+        JobSystem job_system;
+        MeshData mesh;
+        MeshInfo loaded_info;
+        CHECK(!load_mesh(path, job_system, mesh, loaded_info, error));
+        CHECK(!error.empty());
+
+        std::filesystem::remove(path);
+        if (!passed) std::cerr << "  in case " << name << "\n";
+        return passed;
+    }
+
+    void set_header_field(std::vector<char>& bytes, size_t offset, uint64_t value) {
+        memcpy(bytes.data() + offset, &value, sizeof(value));
+    }
+
+    // Aligned like a real blob offset, and large enough that adding a blob length to it wraps around
+    constexpr uint64_t WRAPPING_OFFSET = std::numeric_limits<uint64_t>::max() - (VMESH_BLOB_ALIGNMENT - 1);
+}
+
+bool run_mesh_cache_tests() {
+    bool passed = round_trip(MeshIndexType::UINT16);
+    passed = round_trip(MeshIndexType::UINT32) && passed;
+
+    passed = rejects("truncated_header", [](std::vector<char>& bytes) {
+        bytes.resize(sizeof(VMeshHeader) - 8);
+    }) && passed;
+    passed = rejects("truncated_blobs", [](std::vector<char>& bytes) {
+        bytes.resize(bytes.size() - 1);
+    }) && passed;
+    passed = rejects("wrapping_vertex_offset", [](std::vector<char>& bytes) {
+        set_header_field(bytes, offsetof(VMeshHeader, vertex_offset), WRAPPING_OFFSET);
+    }) && passed;
+    passed = rejects("wrapping_index_offset", [](std::vector<char>& bytes) {
+        set_header_field(bytes, offsetof(VMeshHeader, index_offset), WRAPPING_OFFSET);
+    }) && passed;
+    return passed;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <iostream>
+
+// Just enough of a test harness for CTest: every group is a function returning whether all of its checks passed, run
+// by tests_main.cpp when its name is given on the command line. CHECK clears a `bool passed` the test keeps in scope
+// and carries on, so one run shows every broken case.
+#define CHECK(condition)                                                                                    \
+    do {                                                                                                    \
+        if (!(condition)) {                                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n";                 \
+            passed = false;                                                                                 \
+        }                                                                                                   \
+    } while (false)
+
+bool run_mesh_cache_tests();
+bool run_transform_tests();
@@ -0,0 +1,27 @@
+#include "tests.hpp"
+
+#include <cstring>
+
+// vulkan_tutorial_tests GROUP, exits with 0 when every check of the group passed
+int main(int argc, char** argv) {
+    struct Group
+    {
+        const char* name;
+        bool (*run)();
+    };
+    const Group groups[] = {
+        {"mesh_cache", run_mesh_cache_tests},
+        {"transforms", run_transform_tests},
+    };
+
+    if (argc == 2) {
+        for (const auto& group : groups) {
+            if (strcmp(argv[1], group.name) == 0) return group.run() ? 0 : 1;
+        }
+    }
+
+    std::cerr << "Usage: " << argv[0] << " GROUP, one of:";
+    for (const auto& group : groups) std::cerr << " " << group.name;
+    std::cerr << "\n";
+    return 2;
+}
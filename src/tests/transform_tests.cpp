@@ -0,0 +1,162 @@
+#include "tests.hpp"
+
+#include "transform_system.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // Absolute error for elements up to 1, relative above that
+    constexpr float TOLERANCE = 1e-4f;
+
+    struct TransformScene
+    {
+        TransformStore store;
+        TransformBatch batch;
+        std::vector<glm::mat4> reference_models;
+        std::vector<glm::mat4> reference_mvps;
+    };
+
+    // Random transforms, with every result also computed the plain glm way
+    TransformScene build_scene(uint32_t count) {
+        TransformScene scene;
+        std::mt19937 random(count);
+        std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+        scene.batch.parent = glm::rotate(glm::mat4(1.f), 0.3f, glm::vec3(0.f, 0.f, 1.f));
+        scene.batch.local = glm::translate(glm::scale(glm::mat4(1.f), glm::vec3(0.5f)), glm::vec3(-0.5f, 0.25f, 0.f));
+        scene.batch.view_projection = glm::perspective(0.8f, 16.f / 9.f, 0.1f, 100.f) *
+            glm::lookAt(glm::vec3(20.f, 20.f, 20.f), glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f));
+
+        scene.store.resize(count);
+        scene.reference_models.resize(count);
+        scene.reference_mvps.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            const glm::vec3 position(10.f * unit(random), 10.f * unit(random), 10.f * unit(random));
+            glm::vec3 axis(unit(random), unit(random), unit(random));
+            axis = glm::length(axis) > 1e-3f ? glm::normalize(axis) : glm::vec3(0.f, 0.f, 1.f);
+            const glm::quat rotation = glm::angleAxis(3.f * unit(random), axis);
+            const glm::vec3 scale(1.f + 0.5f * unit(random), 1.f + 0.5f * unit(random), 1.f + 0.5f * unit(random));
+            scene.store.set(i, position, rotation, scale);
+
+            scene.reference_models[i] = scene.batch.parent * glm::translate(glm::mat4(1.f), position) *
+                glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.f), scale) * scene.batch.local;
+            scene.reference_mvps[i] = scene.batch.view_projection * scene.reference_models[i];
+        }
+        return scene;
+    }
+
+    float max_error(const glm::mat4& result, const glm::mat4& reference) {
+        float error = 0.f;
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                const float difference = std::abs(result[column][row] - reference[column][row]);
+                error = std::max(error, difference / std::max(1.f, std::abs(reference[column][row])));
+            }
+        }
+        return error;
+    }
+
+    bool matches(const std::vector<glm::mat4>& results, const std::vector<glm::mat4>& references) {
+        for (size_t i = 0; i < results.size(); i++) {
+            if (!(max_error(results[i], references[i]) <= TOLERANCE)) return false;
+        }
+        return true;
+    }
+
+    // Models and MVPs into their own arrays, the whole store or a range in the middle of it
+    bool kernel_matches_glm(TransformKernel kernel, uint32_t count) {
+        bool passed = true;
+        const TransformScene scene = build_scene(count);
+        std::vector<glm::mat4> models(count, glm::mat4(0.f));
+        std::vector<glm::mat4> mvps(count, glm::mat4(0.f));
+        TransformOutput output;
+        output.models = models.data();
+        output.mvps = mvps.data();
+
+        compute_transforms(scene.store, 0, count, scene.batch, output, kernel);
+        CHECK(matches(models, scene.reference_models));
+        CHECK(matches(mvps, scene.reference_mvps));
+
+        // Odd bounds leave partial batches at both ends, entries outside the range must stay untouched
+        if (count > 2) {
+            std::fill(models.begin(), models.end(), glm::mat4(0.f));
+            compute_transforms(scene.store, 1, count - 1, scene.batch, output, kernel);
+            CHECK(models.front() == glm::mat4(0.f) && models.back() == glm::mat4(0.f));
+            CHECK(matches(std::vector<glm::mat4>(models.begin() + 1, models.end() - 1),
+                          std::vector<glm::mat4>(scene.reference_models.begin() + 1, scene.reference_models.end() - 1)));
+        }
+
+        if (!passed) std::cerr << "  " << transform_kernel_name(kernel) << " kernel, " << count << " objects\n";
+        return passed;
+    }
+
+    // Models written into the middle of a larger struct, the way uniform blocks are filled, without MVPs
+    bool kernel_writes_strided(TransformKernel kernel) {
+        struct Block
+        {
+            glm::mat4 model;
+            glm::mat4 view;
+            glm::mat4 projection;
+        };
+
+        bool passed = true;
+        const uint32_t count = 19;
+        const TransformScene scene = build_scene(count);
+        std::vector<Block> blocks(count, Block{glm::mat4(0.f), glm::mat4(2.f), glm::mat4(3.f)});
+        TransformOutput output;
+        output.models = &blocks[0].model;
+        output.model_stride = sizeof(Block);
+
+        compute_transforms(scene.store, 0, count, scene.batch, output, kernel);
+        for (uint32_t i = 0; i < count; i++) {
+            CHECK(max_error(blocks[i].model, scene.reference_models[i]) <= TOLERANCE);
+            CHECK(blocks[i].view == glm::mat4(2.f) && blocks[i].projection == glm::mat4(3.f));
+        }
+
+        if (!passed) std::cerr << "  " << transform_kernel_name(kernel) << " kernel, strided output\n";
+        return passed;
+    }
+
+    bool parallel_matches_glm(JobSystem& job_system) {
+        bool passed = true;
+        // Several jobs and a partial one at the end
+        const uint32_t count = 3 * TRANSFORM_JOB_SIZE + 5;
+        const TransformScene scene = build_scene(count);
+        std::vector<glm::mat4> models(count, glm::mat4(0.f));
+        std::vector<glm::mat4> mvps(count, glm::mat4(0.f));
+        TransformOutput output;
+        output.models = models.data();
+        output.mvps = mvps.data();
+
+        compute_transforms_parallel(job_system, scene.store, scene.batch, output, best_transform_kernel());
+        CHECK(matches(models, scene.reference_models));
+        CHECK(matches(mvps, scene.reference_mvps));
+
+        if (!passed) std::cerr << "  parallel, " << count << " objects on " << job_system.thread_count() << " threads\n";
+        return passed;
+    }
+}
+
+bool run_transform_tests() {
+    bool passed = true;
+    for (const auto kernel : {TransformKernel::SCALAR, TransformKernel::SSE2, TransformKernel::AVX2}) {
+        if (!transform_kernel_supported(kernel)) {
+            std::cout << transform_kernel_name(kernel) << " kernel not supported here, skipped\n";
+            continue;
+        }
+        for (const uint32_t count : {1u, 4u, 7u, 8u, 37u, 1000u}) passed = kernel_matches_glm(kernel, count) && passed;
+        passed = kernel_writes_strided(kernel) && passed;
+    }
+
+    JobSystem job_system;
+    passed = parallel_matches_glm(job_system) && passed;
+    return passed;
+}
@@ -0,0 +1,393 @@
+#include "texture_streamer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+    // Decoded images wait in memory until their upload is done, this bounds how many of them there are
+    constexpr uint32_t MAX_PENDING_DECODES = 4;
+
+    VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    uint32_t div_up(uint32_t value, uint32_t divisor) {
+        return (value + divisor - 1) / divisor;
+    }
+
+    uint32_t full_mip_count(uint32_t width, uint32_t height) {
+        uint32_t count = 1;
+        while ((width | height) >> count) count++;
+        return count;
+    }
+
+    VkImageMemoryBarrier level_barrier(VkImage image, uint32_t base_level, uint32_t level_count, VkImageLayout old_layout,
+                                       VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access) {
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = src_access;
+        barrier.dstAccessMask = dst_access;
+        barrier.oldLayout = old_layout;
+        barrier.newLayout = new_layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, base_level, level_count, 0, 1};
+        return barrier;
+    }
+
+    const VkPipelineStageFlags SAMPLING_STAGES = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+}
+
+bool TextureStreamer::init(VkPhysicalDevice physical_device, VkDevice device, DeviceMemoryAllocator& allocator,
+                           JobSystem& job_system, uint32_t frame_count, VkDeviceSize frame_budget) {
+    physical_device_ = physical_device;
+    device_ = device;
+    allocator_ = &allocator;
+    job_system_ = &job_system;
+    // Copies into compressed images need offsets aligned to the block size, 16 covers every format format_block() knows
+    alignment_ = std::max<VkDeviceSize>(allocator.limits().optimalBufferCopyOffsetAlignment, 16);
+    frame_budget_ = frame_budget / alignment_ * alignment_;
+
+    VkBufferCreateInfo buffer_create_info = {};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size = frame_budget_ * frame_count;
+    buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (allocator.create_buffer(buffer_create_info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            staging_buffer_, staging_allocation_) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkSamplerCreateInfo sampler_create_info = {};
+    sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_create_info.magFilter = VK_FILTER_LINEAR;
+    sampler_create_info.minFilter = VK_FILTER_LINEAR;
+    sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    // Views start at the finest resident level, so the sampler never has to clamp to it
+    sampler_create_info.maxLod = VK_LOD_CLAMP_NONE;
+    return vkCreateSampler(device_, &sampler_create_info, nullptr, &sampler_) == VK_SUCCESS;
+}
+
+void TextureStreamer::destroy(DeviceMemoryAllocator& allocator) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        decode_queue_.clear();
+        idle_.wait(lock, [this] { return decodes_in_flight_ == 0; });
+    }
+
+    for (auto& texture : textures_) {
+        vkDestroyImageView(device_, texture->view, nullptr);
+        if (texture->image != VK_NULL_HANDLE) allocator.destroy_image(texture->image, texture->allocation);
+    }
+    textures_.clear();
+    uploading_.clear();
+    states_.clear();
+    decoded_.clear();
+
+    vkDestroySampler(device_, sampler_, nullptr);
+    sampler_ = VK_NULL_HANDLE;
+    if (staging_buffer_ != VK_NULL_HANDLE) allocator.destroy_buffer(staging_buffer_, staging_allocation_);
+}
+
+TextureStreamer::TextureId TextureStreamer::request(const std::string& path) {
+    const auto id = TextureId(textures_.size());
+    textures_.push_back(std::make_unique<Texture>());
+    textures_.back()->path = path;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    states_.push_back(State::QUEUED);
+    decode_queue_.emplace_back(id, textures_.back().get());
+    start_decodes();
+    return id;
+}
+
+void TextureStreamer::start_decodes() {
+    while (!decode_queue_.empty() && pending_decodes_ < MAX_PENDING_DECODES) {
+        const auto [id, texture] = decode_queue_.front();
+        decode_queue_.pop_front();
+        states_[id] = State::DECODING;
+        pending_decodes_++;
+        decodes_in_flight_++;
+        job_system_->submit([this, id = id, texture = texture](uint32_t) {
+            const auto start = std::chrono::high_resolution_clock::now();
+            const bool loaded = load_image(texture->path, texture->data, texture->error);
+            const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            decode_milliseconds_ += milliseconds;
+            // Failures too, the main thread reports them
+            states_[id] = loaded ? State::DECODED : State::FAILED;
+            decoded_.push_back(id);
+            decodes_in_flight_--;
+            idle_.notify_all();
+        });
+    }
+}
+
+void TextureStreamer::record_uploads(VkCommandBuffer command_buffer, uint32_t frame, const RetireView& retire) {
+    changed_.clear();
+
+    std::vector<TextureId> decoded;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        decoded.swap(decoded_);
+        for (const TextureId id : decoded) {
+            if (states_[id] == State::DECODED) states_[id] = State::UPLOADING;
+        }
+    }
+
+    for (const TextureId id : decoded) {
+        Texture& texture = *textures_[id];
+        if (state(id) == State::UPLOADING && create_image(texture)) {
+            const VkImageMemoryBarrier barrier = level_barrier(texture.image, 0, texture.level_count, VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                0, nullptr, 0, nullptr, 1, &barrier);
+            uploading_.push_back(id);
+            continue;
+        }
+        std::cerr << "Texture streaming: " << texture.error << "\n";
+        texture.data = {};
+        set_state(id, State::FAILED);
+    }
+
+    // Smallest pending level first, whichever texture it belongs to, until the frame's budget is used up
+    const VkDeviceSize partition = frame_budget_ * frame;
+    VkDeviceSize used = 0;
+    for (;;) {
+        Texture* next = nullptr;
+        TextureId next_id = 0;
+        size_t smallest = std::numeric_limits<size_t>::max();
+        for (const TextureId id : uploading_) {
+            const Texture& texture = *textures_[id];
+            const size_t size = texture.data.levels[texture.upload_level].size;
+            if (size < smallest) {
+                smallest = size;
+                next = textures_[id].get();
+                next_id = id;
+            }
+        }
+        if (next == nullptr) break;
+
+        const VkDeviceSize offset = align_up(used, alignment_);
+        if (offset >= frame_budget_) break;
+        const VkDeviceSize bytes = upload_rows(command_buffer, *next, partition + offset, frame_budget_ - offset);
+        if (bytes == 0) break;
+        used = offset + bytes;
+
+        const ImageLevel& level = next->data.levels[next->upload_level];
+        if (next->upload_row == div_up(level.height, next->block_height)) finish_level(command_buffer, next_id, retire);
+    }
+
+    if (used > 0) {
+        bytes_uploaded_ += used;
+        peak_frame_bytes_ = std::max(peak_frame_bytes_, used);
+        upload_frames_++;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    start_decodes();
+}
+
+bool TextureStreamer::create_image(Texture& texture) {
+    const ImageData& data = texture.data;
+    if (!format_block(data.format, texture.block_bytes, texture.block_width, texture.block_height)) {
+        texture.error = texture.path + ": unknown format";
+        return false;
+    }
+
+    VkFormatProperties format_properties;
+    vkGetPhysicalDeviceFormatProperties(physical_device_, data.format, &format_properties);
+    const VkFormatFeatureFlags features = format_properties.optimalTilingFeatures;
+    if (!(features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+        texture.error = texture.path + ": the device can't sample its format";
+        return false;
+    }
+
+    const uint32_t width = data.levels[0].width;
+    const uint32_t height = data.levels[0].height;
+    const VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    texture.generate_mips = data.levels.size() == 1 && (features & blit_features) == blit_features &&
+        full_mip_count(width, height) > 1;
+    texture.level_count = texture.generate_mips ? full_mip_count(width, height) : uint32_t(data.levels.size());
+    texture.resident_level = texture.level_count;
+    texture.upload_level = texture.generate_mips ? 0 : texture.level_count - 1;
+    texture.upload_row = 0;
+
+    if (VkDeviceSize(div_up(width, texture.block_width)) * texture.block_bytes > frame_budget_) {
+        texture.error = texture.path + ": a single row is larger than the per-frame upload budget";
+        return false;
+    }
+
+    VkImageCreateInfo image_create_info = {};
+    image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_create_info.imageType = VK_IMAGE_TYPE_2D;
+    image_create_info.format = data.format;
+    image_create_info.extent = {width, height, 1};
+    image_create_info.mipLevels = texture.level_count;
+    image_create_info.arrayLayers = 1;
+    image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+        (texture.generate_mips ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+    image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (allocator_->create_image(image_create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image, texture.allocation) != VK_SUCCESS) {
+        texture.image = VK_NULL_HANDLE;
+        texture.error = texture.path + ": out of device memory";
+        return false;
+    }
+    return true;
+}
+
+VkDeviceSize TextureStreamer::upload_rows(VkCommandBuffer command_buffer, Texture& texture, VkDeviceSize staging_offset,
+                                          VkDeviceSize budget) {
+    const ImageLevel& level = texture.data.levels[texture.upload_level];
+    const VkDeviceSize row_bytes = VkDeviceSize(div_up(level.width, texture.block_width)) * texture.block_bytes;
+    const uint32_t remaining_rows = div_up(level.height, texture.block_height) - texture.upload_row;
+    const auto rows = uint32_t(std::min<VkDeviceSize>(remaining_rows, budget / row_bytes));
+    if (rows == 0) return 0;
+
+    const VkDeviceSize bytes = rows * row_bytes;
+    memcpy(static_cast<char*>(staging_allocation_.mapped) + staging_offset,
+        texture.data.pixels.data() + level.offset + texture.upload_row * row_bytes, size_t(bytes));
+
+    const uint32_t y = texture.upload_row * texture.block_height;
+    VkBufferImageCopy region = {};
+    region.bufferOffset = staging_offset;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, texture.upload_level, 0, 1};
+    region.imageOffset = {0, int32_t(y), 0};
+    // Partial blocks are only allowed at the level's edges, which is where a clipped extent ends
+    region.imageExtent = {level.width, std::min(rows * texture.block_height, level.height - y), 1};
+    vkCmdCopyBufferToImage(command_buffer, staging_buffer_, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    texture.upload_row += rows;
+    return bytes;
+}
+
+void TextureStreamer::finish_level(VkCommandBuffer command_buffer, TextureId id, const RetireView& retire) {
+    Texture& texture = *textures_[id];
+    bool complete = true;
+    if (texture.generate_mips) {
+        generate_mips(command_buffer, texture);
+        texture.resident_level = 0;
+    } else {
+        const VkImageMemoryBarrier barrier = level_barrier(texture.image, texture.upload_level, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, SAMPLING_STAGES, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        texture.resident_level = texture.upload_level;
+        complete = texture.upload_level == 0;
+        if (!complete) {
+            texture.upload_level--;
+            texture.upload_row = 0;
+        }
+    }
+
+    if (update_view(texture, retire)) changed_.push_back(id);
+    if (!complete) return;
+
+    texture.data = {};
+    uploading_.erase(std::find(uploading_.begin(), uploading_.end(), id));
+    set_state(id, State::COMPLETE);
+}
+
+void TextureStreamer::generate_mips(VkCommandBuffer command_buffer, Texture& texture) {
+    int32_t width = int32_t(texture.data.levels[0].width);
+    int32_t height = int32_t(texture.data.levels[0].height);
+    for (uint32_t level = 1; level < texture.level_count; level++) {
+        const VkImageMemoryBarrier barrier = level_barrier(texture.image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkImageBlit blit = {};
+        blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+        blit.srcOffsets[1] = {width, height, 1};
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+        blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        blit.dstOffsets[1] = {width, height, 1};
+        vkCmdBlitImage(command_buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+    }
+
+    // Every level but the last was a blit source
+    const uint32_t last = texture.level_count - 1;
+    const VkImageMemoryBarrier barriers[] = {
+        level_barrier(texture.image, 0, last, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT),
+        level_barrier(texture.image, last, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, SAMPLING_STAGES, 0, 0, nullptr, 0, nullptr, 2, barriers);
+}
+
+bool TextureStreamer::update_view(Texture& texture, const RetireView& retire) {
+    VkImageViewCreateInfo view_create_info = {};
+    view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_create_info.image = texture.image;
+    view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_create_info.format = texture.data.format;
+    view_create_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, texture.resident_level,
+        texture.level_count - texture.resident_level, 0, 1};
+    VkImageView view;
+    // Keeps the coarser view, the next level to finish tries again
+    if (vkCreateImageView(device_, &view_create_info, nullptr, &view) != VK_SUCCESS) return false;
+
+    if (texture.view != VK_NULL_HANDLE) retire(texture.view);
+    texture.view = view;
+    return true;
+}
+
+TextureStreamer::State TextureStreamer::state(TextureId texture) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return states_[texture];
+}
+
+void TextureStreamer::set_state(TextureId texture, State state) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state == State::FAILED || state == State::COMPLETE) pending_decodes_--;
+    states_[texture] = state;
+}
+
+VkImageView TextureStreamer::view(TextureId texture) const {
+    return textures_[texture]->view;
+}
+
+uint32_t TextureStreamer::resident_level(TextureId texture) const {
+    return textures_[texture]->resident_level;
+}
+
+bool TextureStreamer::is_complete(TextureId texture) const {
+    return state(texture) == State::COMPLETE;
+}
+
+bool TextureStreamer::failed(TextureId texture) const {
+    return state(texture) == State::FAILED;
+}
+
+void TextureStreamer::print_stats(std::ostream& stream) const {
+    uint32_t complete = 0, failed = 0;
+    double decode_milliseconds;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const State state : states_) {
+            complete += state == State::COMPLETE;
+            failed += state == State::FAILED;
+        }
+        decode_milliseconds = decode_milliseconds_;
+    }
+    stream << "Texture streamer: " << complete << " of " << textures_.size() << " textures resident, " << failed << " failed, "
+        << std::fixed << std::setprecision(1) << bytes_uploaded_ / (1024.0 * 1024.0) << " MiB uploaded over " << upload_frames_
+        << " frames (peak " << peak_frame_bytes_ / 1024 << " KiB of " << frame_budget_ / 1024 << " KiB), "
+        << decode_milliseconds << " ms decoding\n" << std::defaultfloat;
+}
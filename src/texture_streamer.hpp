@@ -0,0 +1,138 @@
+#pragma once
+
+#include "device_memory_allocator.hpp"
+#include "image_loader.hpp"
+#include "job_system.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Streams textures in from PNG and KTX2 files without ever stalling the frame loop. Files are decoded on JobSystem
+// workers, a few at a time. Each frame, record_uploads() copies at most frame_budget bytes of decoded texels into
+// their images, in the frame's command buffer, from a staging partition owned by that frame slot.
+// Levels go up coarsest first, smallest pending level of any texture before anything bigger. A texture's view only
+// covers its levels that are already resident, so it can be sampled as soon as its 1x1 level has arrived and gets
+// sharper as the finer levels follow. Files without mips get theirs from vkCmdBlitImage once level 0 is in, when the
+// format can be blitted, and have a single level otherwise.
+class TextureStreamer
+{
+public:
+    using TextureId = uint32_t;
+    // Called with every view a texture outgrows, which the frames in flight may still be sampling
+    using RetireView = std::function<void(VkImageView)>;
+
+    bool init(VkPhysicalDevice physical_device, VkDevice device, DeviceMemoryAllocator& allocator, JobSystem& job_system,
+              uint32_t frame_count, VkDeviceSize frame_budget);
+    // Waits for the decodes in flight. The device must be idle.
+    void destroy(DeviceMemoryAllocator& allocator);
+
+    // Queues the file for decoding and returns right away
+    TextureId request(const std::string& path);
+
+    // Outside of a render pass, once the frame slot's previous frame has finished. Creates the images of newly
+    // decoded textures, records this frame's share of the uploads and transitions every level it completes for
+    // sampling. Never waits on the workers.
+    void record_uploads(VkCommandBuffer command_buffer, uint32_t frame, const RetireView& retire);
+    // Textures whose view() changed during the last record_uploads()
+    const std::vector<TextureId>& changed() const { return changed_; }
+
+    // Null until the texture's first level is resident
+    VkImageView view(TextureId texture) const;
+    // Finest level the view starts at, the level count while nothing is resident
+    uint32_t resident_level(TextureId texture) const;
+    bool is_complete(TextureId texture) const;
+    bool failed(TextureId texture) const;
+    // Trilinear and repeating, for all of them
+    VkSampler sampler() const { return sampler_; }
+
+    void print_stats(std::ostream& stream) const;
+
+private:
+    enum class State
+    {
+        QUEUED,
+        DECODING,
+        DECODED,
+        UPLOADING,
+        COMPLETE,
+        FAILED,
+    };
+
+    struct Texture
+    {
+        std::string path;
+        // Written by the decode job, only read once it has moved the state to DECODED
+        ImageData data;
+        std::string error;
+
+        VkImage image = VK_NULL_HANDLE;
+        Allocation allocation;
+        VkImageView view = VK_NULL_HANDLE;
+        uint32_t level_count = 0;
+        bool generate_mips = false;
+        uint32_t resident_level = 0;
+        // Level being uploaded and its first block row still missing. Always 0 with generate_mips, the decoded image
+        // has a single level then.
+        uint32_t upload_level = 0;
+        uint32_t upload_row = 0;
+        uint32_t block_bytes = 0;
+        uint32_t block_width = 0;
+        uint32_t block_height = 0;
+    };
+
+    // With mutex_ held
+    void start_decodes();
+    State state(TextureId texture) const;
+    void set_state(TextureId texture, State state);
+
+    bool create_image(Texture& texture);
+    // Copies as many block rows of the texture's upload level as fit, returns the bytes used
+    VkDeviceSize upload_rows(VkCommandBuffer command_buffer, Texture& texture, VkDeviceSize staging_offset, VkDeviceSize budget);
+    void finish_level(VkCommandBuffer command_buffer, TextureId id, const RetireView& retire);
+    void generate_mips(VkCommandBuffer command_buffer, Texture& texture);
+    bool update_view(Texture& texture, const RetireView& retire);
+
+    VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
+    VkDevice device_ = VK_NULL_HANDLE;
+    DeviceMemoryAllocator* allocator_ = nullptr;
+    JobSystem* job_system_ = nullptr;
+    VkSampler sampler_ = VK_NULL_HANDLE;
+
+    // frame_count partitions of frame_budget bytes, persistently mapped
+    VkBuffer staging_buffer_ = VK_NULL_HANDLE;
+    Allocation staging_allocation_;
+    VkDeviceSize frame_budget_ = 0;
+    VkDeviceSize alignment_ = 16;
+
+    // Stable addresses, decode jobs write into them while the vector grows
+    std::vector<std::unique_ptr<Texture>> textures_;
+    // Textures the main thread uploads, in request order. Only touched by the main thread.
+    std::vector<TextureId> uploading_;
+    std::vector<TextureId> changed_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable idle_;
+    std::vector<State> states_;
+    std::deque<std::pair<TextureId, Texture*>> decode_queue_;
+    // Finished decodes, failed ones included, the main thread hasn't looked at yet
+    std::vector<TextureId> decoded_;
+    // Decodes in flight plus decoded textures whose texels haven't all been uploaded yet, bounds the memory held by
+    // decoded images
+    uint32_t pending_decodes_ = 0;
+    uint32_t decodes_in_flight_ = 0;
+    double decode_milliseconds_ = 0.0;
+
+    uint64_t bytes_uploaded_ = 0;
+    VkDeviceSize peak_frame_bytes_ = 0;
+    uint32_t upload_frames_ = 0;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Internal to transform_system: what the batch kernels see. Plain data only, transform_system_avx2.cpp is compiled
+// with AVX2 enabled and must not instantiate anything (std:: or glm templates) another translation unit could end up
+// linking against on a CPU without it.
+struct TransformKernelArgs
+{
+    // Structure of arrays, readable up to a multiple of TRANSFORM_LANE_PADDING past end
+    const float* position[3];
+    const float* rotation[4];
+    const float* scale[3];
+    uint32_t begin;
+    uint32_t end;
+
+    // Column major like glm: matrix[column * 4 + row]
+    float parent[16];
+    float local[16];
+    // view_projection * parent, only used when mvps is set
+    float view_projection_parent[16];
+
+    char* models;
+    size_t model_stride;
+    char* mvps;
+    size_t mvp_stride;
+};
+
+// Widest vector the kernels use, the store pads its arrays to a multiple of it
+constexpr uint32_t TRANSFORM_LANE_PADDING = 8;
+
+void transform_kernel_scalar(const TransformKernelArgs& args);
+void transform_kernel_sse2(const TransformKernelArgs& args);
+// Only callable when transform_kernel_avx2_compiled() and the CPU supports AVX2
+void transform_kernel_avx2(const TransformKernelArgs& args);
+bool transform_kernel_avx2_compiled();
@@ -0,0 +1,231 @@
+#include "transform_system.hpp"
+
+#include "cpu_features.hpp"
+#include "transform_kernels.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_SYSTEM_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // out = p * al, where al's last row is given separately since it is the local matrix's last row for every object
+    void multiply(const float* p, const float* al, float* out) {
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                out[column * 4 + row] = p[0 * 4 + row] * al[column * 4 + 0] + p[1 * 4 + row] * al[column * 4 + 1] +
+                    p[2 * 4 + row] * al[column * 4 + 2] + p[3 * 4 + row] * al[column * 4 + 3];
+            }
+        }
+    }
+}
+
+void TransformStore::resize(uint32_t count) {
+    // Padding past the end lets the kernels load whole vectors for the last objects, it holds identities as well
+    const size_t padded = (size_t(count) + TRANSFORM_LANE_PADDING - 1) / TRANSFORM_LANE_PADDING * TRANSFORM_LANE_PADDING + TRANSFORM_LANE_PADDING;
+    for (int c = 0; c < COMPONENT_COUNT; c++) {
+        const float identity = c == ROTATION_W || c >= SCALE_X ? 1.f : 0.f;
+        if (count < count_) std::fill(components_[c].begin() + count, components_[c].end(), identity);
+        components_[c].resize(padded, identity);
+    }
+    count_ = count;
+}
+
+void TransformStore::set(uint32_t index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    components_[POSITION_X][index] = position.x;
+    components_[POSITION_Y][index] = position.y;
+    components_[POSITION_Z][index] = position.z;
+    components_[ROTATION_X][index] = rotation.x;
+    components_[ROTATION_Y][index] = rotation.y;
+    components_[ROTATION_Z][index] = rotation.z;
+    components_[ROTATION_W][index] = rotation.w;
+    components_[SCALE_X][index] = scale.x;
+    components_[SCALE_Y][index] = scale.y;
+    components_[SCALE_Z][index] = scale.z;
+}
+
+const char* transform_kernel_name(TransformKernel kernel) {
+    switch (kernel) {
+        case TransformKernel::SCALAR: return "scalar";
+        case TransformKernel::SSE2: return "sse2";
+        case TransformKernel::AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+bool transform_kernel_supported(TransformKernel kernel) {
+    switch (kernel) {
+        case TransformKernel::SCALAR: return true;
+#ifdef TRANSFORM_SYSTEM_SSE2
+        case TransformKernel::SSE2: return true;
+#else
+        case TransformKernel::SSE2: return false;
+#endif
+        case TransformKernel::AVX2: return transform_kernel_avx2_compiled() && cpu_supports_avx2();
+    }
+    return false;
+}
+
+TransformKernel best_transform_kernel() {
+    if (transform_kernel_supported(TransformKernel::AVX2)) return TransformKernel::AVX2;
+    if (transform_kernel_supported(TransformKernel::SSE2)) return TransformKernel::SSE2;
+    return TransformKernel::SCALAR;
+}
+
+void compute_transforms(const TransformStore& store, uint32_t begin, uint32_t end, const TransformBatch& batch,
+                        const TransformOutput& output, TransformKernel kernel) {
+    if (begin >= end) return;
+
+    TransformKernelArgs args;
+    for (int axis = 0; axis < 3; axis++) {
+        args.position[axis] = store.component(TransformStore::Component(TransformStore::POSITION_X + axis));
+        args.scale[axis] = store.component(TransformStore::Component(TransformStore::SCALE_X + axis));
+    }
+    for (int c = 0; c < 4; c++) args.rotation[c] = store.component(TransformStore::Component(TransformStore::ROTATION_X + c));
+    args.begin = begin;
+    args.end = end;
+    memcpy(args.parent, glm::value_ptr(batch.parent), sizeof(args.parent));
+    memcpy(args.local, glm::value_ptr(batch.local), sizeof(args.local));
+    const glm::mat4 view_projection_parent = batch.view_projection * batch.parent;
+    memcpy(args.view_projection_parent, glm::value_ptr(view_projection_parent), sizeof(args.view_projection_parent));
+    args.models = static_cast<char*>(output.models);
+    args.model_stride = output.model_stride;
+    args.mvps = static_cast<char*>(output.mvps);
+    args.mvp_stride = output.mvp_stride;
+
+    if (!transform_kernel_supported(kernel)) kernel = best_transform_kernel();
+    switch (kernel) {
+        case TransformKernel::SCALAR: transform_kernel_scalar(args); break;
+        case TransformKernel::SSE2: transform_kernel_sse2(args); break;
+        case TransformKernel::AVX2: transform_kernel_avx2(args); break;
+    }
+}
+
+void compute_transforms_parallel(JobSystem& job_system, const TransformStore& store, const TransformBatch& batch,
+                                 const TransformOutput& output, TransformKernel kernel) {
+    job_system.parallel_for(store.size(), TRANSFORM_JOB_SIZE, [&](uint32_t begin, uint32_t end, uint32_t) {
+        compute_transforms(store, begin, end, batch, output, kernel);
+    });
+}
+
+// Same math as the vector kernels, one object at a time
+void transform_kernel_scalar(const TransformKernelArgs& args) {
+    const float* local = args.local;
+    for (uint32_t i = args.begin; i < args.end; i++) {
+        const float x = args.rotation[0][i], y = args.rotation[1][i], z = args.rotation[2][i], w = args.rotation[3][i];
+        const float sx = args.scale[0][i], sy = args.scale[1][i], sz = args.scale[2][i];
+
+        // translate * rotate * scale, the last row is (0, 0, 0, 1)
+        const float a[4][3] = {
+            {(1.f - 2.f * (y * y + z * z)) * sx, 2.f * (x * y + w * z) * sx, 2.f * (x * z - w * y) * sx},
+            {2.f * (x * y - w * z) * sy, (1.f - 2.f * (x * x + z * z)) * sy, 2.f * (y * z + w * x) * sy},
+            {2.f * (x * z + w * y) * sz, 2.f * (y * z - w * x) * sz, (1.f - 2.f * (x * x + y * y)) * sz},
+            {args.position[0][i], args.position[1][i], args.position[2][i]},
+        };
+
+        float al[16];
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 3; row++) {
+                al[column * 4 + row] = a[0][row] * local[column * 4 + 0] + a[1][row] * local[column * 4 + 1] +
+                    a[2][row] * local[column * 4 + 2] + a[3][row] * local[column * 4 + 3];
+            }
+            al[column * 4 + 3] = local[column * 4 + 3];
+        }
+
+        float matrix[16];
+        multiply(args.parent, al, matrix);
+        memcpy(args.models + i * args.model_stride, matrix, sizeof(matrix));
+        if (args.mvps) {
+            multiply(args.view_projection_parent, al, matrix);
+            memcpy(args.mvps + i * args.mvp_stride, matrix, sizeof(matrix));
+        }
+    }
+}
+
+#ifdef TRANSFORM_SYSTEM_SSE2
+
+namespace
+{
+    // m[column][row] holds that element for four objects. Transposing each column turns it into one column per
+    // object, only the first lanes objects exist.
+    void store_matrices(__m128 (&m)[4][4], uint32_t lanes, char* out, size_t stride) {
+        for (int column = 0; column < 4; column++) {
+            _MM_TRANSPOSE4_PS(m[column][0], m[column][1], m[column][2], m[column][3]);
+            for (uint32_t lane = 0; lane < lanes; lane++) {
+                _mm_storeu_ps(reinterpret_cast<float*>(out + lane * stride) + column * 4, m[column][lane]);
+            }
+        }
+    }
+
+    // out = p * al, al's last row being the local matrix's
+    void multiply(const float* p, const __m128 (&al)[4][3], const float* local, __m128 (&out)[4][4]) {
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                __m128 sum = _mm_set1_ps(p[3 * 4 + row] * local[column * 4 + 3]);
+                for (int k = 0; k < 3; k++) sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(p[k * 4 + row]), al[column][k]));
+                out[column][row] = sum;
+            }
+        }
+    }
+}
+
+void transform_kernel_sse2(const TransformKernelArgs& args) {
+    const float* local = args.local;
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 two = _mm_set1_ps(2.f);
+
+    for (uint32_t i = args.begin; i < args.end; i += 4) {
+        const __m128 x = _mm_loadu_ps(args.rotation[0] + i), y = _mm_loadu_ps(args.rotation[1] + i);
+        const __m128 z = _mm_loadu_ps(args.rotation[2] + i), w = _mm_loadu_ps(args.rotation[3] + i);
+        const __m128 sx = _mm_loadu_ps(args.scale[0] + i), sy = _mm_loadu_ps(args.scale[1] + i), sz = _mm_loadu_ps(args.scale[2] + i);
+
+        const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        const __m128 a[4][3] = {
+            {_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+             _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+             _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx)},
+            {_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+             _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+             _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy)},
+            {_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+             _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+             _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz)},
+            {_mm_loadu_ps(args.position[0] + i), _mm_loadu_ps(args.position[1] + i), _mm_loadu_ps(args.position[2] + i)},
+        };
+
+        __m128 al[4][3];
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 3; row++) {
+                __m128 sum = _mm_mul_ps(a[0][row], _mm_set1_ps(local[column * 4 + 0]));
+                for (int k = 1; k < 4; k++) sum = _mm_add_ps(sum, _mm_mul_ps(a[k][row], _mm_set1_ps(local[column * 4 + k])));
+                al[column][row] = sum;
+            }
+        }
+
+        const uint32_t lanes = std::min(4u, args.end - i);
+        __m128 matrices[4][4];
+        multiply(args.parent, al, local, matrices);
+        store_matrices(matrices, lanes, args.models + i * args.model_stride, args.model_stride);
+        if (args.mvps) {
+            multiply(args.view_projection_parent, al, local, matrices);
+            store_matrices(matrices, lanes, args.mvps + i * args.mvp_stride, args.mvp_stride);
+        }
+    }
+}
+
+#else
+
+void transform_kernel_sse2(const TransformKernelArgs& args) {
+    transform_kernel_scalar(args);
+}
+
+#endif
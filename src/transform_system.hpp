@@ -0,0 +1,81 @@
+#pragma once
+
+#include "job_system.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Object transforms as structure of arrays: every component (position x, rotation w, ...) is its own contiguous array,
+// so the batch kernels load 4 or 8 objects' worth of one component with a single instruction. Writing a transform
+// goes through set(), bulk updates can work on the arrays directly.
+class TransformStore
+{
+public:
+    enum Component
+    {
+        POSITION_X, POSITION_Y, POSITION_Z,
+        ROTATION_X, ROTATION_Y, ROTATION_Z, ROTATION_W,
+        SCALE_X, SCALE_Y, SCALE_Z,
+        COMPONENT_COUNT,
+    };
+
+    // New transforms are identities
+    void resize(uint32_t count);
+    uint32_t size() const { return count_; }
+
+    // rotation must be normalized
+    void set(uint32_t index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+    float* component(Component component) { return components_[component].data(); }
+    const float* component(Component component) const { return components_[component].data(); }
+
+private:
+    uint32_t count_ = 0;
+    std::vector<float> components_[COMPONENT_COUNT];
+};
+
+enum class TransformKernel
+{
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+const char* transform_kernel_name(TransformKernel kernel);
+bool transform_kernel_supported(TransformKernel kernel);
+// The widest kernel both this build and this CPU support
+TransformKernel best_transform_kernel();
+
+// Where the results go: a glm-layout mat4 every stride bytes, e.g. the model member of an array of uniform blocks
+struct TransformOutput
+{
+    // parent * translate(position) * rotate(rotation) * scale(scale) * local
+    void* models = nullptr;
+    size_t model_stride = sizeof(glm::mat4);
+    // view_projection * model, skipped when null
+    void* mvps = nullptr;
+    size_t mvp_stride = sizeof(glm::mat4);
+};
+
+struct TransformBatch
+{
+    glm::mat4 parent = glm::mat4(1.f);
+    glm::mat4 local = glm::mat4(1.f);
+    glm::mat4 view_projection = glm::mat4(1.f);
+};
+
+// Transforms [begin, end) of the store into output entries [begin, end)
+void compute_transforms(const TransformStore& store, uint32_t begin, uint32_t end, const TransformBatch& batch,
+                        const TransformOutput& output, TransformKernel kernel);
+
+// Objects per job of compute_transforms_parallel(), below that the work stays on the calling thread
+constexpr uint32_t TRANSFORM_JOB_SIZE = 4096;
+
+// The whole store, split over the job system
+void compute_transforms_parallel(JobSystem& job_system, const TransformStore& store, const TransformBatch& batch,
+                                 const TransformOutput& output, TransformKernel kernel);
@@ -0,0 +1,106 @@
+// Built with AVX2 code generation enabled (see CMakeLists.txt), only ever entered after a CPU check. Includes nothing
+// but the kernel interface and intrinsics, see transform_kernels.hpp.
+#include "transform_kernels.hpp"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace
+{
+    void store_half(__m128 (&rows)[4], uint32_t lanes, char* out, size_t stride, int column) {
+        _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+        for (uint32_t lane = 0; lane < lanes; lane++) {
+            _mm_storeu_ps(reinterpret_cast<float*>(out + lane * stride) + column * 4, rows[lane]);
+        }
+    }
+
+    // m[column][row] holds that element for eight objects, written out as two 4x4 transposes per column
+    void store_matrices(const __m256 (&m)[4][4], uint32_t lanes, char* out, size_t stride) {
+        for (int column = 0; column < 4; column++) {
+            __m128 low[4], high[4];
+            for (int row = 0; row < 4; row++) {
+                low[row] = _mm256_castps256_ps128(m[column][row]);
+                high[row] = _mm256_extractf128_ps(m[column][row], 1);
+            }
+            store_half(low, lanes < 4 ? lanes : 4, out, stride, column);
+            if (lanes > 4) store_half(high, lanes - 4, out + 4 * stride, stride, column);
+        }
+    }
+
+    // out = p * al, al's last row being the local matrix's
+    void multiply(const float* p, const __m256 (&al)[4][3], const float* local, __m256 (&out)[4][4]) {
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                __m256 sum = _mm256_set1_ps(p[3 * 4 + row] * local[column * 4 + 3]);
+                for (int k = 0; k < 3; k++) sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(p[k * 4 + row]), al[column][k]));
+                out[column][row] = sum;
+            }
+        }
+    }
+}
+
+bool transform_kernel_avx2_compiled() {
+    return true;
+}
+
+void transform_kernel_avx2(const TransformKernelArgs& args) {
+    const float* local = args.local;
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 two = _mm256_set1_ps(2.f);
+
+    for (uint32_t i = args.begin; i < args.end; i += 8) {
+        const __m256 x = _mm256_loadu_ps(args.rotation[0] + i), y = _mm256_loadu_ps(args.rotation[1] + i);
+        const __m256 z = _mm256_loadu_ps(args.rotation[2] + i), w = _mm256_loadu_ps(args.rotation[3] + i);
+        const __m256 sx = _mm256_loadu_ps(args.scale[0] + i), sy = _mm256_loadu_ps(args.scale[1] + i), sz = _mm256_loadu_ps(args.scale[2] + i);
+
+        const __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+        const __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        const __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+        const __m256 a[4][3] = {
+            {_mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), sx),
+             _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx),
+             _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx)},
+            {_mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy),
+             _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), sy),
+             _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy)},
+            {_mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz),
+             _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz),
+             _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), sz)},
+            {_mm256_loadu_ps(args.position[0] + i), _mm256_loadu_ps(args.position[1] + i), _mm256_loadu_ps(args.position[2] + i)},
+        };
+
+        __m256 al[4][3];
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 3; row++) {
+                __m256 sum = _mm256_mul_ps(a[0][row], _mm256_set1_ps(local[column * 4 + 0]));
+                for (int k = 1; k < 4; k++) sum = _mm256_add_ps(sum, _mm256_mul_ps(a[k][row], _mm256_set1_ps(local[column * 4 + k])));
+                al[column][row] = sum;
+            }
+        }
+
+        const uint32_t remaining = args.end - i;
+        const uint32_t lanes = remaining < 8 ? remaining : 8;
+        __m256 matrices[4][4];
+        multiply(args.parent, al, local, matrices);
+        store_matrices(matrices, lanes, args.models + i * args.model_stride, args.model_stride);
+        if (args.mvps) {
+            multiply(args.view_projection_parent, al, local, matrices);
+            store_matrices(matrices, lanes, args.mvps + i * args.mvp_stride, args.mvp_stride);
+        }
+    }
+}
+
+#else
+
+// Compiler without AVX2 support or a non-x86 target, never called
+bool transform_kernel_avx2_compiled() {
+    return false;
+}
+
+void transform_kernel_avx2(const TransformKernelArgs& args) {
+    transform_kernel_scalar(args);
+}
+
+#endif
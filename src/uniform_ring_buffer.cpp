@@ -0,0 +1,83 @@
+#include "uniform_ring_buffer.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+bool UniformRingBuffer::init(VkDevice device, DeviceMemoryAllocator& allocator, uint32_t frame_count, VkDeviceSize frame_capacity,
+                             VkBufferUsageFlags extra_usage) {
+    device_ = device;
+    const auto& limits = allocator.limits();
+    alignment_ = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 1);
+    non_coherent_atom_size_ = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1);
+    // Partitions start on an atom boundary so that flushing one never has to touch its neighbours
+    frame_capacity_ = align_up(frame_capacity, std::max(alignment_, non_coherent_atom_size_));
+
+    VkBufferCreateInfo buffer_create_info = {};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size = frame_capacity_ * frame_count;
+    buffer_create_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | extra_usage;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device_, &buffer_create_info, nullptr, &buffer_) != VK_SUCCESS) return false;
+
+    VkMemoryRequirements memory_requirements;
+    vkGetBufferMemoryRequirements(device_, buffer_, &memory_requirements);
+    // Same reasoning for the allocation itself, flush ranges are rounded to whole atoms
+    memory_requirements.alignment = std::max(memory_requirements.alignment, non_coherent_atom_size_);
+    memory_requirements.size = align_up(memory_requirements.size, non_coherent_atom_size_);
+
+    if (allocator.allocate(memory_requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, AllocationKind::LINEAR, allocation_) != VK_SUCCESS) {
+        vkDestroyBuffer(device_, buffer_, nullptr);
+        buffer_ = VK_NULL_HANDLE;
+        return false;
+    }
+    coherent_ = allocator.is_host_coherent(allocation_.memory_type);
+
+    return vkBindBufferMemory(device_, buffer_, allocation_.memory, allocation_.offset) == VK_SUCCESS;
+}
+
+void UniformRingBuffer::destroy(DeviceMemoryAllocator& allocator) {
+    allocator.destroy_buffer(buffer_, allocation_);
+}
+
+void UniformRingBuffer::begin_frame(uint32_t frame_index) {
+    frame_begin_ = frame_capacity_ * frame_index;
+    head_ = frame_begin_;
+}
+
+bool UniformRingBuffer::allocate(const void* data, VkDeviceSize size, uint32_t& dynamic_offset) {
+    const VkDeviceSize offset = align_up(head_, alignment_);
+    if (offset + size > frame_begin_ + frame_capacity_) return false;
+
+    memcpy(static_cast<char*>(allocation_.mapped) + offset, data, size);
+    dynamic_offset = static_cast<uint32_t>(offset);
+    head_ = offset + size;
+    return true;
+}
+
+void* UniformRingBuffer::allocate_array(VkDeviceSize element_size, uint32_t count, VkDeviceSize& element_stride, uint32_t& first_dynamic_offset) {
+    element_stride = align_up(element_size, alignment_);
+    const VkDeviceSize offset = align_up(head_, alignment_);
+    if (offset + element_stride * count > frame_begin_ + frame_capacity_) return nullptr;
+
+    first_dynamic_offset = static_cast<uint32_t>(offset);
+    head_ = offset + element_stride * count;
+    return static_cast<char*>(allocation_.mapped) + offset;
+}
+
+void UniformRingBuffer::flush() const {
+    if (coherent_ || head_ == frame_begin_) return;
+
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation_.memory;
+    range.offset = allocation_.offset + frame_begin_;
+    range.size = align_up(head_ - frame_begin_, non_coherent_atom_size_);
+    vkFlushMappedMemoryRanges(device_, 1, &range);
+}
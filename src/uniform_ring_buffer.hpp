@@ -0,0 +1,52 @@
+#pragma once
+
+#include "device_memory_allocator.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <cstring>
+
+// One persistently mapped uniform buffer split into a partition per frame in flight. Per-draw data is bump
+// allocated from the current frame's partition and bound with VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC offsets,
+// so nothing gets mapped, unmapped or reallocated while rendering. A partition may only be reused once the fence of
+// the frame that last wrote to it has signaled.
+class UniformRingBuffer
+{
+public:
+    // extra_usage adds to VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, e.g. storage for shaders that index the whole buffer
+    bool init(VkDevice device, DeviceMemoryAllocator& allocator, uint32_t frame_count, VkDeviceSize frame_capacity,
+              VkBufferUsageFlags extra_usage = 0);
+    void destroy(DeviceMemoryAllocator& allocator);
+
+    void begin_frame(uint32_t frame_index);
+
+    // Copies size bytes into the current frame's partition. Returns false when the partition is full.
+    bool allocate(const void* data, VkDeviceSize size, uint32_t& dynamic_offset);
+
+    // Reserves count elements of element_size bytes, each at a valid dynamic offset, for the caller to fill in place.
+    // Element i sits at first_dynamic_offset + i * element_stride. Returns nullptr when the partition is full.
+    void* allocate_array(VkDeviceSize element_size, uint32_t count, VkDeviceSize& element_stride, uint32_t& first_dynamic_offset);
+
+    template <typename T>
+    bool push(const T& value, uint32_t& dynamic_offset) {
+        return allocate(&value, sizeof(T), dynamic_offset);
+    }
+
+    // Makes this frame's writes visible to the device, a no-op on host coherent memory
+    void flush() const;
+
+    VkBuffer buffer() const { return buffer_; }
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkBuffer buffer_ = VK_NULL_HANDLE;
+    Allocation allocation_;
+    bool coherent_ = true;
+
+    VkDeviceSize alignment_ = 0;
+    VkDeviceSize non_coherent_atom_size_ = 1;
+    VkDeviceSize frame_capacity_ = 0;
+    VkDeviceSize frame_begin_ = 0;
+    VkDeviceSize head_ = 0;
+};
@@ -0,0 +1,171 @@
+#include "vertex_formats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VERTEX_FORMATS_SSE2
+#include <emmintrin.h>
+#endif
+
+// Both paths read MeshVertex as six consecutive floats
+static_assert(sizeof(MeshVertex) == 6 * sizeof(float) && offsetof(MeshVertex, color) == 3 * sizeof(float),
+    "MeshVertex must be tightly packed");
+static_assert(sizeof(PackedVertex) == 12, "PackedVertex must stay 12 bytes");
+
+namespace
+{
+    constexpr float SNORM16_MAX = 32767.f;
+    constexpr float UNORM8_MAX = 255.f;
+
+    // nearbyint() honours the current rounding mode, nearest even by default, same as cvtps2dq
+    int16_t to_snorm16(float value) {
+        return int16_t(std::nearbyint(std::min(std::max(value, -1.f), 1.f) * SNORM16_MAX));
+    }
+
+    // Same as the Vulkan conversion rule, -32768 maps to -1 like -32767 does
+    float from_snorm16(int16_t value) {
+        return std::max(float(value) * (1.f / SNORM16_MAX), -1.f);
+    }
+}
+
+VertexQuantization vertex_quantization_for_bounds(const glm::vec3& bounds_min, const glm::vec3& bounds_max) {
+    VertexQuantization quantization;
+    quantization.center = 0.5f * (bounds_min + bounds_max);
+    for (int axis = 0; axis < 3; axis++) {
+        // Flat meshes have a zero extent along some axis, anything nonzero maps that axis to 0 exactly
+        const float half_extent = 0.5f * (bounds_max[axis] - bounds_min[axis]);
+        quantization.half_extent[axis] = half_extent > 0.f ? half_extent : 1.f;
+    }
+    return quantization;
+}
+
+#ifdef VERTEX_FORMATS_SSE2
+
+void quantize_vertices(const MeshVertex* vertices, size_t count, const VertexQuantization& quantization, PackedVertex* packed) {
+    const auto& center = quantization.center;
+    const auto& half_extent = quantization.half_extent;
+    // w ends up 0: its lanes are zeroed by the scale before conversion
+    const __m128 offset = _mm_setr_ps(center.x, center.y, center.z, 0.f);
+    const __m128 position_scale = _mm_setr_ps(SNORM16_MAX / half_extent.x, SNORM16_MAX / half_extent.y, SNORM16_MAX / half_extent.z, 0.f);
+    const __m128 position_limit = _mm_set1_ps(SNORM16_MAX);
+    const __m128 color_scale = _mm_set1_ps(UNORM8_MAX);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+
+    for (size_t v = 0; v < count; v++) {
+        // Two overlapping unaligned loads cover the six floats without reading past the vertex:
+        // low = (px, py, pz, r), high = (pz, r, g, b)
+        const auto* floats = reinterpret_cast<const float*>(vertices + v);
+        const __m128 low = _mm_loadu_ps(floats);
+        const __m128 high = _mm_loadu_ps(floats + 2);
+
+        // Scaling before clamping saves a multiply, the limit is the scaled [-1, 1]
+        __m128 position = _mm_mul_ps(_mm_sub_ps(low, offset), position_scale);
+        position = _mm_min_ps(_mm_max_ps(position, _mm_sub_ps(zero, position_limit)), position_limit);
+        const __m128i position_words = _mm_packs_epi32(_mm_cvtps_epi32(position), _mm_setzero_si128());
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&packed[v].position), position_words);
+
+        // (r, g, b, 1): (g, b, 1, 1) first, then r and g from high, b and 1 from that
+        const __m128 green_blue_one = _mm_shuffle_ps(high, one, _MM_SHUFFLE(0, 0, 3, 2));
+        __m128 color = _mm_shuffle_ps(high, green_blue_one, _MM_SHUFFLE(2, 1, 2, 1));
+        color = _mm_mul_ps(_mm_min_ps(_mm_max_ps(color, zero), one), color_scale);
+        const __m128i color_words = _mm_packs_epi32(_mm_cvtps_epi32(color), _mm_setzero_si128());
+        const int color_bytes = _mm_cvtsi128_si32(_mm_packus_epi16(color_words, _mm_setzero_si128()));
+        memcpy(&packed[v].color, &color_bytes, sizeof(color_bytes));
+    }
+}
+
+void dequantize_vertices(const PackedVertex* packed, size_t count, const VertexQuantization& quantization, MeshVertex* vertices) {
+    const auto& center = quantization.center;
+    const auto& half_extent = quantization.half_extent;
+    const __m128 offset = _mm_setr_ps(center.x, center.y, center.z, 0.f);
+    const __m128 position_scale = _mm_setr_ps(half_extent.x, half_extent.y, half_extent.z, 0.f);
+    const __m128 snorm_scale = _mm_set1_ps(1.f / SNORM16_MAX);
+    const __m128 color_scale = _mm_set1_ps(1.f / UNORM8_MAX);
+    const __m128 minus_one = _mm_set1_ps(-1.f);
+
+    for (size_t v = 0; v < count; v++) {
+        // Sign extend the four int16 by interleaving them into the high halves and shifting back down
+        const __m128i position_words = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&packed[v].position));
+        const __m128i position_dwords = _mm_srai_epi32(_mm_unpacklo_epi16(position_words, position_words), 16);
+        __m128 position = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(position_dwords), snorm_scale), minus_one);
+        position = _mm_add_ps(_mm_mul_ps(position, position_scale), offset);
+
+        int color_bytes;
+        memcpy(&color_bytes, &packed[v].color, sizeof(color_bytes));
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i color_dwords = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(color_bytes), zero), zero);
+        const __m128 color = _mm_mul_ps(_mm_cvtepi32_ps(color_dwords), color_scale);
+
+        // Stores overlap the same way the loads do: (px, py, pz, -) then (pz, r, g, b) on top
+        auto* floats = reinterpret_cast<float*>(vertices + v);
+        _mm_storeu_ps(floats, position);
+        const __m128 z_and_red = _mm_shuffle_ps(position, color, _MM_SHUFFLE(0, 0, 2, 2));
+        _mm_storeu_ps(floats + 2, _mm_shuffle_ps(z_and_red, color, _MM_SHUFFLE(2, 1, 2, 0)));
+    }
+}
+
+#else
+
+namespace
+{
+    // Scaled first and clamped after like the SSE2 path, so both round the same values
+    int16_t quantize_coordinate(float value, float center, float half_extent) {
+        const float scaled = (value - center) * (SNORM16_MAX / half_extent);
+        return int16_t(std::nearbyint(std::min(std::max(scaled, -SNORM16_MAX), SNORM16_MAX)));
+    }
+
+    uint8_t to_unorm8(float value) {
+        return uint8_t(std::nearbyint(std::min(std::max(value, 0.f), 1.f) * UNORM8_MAX));
+    }
+}
+
+void quantize_vertices(const MeshVertex* vertices, size_t count, const VertexQuantization& quantization, PackedVertex* packed) {
+    for (size_t v = 0; v < count; v++) {
+        for (int axis = 0; axis < 3; axis++) {
+            packed[v].position.values[axis] = quantize_coordinate(vertices[v].position[axis], quantization.center[axis], quantization.half_extent[axis]);
+            packed[v].color.values[axis] = to_unorm8(vertices[v].color[axis]);
+        }
+        packed[v].position.values[3] = 0;
+        packed[v].color.values[3] = uint8_t(UNORM8_MAX);
+    }
+}
+
+void dequantize_vertices(const PackedVertex* packed, size_t count, const VertexQuantization& quantization, MeshVertex* vertices) {
+    for (size_t v = 0; v < count; v++) {
+        for (int axis = 0; axis < 3; axis++) {
+            vertices[v].position[axis] = from_snorm16(packed[v].position.values[axis]) * quantization.half_extent[axis] + quantization.center[axis];
+            vertices[v].color[axis] = float(packed[v].color.values[axis]) * (1.f / UNORM8_MAX);
+        }
+    }
+}
+
+#endif
+
+Snorm16x2 encode_octahedral(const glm::vec3& normal) {
+    const float l1_norm = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    float x = l1_norm > 0.f ? normal.x / l1_norm : 0.f;
+    float y = l1_norm > 0.f ? normal.y / l1_norm : 0.f;
+    // The lower hemisphere folds over the diagonals onto the outer triangles of the square
+    if (normal.z < 0.f) {
+        const float folded_x = (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f);
+        const float folded_y = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+        x = folded_x;
+        y = folded_y;
+    }
+    return {{to_snorm16(x), to_snorm16(y)}};
+}
+
+glm::vec3 decode_octahedral(const Snorm16x2& encoded) {
+    const float x = from_snorm16(encoded.values[0]);
+    const float y = from_snorm16(encoded.values[1]);
+    glm::vec3 normal(x, y, 1.f - std::abs(x) - std::abs(y));
+    if (normal.z < 0.f) {
+        normal.x = (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f);
+        normal.y = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+    }
+    const float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+    return glm::vec3(normal.x / length, normal.y / length, normal.z / length);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "mesh_loader.hpp"
+#include "vertex_layout.hpp"
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+// Packed vertex components. The GPU expands them back to floats on fetch, shaders read them as plain vecN.
+struct Snorm16x4
+{
+    int16_t values[4];
+};
+
+struct Snorm16x2
+{
+    int16_t values[2];
+};
+
+struct Unorm8x4
+{
+    uint8_t values[4];
+};
+
+template <> struct VertexAttributeFormat<Snorm16x4> { static constexpr VkFormat format = VK_FORMAT_R16G16B16A16_SNORM; static constexpr uint32_t locations = 1; };
+template <> struct VertexAttributeFormat<Snorm16x2> { static constexpr VkFormat format = VK_FORMAT_R16G16_SNORM; static constexpr uint32_t locations = 1; };
+template <> struct VertexAttributeFormat<Unorm8x4> { static constexpr VkFormat format = VK_FORMAT_R8G8B8A8_UNORM; static constexpr uint32_t locations = 1; };
+
+// 12 bytes instead of MeshVertex's 24. Positions are stored relative to the mesh bounds (see VertexQuantization) with
+// 16 bits per axis, i.e. 1/65534 of the extent, far below a pixel for anything but extreme close-ups. w is unused.
+struct PackedVertex
+{
+    Snorm16x4 position;
+    Unorm8x4 color;
+};
+
+template <> struct VertexLayout<MeshVertex>
+{
+    static constexpr std::array<VertexAttribute, 2> attributes = {{
+        VERTEX_ATTRIBUTE(MeshVertex, position, 0),
+        VERTEX_ATTRIBUTE(MeshVertex, color, 1),
+    }};
+};
+
+template <> struct VertexLayout<PackedVertex>
+{
+    static constexpr std::array<VertexAttribute, 2> attributes = {{
+        VERTEX_ATTRIBUTE(PackedVertex, position, 0),
+        VERTEX_ATTRIBUTE(PackedVertex, color, 1),
+    }};
+};
+
+// Maps the mesh bounds onto [-1, 1] per axis: packed = (position - center) / half_extent. The inverse is the matrix
+// translate(center) * scale(half_extent), folded into the model transform so shaders never see the difference.
+struct VertexQuantization
+{
+    glm::vec3 center = glm::vec3(0.f);
+    glm::vec3 half_extent = glm::vec3(1.f);
+};
+
+VertexQuantization vertex_quantization_for_bounds(const glm::vec3& bounds_min, const glm::vec3& bounds_max);
+
+// SSE2 where available, scalar otherwise. Both round to nearest even and give bit identical results.
+void quantize_vertices(const MeshVertex* vertices, size_t count, const VertexQuantization& quantization, PackedVertex* packed);
+void dequantize_vertices(const PackedVertex* packed, size_t count, const VertexQuantization& quantization, MeshVertex* vertices);
+
+// Octahedral unit vector encoding: the direction is projected onto an octahedron which is unfolded into a square,
+// two snorm16 components with an angular error well below what shading can show
+Snorm16x2 encode_octahedral(const glm::vec3& normal);
+glm::vec3 decode_octahedral(const Snorm16x2& encoded);
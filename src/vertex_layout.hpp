@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Vertex input descriptions derived from the vertex structs themselves. A vertex type declares its attributes once by
+// specializing VertexLayout:
+//
+//   template <> struct VertexLayout<MyVertex>
+//   {
+//       static constexpr std::array<VertexAttribute, 2> attributes = {{
+//           VERTEX_ATTRIBUTE(MyVertex, position, 0),
+//           VERTEX_ATTRIBUTE(MyVertex, color, 1),
+//       }};
+//   };
+//
+// Formats come from the member types through VertexAttributeFormat, offsets from offsetof(), so the descriptions can't
+// drift from the struct. Attributes spanning several locations (matrices) are expanded to one description per column.
+
+// Maps a member type to the VkFormat it is read with. Specialize it for new component types.
+template <typename T>
+struct VertexAttributeFormat;
+
+template <> struct VertexAttributeFormat<float> { static constexpr VkFormat format = VK_FORMAT_R32_SFLOAT; static constexpr uint32_t locations = 1; };
+template <> struct VertexAttributeFormat<glm::vec2> { static constexpr VkFormat format = VK_FORMAT_R32G32_SFLOAT; static constexpr uint32_t locations = 1; };
+template <> struct VertexAttributeFormat<glm::vec3> { static constexpr VkFormat format = VK_FORMAT_R32G32B32_SFLOAT; static constexpr uint32_t locations = 1; };
+template <> struct VertexAttributeFormat<glm::vec4> { static constexpr VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT; static constexpr uint32_t locations = 1; };
+// A mat4 attribute takes four consecutive locations, one vec4 column each
+template <> struct VertexAttributeFormat<glm::mat4> { static constexpr VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT; static constexpr uint32_t locations = 4; };
+
+struct VertexAttribute
+{
+    uint32_t location;
+    VkFormat format;
+    uint32_t offset;
+    // Consecutive locations taken, each one format-sized column after the previous
+    uint32_t locations;
+    uint32_t column_size;
+};
+
+template <typename T>
+constexpr VertexAttribute make_vertex_attribute(uint32_t location, size_t offset) {
+    return {location, VertexAttributeFormat<T>::format, uint32_t(offset), VertexAttributeFormat<T>::locations,
+        uint32_t(sizeof(T) / VertexAttributeFormat<T>::locations)};
+}
+
+#define VERTEX_ATTRIBUTE(vertex, member, location) \
+    make_vertex_attribute<decltype(vertex::member)>(location, offsetof(vertex, member))
+
+template <typename Vertex>
+struct VertexLayout;
+
+template <typename Vertex>
+constexpr size_t vertex_location_count() {
+    size_t count = 0;
+    for (const auto& attribute : VertexLayout<Vertex>::attributes) count += attribute.locations;
+    return count;
+}
+
+template <typename Vertex>
+VkVertexInputBindingDescription vertex_binding_description(uint32_t binding, VkVertexInputRate input_rate = VK_VERTEX_INPUT_RATE_VERTEX) {
+    VkVertexInputBindingDescription binding_description = {};
+
+    binding_description.binding = binding;
+    binding_description.stride = sizeof(Vertex);
+    binding_description.inputRate = input_rate;
+
+    return binding_description;
+}
+
+template <typename Vertex>
+std::array<VkVertexInputAttributeDescription, vertex_location_count<Vertex>()> vertex_attribute_descriptions(uint32_t binding) {
+    std::array<VkVertexInputAttributeDescription, vertex_location_count<Vertex>()> attribute_descriptions = {};
+
+    size_t next = 0;
+    for (const auto& attribute : VertexLayout<Vertex>::attributes) {
+        for (uint32_t column = 0; column < attribute.locations; column++) {
+            attribute_descriptions[next].binding = binding;
+            attribute_descriptions[next].location = attribute.location + column;
+            attribute_descriptions[next].format = attribute.format;
+            attribute_descriptions[next].offset = attribute.offset + column * attribute.column_size;
+            next++;
+        }
+    }
+
+    return attribute_descriptions;
+}